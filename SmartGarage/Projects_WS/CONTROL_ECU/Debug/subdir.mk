@@ -4,34 +4,49 @@
 
 # Add inputs and outputs from these tool invocations to the build variables 
 C_SRCS += \
+../adc.c \
 ../buzzer.c \
 ../dc_motor.c \
+../door_control.c \
+../door_sensor.c \
 ../external_eeprom.c \
 ../gpio.c \
 ../main.c \
+../protocol.c \
 ../pwm_timer0.c \
+../scheduler.c \
 ../timer.c \
 ../twi.c \
 ../uart.c 
 
 OBJS += \
+./adc.o \
 ./buzzer.o \
 ./dc_motor.o \
+./door_control.o \
+./door_sensor.o \
 ./external_eeprom.o \
 ./gpio.o \
 ./main.o \
+./protocol.o \
 ./pwm_timer0.o \
+./scheduler.o \
 ./timer.o \
 ./twi.o \
 ./uart.o 
 
 C_DEPS += \
+./adc.d \
 ./buzzer.d \
 ./dc_motor.d \
+./door_control.d \
+./door_sensor.d \
 ./external_eeprom.d \
 ./gpio.d \
 ./main.d \
+./protocol.d \
 ./pwm_timer0.d \
+./scheduler.d \
 ./timer.d \
 ./twi.d \
 ./uart.d 
@@ -0,0 +1,170 @@
+/******************************************************************************
+ *
+ * Module: ADC
+ *
+ * File Name: adc.c
+ *
+ * Description: Source file for the ATmega32 free running ADC driver
+ *
+ * Author: Shehab Kishta
+ *
+ *******************************************************************************/
+
+#include "adc.h"
+#include "avr/io.h" /* To use the ADC Registers */
+#include <avr/interrupt.h> /* For ADC ISR */
+
+#define ADC_BUFFER_MASK			(ADC_BUFFER_SIZE - 1)
+
+/* ADCSRA bits without ADIF: writing a pending ADIF back as one would clear it and lose the sample */
+#define ADC_CONTROL_BITS		((uint8)~(1<<ADIF))
+
+#if ((ADC_BUFFER_SIZE & ADC_BUFFER_MASK) != 0)
+#error "ADC_BUFFER_SIZE must be a power of 2"
+#endif
+#if (ADC_BUFFER_SIZE * ADC_MAXIMUM_VALUE > 0xFFFF)
+#error "ADC_BUFFER_SIZE is too large for the 16-bit running sum"
+#endif
+
+/*******************************************************************************
+ *                           Global Variables                                  *
+ *******************************************************************************/
+/*
+ * Ring buffer of the last samples and their running sum: each new sample replaces
+ * the oldest one in the sum, so the average costs no loop in the ISR.
+ */
+static uint16 g_buffer[ADC_BUFFER_SIZE];
+static uint8 g_bufferIndex = 0;
+static volatile uint16 g_sum = 0;
+static volatile uint16 g_sample = 0;
+
+static void (*g_ADC_callBackPtr)(void) = NULL_PTR;
+
+/*******************************************************************************
+ *                       Interrupt Service Routines                            *
+ *******************************************************************************/
+ISR(ADC_vect)
+{
+	uint16 sample = ADC;
+
+	g_sum = g_sum - g_buffer[g_bufferIndex] + sample;
+	g_buffer[g_bufferIndex] = sample;
+	g_bufferIndex = (g_bufferIndex + 1) & ADC_BUFFER_MASK;
+	g_sample = sample;
+
+	if(g_ADC_callBackPtr != NULL_PTR)
+	{
+		/* Call the Call Back function in the application after each sample */
+		(*g_ADC_callBackPtr)();
+	}
+}
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Initialize the ADC driver with the required reference voltage and prescaler.
+ * The ADC is enabled but does not convert until ADC_startFreeRunning.
+ */
+void ADC_init(const ADC_ConfigType * Config_Ptr)
+{
+	/*
+	 * ADMUX Register Bits Description:
+	 * REFS1:0 = the required reference voltage
+	 * ADLAR   = 0 right adjusted
+	 * MUX4:0  = 00000 to choose channel 0 as initialization
+	 */
+	ADMUX = (Config_Ptr->ref_volt) << REFS0;
+
+	/*
+	 * ADCSRA Register Bits Description:
+	 * ADEN    = 1 Enable ADC
+	 * ADIE    = 0 Disable ADC Interrupt until the conversions start
+	 * ADATE   = 0 Disable Auto Trigger until the conversions start
+	 * ADPS2:0 = the required prescaler
+	 */
+	ADCSRA = (1<<ADEN) | (Config_Ptr->prescaler);
+}
+
+/*
+ * Description :
+ * Convert the required channel continuously in free running mode:
+ * each conversion complete interrupt puts the sample in the ring buffer,
+ * updates the running sum and calls the call back function.
+ */
+void ADC_startFreeRunning(uint8 channel_num)
+{
+	uint8 i;
+
+	ADC_stop();
+
+	/* The average starts from zero, it is valid after ADC_BUFFER_SIZE samples */
+	for(i = 0 ; i < ADC_BUFFER_SIZE ; i++)
+	{
+		g_buffer[i] = 0;
+	}
+	g_bufferIndex = 0;
+	g_sum = 0;
+	g_sample = 0;
+
+	/* Choose the channel by MUX4:0 and keep the reference voltage */
+	ADMUX = (ADMUX & 0xE0) | (channel_num & (ADC_NUM_OF_CHANNELS - 1));
+
+	/* Free running mode ADTS2:0 = 000 */
+	SFIOR &= ~((1<<ADTS2) | (1<<ADTS1) | (1<<ADTS0));
+
+	/* Clear a pending flag, then start the first conversion with the auto trigger and the interrupt */
+	ADCSRA |= (1<<ADIF) | (1<<ADATE) | (1<<ADIE) | (1<<ADSC);
+}
+
+/*
+ * Description :
+ * Stop the free running conversions.
+ */
+void ADC_stop(void)
+{
+	ADCSRA = (ADCSRA & ADC_CONTROL_BITS) & ~((1<<ADATE) | (1<<ADIE));
+}
+
+/*
+ * Description :
+ * Return the last sample.
+ */
+uint16 ADC_getSample(void)
+{
+	uint8 control = ADCSRA & ADC_CONTROL_BITS;
+	uint16 sample;
+
+	/* 16-bit value shared with the ADC ISR, read it with the interrupt masked */
+	ADCSRA = control & ~(1<<ADIE);
+	sample = g_sample;
+	ADCSRA = control;
+	return sample;
+}
+
+/*
+ * Description :
+ * Return the average of the last ADC_BUFFER_SIZE samples.
+ */
+uint16 ADC_getAverage(void)
+{
+	uint8 control = ADCSRA & ADC_CONTROL_BITS;
+	uint16 sum;
+
+	/* 16-bit value shared with the ADC ISR, read it with the interrupt masked */
+	ADCSRA = control & ~(1<<ADIE);
+	sum = g_sum;
+	ADCSRA = control;
+	return sum / ADC_BUFFER_SIZE;
+}
+
+/*
+ * Description :
+ * Set the call back function called after each sample, from the ADC interrupt.
+ */
+void ADC_setCallBack(void(*a_ptr)(void))
+{
+	g_ADC_callBackPtr = a_ptr;
+}
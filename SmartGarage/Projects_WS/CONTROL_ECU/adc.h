@@ -0,0 +1,96 @@
+/******************************************************************************
+ *
+ * Module: ADC
+ *
+ * File Name: adc.h
+ *
+ * Description: header file for the ATmega32 free running ADC driver
+ *
+ * Author: Shehab Kishta
+ *
+ *******************************************************************************/
+
+#ifndef ADC_H_
+#define ADC_H_
+
+#include "std_types.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+#define ADC_MAXIMUM_VALUE           1023
+#define ADC_NUM_OF_CHANNELS         8
+
+/* Samples kept in the ring buffer for the running average, must be a power of 2 */
+#define ADC_BUFFER_SIZE             16
+
+/* One conversion takes 13 ADC clocks in free running mode */
+#define ADC_CONVERSION_CLOCKS       13
+
+/*******************************************************************************
+ *                               Types Declaration                             *
+ *******************************************************************************/
+typedef enum
+{
+	ADC_AREF,ADC_AVCC,ADC_INTERNAL_2_56V=3
+}ADC_ReferenceVoltage;
+
+/*
+ * ADC clock = F_CPU / prescaler, it must be 50KHz --> 200KHz for the full 10-bit resolution:
+ * at 8MHz F_CPU/64 = 125KHz (9615 samples/s) and F_CPU/128 = 62.5KHz (4808 samples/s).
+ */
+typedef enum
+{
+	ADC_F_CPU_2=1,ADC_F_CPU_4,ADC_F_CPU_8,ADC_F_CPU_16,ADC_F_CPU_32,ADC_F_CPU_64,ADC_F_CPU_128
+}ADC_Prescaler;
+
+typedef struct
+{
+	ADC_ReferenceVoltage ref_volt;
+	ADC_Prescaler prescaler;
+}ADC_ConfigType;
+
+/*******************************************************************************
+ *                      Functions Prototypes                                   *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Initialize the ADC driver with the required reference voltage and prescaler.
+ * The ADC is enabled but does not convert until ADC_startFreeRunning.
+ */
+void ADC_init(const ADC_ConfigType * Config_Ptr);
+
+/*
+ * Description :
+ * Convert the required channel continuously in free running mode:
+ * each conversion complete interrupt puts the sample in the ring buffer,
+ * updates the running sum and calls the call back function.
+ */
+void ADC_startFreeRunning(uint8 channel_num);
+
+/*
+ * Description :
+ * Stop the free running conversions.
+ */
+void ADC_stop(void);
+
+/*
+ * Description :
+ * Return the last sample.
+ */
+uint16 ADC_getSample(void);
+
+/*
+ * Description :
+ * Return the average of the last ADC_BUFFER_SIZE samples.
+ */
+uint16 ADC_getAverage(void);
+
+/*
+ * Description :
+ * Set the call back function called after each sample, from the ADC interrupt.
+ */
+void ADC_setCallBack(void(*a_ptr)(void));
+
+#endif /* ADC_H_ */
@@ -1,4 +1,4 @@
- /******************************************************************************
+/******************************************************************************
  *
  * Module: BUZZER
  *
@@ -11,6 +11,113 @@
  *******************************************************************************/
 #include "buzzer.h"
 #include "gpio.h"
+#include <avr/interrupt.h> /* For Timer2 compare ISR */
+
+/* Timer2 updates in one millisecond, the sweeps and the step times count milliseconds */
+#define BUZZER_UPDATES_PER_MS       (BUZZER_UPDATE_RATE_HZ / 1000)
+
+/*
+ * Phase increment of a tone in 1/256 steps: f * 65536 * 256 / BUZZER_UPDATE_RATE_HZ,
+ * written as f * 2^18 / (rate / 64) so it fits 32 bits up to 8KHz.
+ */
+#define BUZZER_HZ_TO_INCREMENT(HZ)  ((((sint32)(HZ)) << 18) / (BUZZER_UPDATE_RATE_HZ / 64))
+
+#define BUZZER_BEEP_HZ              2000
+#define BUZZER_BEEP_TIME_MS         100
+#define BUZZER_CHIRP_HZ             3000
+#define BUZZER_CHIRP_TIME_MS        30
+
+/*******************************************************************************
+ *                           Global Variables                                  *
+ *******************************************************************************/
+const Buzzer_StepType Buzzer_sirenSteps[BUZZER_SIREN_STEPS] =
+{
+	{800, 2000, BUZZER_SIREN_PERIOD_MS / 2},
+	{2000, 800, BUZZER_SIREN_PERIOD_MS / 2}
+};
+
+static const Buzzer_StepType g_beepSteps[2] =
+{
+	{BUZZER_BEEP_HZ, BUZZER_BEEP_HZ, BUZZER_BEEP_TIME_MS},
+	{0, 0, BUZZER_BEEP_TIME_MS}
+};
+
+static const Buzzer_StepType g_chirpSteps[1] =
+{
+	{BUZZER_CHIRP_HZ, BUZZER_CHIRP_HZ, BUZZER_CHIRP_TIME_MS}
+};
+
+static Buzzer_PatternType g_beepPattern = {g_beepSteps, 2, 1};
+static const Buzzer_PatternType g_chirpPattern = {g_chirpSteps, 1, 1};
+
+/* Pattern state, written by Buzzer_play while Timer2 is stopped and then by the Timer2 ISR only */
+static Buzzer_PatternType g_pattern;
+static uint8 g_step;
+static uint8 g_repeatLeft;
+static uint16 g_stepMs;
+static uint8 g_msUpdates;
+static uint16 g_phase;
+static sint32 g_increment;      /* Phase increment in 1/256 steps */
+static sint32 g_sweepDelta;     /* Increment change every millisecond */
+static uint8 g_output;
+static volatile boolean g_playing = FALSE;
+
+/*******************************************************************************
+ *                      Functions Prototypes(Private)                          *
+ *******************************************************************************/
+static void Buzzer_startStep(void);
+static void Buzzer_timerStop(void);
+
+/*******************************************************************************
+ *                       Interrupt Service Routines                            *
+ *******************************************************************************/
+ISR(TIMER2_COMP_vect)
+{
+	uint8 output = LOGIC_LOW;
+
+	/* Square wave from the top bit of the phase accumulator, silence at 0Hz */
+	g_phase += (uint16)(g_increment >> 8);
+	if((g_increment != 0) && (g_phase & 0x8000))
+	{
+		output = LOGIC_HIGH;
+	}
+	if(output != g_output)
+	{
+		g_output = output;
+		GPIO_writePin(BUZZER_PORT, BUZZER_PIN, output);
+	}
+
+	if(--g_msUpdates != 0)
+	{
+		return;
+	}
+	g_msUpdates = BUZZER_UPDATES_PER_MS;
+	g_increment += g_sweepDelta;
+
+	if(--g_stepMs != 0)
+	{
+		return;
+	}
+	g_step++;
+	if(g_step == g_pattern.num_of_steps)
+	{
+		g_step = 0;
+		if(g_repeatLeft != BUZZER_REPEAT_FOREVER)
+		{
+			g_repeatLeft--;
+			if(g_repeatLeft == 0)
+			{
+				Buzzer_timerStop();
+				return;
+			}
+		}
+	}
+	Buzzer_startStep();
+}
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
 
 /*
  * Description
@@ -19,21 +126,122 @@
 void Buzzer_init(void)
 {
 	GPIO_setupPinDirection(BUZZER_PORT, BUZZER_PIN, PIN_OUTPUT);
-	GPIO_writePin(BUZZER_PORT, BUZZER_PIN, LOGIC_LOW);
+	Buzzer_stop();
 }
 /*
  * Description
- * Function to Activate the BUZZER.
+ * Function to Activate the BUZZER, it stops the running pattern.
  */
 void Buzzer_on(void)
 {
+	Buzzer_timerStop();
 	GPIO_writePin(BUZZER_PORT, BUZZER_PIN, LOGIC_HIGH);
 }
 /*
  * Description
- * Function to DeActivate the BUZZER.
+ * Function to DeActivate the BUZZER, it stops the running pattern.
  */
 void Buzzer_off(void)
 {
+	Buzzer_stop();
+}
+/*
+ * Description
+ * Function to start playing a pattern from the Timer2 interrupt and return at once.
+ * The steps of the pattern must stay in memory while it plays, a new pattern replaces the running one.
+ */
+void Buzzer_play(const Buzzer_PatternType *pattern)
+{
+	Buzzer_stop();
+	if((pattern->num_of_steps == 0) || (pattern->steps == NULL_PTR))
+	{
+		return;
+	}
+
+	g_pattern = *pattern;
+	g_step = 0;
+	g_repeatLeft = pattern->repeat;
+	g_msUpdates = BUZZER_UPDATES_PER_MS;
+	g_phase = 0;
+	Buzzer_startStep();
+	g_playing = TRUE;
+
+	/*
+	 * Configure Timer2 control register
+	 * 1. Compare mode WGM21=1 & WGM20=0, OC2 disconnected COM21:0=0
+	 * 2. clock = F_CPU/8 CS22:0=010
+	 */
+	TCNT2 = 0;
+	OCR2 = BUZZER_TIMER_COMPARE_VALUE;
+	TIFR = (1<<OCF2);
+	TCCR2 = (1<<WGM21) | (1<<CS21);
+	SET_BIT(TIMSK,OCIE2);
+}
+/*
+ * Description
+ * Function to play count short beeps.
+ */
+void Buzzer_beep(uint8 count)
+{
+	if(count == 0)
+	{
+		return;
+	}
+	g_beepPattern.repeat = count;
+	Buzzer_play(&g_beepPattern);
+}
+/*
+ * Description
+ * Function to play one short high chirp, the key press sound.
+ */
+void Buzzer_chirp(void)
+{
+	Buzzer_play(&g_chirpPattern);
+}
+/*
+ * Description
+ * Function to stop the running pattern and silence the BUZZER.
+ */
+void Buzzer_stop(void)
+{
+	Buzzer_timerStop();
+	g_output = LOGIC_LOW;
 	GPIO_writePin(BUZZER_PORT, BUZZER_PIN, LOGIC_LOW);
 }
+/*
+ * Description
+ * Function to check if a pattern is still playing.
+ */
+boolean Buzzer_isPlaying(void)
+{
+	return g_playing;
+}
+/*
+ * Description
+ * Function to load the current step: its first frequency and the increment change
+ * of its sweep, computed once here so the ISR only adds.
+ */
+static void Buzzer_startStep(void)
+{
+	const Buzzer_StepType *step = &g_pattern.steps[g_step];
+	sint32 end_increment = BUZZER_HZ_TO_INCREMENT(step->end_hz);
+
+	g_increment = BUZZER_HZ_TO_INCREMENT(step->start_hz);
+	g_stepMs = step->time_ms;
+	if(g_stepMs == 0)
+	{
+		/* Shortest step is one millisecond */
+		g_stepMs = 1;
+	}
+	g_sweepDelta = (end_increment - g_increment) / g_stepMs;
+}
+/*
+ * Description
+ * Function to stop Timer2 and its interrupt, the pattern ends.
+ */
+static void Buzzer_timerStop(void)
+{
+	CLEAR_BIT(TIMSK,OCIE2);
+	TCCR2 = 0;
+	g_playing = FALSE;
+}
@@ -1,4 +1,4 @@
- /******************************************************************************
+/******************************************************************************
  *
  * Module: BUZZER
  *
@@ -25,6 +25,47 @@
 #define BUZZER_PORT                 PORTA_ID
 #define BUZZER_PIN                  PIN7_ID
 
+/*
+ * Timer2 compare mode with F_CPU/8: (124 + 1) * 1us = 125us, 8000 updates per second.
+ * The tones are square waves up to 4KHz from a phase accumulator.
+ */
+#define BUZZER_TIMER_COMPARE_VALUE  124
+#define BUZZER_UPDATE_RATE_HZ       8000
+
+/* Repeat count of a pattern that plays until Buzzer_stop */
+#define BUZZER_REPEAT_FOREVER       0
+
+/* Steps of the predefined sounds */
+#define BUZZER_SIREN_STEPS          2
+#define BUZZER_SIREN_PERIOD_MS      1000
+
+/*******************************************************************************
+ *                               Types Declaration                             *
+ *******************************************************************************/
+/*
+ * One step of a pattern: a tone sweeping from start_hz to end_hz in time_ms,
+ * the same frequency twice is a plain tone and 0Hz is a silence.
+ */
+typedef struct
+{
+	uint16 start_hz;
+	uint16 end_hz;
+	uint16 time_ms;
+}Buzzer_StepType;
+
+/* A pattern plays its steps in order, repeat times or until Buzzer_stop with BUZZER_REPEAT_FOREVER */
+typedef struct
+{
+	const Buzzer_StepType *steps;
+	uint8 num_of_steps;
+	uint8 repeat;
+}Buzzer_PatternType;
+
+/*******************************************************************************
+ *                           Global Variables                                  *
+ *******************************************************************************/
+/* Siren sweep up and down in BUZZER_SIREN_PERIOD_MS */
+extern const Buzzer_StepType Buzzer_sirenSteps[BUZZER_SIREN_STEPS];
 
 /*******************************************************************************
  *                      Functions Prototypes                                   *
@@ -36,14 +77,40 @@
 void Buzzer_init(void);
 /*
  * Description
- * Function to Activate the BUZZER.
+ * Function to Activate the BUZZER, it stops the running pattern.
  */
 void Buzzer_on(void);
 /*
  * Description
- * Function to DeActivate the BUZZER.
+ * Function to DeActivate the BUZZER, it stops the running pattern.
  */
 void Buzzer_off(void);
+/*
+ * Description
+ * Function to start playing a pattern from the Timer2 interrupt and return at once.
+ * The steps of the pattern must stay in memory while it plays, a new pattern replaces the running one.
+ */
+void Buzzer_play(const Buzzer_PatternType *pattern);
+/*
+ * Description
+ * Function to play count short beeps.
+ */
+void Buzzer_beep(uint8 count);
+/*
+ * Description
+ * Function to play one short high chirp, the key press sound.
+ */
+void Buzzer_chirp(void);
+/*
+ * Description
+ * Function to stop the running pattern and silence the BUZZER.
+ */
+void Buzzer_stop(void);
+/*
+ * Description
+ * Function to check if a pattern is still playing.
+ */
+boolean Buzzer_isPlaying(void);
 
 
 #endif /* BUZZER_H_ */
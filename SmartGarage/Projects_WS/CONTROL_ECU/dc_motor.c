@@ -1,4 +1,4 @@
- /******************************************************************************
+/******************************************************************************
  *
  * Module: DC Motor
  *
@@ -13,12 +13,70 @@
 #include "dc_motor.h"
 #include "gpio.h"
 #include "pwm_timer0.h"
+#include "scheduler.h"
+#include "adc.h"
+
+/* 31.25KHz PWM at 8MHz, above the audible range */
+#define DC_MOTOR_PWM_PRESCALER		PWM_F_CPU_CLOCK
+
+/* ADC clock F_CPU/128 = 62.5KHz, the ADPS value n divides by 2^n: 4808 current samples/s at 8MHz */
+#define DC_MOTOR_ADC_PRESCALER		ADC_F_CPU_128
+#define DC_MOTOR_SAMPLE_RATE_HZ		((F_CPU >> DC_MOTOR_ADC_PRESCALER) / ADC_CONVERSION_CLOCKS)
+#define DC_MOTOR_MS_TO_SAMPLES(MS)	((uint16)(((uint32)(MS) * DC_MOTOR_SAMPLE_RATE_HZ) / 1000))
+
+/*******************************************************************************
+ *                           Global Variables                                  *
+ *******************************************************************************/
+static const ADC_ConfigType g_adcConfiguration = {ADC_AVCC, DC_MOTOR_ADC_PRESCALER};
+
+static DcMotor_ProfileType g_profile;
+static uint32 g_profileTime = 0;
+static SCHEDULER_TimerId g_rampTimer = SCHEDULER_NO_TIMER;
+static void (*g_profileDoneCallBackPtr)(void) = NULL_PTR;
+
+/* Last driven direction, kept while the motor coasts until a brake dead time ends */
+static DcMotor_State g_direction = DC_MOTOR_STOP;
+static volatile DcMotor_State g_driveState = DC_MOTOR_STOP;
+static uint32 g_brakeStart = 0;
+
+/* Direction and speed waiting for the end of the reversal dead time, timed from g_brakeStart
+ * when no scheduler timer was free */
+static boolean g_reversing = FALSE;
+static SCHEDULER_TimerId g_deadTimer = SCHEDULER_NO_TIMER;
+static DcMotor_State g_pendingState = DC_MOTOR_STOP;
+static uint8 g_pendingSpeed = 0;
+
+/* Fault latched by the current monitor, the other monitor variables are used by the ADC ISR only */
+static volatile DcMotor_FaultType g_fault = DC_MOTOR_NO_FAULT;
+static DcMotor_State g_monitorState = DC_MOTOR_STOP;
+static uint16 g_runSamples = 0;
+static uint16 g_stallSamples = 0;
+
+/* Emergency stop, kept over DcMotor_clearFault until DcMotor_releaseEmergencyStop */
+static volatile boolean g_emergencyStop = FALSE;
+
+/*******************************************************************************
+ *                      Functions Prototypes(Private)                          *
+ *******************************************************************************/
+static void DcMotor_drive(DcMotor_State state,uint8 speed);
+static void DcMotor_setSpeed(uint8 speed);
+static void DcMotor_deadTimeEnd(void);
+static void DcMotor_reversalCheck(void);
+static void DcMotor_profileStep(void);
+static void DcMotor_currentCheck(void);
+static void DcMotor_cut(void);
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
 
 /*
  * Description :
  * Initialize the DC Motor by:
  * 1. Setup the direction of the two motor pins as output by send the request to GPIO driver.
  * 2. Stop the motor at the beginning
+ * 3. Start the PWM with 0% duty.
+ * 4. Start the current monitor on the free running ADC.
  */
 void DcMotor_Init(void)
 {
@@ -29,22 +87,81 @@ void DcMotor_Init(void)
 	/* Motor is stopped at the beginning */
 	GPIO_writePin(DC_MOTOR_PORT1_ID,DC_MOTOR_PIN1_ID,LOGIC_LOW);
 	GPIO_writePin(DC_MOTOR_PORT2_ID,DC_MOTOR_PIN2_ID,LOGIC_LOW);
+
+	PWM_Timer0_init(DC_MOTOR_PWM_PRESCALER);
+
+	ADC_init(&g_adcConfiguration);
+	ADC_setCallBack(DcMotor_currentCheck);
+	ADC_startFreeRunning(DC_MOTOR_CURRENT_CHANNEL);
 }
 
 /*
  * Description :
- * 1. Rotate  or Stop the motor according to the state input variable.
+ * 1. Rotate, Brake or Stop (coast) the motor according to the state input variable.
  * 2. Control the motor speed 0 --> 100% from its maximum speed by sending to PWM driver.
+ * 3. Reversing the last driven direction brakes for DC_MOTOR_DEAD_TIME_MS first, unless the
+ *    motor is braked that long already. The new direction is applied later from the scheduler,
+ *    without a free timer by the next profile step or DcMotor_Rotate call after the dead time.
+ * 4. While a fault is latched the motor is not driven in any direction.
  */
 void DcMotor_Rotate(DcMotor_State state,uint8 speed)
 {
+	if(g_reversing)
+	{
+		if(state == g_pendingState)
+		{
+			/* Same reversal, only the speed changes */
+			g_pendingSpeed = speed;
+			DcMotor_reversalCheck();
+			return;
+		}
+		/* Another command cancels the waiting reversal */
+		SCHEDULER_stopTimer(g_deadTimer);
+		g_deadTimer = SCHEDULER_NO_TIMER;
+		g_reversing = FALSE;
+	}
+
+	if((g_driveState == DC_MOTOR_BRAKE) && SCHEDULER_isTimeout(g_brakeStart, DC_MOTOR_DEAD_TIME_MS))
+	{
+		/* Braked long enough already, the motor is stopped */
+		g_direction = DC_MOTOR_STOP;
+	}
+
+	if(((state == DC_MOTOR_CW) && (g_direction == DC_MOTOR_ACW)) ||
+			((state == DC_MOTOR_ACW) && (g_direction == DC_MOTOR_CW)))
+	{
+		DcMotor_drive(DC_MOTOR_BRAKE, 0);
+		g_pendingState = state;
+		g_pendingSpeed = speed;
+		g_reversing = TRUE;
+		/* Without a free timer SCHEDULER_NO_TIMER is kept and DcMotor_reversalCheck ends the dead time */
+		g_deadTimer = SCHEDULER_startTimer(DC_MOTOR_DEAD_TIME_MS, SCHEDULER_ONE_SHOT, DcMotor_deadTimeEnd);
+		return;
+	}
+
+	DcMotor_drive(state, speed);
+}
+
+/*
+ * Description :
+ * Write the H-bridge inputs and the PWM duty of the required state.
+ */
+static void DcMotor_drive(DcMotor_State state,uint8 speed)
+{
+	if(((g_fault != DC_MOTOR_NO_FAULT) || g_emergencyStop) && ((state == DC_MOTOR_CW) || (state == DC_MOTOR_ACW)))
+	{
+		/* The motor has been cut, it stays cut until the fault is cleared */
+		return;
+	}
+
 	if(state == DC_MOTOR_CW)
 	{
 		/* Rotates the Motor CW */
 		GPIO_writePin(DC_MOTOR_PORT1_ID,DC_MOTOR_PIN1_ID,LOGIC_LOW);
 		GPIO_writePin(DC_MOTOR_PORT2_ID,DC_MOTOR_PIN2_ID,LOGIC_HIGH);
 
-		PWM_Timer0_Start(speed);
+		PWM_Timer0_setDuty(speed);
+		g_direction = DC_MOTOR_CW;
 	}
 	else if(state == DC_MOTOR_ACW)
 	{
@@ -52,18 +169,308 @@ void DcMotor_Rotate(DcMotor_State state,uint8 speed)
 		GPIO_writePin(DC_MOTOR_PORT1_ID,DC_MOTOR_PIN1_ID,LOGIC_HIGH);
 		GPIO_writePin(DC_MOTOR_PORT2_ID,DC_MOTOR_PIN2_ID,LOGIC_LOW);
 
-		PWM_Timer0_Start(speed);
+		PWM_Timer0_setDuty(speed);
+		g_direction = DC_MOTOR_ACW;
 	}
 	else if(state == DC_MOTOR_STOP)
 	{
-		/* Stop the Motor */
+		/* Stop the Motor, it coasts and keeps its direction.
+		 * The enable goes low first: from a brake, the inputs pass through a CW drive */
+		PWM_Timer0_setDuty(speed);
+
 		GPIO_writePin(DC_MOTOR_PORT1_ID,DC_MOTOR_PIN1_ID,LOGIC_LOW);
 		GPIO_writePin(DC_MOTOR_PORT2_ID,DC_MOTOR_PIN2_ID,LOGIC_LOW);
+	}
+	else if(state == DC_MOTOR_BRAKE)
+	{
+		/* Brake the Motor, the enable input must be fully on to short the windings */
+		GPIO_writePin(DC_MOTOR_PORT1_ID,DC_MOTOR_PIN1_ID,LOGIC_HIGH);
+		GPIO_writePin(DC_MOTOR_PORT2_ID,DC_MOTOR_PIN2_ID,LOGIC_HIGH);
 
-		PWM_Timer0_Start(speed);
+		PWM_Timer0_setDuty(100);
+		if(g_driveState != DC_MOTOR_BRAKE)
+		{
+			g_brakeStart = SCHEDULER_getMillis();
+		}
 	}
 	else
 	{
 		/* Invalid Input State - Do Nothing */
+		return;
+	}
+	g_driveState = state;
+}
+
+/*
+ * Description :
+ * Run a speed profile in the background, one step every DC_MOTOR_RAMP_STEP_MS from the scheduler.
+ * The motor is braked at the end and a_ptr is called, it may be NULL_PTR.
+ * A fault ends the profile early with the motor cut. A new profile replaces the running one
+ * and clears the latched fault.
+ */
+void DcMotor_startProfile(DcMotor_State state, const DcMotor_ProfileType *profile, void(*a_ptr)(void))
+{
+	SCHEDULER_stopTimer(g_rampTimer);
+
+	g_profile = *profile;
+	g_profileTime = 0;
+	g_profileDoneCallBackPtr = a_ptr;
+	DcMotor_clearFault();
+
+	/* The steps take the timer first, they also end a reversal that finds no free timer */
+	g_rampTimer = SCHEDULER_startTimer(DC_MOTOR_RAMP_STEP_MS, SCHEDULER_PERIODIC, DcMotor_profileStep);
+
+	/* Set the direction with the speed at the start, 0% unless the profile has no acceleration ramp */
+	DcMotor_Rotate(state, DcMotor_profileSpeed(&g_profile, 0));
+}
+
+/*
+ * Description :
+ * Return the speed of the profile at time_ms from its start.
+ */
+uint8 DcMotor_profileSpeed(const DcMotor_ProfileType *profile, uint32 time_ms)
+{
+	uint32 decel_start = (uint32)profile->accel_time_ms + profile->cruise_time_ms;
+	uint32 end = decel_start + profile->decel_time_ms;
+
+	if(time_ms < profile->accel_time_ms)
+	{
+		return (uint8)(((uint32)profile->cruise_speed * time_ms) / profile->accel_time_ms);
+	}
+	else if(time_ms < decel_start)
+	{
+		return profile->cruise_speed;
+	}
+	else if(time_ms < end)
+	{
+		return (uint8)(((uint32)profile->cruise_speed * (end - time_ms)) / profile->decel_time_ms);
+	}
+	else
+	{
+		return 0;
+	}
+}
+
+/*
+ * Description :
+ * Change the speed of the running direction, or of the direction waiting for the dead time.
+ */
+static void DcMotor_setSpeed(uint8 speed)
+{
+	if(g_reversing)
+	{
+		g_pendingSpeed = speed;
+		DcMotor_reversalCheck();
+	}
+	else
+	{
+		PWM_Timer0_setDuty(speed);
+	}
+}
+
+/*
+ * Description :
+ * Scheduler call back at the end of the reversal dead time, the motor is stopped now.
+ */
+static void DcMotor_deadTimeEnd(void)
+{
+	g_deadTimer = SCHEDULER_NO_TIMER;
+	g_reversing = FALSE;
+	g_direction = DC_MOTOR_STOP;
+	DcMotor_drive(g_pendingState, g_pendingSpeed);
+}
+
+/*
+ * Description :
+ * End the dead time of a reversal that found no free timer, once the motor is braked
+ * DC_MOTOR_DEAD_TIME_MS from g_brakeStart.
+ */
+static void DcMotor_reversalCheck(void)
+{
+	if(g_reversing && (g_deadTimer == SCHEDULER_NO_TIMER) && SCHEDULER_isTimeout(g_brakeStart, DC_MOTOR_DEAD_TIME_MS))
+	{
+		DcMotor_deadTimeEnd();
+	}
+}
+
+/*
+ * Description :
+ * Scheduler call back of the running profile: set the speed of the current step,
+ * or stop the motor and call the done call back at the end of the profile or on a fault.
+ * The speed is computed from the profile time, so the steps do not add up errors.
+ */
+static void DcMotor_profileStep(void)
+{
+	void (*callBackPtr)(void);
+	uint32 end = (uint32)g_profile.accel_time_ms + g_profile.cruise_time_ms + g_profile.decel_time_ms;
+
+	g_profileTime += DC_MOTOR_RAMP_STEP_MS;
+	if((g_profileTime < end) && (DcMotor_getFault() == DC_MOTOR_NO_FAULT))
+	{
+		DcMotor_setSpeed(DcMotor_profileSpeed(&g_profile, g_profileTime));
+		return;
+	}
+
+	SCHEDULER_stopTimer(g_rampTimer);
+	g_rampTimer = SCHEDULER_NO_TIMER;
+	if(((g_fault == DC_MOTOR_STALL) || (g_fault == DC_MOTOR_OVERCURRENT)) && !g_emergencyStop)
+	{
+		/* Leave the cut motor coasting, braking adds to the fault current */
+		DcMotor_Rotate(DC_MOTOR_STOP, 0);
+	}
+	else
+	{
+		DcMotor_Rotate(DC_MOTOR_BRAKE, 0);
+	}
+
+	/* The call back may start the next profile */
+	callBackPtr = g_profileDoneCallBackPtr;
+	g_profileDoneCallBackPtr = NULL_PTR;
+	if(callBackPtr != NULL_PTR)
+	{
+		(*callBackPtr)();
+	}
+}
+
+/*
+ * Description :
+ * Return the latched fault of the current monitor. The monitor cuts the motor from the ADC
+ * interrupt: within the averaging time of the samples for an over-current, and
+ * DC_MOTOR_STALL_TIME_MS after the inrush time for a stall.
+ */
+DcMotor_FaultType DcMotor_getFault(void)
+{
+	if(g_emergencyStop)
+	{
+		return DC_MOTOR_EMERGENCY_STOP;
+	}
+	return g_fault;
+}
+
+/*
+ * Description :
+ * Clear the latched fault so the motor can be driven again. An emergency stop is kept.
+ */
+void DcMotor_clearFault(void)
+{
+	g_fault = DC_MOTOR_NO_FAULT;
+}
+
+/*
+ * Description :
+ * Brake the motor at once and latch DC_MOTOR_OBSTACLE, to be called from the ISR of a safety input.
+ * A fault of the current monitor is kept, the motor is cut already.
+ */
+void DcMotor_obstacleStop(void)
+{
+	if(g_fault == DC_MOTOR_NO_FAULT)
+	{
+		g_fault = DC_MOTOR_OBSTACLE;
+		DcMotor_cut();
+	}
+}
+
+/*
+ * Description :
+ * Brake the motor at once and latch DC_MOTOR_EMERGENCY_STOP, to be called from the ISR of the stop command.
+ * The motor is not driven again until DcMotor_releaseEmergencyStop, DcMotor_clearFault keeps it.
+ */
+void DcMotor_emergencyStop(void)
+{
+	g_emergencyStop = TRUE;
+	if((g_fault == DC_MOTOR_NO_FAULT) || (g_fault == DC_MOTOR_OBSTACLE))
+	{
+		DcMotor_cut();
+	}
+}
+
+/*
+ * Description :
+ * Release the emergency stop, for the next command of the user.
+ */
+void DcMotor_releaseEmergencyStop(void)
+{
+	g_emergencyStop = FALSE;
+}
+
+/*
+ * Description :
+ * ADC call back after each current sample, runs in the ADC ISR:
+ * 1. An average current above DC_MOTOR_OVERCURRENT_LIMIT cuts the motor at once.
+ * 2. After the inrush time of a start, an average current above DC_MOTOR_STALL_LIMIT
+ *    for DC_MOTOR_STALL_TIME_MS cuts the motor as stalled.
+ * 3. While a fault is latched a driven motor is cut again, so a drive written by the
+ *    main loop together with the fault is undone with the next sample.
+ */
+static void DcMotor_currentCheck(void)
+{
+	DcMotor_State state = g_driveState;
+	uint16 current;
+
+	if((state != DC_MOTOR_CW) && (state != DC_MOTOR_ACW))
+	{
+		g_monitorState = state;
+		return;
+	}
+	if((g_fault != DC_MOTOR_NO_FAULT) || g_emergencyStop)
+	{
+		/* The next drive after the fault is cleared is a new start */
+		g_monitorState = DC_MOTOR_STOP;
+		DcMotor_cut();
+		return;
+	}
+	if(state != g_monitorState)
+	{
+		/* The motor starts now */
+		g_monitorState = state;
+		g_runSamples = 0;
+		g_stallSamples = 0;
+	}
+
+	current = ADC_getAverage();
+	if(current >= DC_MOTOR_OVERCURRENT_LIMIT)
+	{
+		g_fault = DC_MOTOR_OVERCURRENT;
+		DcMotor_cut();
+	}
+	else if(g_runSamples < DC_MOTOR_MS_TO_SAMPLES(DC_MOTOR_INRUSH_TIME_MS))
+	{
+		g_runSamples++;
+	}
+	else if(current >= DC_MOTOR_STALL_LIMIT)
+	{
+		g_stallSamples++;
+		if(g_stallSamples >= DC_MOTOR_MS_TO_SAMPLES(DC_MOTOR_STALL_TIME_MS))
+		{
+			g_fault = DC_MOTOR_STALL;
+			DcMotor_cut();
+		}
+	}
+	else
+	{
+		g_stallSamples = 0;
+	}
+}
+
+/*
+ * Description :
+ * Cut the motor from interrupt context according to the latched fault:
+ * 0% duty then both inputs low for a current fault so the motor coasts,
+ * both inputs high and 100% duty for an obstacle or an emergency stop so the motor brakes.
+ * The drive state is left to the main loop, it sees the fault and stops the motor itself.
+ */
+static void DcMotor_cut(void)
+{
+	if((g_fault == DC_MOTOR_OBSTACLE) || g_emergencyStop)
+	{
+		GPIO_writePin(DC_MOTOR_PORT1_ID,DC_MOTOR_PIN1_ID,LOGIC_HIGH);
+		GPIO_writePin(DC_MOTOR_PORT2_ID,DC_MOTOR_PIN2_ID,LOGIC_HIGH);
+		PWM_Timer0_setDuty(100);
+	}
+	else
+	{
+		PWM_Timer0_setDuty(0);
+		GPIO_writePin(DC_MOTOR_PORT1_ID,DC_MOTOR_PIN1_ID,LOGIC_LOW);
+		GPIO_writePin(DC_MOTOR_PORT2_ID,DC_MOTOR_PIN2_ID,LOGIC_LOW);
 	}
 }
@@ -1,4 +1,4 @@
- /******************************************************************************
+/******************************************************************************
  *
  * Module: DC Motor
  *
@@ -25,14 +25,62 @@
 #define DC_MOTOR_PIN1_ID    PIN0_ID
 #define DC_MOTOR_PIN2_ID    PIN1_ID
 
+/* Period of the speed profile steps */
+#define DC_MOTOR_RAMP_STEP_MS    10
+
+/* Brake time forced between the two directions so the H-bridge never reverses a running motor */
+#define DC_MOTOR_DEAD_TIME_MS    100
+
+/* Motor current measured on the shunt resistor, ADC channel 0 (PA0) with the AVCC 5V reference */
+#define DC_MOTOR_CURRENT_CHANNEL       0
+
+/*
+ * Current limits in ADC counts of the shunt voltage, 4.9mV per count is 22mA with the 0.22 ohm shunt.
+ * An average above DC_MOTOR_OVERCURRENT_LIMIT cuts the motor at once, an average above
+ * DC_MOTOR_STALL_LIMIT for DC_MOTOR_STALL_TIME_MS cuts it as stalled.
+ * The stall check starts DC_MOTOR_INRUSH_TIME_MS after the motor starts, the start current is higher.
+ */
+#define DC_MOTOR_OVERCURRENT_LIMIT     136     /* 3A */
+#define DC_MOTOR_STALL_LIMIT           68      /* 1.5A */
+#define DC_MOTOR_STALL_TIME_MS         100
+#define DC_MOTOR_INRUSH_TIME_MS        200
+
 /*******************************************************************************
  *                               Types Declaration                             *
  *******************************************************************************/
+/*
+ * DC_MOTOR_STOP  : both inputs low, the motor coasts to a stop.
+ * DC_MOTOR_BRAKE : both inputs high, the motor windings are shorted and it stops fast.
+ */
 typedef enum
 {
-	DC_MOTOR_STOP,DC_MOTOR_CW,DC_MOTOR_ACW
+	DC_MOTOR_STOP,DC_MOTOR_CW,DC_MOTOR_ACW,DC_MOTOR_BRAKE,DC_MOTOR_COAST=DC_MOTOR_STOP
 }DcMotor_State;
 
+/*
+ * DC_MOTOR_STALL and DC_MOTOR_OVERCURRENT : the current monitor has cut the motor, it coasts.
+ * DC_MOTOR_OBSTACLE : DcMotor_obstacleStop has braked the motor.
+ * DC_MOTOR_EMERGENCY_STOP : DcMotor_emergencyStop has braked the motor, it is reported over
+ * any other fault until DcMotor_releaseEmergencyStop.
+ */
+typedef enum
+{
+	DC_MOTOR_NO_FAULT,DC_MOTOR_STALL,DC_MOTOR_OVERCURRENT,DC_MOTOR_OBSTACLE,DC_MOTOR_EMERGENCY_STOP
+}DcMotor_FaultType;
+
+/*
+ * Trapezoidal speed profile of one move:
+ * the speed rises from 0 to cruise_speed in accel_time_ms, stays for cruise_time_ms,
+ * then falls back to 0 in decel_time_ms.
+ */
+typedef struct
+{
+	uint8 cruise_speed;
+	uint16 accel_time_ms;
+	uint16 cruise_time_ms;
+	uint16 decel_time_ms;
+}DcMotor_ProfileType;
+
 /*******************************************************************************
  *                              Functions Prototypes                           *
  *******************************************************************************/
@@ -42,15 +90,70 @@ typedef enum
  * Initialize the DC Motor by:
  * 1. Setup the direction of the two motor pins as output by send the request to GPIO driver.
  * 2. Stop the motor at the beginning
+ * 3. Start the PWM with 0% duty.
+ * 4. Start the current monitor on the free running ADC.
  */
 void DcMotor_Init(void);
 
 /*
  * Description :
- * 1. Rotate  or Stop the motor according to the state input variable.
+ * 1. Rotate, Brake or Stop (coast) the motor according to the state input variable.
  * 2. Control the motor speed 0 --> 100% from its maximum speed by sending to PWM driver.
+ * 3. Reversing the last driven direction brakes for DC_MOTOR_DEAD_TIME_MS first, unless the
+ *    motor is braked that long already. The new direction is applied later from the scheduler,
+ *    without a free timer by the next profile step or DcMotor_Rotate call after the dead time.
+ * 4. While a fault is latched the motor is not driven in any direction.
  */
 void DcMotor_Rotate(DcMotor_State state,uint8 speed);
 
+/*
+ * Description :
+ * Run a speed profile in the background, one step every DC_MOTOR_RAMP_STEP_MS from the scheduler.
+ * The motor is braked at the end and a_ptr is called, it may be NULL_PTR.
+ * A fault ends the profile early with the motor cut. A new profile replaces the running one
+ * and clears the latched fault.
+ */
+void DcMotor_startProfile(DcMotor_State state, const DcMotor_ProfileType *profile, void(*a_ptr)(void));
+
+/*
+ * Description :
+ * Return the speed of the profile at time_ms from its start.
+ */
+uint8 DcMotor_profileSpeed(const DcMotor_ProfileType *profile, uint32 time_ms);
+
+/*
+ * Description :
+ * Return the latched fault of the current monitor. The monitor cuts the motor from the ADC
+ * interrupt: within the averaging time of the samples for an over-current, and
+ * DC_MOTOR_STALL_TIME_MS after the inrush time for a stall.
+ */
+DcMotor_FaultType DcMotor_getFault(void);
+
+/*
+ * Description :
+ * Clear the latched fault so the motor can be driven again. An emergency stop is kept.
+ */
+void DcMotor_clearFault(void);
+
+/*
+ * Description :
+ * Brake the motor at once and latch DC_MOTOR_OBSTACLE, to be called from the ISR of a safety input.
+ * A fault of the current monitor is kept, the motor is cut already.
+ */
+void DcMotor_obstacleStop(void);
+
+/*
+ * Description :
+ * Brake the motor at once and latch DC_MOTOR_EMERGENCY_STOP, to be called from the ISR of the stop command.
+ * The motor is not driven again until DcMotor_releaseEmergencyStop, DcMotor_clearFault keeps it.
+ */
+void DcMotor_emergencyStop(void);
+
+/*
+ * Description :
+ * Release the emergency stop, for the next command of the user.
+ */
+void DcMotor_releaseEmergencyStop(void);
+
 
 #endif /* DC_MOTOR_H_ */
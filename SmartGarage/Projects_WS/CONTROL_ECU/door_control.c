@@ -0,0 +1,284 @@
+/******************************************************************************
+ *
+ * Module: Door Control
+ *
+ * File Name: door_control.c
+ *
+ * Description: source file for the closed loop door position controller
+ *
+ * Author: Shehab Kishta
+ *
+ *******************************************************************************/
+
+#include "door_control.h"
+#include "door_sensor.h"
+#include "scheduler.h"
+
+/*******************************************************************************
+ *                           Global Variables                                  *
+ *******************************************************************************/
+/* Door position in encoder counts from the closed end */
+static uint16 g_position = 0;
+static uint16 g_lastCount = 0;
+
+/* Cleared when a move leaves the door at an unknown place, set again by a limit switch */
+static boolean g_positionKnown = TRUE;
+static boolean g_moveCounted = FALSE;
+
+static DcMotor_State g_direction = DC_MOTOR_STOP;
+static DcMotor_ProfileType g_profile;
+static uint32 g_moveTime = 0;
+static SCHEDULER_TimerId g_stepTimer = SCHEDULER_NO_TIMER;
+static void (*g_moveDoneCallBackPtr)(void) = NULL_PTR;
+
+/* Set while a closing move runs, read by the obstacle ISR */
+static volatile boolean g_closing = FALSE;
+
+/*******************************************************************************
+ *                      Functions Prototypes(Private)                          *
+ *******************************************************************************/
+static uint16 DoorControl_updatePosition(void);
+static void DoorControl_step(void);
+static void DoorControl_obstacle(void);
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Initialize the position inputs, the door is taken as closed unless the open limit switch is pressed.
+ * The obstacle beam stops a closing move from its interrupt.
+ */
+void DoorControl_init(void)
+{
+	DoorSensor_setObstacleCallBack(DoorControl_obstacle);
+	DoorSensor_init();
+	g_lastCount = DoorSensor_getCount();
+
+	if(DoorSensor_isOpen())
+	{
+		g_position = DOOR_CONTROL_TRAVEL_COUNTS;
+	}
+	else
+	{
+		g_position = 0;
+	}
+}
+
+/*
+ * Description :
+ * Move the door to the end of the required direction in the background, one step every
+ * DOOR_CONTROL_STEP_MS from the scheduler:
+ * 1. The speed follows the profile, and falls near the end of the travel.
+ * 2. The motor is braked as soon as the door arrives: its limit switch is pressed or
+ *    the encoder position reaches the end.
+ * 3. The profile time is the limit of the move. A door that has not arrived by then is
+ *    braked where it is and its position is unknown, see DoorControl_isPositionKnown.
+ * 4. A stall or an over-current cut by the DC motor current monitor ends the move early.
+ * 5. Breaking the obstacle beam brakes a closing move from the interrupt and ends it,
+ *    DcMotor_getFault returns DC_MOTOR_OBSTACLE then.
+ * 6. An emergency stop brakes any move and ends it, DcMotor_getFault returns
+ *    DC_MOTOR_EMERGENCY_STOP then.
+ * a_ptr is called when the move ends, it may be NULL_PTR. A new move replaces the running one.
+ */
+void DoorControl_move(DcMotor_State direction, const DcMotor_ProfileType *profile, void(*a_ptr)(void))
+{
+	SCHEDULER_stopTimer(g_stepTimer);
+	g_closing = FALSE;
+
+	/* Counts of the last move that came after its end still belong to it */
+	DoorControl_updatePosition();
+
+	g_direction = direction;
+	g_profile = *profile;
+	g_moveTime = 0;
+	g_moveDoneCallBackPtr = a_ptr;
+	g_moveCounted = FALSE;
+
+	/* A new move is a new attempt after a stall or an over-current */
+	DcMotor_clearFault();
+
+	/* Set the direction with 0% duty, the first step starts the ramp */
+	DcMotor_Rotate(direction, 0);
+	g_stepTimer = SCHEDULER_startTimer(DOOR_CONTROL_STEP_MS, SCHEDULER_PERIODIC, DoorControl_step);
+	g_closing = (direction == DOOR_CONTROL_CLOSE_DIRECTION);
+}
+
+/*
+ * Description :
+ * End the running move at once with the motor braked, its call back is not called.
+ */
+void DoorControl_stop(void)
+{
+	if(g_stepTimer != SCHEDULER_NO_TIMER)
+	{
+		DoorControl_updatePosition();
+		if(g_moveCounted == FALSE)
+		{
+			/* Stopped on the way with nothing counted */
+			g_positionKnown = FALSE;
+		}
+	}
+	SCHEDULER_stopTimer(g_stepTimer);
+	g_stepTimer = SCHEDULER_NO_TIMER;
+	g_closing = FALSE;
+	g_moveDoneCallBackPtr = NULL_PTR;
+	DcMotor_Rotate(DC_MOTOR_BRAKE, 0);
+}
+
+/*
+ * Description :
+ * Return the door opening in percent of the full travel, 0 closed --> 100 open,
+ * from the position of the last move step.
+ */
+uint8 DoorControl_getPercent(void)
+{
+	return (uint8)(((uint32)g_position * 100) / DOOR_CONTROL_TRAVEL_COUNTS);
+}
+
+/*
+ * Description :
+ * Return FALSE once a move has left the door at an unknown place: the move ended on its
+ * profile time, or it was ended early without any encoder count. The limit switch of
+ * the next move makes the position known again.
+ */
+boolean DoorControl_isPositionKnown(void)
+{
+	return g_positionKnown;
+}
+
+/*
+ * Description :
+ * Add the encoder counts since the last update in the move direction, the limit switches
+ * set the position to the exact end. Return the counts left to the end of the move.
+ */
+static uint16 DoorControl_updatePosition(void)
+{
+	uint16 count = DoorSensor_getCount();
+	uint16 moved = count - g_lastCount;
+
+	g_lastCount = count;
+	if(moved != 0)
+	{
+		g_moveCounted = TRUE;
+	}
+
+	if(g_direction == DOOR_CONTROL_OPEN_DIRECTION)
+	{
+		if(moved > (DOOR_CONTROL_TRAVEL_COUNTS - g_position))
+		{
+			moved = DOOR_CONTROL_TRAVEL_COUNTS - g_position;
+		}
+		g_position += moved;
+		if(DoorSensor_isOpen())
+		{
+			g_position = DOOR_CONTROL_TRAVEL_COUNTS;
+			g_positionKnown = TRUE;
+		}
+		return DOOR_CONTROL_TRAVEL_COUNTS - g_position;
+	}
+	else if(g_direction == DOOR_CONTROL_CLOSE_DIRECTION)
+	{
+		if(moved > g_position)
+		{
+			moved = g_position;
+		}
+		g_position -= moved;
+		if(DoorSensor_isClosed())
+		{
+			g_position = 0;
+			g_positionKnown = TRUE;
+		}
+		return g_position;
+	}
+	else
+	{
+		return 0;
+	}
+}
+
+/*
+ * Description :
+ * Scheduler call back of the running move:
+ * set the speed of the current step, or brake the motor and call the done call back
+ * when the door arrives or the profile time is over.
+ * The encoder counts arrive only from a known position. A move that ends on its profile
+ * time, or on a fault with nothing counted, leaves the door where it stopped and not at its end.
+ * A fault also ends the move, the call back reads it from DcMotor_getFault:
+ * the motor cut by the current monitor is left coasting, an obstacle or an emergency stop keeps braking.
+ */
+static void DoorControl_step(void)
+{
+	void (*callBackPtr)(void);
+	uint32 end = (uint32)g_profile.accel_time_ms + g_profile.cruise_time_ms + g_profile.decel_time_ms;
+	uint16 remaining = DoorControl_updatePosition();
+	boolean arrived = (remaining == 0) && g_positionKnown;
+	uint8 speed;
+	uint8 approach_speed;
+
+	g_moveTime += DOOR_CONTROL_STEP_MS;
+	if((DcMotor_getFault() == DC_MOTOR_OBSTACLE) || (DcMotor_getFault() == DC_MOTOR_EMERGENCY_STOP))
+	{
+		DcMotor_Rotate(DC_MOTOR_BRAKE, 0);
+		g_positionKnown = g_positionKnown && g_moveCounted;
+	}
+	else if(DcMotor_getFault() != DC_MOTOR_NO_FAULT)
+	{
+		DcMotor_Rotate(DC_MOTOR_STOP, 0);
+		g_positionKnown = g_positionKnown && g_moveCounted;
+	}
+	else if((arrived == FALSE) && (g_moveTime < end))
+	{
+		speed = DcMotor_profileSpeed(&g_profile, g_moveTime);
+		if(g_positionKnown && (remaining < DOOR_CONTROL_SLOW_COUNTS))
+		{
+			approach_speed = (uint8)(((uint32)g_profile.cruise_speed * remaining) / DOOR_CONTROL_SLOW_COUNTS);
+			if(approach_speed < DOOR_CONTROL_CREEP_SPEED)
+			{
+				approach_speed = DOOR_CONTROL_CREEP_SPEED;
+			}
+			if(approach_speed < speed)
+			{
+				speed = approach_speed;
+			}
+		}
+		DcMotor_Rotate(g_direction, speed);
+		return;
+	}
+	else
+	{
+		DcMotor_Rotate(DC_MOTOR_BRAKE, 0);
+
+		/* No sensor has seen the end, the door may have stopped anywhere */
+		if(arrived == FALSE)
+		{
+			g_positionKnown = FALSE;
+		}
+	}
+
+	SCHEDULER_stopTimer(g_stepTimer);
+	g_stepTimer = SCHEDULER_NO_TIMER;
+	g_closing = FALSE;
+
+	/* The call back may start the next move */
+	callBackPtr = g_moveDoneCallBackPtr;
+	g_moveDoneCallBackPtr = NULL_PTR;
+	if(callBackPtr != NULL_PTR)
+	{
+		(*callBackPtr)();
+	}
+}
+
+/*
+ * Description :
+ * Obstacle beam call back, runs in the INT1 ISR: brake a closing door at once.
+ * The next control step ends the move, the reversal waits for the main loop and the motor dead time.
+ */
+static void DoorControl_obstacle(void)
+{
+	if(g_closing)
+	{
+		DcMotor_obstacleStop();
+	}
+}
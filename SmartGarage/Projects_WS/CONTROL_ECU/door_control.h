@@ -0,0 +1,89 @@
+/******************************************************************************
+ *
+ * Module: Door Control
+ *
+ * File Name: door_control.h
+ *
+ * Description: header file for the closed loop door position controller
+ *
+ * Author: Shehab Kishta
+ *
+ *******************************************************************************/
+
+#ifndef DOOR_CONTROL_H_
+#define DOOR_CONTROL_H_
+
+#include "std_types.h"
+#include "dc_motor.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+/* Motor directions of the door moves */
+#define DOOR_CONTROL_OPEN_DIRECTION     DC_MOTOR_CW
+#define DOOR_CONTROL_CLOSE_DIRECTION    DC_MOTOR_ACW
+
+/* Period of the position control steps */
+#define DOOR_CONTROL_STEP_MS            10
+
+/* Encoder counts of the full door travel, from closed to open */
+#define DOOR_CONTROL_TRAVEL_COUNTS      1200
+
+/*
+ * Approach: in the last DOOR_CONTROL_SLOW_COUNTS the speed falls with the distance left,
+ * down to DOOR_CONTROL_CREEP_SPEED that is still enough to reach the limit switch.
+ */
+#define DOOR_CONTROL_SLOW_COUNTS        200
+#define DOOR_CONTROL_CREEP_SPEED        25
+
+/*******************************************************************************
+ *                              Functions Prototypes                           *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Initialize the position inputs, the door is taken as closed unless the open limit switch is pressed.
+ * The obstacle beam stops a closing move from its interrupt.
+ */
+void DoorControl_init(void);
+
+/*
+ * Description :
+ * Move the door to the end of the required direction in the background, one step every
+ * DOOR_CONTROL_STEP_MS from the scheduler:
+ * 1. The speed follows the profile, and falls near the end of the travel.
+ * 2. The motor is braked as soon as the door arrives: its limit switch is pressed or
+ *    the encoder position reaches the end.
+ * 3. The profile time is the limit of the move. A door that has not arrived by then is
+ *    braked where it is and its position is unknown, see DoorControl_isPositionKnown.
+ * 4. A stall or an over-current cut by the DC motor current monitor ends the move early.
+ * 5. Breaking the obstacle beam brakes a closing move from the interrupt and ends it,
+ *    DcMotor_getFault returns DC_MOTOR_OBSTACLE then.
+ * 6. An emergency stop brakes any move and ends it, DcMotor_getFault returns
+ *    DC_MOTOR_EMERGENCY_STOP then.
+ * a_ptr is called when the move ends, it may be NULL_PTR. A new move replaces the running one.
+ */
+void DoorControl_move(DcMotor_State direction, const DcMotor_ProfileType *profile, void(*a_ptr)(void));
+
+/*
+ * Description :
+ * End the running move at once with the motor braked, its call back is not called.
+ */
+void DoorControl_stop(void);
+
+/*
+ * Description :
+ * Return the door opening in percent of the full travel, 0 closed --> 100 open,
+ * from the position of the last move step.
+ */
+uint8 DoorControl_getPercent(void);
+
+/*
+ * Description :
+ * Return FALSE once a move has left the door at an unknown place: the move ended on its
+ * profile time, or it was ended early without any encoder count. The limit switch of
+ * the next move makes the position known again.
+ */
+boolean DoorControl_isPositionKnown(void);
+
+#endif /* DOOR_CONTROL_H_ */
@@ -0,0 +1,128 @@
+/******************************************************************************
+ *
+ * Module: Door Sensor
+ *
+ * File Name: door_sensor.c
+ *
+ * Description: source file for the door inputs: encoder, limit switches and obstacle beam
+ *
+ * Author: Shehab Kishta
+ *
+ *******************************************************************************/
+
+#include "door_sensor.h"
+#include "gpio.h"
+#include "common_macros.h" /* To use the macros like SET_BIT */
+#include "avr/io.h" /* To use the External Interrupts Registers */
+#include <avr/interrupt.h> /* For INT0/INT1 ISR */
+
+/*******************************************************************************
+ *                           Global Variables                                  *
+ *******************************************************************************/
+static volatile uint16 g_encoderCount = 0;
+
+static void (*g_obstacleCallBackPtr)(void) = NULL_PTR;
+
+/*******************************************************************************
+ *                       Interrupt Service Routines                            *
+ *******************************************************************************/
+ISR(INT0_vect)
+{
+	g_encoderCount++;
+}
+
+ISR(INT1_vect)
+{
+	if(g_obstacleCallBackPtr != NULL_PTR)
+	{
+		/* Call the Call Back function in the application at the beam break */
+		(*g_obstacleCallBackPtr)();
+	}
+}
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Initialize the door position inputs by:
+ * 1. Setup the encoder pin as input and count its rising edges on INT0.
+ * 2. Setup the two limit switch pins as inputs with the internal pull-ups.
+ * 3. Setup the obstacle beam pin as input with the internal pull-up and catch the beam break on INT1.
+ */
+void DoorSensor_init(void)
+{
+	GPIO_setupPinDirection(DOOR_SENSOR_ENCODER_PORT_ID,DOOR_SENSOR_ENCODER_PIN_ID,PIN_INPUT);
+
+	GPIO_setupPinDirection(DOOR_SENSOR_OPEN_PORT_ID,DOOR_SENSOR_OPEN_PIN_ID,PIN_INPUT);
+	GPIO_writePin(DOOR_SENSOR_OPEN_PORT_ID,DOOR_SENSOR_OPEN_PIN_ID,LOGIC_HIGH);
+	GPIO_setupPinDirection(DOOR_SENSOR_CLOSED_PORT_ID,DOOR_SENSOR_CLOSED_PIN_ID,PIN_INPUT);
+	GPIO_writePin(DOOR_SENSOR_CLOSED_PORT_ID,DOOR_SENSOR_CLOSED_PIN_ID,LOGIC_HIGH);
+	GPIO_setupPinDirection(DOOR_SENSOR_OBSTACLE_PORT_ID,DOOR_SENSOR_OBSTACLE_PIN_ID,PIN_INPUT);
+	GPIO_writePin(DOOR_SENSOR_OBSTACLE_PORT_ID,DOOR_SENSOR_OBSTACLE_PIN_ID,LOGIC_HIGH);
+
+	g_encoderCount = 0;
+
+	/* INT0 on the rising edge ISC01=1 & ISC00=1, clear a pending edge before enabling it */
+	MCUCR |= (1<<ISC01) | (1<<ISC00);
+	GIFR = (1<<INTF0);
+	SET_BIT(GICR,INT0);
+
+	/* INT1 on the falling edge ISC11=1 & ISC10=0, the beam break */
+	MCUCR = (MCUCR & ~(1<<ISC10)) | (1<<ISC11);
+	GIFR = (1<<INTF1);
+	SET_BIT(GICR,INT1);
+}
+
+/*
+ * Description :
+ * Return the free running encoder count, it wraps at 65536.
+ * The count has no direction, the difference of two readings is the distance moved between them.
+ */
+uint16 DoorSensor_getCount(void)
+{
+	uint16 count;
+
+	/* 16-bit value shared with the INT0 ISR, read it with the interrupt masked */
+	CLEAR_BIT(GICR,INT0);
+	count = g_encoderCount;
+	SET_BIT(GICR,INT0);
+	return count;
+}
+
+/*
+ * Description :
+ * Return TRUE while the door presses the open limit switch.
+ */
+boolean DoorSensor_isOpen(void)
+{
+	return (GPIO_readPin(DOOR_SENSOR_OPEN_PORT_ID,DOOR_SENSOR_OPEN_PIN_ID) == LOGIC_LOW);
+}
+
+/*
+ * Description :
+ * Return TRUE while the door presses the closed limit switch.
+ */
+boolean DoorSensor_isClosed(void)
+{
+	return (GPIO_readPin(DOOR_SENSOR_CLOSED_PORT_ID,DOOR_SENSOR_CLOSED_PIN_ID) == LOGIC_LOW);
+}
+
+/*
+ * Description :
+ * Return TRUE while the obstacle beam is broken.
+ */
+boolean DoorSensor_isObstacle(void)
+{
+	return (GPIO_readPin(DOOR_SENSOR_OBSTACLE_PORT_ID,DOOR_SENSOR_OBSTACLE_PIN_ID) == LOGIC_LOW);
+}
+
+/*
+ * Description :
+ * Set the call back function called from the INT1 ISR when the obstacle beam is broken.
+ */
+void DoorSensor_setObstacleCallBack(void(*a_ptr)(void))
+{
+	g_obstacleCallBackPtr = a_ptr;
+}
@@ -0,0 +1,79 @@
+/******************************************************************************
+ *
+ * Module: Door Sensor
+ *
+ * File Name: door_sensor.h
+ *
+ * Description: header file for the door inputs: encoder, limit switches and obstacle beam
+ *
+ * Author: Shehab Kishta
+ *
+ *******************************************************************************/
+
+#ifndef DOOR_SENSOR_H_
+#define DOOR_SENSOR_H_
+
+#include "std_types.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+/* Encoder pulse input on INT0, one count on each rising edge */
+#define DOOR_SENSOR_ENCODER_PORT_ID    PORTD_ID
+#define DOOR_SENSOR_ENCODER_PIN_ID     PIN2_ID
+
+/* Limit switches to ground with the internal pull-ups, low when the door reaches the end */
+#define DOOR_SENSOR_OPEN_PORT_ID       PORTD_ID
+#define DOOR_SENSOR_OPEN_PIN_ID        PIN4_ID
+#define DOOR_SENSOR_CLOSED_PORT_ID     PORTD_ID
+#define DOOR_SENSOR_CLOSED_PIN_ID      PIN5_ID
+
+/* Obstacle light barrier receiver on INT1 with the internal pull-up, low while the beam is broken */
+#define DOOR_SENSOR_OBSTACLE_PORT_ID   PORTD_ID
+#define DOOR_SENSOR_OBSTACLE_PIN_ID    PIN3_ID
+
+/*******************************************************************************
+ *                              Functions Prototypes                           *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Initialize the door position inputs by:
+ * 1. Setup the encoder pin as input and count its rising edges on INT0.
+ * 2. Setup the two limit switch pins as inputs with the internal pull-ups.
+ * 3. Setup the obstacle beam pin as input with the internal pull-up and catch the beam break on INT1.
+ */
+void DoorSensor_init(void);
+
+/*
+ * Description :
+ * Return the free running encoder count, it wraps at 65536.
+ * The count has no direction, the difference of two readings is the distance moved between them.
+ */
+uint16 DoorSensor_getCount(void);
+
+/*
+ * Description :
+ * Return TRUE while the door presses the open limit switch.
+ */
+boolean DoorSensor_isOpen(void);
+
+/*
+ * Description :
+ * Return TRUE while the door presses the closed limit switch.
+ */
+boolean DoorSensor_isClosed(void);
+
+/*
+ * Description :
+ * Return TRUE while the obstacle beam is broken.
+ */
+boolean DoorSensor_isObstacle(void);
+
+/*
+ * Description :
+ * Set the call back function called from the INT1 ISR when the obstacle beam is broken.
+ */
+void DoorSensor_setObstacleCallBack(void(*a_ptr)(void));
+
+#endif /* DOOR_SENSOR_H_ */
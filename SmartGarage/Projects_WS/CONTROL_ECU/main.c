@@ -15,81 +15,125 @@
 #include"uart.h"
 #include"common_macros.h"
 #include"dc_motor.h"
-#include"timer.h"
+#include"door_control.h"
+#include"door_sensor.h"
+#include"scheduler.h"
 #include"buzzer.h"
 #include"twi.h"
+#include"protocol.h"
 
 /*******************************************************************************
  *                                Definitions                                  *
  *******************************************************************************/
-#define READY                                              0xFF
-#define DONE                                               0xFE
-#define PASSWORD_SEND                                      0xFD
-#define PASSWORD_MATCH                                     0xFC
-#define PASSWORD_NOT_MATCHED                               0xFB
-#define PASSWORD_CONFIRMATION_SEND                         0xFA
-#define CHANGE_PASSWORD                                    0xF9
-#define OPEN_DOOR                                          0xF8
-#define CHECK_PASSWORD                                     0xF7
-#define WRONG_PASSWORD                                     0xF6
-#define CHECK_IF_SAVED                                     0xF5
-#define YES_SAVED                                          0xF4
-#define NO_SAVED_PASSWORD                                  0xF3
-#define DC_ON_TICKS                                        16
-#define DC_HOLD_TICKS                                      19
-#define TIMER_TICKS_STOP								   3
-#define TIMER_TICKS_1MINUTE                                60
-#define TIMER_TOTAL_TICKS								   33
+/* Times a jammed closing opens the door again before the cycle gives up */
+#define DOOR_MAX_REOPENS                                   3
 #define MAX_WRONG_COUNTER                                  3
-#define PASSWORD_SIZE                                	   5
 #define DEFUALT_VALUE_OF_EEPROM                            1
+#define PASSWORD_EEPROM_ADDRESS                            0x0311
+/* Door parameters block followed by its CRC-8, after the saved password */
+#define PARAMS_EEPROM_ADDRESS                              0x0320
+/* EEPROM bytes waiting to be written: one password and one parameters block with its CRC */
+#define MEMORY_QUEUE_SIZE                                  (PASSWORD_SIZE + PARAMS_SIZE + 1)
+/* Write cycle of the 24C16, the next byte is written once it is over */
+#define MEMORY_WRITE_TIME_MS                               10
 typedef enum{
 	False, True
 }bool;
 /*******************************************************************************
  *                      Functions Prototypes                                   *
  *******************************************************************************/
-void Password_recieve(uint8 a_arr[]);
+void Password_recieve(uint8 a_arr[],const PROTOCOL_FrameType *frame,uint8 offset);
 bool Match_or_NoMatch(uint8 a_arr1[],uint8 a_arr2[]);
 void Password_storeInMemory(void);
-uint8 Command_recieve(void);
 void Command_send(uint8 command);
 void Get_savedPassword(uint8 a_arr[]);
-void g_tickCounterMotor(void);
-void g_tickCounterAlarm(void);
+void Door_open(void);
+void Door_hold(void);
+void Door_close(void);
+void Door_stop(void);
+void Door_setState(uint8 state);
+void Door_report(void);
+void Alarm_start(void);
+void Emergency_stop(void);
+void Emergency_stopDoor(uint8 data);
+void Params_load(void);
+void Params_store(void);
+void Params_apply(void);
+void Params_reply(uint8 command);
+void Memory_queueWrite(uint16 address, uint8 data);
+void Memory_writeNext(void);
 
 /************************************************************************************************
  *                                GLOBAL VARIABLES                                              *
  ************************************************************************************************/
-uint8 g_password[5];
-uint8 g_passmatch[5];
-uint8 savedpass[5];
-uint8 command;
-uint8 g_tick=0;
+uint8 g_password[PASSWORD_SIZE];
+uint8 g_passmatch[PASSWORD_SIZE];
+uint8 savedpass[PASSWORD_SIZE];
+PROTOCOL_FrameType g_frame;
 uint8 g_wrong=0;
-UART_ConfigType UART_configuration = {EIGHT, DISABLED, ONE, 9600};
-Timer1_ConfigType TIMER_configuration= {0, 7812,F_CPU_1024,Compare};
+uint8 g_doorState = DOOR_STATE_CLOSED;
+uint8 g_doorReopens = 0;
+SCHEDULER_TimerId g_holdTimer = SCHEDULER_NO_TIMER; /* Running door hold */
+SCHEDULER_TimerId g_progressTimer = SCHEDULER_NO_TIMER; /* Running DOOR_PROGRESS stream */
+UART_ConfigType UART_configuration = {EIGHT, DISABLED, ONE, UART_BAUD_9600};
+/* Door parameters loaded from the EEPROM, changed by PARAMS_SET */
+PROTOCOL_ParamsType g_params;
+/*
+ * Door cycle built from the parameters when a cycle starts, so new parameters apply from the next cycle.
+ * Soft start and soft stop, the profile time is the limit of a move if the position sensors do not stop it.
+ */
+DcMotor_ProfileType g_openProfile;
+DcMotor_ProfileType g_closeProfile;
+uint16 g_holdTime;
+/* Siren for the lockout time, played by the buzzer in the background */
+Buzzer_PatternType g_alarmPattern = {Buzzer_sirenSteps, BUZZER_SIREN_STEPS, PARAMS_DEFAULT_LOCKOUT_TIME};
 TWI_ConfigType TWI_Configuration = {0b00000010, Scale_ONE};
+/*
+ * EEPROM writes done one byte per write cycle from the main loop, so a store does not hold the
+ * dispatcher. A queued address is written once with its last data.
+ */
+uint16 g_memoryAddress[MEMORY_QUEUE_SIZE];
+uint8 g_memoryData[MEMORY_QUEUE_SIZE];
+uint8 g_memoryCount = 0;
+uint32 g_memoryWriteStart = 0;
 
 int main(void)
 {
+	uint8 counter;
+
 	TWI_init(&TWI_Configuration);
 	DcMotor_Init();
+	DoorControl_init();
 	Buzzer_init();
 	UART_init(&UART_configuration);
+	PROTOCOL_init();
+	SCHEDULER_init();
+	PROTOCOL_setEmergencyCallBack(Emergency_stop);
 	SREG |= (1<<7);
 
+	/* Keep a copy of the saved password so a check does not wait on the EEPROM */
+	Get_savedPassword(savedpass);
+	Params_load();
+
 	while(1){
-		switch(Command_recieve())
+		/* The door cycle and the alarm run from the dispatcher between the requests */
+		SCHEDULER_dispatch();
+		Memory_writeNext();
+
+		/* Retried requests are answered from the reply cache inside the protocol */
+		if(PROTOCOL_receiveRequest(&g_frame) == FALSE)
+		{
+			continue;
+		}
+		switch(g_frame.type)
 		{
-		case PASSWORD_SEND:
-			Password_recieve(g_password);
-			break;
 		case PASSWORD_CONFIRMATION_SEND:
-			Password_recieve(g_passmatch);
+			/* The new password and its confirmation travel in the same frame */
+			Password_recieve(g_password,&g_frame,0);
+			Password_recieve(g_passmatch,&g_frame,PASSWORD_SIZE);
 			if(Match_or_NoMatch(g_password,g_passmatch)){
-				Password_storeInMemory();
 				Command_send(PASSWORD_MATCH);
+				Password_storeInMemory();
 			}
 			else
 			{
@@ -97,8 +141,7 @@ int main(void)
 			}
 			break;
 		case CHECK_PASSWORD:
-			Password_recieve(g_password);
-			Get_savedPassword(savedpass);
+			Password_recieve(g_password,&g_frame,0);
 			if(Match_or_NoMatch(g_password,savedpass))
 			{
 				Command_send(PASSWORD_MATCH);
@@ -108,29 +151,63 @@ int main(void)
 				Command_send(PASSWORD_NOT_MATCHED);
 			}
 			break;
-		case OPEN_DOOR:
-			while(UART_recieveByte() != READY){};
-			UART_sendByte(READY);
-			Timer1_setCallBack(g_tickCounterMotor);
-			Timer1_init(&TIMER_configuration);
-			while(g_tick != TIMER_TOTAL_TICKS);
-			Timer1_deInit();
-			DcMotor_Rotate(DC_MOTOR_STOP, 0);
-			g_tick = 0;
+		case UNLOCK_DOOR:
+			/* Verify and actuate: the one reply carries the result and the motor starts with it */
+			Password_recieve(g_password,&g_frame,0);
+			if(Match_or_NoMatch(g_password,savedpass))
+			{
+				Command_send(DOOR_OPENING);
+				Buzzer_chirp();
+				Door_open();
+			}
+			else
+			{
+				Command_send(PASSWORD_NOT_MATCHED);
+				Buzzer_beep(2);
+			}
 			break;
 		case WRONG_PASSWORD:
-			while(UART_recieveByte() != READY){};
-			UART_sendByte(READY);
-			Timer1_setCallBack(g_tickCounterAlarm);
-			Timer1_init(&TIMER_configuration);
-			while(g_tick != TIMER_TICKS_1MINUTE);
-			Timer1_deInit();
-			Buzzer_off();
-			g_tick = 0;
+			Command_send(DONE);
+			Alarm_start();
+			break;
+		case LINK_PING:
+			Command_send(LINK_PING);
+			break;
+		case LINK_SPEED_REQUEST:
+			PROTOCOL_acceptSpeed(&g_frame);
+			break;
+		case LINK_STATS:
+			PROTOCOL_replyLinkStats(&g_frame);
+			break;
+		case DOOR_STATUS:
+			PROTOCOL_reply(&g_frame, DOOR_STATUS, &g_doorState, 1);
+			break;
+		case PARAMS_GET:
+			Params_reply(PARAMS_GET);
+			break;
+		case PARAMS_SET:
+			if(PROTOCOL_decodeParams(g_frame.payload, g_frame.length, &g_params))
+			{
+				Params_reply(PARAMS_GET);
+				Params_store();
+			}
+			else
+			{
+				Command_send(PARAMS_REJECTED);
+			}
+			break;
+		case EMERGENCY_STOP:
+			/*
+			 * Handled already from the RX interrupt when its last byte was received, unless a
+			 * broken frame just before it hid it there: stopping a stopped door again does nothing.
+			 * The interrupts are off like in the RX interrupt, the motor ISRs drive the same pins.
+			 */
+			cli();
+			Emergency_stop();
+			sei();
 			break;
 		case CHECK_IF_SAVED:
-			Get_savedPassword(savedpass);
-			uint8 counter=0;
+			counter=0;
 			for(uint8 i = 0 ; i < PASSWORD_SIZE; i++)
 			{
 				if(savedpass[i] == DEFUALT_VALUE_OF_EEPROM)
@@ -153,14 +230,18 @@ int main(void)
 }
 /*
  * Description
- * Functions that responsible for Receiving the input password.
+ * Functions that responsible for Receiving the input password from the frame payload.
+ * Missing digits in a short payload are cleared.
  */
-void Password_recieve(uint8 a_arr[])
+void Password_recieve(uint8 a_arr[],const PROTOCOL_FrameType *frame,uint8 offset)
 {
-	while(UART_recieveByte() != READY){};
-	UART_sendByte(READY);
 	for(uint8 i=0 ; i<PASSWORD_SIZE ; i++){
-		a_arr[i]=UART_recieveByte();
+		if((offset+i) < frame->length){
+			a_arr[i]=frame->payload[offset+i];
+		}
+		else{
+			a_arr[i]=0;
+		}
 	}
 }
 /*
@@ -186,74 +267,315 @@ bool Match_or_NoMatch(uint8 a_arr1[],uint8 a_arr2[])
 /*
  * Description
  * Functions that responsible for Storing the input password.
+ * The copy in use changes at once, the EEPROM bytes are written from the main loop.
  */
 void Password_storeInMemory(void)
 {
 	for(uint8 i=0;i<PASSWORD_SIZE;i++){
-		EEPROM_writeByte(0x0311+i,g_password[i]);
+		Memory_queueWrite(PASSWORD_EEPROM_ADDRESS+i,g_password[i]);
+		savedpass[i]=g_password[i];
+	}
+}
+/*
+ * Description
+ * Functions that responsible for Sending the Command as a reply without payload.
+ * The reply carries the sequence number of the request being handled.
+ */
+void Command_send(uint8 command)
+{
+	PROTOCOL_reply(&g_frame, command, NULL_PTR, 0);
+}
+/*
+ * Description
+ * Functions that responsible for Getting the Saved password.
+ */
+void Get_savedPassword(uint8 a_arr[])
+{
+	for(uint8 i=0 ; i<PASSWORD_SIZE ; i++){
+		EEPROM_readByte(PASSWORD_EEPROM_ADDRESS+i, &a_arr[i]);
 		_delay_ms(10);
 	}
 }
 /*
  * Description
- * Functions that responsible for Receiving the Command.
+ * Functions that responsible for starting the door cycle:
+ * the opening move starts at once, each step starts the next one when it ends.
+ * A request during a running cycle does not start it again,
+ * a request after a motor fault or an emergency stop does.
  */
-uint8 Command_recieve(void)
+void Door_open(void)
 {
-	while(UART_recieveByte() != READY){};
-	UART_sendByte(READY);
-	command=UART_recieveByte();
-	UART_sendByte(DONE);
-	return command;
+	if((g_doorState != DOOR_STATE_CLOSED) && (g_doorState != DOOR_STATE_FAULT) &&
+			(g_doorState != DOOR_STATE_STOPPED))
+	{
+		return;
+	}
+	g_doorReopens = 0;
+	DcMotor_releaseEmergencyStop();
+	Params_apply();
+	if(g_progressTimer == SCHEDULER_NO_TIMER)
+	{
+		g_progressTimer = SCHEDULER_startTimer(DOOR_PROGRESS_PERIOD_MS, SCHEDULER_PERIODIC, Door_report);
+	}
+	Door_setState(DOOR_STATE_OPENING);
+	DoorControl_move(DOOR_CONTROL_OPEN_DIRECTION, &g_openProfile, Door_hold);
 }
 /*
  * Description
- * Functions that responsible for Sending the Command.
+ * Functions that responsible for holding the door open.
+ * A door jammed while opening is closed again, an over-current or an emergency stop ends the cycle.
+ * An opening that leaves the door at an unknown place ends the cycle as a fault,
+ * and so does a hold that finds no free timer: the door is left open.
  */
-void Command_send(uint8 command)
+void Door_hold(void)
 {
-	UART_sendByte(READY);
-	while(UART_recieveByte() != READY){};
-	UART_sendByte(command);
+	DcMotor_FaultType fault = DcMotor_getFault();
+
+	if(fault == DC_MOTOR_EMERGENCY_STOP)
+	{
+		Door_setState(DOOR_STATE_STOPPED);
+		return;
+	}
+	if((fault == DC_MOTOR_OVERCURRENT) || (DoorControl_isPositionKnown() == FALSE))
+	{
+		Door_setState(DOOR_STATE_FAULT);
+		return;
+	}
+	g_holdTimer = SCHEDULER_startTimer(g_holdTime, SCHEDULER_ONE_SHOT, Door_close);
+	if(g_holdTimer == SCHEDULER_NO_TIMER)
+	{
+		Door_setState(DOOR_STATE_FAULT);
+		return;
+	}
+	Door_setState(DOOR_STATE_HOLD);
 }
 /*
  * Description
- * Functions that responsible for Getting the Saved password.
+ * Functions that responsible for closing the door, the door is held open while the obstacle beam is broken.
  */
-void Get_savedPassword(uint8 a_arr[])
+void Door_close(void)
 {
-	for(uint8 i=0 ; i<PASSWORD_SIZE ; i++){
-		EEPROM_readByte(0x0311+i, &a_arr[i]);
-		_delay_ms(10);
+	g_holdTimer = SCHEDULER_NO_TIMER;
+	if(DoorSensor_isObstacle())
+	{
+		Door_hold();
+		return;
 	}
+	Door_setState(DOOR_STATE_CLOSING);
+	DoorControl_move(DOOR_CONTROL_CLOSE_DIRECTION, &g_closeProfile, Door_stop);
 }
 /*
  * Description
- * Functions that responsible for Rotating the Motor.
+ * Functions that responsible for ending the door cycle, the move has braked the motor.
+ * A closing stopped by the obstacle beam is opened again and closed after the hold.
+ * A door jammed while closing is opened again the same way, up to DOOR_MAX_REOPENS times.
+ * An emergency stop ends the cycle where the door is, even after the obstacle beam.
+ * A closing that leaves the door at an unknown place is a fault.
  */
-void g_tickCounterMotor(void)
+void Door_stop(void)
 {
-	g_tick++;
-	if(g_tick == 1)
+	DcMotor_FaultType fault = DcMotor_getFault();
+
+	if(fault == DC_MOTOR_EMERGENCY_STOP)
 	{
-		DcMotor_Rotate(DC_MOTOR_CW, 100);
-	}else if(g_tick == DC_ON_TICKS)
+		Door_setState(DOOR_STATE_STOPPED);
+	}
+	else if(fault == DC_MOTOR_OBSTACLE)
 	{
-		DcMotor_Rotate(DC_MOTOR_STOP, 0);
-	}else if(g_tick == DC_HOLD_TICKS)
+		Door_setState(DOOR_STATE_OBSTACLE);
+		DoorControl_move(DOOR_CONTROL_OPEN_DIRECTION, &g_openProfile, Door_hold);
+	}
+	else if((fault == DC_MOTOR_STALL) && (g_doorReopens < DOOR_MAX_REOPENS))
+	{
+		g_doorReopens++;
+		Door_setState(DOOR_STATE_STALLED);
+		DoorControl_move(DOOR_CONTROL_OPEN_DIRECTION, &g_openProfile, Door_hold);
+	}
+	else if((fault != DC_MOTOR_NO_FAULT) || (DoorControl_isPositionKnown() == FALSE))
 	{
-		DcMotor_Rotate(DC_MOTOR_ACW, 100);
+		Door_setState(DOOR_STATE_FAULT);
+	}
+	else
+	{
+		Door_setState(DOOR_STATE_CLOSED);
 	}
 }
 /*
  * Description
- * Functions that responsible for Incrementing the timer seconds.
+ * Functions that responsible for changing the door state, the new state is reported at once.
  */
-void g_tickCounterAlarm(void)
+void Door_setState(uint8 state)
 {
-	g_tick++;
-	if(g_tick == 1)
+	if(state != g_doorState)
 	{
-		Buzzer_on();
+		g_doorState = state;
+		Door_report();
+	}
+}
+/*
+ * Description
+ * Functions that responsible for pushing the door state and opening to the HMI ECU,
+ * the stream stops after the state that ends the door cycle.
+ */
+void Door_report(void)
+{
+	uint8 progress[DOOR_PROGRESS_SIZE];
+
+	progress[0] = g_doorState;
+	progress[1] = DoorControl_getPercent();
+	PROTOCOL_sendFrame(DOOR_PROGRESS, PROTOCOL_NO_SEQ, progress, DOOR_PROGRESS_SIZE);
+
+	if((g_doorState == DOOR_STATE_CLOSED) || (g_doorState == DOOR_STATE_FAULT) ||
+			(g_doorState == DOOR_STATE_STOPPED))
+	{
+		SCHEDULER_stopTimer(g_progressTimer);
+		g_progressTimer = SCHEDULER_NO_TIMER;
+	}
+}
+/*
+ * Description
+ * Functions that responsible for sounding the alarm for the lockout time, a new alarm restarts it.
+ */
+void Alarm_start(void)
+{
+	g_alarmPattern.repeat = ((uint32)g_params.lockout_time * 1000) / BUZZER_SIREN_PERIOD_MS;
+	Buzzer_play(&g_alarmPattern);
+}
+/*
+ * Description
+ * Functions that responsible for the EMERGENCY_STOP frame, called from the UART RX interrupt:
+ * the motor is braked at once and the door cycle is ended from the dispatcher.
+ */
+void Emergency_stop(void)
+{
+	DcMotor_emergencyStop();
+	SCHEDULER_postEvent(Emergency_stopDoor, 0);
+}
+/*
+ * Description
+ * Functions that responsible for ending the running door cycle after an emergency stop,
+ * the door stays where it stopped until the next unlock.
+ */
+void Emergency_stopDoor(uint8 data)
+{
+	(void)data;
+	if((g_doorState == DOOR_STATE_CLOSED) || (g_doorState == DOOR_STATE_FAULT) ||
+			(g_doorState == DOOR_STATE_STOPPED))
+	{
+		return;
+	}
+	DoorControl_stop();
+	SCHEDULER_stopTimer(g_holdTimer);
+	g_holdTimer = SCHEDULER_NO_TIMER;
+	Door_setState(DOOR_STATE_STOPPED);
+}
+/*
+ * Description
+ * Functions that responsible for Getting the door parameters from the EEPROM,
+ * a block with a wrong CRC or out of its limits is replaced by the default values.
+ */
+void Params_load(void)
+{
+	uint8 block[PARAMS_SIZE + 1];
+	uint8 crc = 0;
+
+	for(uint8 i=0 ; i<(PARAMS_SIZE + 1) ; i++){
+		EEPROM_readByte(PARAMS_EEPROM_ADDRESS+i, &block[i]);
+		_delay_ms(10);
+	}
+	for(uint8 i=0 ; i<PARAMS_SIZE ; i++){
+		crc = PROTOCOL_crc8(crc, block[i]);
+	}
+	if((crc != block[PARAMS_SIZE]) || (PROTOCOL_decodeParams(block, PARAMS_SIZE, &g_params) == FALSE))
+	{
+		PROTOCOL_defaultParams(&g_params);
+	}
+}
+/*
+ * Description
+ * Functions that responsible for Storing the door parameters and their CRC in the EEPROM,
+ * the bytes are written from the main loop.
+ */
+void Params_store(void)
+{
+	uint8 block[PARAMS_SIZE + 1];
+	uint8 crc = 0;
+
+	PROTOCOL_encodeParams(&g_params, block);
+	for(uint8 i=0 ; i<PARAMS_SIZE ; i++){
+		crc = PROTOCOL_crc8(crc, block[i]);
+	}
+	block[PARAMS_SIZE] = crc;
+	for(uint8 i=0 ; i<(PARAMS_SIZE + 1) ; i++){
+		Memory_queueWrite(PARAMS_EEPROM_ADDRESS+i, block[i]);
+	}
+}
+/*
+ * Description
+ * Functions that responsible for building the door cycle from the door parameters.
+ */
+void Params_apply(void)
+{
+	uint16 ramp = (uint16)g_params.ramp_time * PARAMS_TIME_UNIT_MS;
+
+	g_openProfile.cruise_speed = g_params.speed;
+	g_openProfile.accel_time_ms = ramp;
+	g_openProfile.cruise_time_ms = (uint16)g_params.open_time * PARAMS_TIME_UNIT_MS - 2*ramp;
+	g_openProfile.decel_time_ms = ramp;
+
+	g_closeProfile.cruise_speed = g_params.speed;
+	g_closeProfile.accel_time_ms = ramp;
+	g_closeProfile.cruise_time_ms = (uint16)g_params.close_time * PARAMS_TIME_UNIT_MS - 2*ramp;
+	g_closeProfile.decel_time_ms = ramp;
+
+	g_holdTime = (uint16)g_params.hold_time * PARAMS_TIME_UNIT_MS;
+}
+/*
+ * Description
+ * Functions that responsible for Sending the door parameters in use as a reply.
+ */
+void Params_reply(uint8 command)
+{
+	uint8 payload[PARAMS_SIZE];
+
+	PROTOCOL_encodeParams(&g_params, payload);
+	PROTOCOL_reply(&g_frame, command, payload, PARAMS_SIZE);
+}
+/*
+ * Description
+ * Functions that responsible for queueing one EEPROM byte write.
+ * A byte already waiting for the same address takes the new data and keeps its place.
+ */
+void Memory_queueWrite(uint16 address, uint8 data)
+{
+	for(uint8 i=0 ; i<g_memoryCount ; i++){
+		if(g_memoryAddress[i] == address){
+			g_memoryData[i] = data;
+			return;
+		}
+	}
+	if(g_memoryCount < MEMORY_QUEUE_SIZE){
+		g_memoryAddress[g_memoryCount] = address;
+		g_memoryData[g_memoryCount] = data;
+		g_memoryCount++;
+	}
+}
+/*
+ * Description
+ * Functions that responsible for writing the oldest queued EEPROM byte,
+ * once the write cycle of the last one is over.
+ */
+void Memory_writeNext(void)
+{
+	if((g_memoryCount == 0) || !SCHEDULER_isTimeout(g_memoryWriteStart, MEMORY_WRITE_TIME_MS))
+	{
+		return;
+	}
+	EEPROM_writeByte(g_memoryAddress[0], g_memoryData[0]);
+	g_memoryWriteStart = SCHEDULER_getMillis();
+	g_memoryCount--;
+	for(uint8 i=0 ; i<g_memoryCount ; i++){
+		g_memoryAddress[i] = g_memoryAddress[i+1];
+		g_memoryData[i] = g_memoryData[i+1];
 	}
 }
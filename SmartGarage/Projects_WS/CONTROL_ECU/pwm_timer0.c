@@ -1,4 +1,4 @@
- /******************************************************************************
+/******************************************************************************
  *
  * Module: PWM
  *
@@ -12,35 +12,74 @@
 
 #include "pwm_timer0.h"
 #include "gpio.h"
+#include "common_macros.h" /* To use the macros like SET_BIT */
 #include "avr/io.h" /* To use Timer0 Registers */
+#include <avr/interrupt.h> /* For cli to update TCCR0 with the interrupts off */
+
+/*
+ * Duty cycle to compare value: OCR0 = duty * 255 / 100 without a division,
+ * (duty * 653) >> 8 is exact at 0% and 100% and within one count in between.
+ */
+#define PWM_DUTY_MULTIPLIER		653
+#define PWM_MAX_DUTY			100
 
 /*
  * Description :
  * Initialize the PWM module by:
- * 1. Trigger Timer0 with PWM Mode.
- * 2. Setup the PWM mode with Non-Inverting.
- * 3. Setup the prescaler with F_CPU/8
- * 4. Setup the compare value based on the required input duty cycle
- * 5. Setup the direction for OC0 as output pin
+ * 1. Trigger Timer0 with Fast PWM Mode, Non-Inverting.
+ * 2. Setup the prescaler with the required one.
+ * 3. Keep OC0 low (0% duty) until the first PWM_Timer0_setDuty.
+ * 4. Setup the direction for OC0 as output pin
  */
-void PWM_Timer0_Start(uint8 duty_cycle)
+void PWM_Timer0_init(PWM_Timer0_Prescaler prescaler)
 {
 	TCNT0 = 0; /* Timer0 initial value */
-
-	OCR0  = ((float)duty_cycle / 100) * 255; /* Set Compare value */
+	OCR0 = 0;
 
 	/*
 	 * Configure Timer0 control register
 	 * 1. Fast PWM mode FOC0=0
 	 * 2. Fast PWM Mode WGM01=1 & WGM00=1
-	 * 3. Clear OC0 when match occurs (non inverted mode) COM00=0 & COM01=1
-	 * 4. clock = F_CPU/8 CS00=0 CS01=1 CS02=0
+	 * 3. OC0 disconnected COM00=0 & COM01=0, it is connected with the first non zero duty
+	 * 4. clock = the required prescaler CS02:0
 	 */
-	TCCR0 = (1<<WGM00) | (1<<WGM01) | (1<<COM01) | (1<<CS01);
+	TCCR0 = (1<<WGM00) | (1<<WGM01) | prescaler;
 
 	/* Configure PB3/ OC0 as output pin --> pin where the PWM signal is generated from Timer0 */
+	GPIO_writePin(TIMER0_OCO_PORT_ID,TIMER0_OCO_PIN_ID,LOGIC_LOW);
 	GPIO_setupPinDirection(TIMER0_OCO_PORT_ID,TIMER0_OCO_PIN_ID,PIN_OUTPUT);
 }
 
+/*
+ * Description :
+ * Set the duty cycle 0 --> 100%, larger values are taken as 100%.
+ * OCR0 is double buffered in Fast PWM mode, the new duty starts with the next PWM period.
+ * It is called from the main loop and from the safety ISRs of the motor, so the compare value
+ * and the read-modify-write of TCCR0 are done with the interrupts off.
+ */
+void PWM_Timer0_setDuty(uint8 duty_cycle)
+{
+	uint8 sreg;
+
+	if(duty_cycle > PWM_MAX_DUTY)
+	{
+		duty_cycle = PWM_MAX_DUTY;
+	}
 
+	sreg = SREG;
+	cli();
+	OCR0 = (uint8)(((uint16)duty_cycle * PWM_DUTY_MULTIPLIER) >> 8); /* Set Compare value */
 
+	if(duty_cycle == 0)
+	{
+		/* Fast PWM still gives a one count pulse at OCR0 = 0, disconnect OC0 so the pin stays low */
+		CLEAR_BIT(TCCR0,COM01);
+	}
+	else
+	{
+		/* Clear OC0 when match occurs (non inverted mode) COM00=0 & COM01=1 */
+		SET_BIT(TCCR0,COM01);
+	}
+	/* Restore the I-bit as it was, a call from an ISR keeps it cleared */
+	SREG = sreg;
+}
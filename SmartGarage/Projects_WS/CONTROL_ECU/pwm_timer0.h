@@ -1,4 +1,4 @@
- /******************************************************************************
+/******************************************************************************
  *
  * Module: PWM
  *
@@ -18,15 +18,38 @@
 #define TIMER0_OCO_PORT_ID    1
 #define TIMER0_OCO_PIN_ID     3
 
+/*******************************************************************************
+ *                               Types Declaration                             *
+ *******************************************************************************/
+
+/*
+ * Timer0 clock, the fast PWM frequency is F_CPU / (prescaler * 256):
+ * at 8MHz 31.25KHz, 3.9KHz, 488Hz, 122Hz and 30.5Hz.
+ */
+typedef enum
+{
+	PWM_F_CPU_CLOCK=1,PWM_F_CPU_8,PWM_F_CPU_64,PWM_F_CPU_256,PWM_F_CPU_1024
+}PWM_Timer0_Prescaler;
+
+/*******************************************************************************
+ *                      Functions Prototypes                                   *
+ *******************************************************************************/
+
 /*
  * Description :
  * Initialize the PWM module by:
- * 1. Trigger Timer0 with PWM Mode.
- * 2. Setup the PWM mode with Non-Inverting.
- * 3. Setup the precaler with F_CPU/8
- * 4. Setup the compare value based on the required input duty cycle
- * 5. Setup the direction for OC0 as output pin
+ * 1. Trigger Timer0 with Fast PWM Mode, Non-Inverting.
+ * 2. Setup the prescaler with the required one.
+ * 3. Keep OC0 low (0% duty) until the first PWM_Timer0_setDuty.
+ * 4. Setup the direction for OC0 as output pin
+ */
+void PWM_Timer0_init(PWM_Timer0_Prescaler prescaler);
+
+/*
+ * Description :
+ * Set the duty cycle 0 --> 100%, larger values are taken as 100%.
+ * OCR0 is double buffered in Fast PWM mode, the new duty starts with the next PWM period.
  */
-void PWM_Timer0_Start(uint8 duty_cycle);
+void PWM_Timer0_setDuty(uint8 duty_cycle);
 
 #endif /* PWM_TIMER0_H_ */
@@ -0,0 +1,139 @@
+/******************************************************************************
+ *
+ * Module: SCHEDULER
+ *
+ * File Name: scheduler.h
+ *
+ * Description: Header file for the Timer1 system tick and the software timer wheel
+ *
+ * Author: Shehab Kishta
+ *
+ *******************************************************************************/
+
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+#include "std_types.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+
+/*
+ * System tick period, Timer1 compare mode with F_CPU/64: (124 + 1) * 8us = 1ms exactly.
+ * The compare mode clears the counter in hardware so the tick does not drift.
+ */
+#define SCHEDULER_TICK_MS                           1
+#define SCHEDULER_TICK_COMPARE_VALUE                124
+
+/* Number of virtual timers that can run at the same time */
+#define SCHEDULER_MAX_TIMERS                        8
+
+/*
+ * Number of wheel slots, must be a power of 2.
+ * A timer longer than the wheel turn waits extra turns in its slot.
+ */
+#define SCHEDULER_WHEEL_SIZE                        16
+
+/* Number of events the ISRs can post before the dispatcher drains them, must be a power of 2 */
+#define SCHEDULER_QUEUE_SIZE                        8
+
+/* Time of one Timer1 count in microseconds, the unit of the ISR time measurement */
+#define SCHEDULER_COUNT_TIME_US                     8
+
+/* Id returned when no timer is free */
+#define SCHEDULER_NO_TIMER                          0xFF
+
+/* Convert a time in milliseconds to system ticks, rounded up */
+#define SCHEDULER_MS_TO_TICKS(MS)                   (((MS) + SCHEDULER_TICK_MS - 1) / SCHEDULER_TICK_MS)
+
+/*******************************************************************************
+ *                               Types Declaration                             *
+ *******************************************************************************/
+typedef enum
+{
+	SCHEDULER_ONE_SHOT,SCHEDULER_PERIODIC
+}SCHEDULER_TimerMode;
+
+typedef uint8 SCHEDULER_TimerId;
+
+/*
+ * Tick ISR time in Timer1 counts (SCHEDULER_COUNT_TIME_US each), from the compare
+ * match to the end of the tick: interrupt latency + ISR prologue + tick work.
+ */
+typedef struct
+{
+	uint8 last;
+	uint8 max;
+}SCHEDULER_IsrTimeType;
+
+/*******************************************************************************
+ *                      Functions Prototypes                                   *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Start the system tick on Timer1 and clear all the virtual timers.
+ * Timer1 belongs to the scheduler after this call.
+ */
+void SCHEDULER_init(void);
+
+/*
+ * Description :
+ * Start a virtual timer that calls a_ptr from SCHEDULER_dispatch after time_ms,
+ * once or every time_ms according to the mode.
+ * Return the timer id, or SCHEDULER_NO_TIMER if all the timers are used.
+ * The id of a one-shot timer is free again once its call back is called.
+ */
+SCHEDULER_TimerId SCHEDULER_startTimer(uint16 time_ms, SCHEDULER_TimerMode mode, void(*a_ptr)(void));
+
+/*
+ * Description :
+ * Stop a running virtual timer, its call back is not called any more.
+ */
+void SCHEDULER_stopTimer(SCHEDULER_TimerId id);
+
+/*
+ * Description :
+ * Main loop event dispatcher: call the events posted by the ISRs, then advance the wheel
+ * by the ticks elapsed since the last call and call the call backs of the timers that expired.
+ * A timer expires on its tick even if the dispatcher runs late, so periodic timers do not drift.
+ */
+void SCHEDULER_dispatch(void);
+
+/*
+ * Description :
+ * Queue a call of a_ptr(data) from the next SCHEDULER_dispatch, the bottom half of an ISR.
+ * Call it from ISRs only: they do not nest, so together they are the single producer of
+ * the lock-free queue. The emergency stop ISR of the CONTROL_ECU is its only user, the
+ * keypad scan of the HMI_ECU keeps its own key event queue.
+ * Return FALSE if the queue is full and the event is lost.
+ */
+boolean SCHEDULER_postEvent(void(*a_ptr)(uint8 data), uint8 data);
+
+/*
+ * Description :
+ * Copy the time measured for the Timer1 tick ISR.
+ */
+void SCHEDULER_getIsrTime(SCHEDULER_IsrTimeType *time);
+
+/*
+ * Description :
+ * Return the monotonic time in milliseconds since SCHEDULER_init, it wraps after about 49 days.
+ */
+uint32 SCHEDULER_getMillis(void);
+
+/*
+ * Description :
+ * Return the milliseconds elapsed since start_ms, a value taken from SCHEDULER_getMillis.
+ * The unsigned subtraction stays right when the time wraps.
+ */
+uint32 SCHEDULER_elapsedMs(uint32 start_ms);
+
+/*
+ * Description :
+ * Return TRUE if timeout_ms milliseconds have elapsed since start_ms.
+ */
+boolean SCHEDULER_isTimeout(uint32 start_ms, uint32 timeout_ms);
+
+#endif /* SCHEDULER_H_ */
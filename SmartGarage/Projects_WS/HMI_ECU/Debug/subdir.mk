@@ -8,6 +8,8 @@ C_SRCS += \
 ../keypad.c \
 ../lcd.c \
 ../main.c \
+../protocol.c \
+../scheduler.c \
 ../timer.c \
 ../uart.c 
 
@@ -16,6 +18,8 @@ OBJS += \
 ./keypad.o \
 ./lcd.o \
 ./main.o \
+./protocol.o \
+./scheduler.o \
 ./timer.o \
 ./uart.o 
 
@@ -24,6 +28,8 @@ C_DEPS += \
 ./keypad.d \
 ./lcd.d \
 ./main.d \
+./protocol.d \
+./scheduler.d \
 ./timer.d \
 ./uart.d 
 
@@ -1,4 +1,4 @@
- /******************************************************************************
+/******************************************************************************
  *
  * Module: KEYPAD
  *
@@ -10,161 +10,406 @@
  *
  *******************************************************************************/
 #include "keypad.h"
-#include "gpio.h"
-#include <util/delay.h>
+#include "gpio.h" /* For the port and pin ids of the keypad configurations */
+#include "common_macros.h" /* To use the macros like SET_BIT */
+#include <avr/io.h> /* To use the Timer0 and the keypad port registers */
+#include <avr/interrupt.h> /* For Timer0 compare ISR */
+#include <avr/pgmspace.h> /* For the key table in the flash */
+#include <avr/sleep.h> /* For the idle and power down sleep modes */
+
+#define KEYPAD_NUM_KEYS              (KEYPAD_NUM_ROWS * KEYPAD_NUM_COLS)
+#define KEYPAD_COLS_MASK             ((1 << KEYPAD_NUM_COLS) - 1)
+#define KEYPAD_QUEUE_MASK            (KEYPAD_QUEUE_SIZE - 1)
+
+#if ((KEYPAD_QUEUE_SIZE & KEYPAD_QUEUE_MASK) != 0)
+#error "KEYPAD_QUEUE_SIZE must be a power of 2"
+#endif
+#if (KEYPAD_LONG_PRESS_SAMPLES > 255)
+#error "KEYPAD_LONG_PRESS_MS is too long for the 8-bit hold counters"
+#endif
 
 /*******************************************************************************
- *                      Functions Prototypes(Private)                          *
+ *                           Global Variables                                  *
  *******************************************************************************/
 
-#ifndef STANDARD_KEYPAD
+/*
+ * Scan state, written by the Timer0 ISR only. Each row keeps one bit per column:
+ * the debounced pressed keys and the keys whose samples disagree with it.
+ */
+static uint8 g_row = 0;
+static uint8 g_rowPressed[KEYPAD_NUM_ROWS];
+static uint8 g_rowCounting[KEYPAD_NUM_ROWS];
+static uint8 g_debounceCount[KEYPAD_NUM_KEYS];
+static uint8 g_holdCount[KEYPAD_NUM_KEYS];
+
+/* Scans without any key down, the flag tells KEYPAD_getPressedKey it may power down */
+static uint16 g_quietScans = 0;
+static volatile boolean g_quiet = FALSE;
 
-#if (KEYPAD_NUM_COLS == 3)
 /*
- * Function responsible for mapping the switch number in the keypad to
- * its corresponding functional number in the proteus for 4x3 keypad
+ * Functional value of each button, row by row, chosen at compile time.
+ * The table stays in the flash and each key event reads one byte of it.
  */
-static uint8 KEYPAD_4x3_adjustKeyNumber(uint8 button_number);
+#ifdef STANDARD_KEYPAD
+#if (KEYPAD_NUM_COLS == 3)
+static const uint8 g_keyTable[KEYPAD_NUM_KEYS] PROGMEM =
+{
+	1, 2, 3,
+	4, 5, 6,
+	7, 8, 9,
+	10, 11, 12
+};
 #elif (KEYPAD_NUM_COLS == 4)
+static const uint8 g_keyTable[KEYPAD_NUM_KEYS] PROGMEM =
+{
+	1, 2, 3, 4,
+	5, 6, 7, 8,
+	9, 10, 11, 12,
+	13, 14, 15, 16
+};
+#endif
+#else
+#if (KEYPAD_NUM_COLS == 3)
+/* Keypad 4x3 shape of the proteus */
+static const uint8 g_keyTable[KEYPAD_NUM_KEYS] PROGMEM =
+{
+	1, 2, 3,
+	4, 5, 6,
+	7, 8, 9,
+	'*', 0, '#'
+};
+#elif (KEYPAD_NUM_COLS == 4)
+/* Keypad 4x4 shape of the proteus, 13 is the ON/C key */
+static const uint8 g_keyTable[KEYPAD_NUM_KEYS] PROGMEM =
+{
+	7, 8, 9, '%',
+	4, 5, 6, '*',
+	1, 2, 3, '-',
+	13, 0, '=', '+'
+};
+#endif
+#endif /* STANDARD_KEYPAD */
+
+/*
+ * Key events: the head index is written by the ISR only and the tail index by
+ * the reading side only, so one byte indices need no locking.
+ */
+static KEYPAD_EventType g_queue[KEYPAD_QUEUE_SIZE];
+static volatile uint8 g_queueHead = 0;
+static volatile uint8 g_queueTail = 0;
+
+/*******************************************************************************
+ *                      Functions Prototypes(Private)                          *
+ *******************************************************************************/
+
+/*
+ * Function responsible for debouncing one key sample and queuing its events.
+ */
+static void KEYPAD_sample(uint8 row, uint8 col, boolean pressed);
+
+/*
+ * Function responsible for queuing one key event, the event is lost if the queue is full.
+ */
+static void KEYPAD_postEvent(uint8 button, KEYPAD_EventKind kind);
+
+/*
+ * Function responsible for starting the row scan on Timer0 with all the keys released.
+ */
+static void KEYPAD_startScan(void);
+
+/*
+ * Function responsible for sleeping until the next interrupt, or until a key is pressed
+ * once the keypad is quiet.
+ */
+static void KEYPAD_sleep(void);
+
+/*******************************************************************************
+ *                       Interrupt Service Routines                            *
+ *******************************************************************************/
+
 /*
- * Function responsible for mapping the switch number in the keypad to
- * its corresponding functional number in the proteus for 4x4 keypad
+ * One row per interrupt: the columns of the row driven since the last interrupt are read,
+ * then the next row is driven so it settles until the next interrupt without any delay.
+ * Only the keys that are pressed or bouncing are debounced, an idle row costs a few cycles.
  */
-static uint8 KEYPAD_4x4_adjustKeyNumber(uint8 button_number);
+ISR(TIMER0_COMP_vect)
+{
+	uint8 row = g_row;
+	uint8 columns = KEYPAD_COL_INPUT_REGISTER >> KEYPAD_FIRST_COL_PIN_ID;
+	uint8 active;
+	uint8 col;
+
+#if (KEYPAD_BUTTON_PRESSED == LOGIC_LOW)
+	columns = ~columns;
 #endif
+	columns &= KEYPAD_COLS_MASK;
 
-#endif /* STANDARD_KEYPAD */
+	/* Release this row and drive the next one */
+	CLEAR_BIT(KEYPAD_ROW_DIRECTION_REGISTER, (KEYPAD_FIRST_ROW_PIN_ID + row));
+	g_row = ((row + 1) == KEYPAD_NUM_ROWS) ? 0 : (row + 1);
+	SET_BIT(KEYPAD_ROW_DIRECTION_REGISTER, (KEYPAD_FIRST_ROW_PIN_ID + g_row));
+
+	active = columns | g_rowPressed[row] | g_rowCounting[row];
+	if(active != 0)
+	{
+		g_quietScans = 0;
+		g_quiet = FALSE;
+	}
+	else if(g_quietScans < KEYPAD_SLEEP_SCANS)
+	{
+		g_quietScans++;
+	}
+	else
+	{
+		g_quiet = TRUE;
+	}
+
+	for(col = 0 ; active != 0 ; col++, active >>= 1)
+	{
+		if(active & 1)
+		{
+			KEYPAD_sample(row, col, BIT_IS_SET(columns,col) ? TRUE : FALSE);
+		}
+	}
+}
+
+/*
+ * A key pressed while the MCU is powered down, the level interrupt is disabled at once
+ * since it stays active while the key is down.
+ */
+ISR(INT0_vect)
+{
+	CLEAR_BIT(GICR,INT0);
+}
 
 /*******************************************************************************
  *                      Functions Definitions                                  *
  *******************************************************************************/
 
-uint8 KEYPAD_getPressedKey(void)
+/*
+ * Description :
+ * Start the background keypad scan on Timer0, Timer0 belongs to the keypad after this call.
+ * The interrupts must be enabled for the scan to run.
+ */
+void KEYPAD_init(void)
 {
-	uint8 col,row;
-	GPIO_setupPinDirection(KEYPAD_ROW_PORT_ID, KEYPAD_FIRST_ROW_PIN_ID, PIN_INPUT);
-	GPIO_setupPinDirection(KEYPAD_ROW_PORT_ID, KEYPAD_FIRST_ROW_PIN_ID+1, PIN_INPUT);
-	GPIO_setupPinDirection(KEYPAD_ROW_PORT_ID, KEYPAD_FIRST_ROW_PIN_ID+2, PIN_INPUT);
-	GPIO_setupPinDirection(KEYPAD_ROW_PORT_ID, KEYPAD_FIRST_ROW_PIN_ID+3, PIN_INPUT);
-
-	GPIO_setupPinDirection(KEYPAD_COL_PORT_ID, KEYPAD_FIRST_COL_PIN_ID, PIN_INPUT);
-	GPIO_setupPinDirection(KEYPAD_COL_PORT_ID, KEYPAD_FIRST_COL_PIN_ID+1, PIN_INPUT);
-	GPIO_setupPinDirection(KEYPAD_COL_PORT_ID, KEYPAD_FIRST_COL_PIN_ID+2, PIN_INPUT);
-#if(KEYPAD_NUM_COLS == 4)
-	GPIO_setupPinDirection(KEYPAD_COL_PORT_ID, KEYPAD_FIRST_COL_PIN_ID+3, PIN_INPUT);
+	uint8 i;
+
+	for(i = 0 ; i < KEYPAD_NUM_ROWS ; i++)
+	{
+		g_rowPressed[i] = 0;
+		g_rowCounting[i] = 0;
+	}
+	for(i = 0 ; i < KEYPAD_NUM_KEYS ; i++)
+	{
+		g_debounceCount[i] = 0;
+		g_holdCount[i] = 0;
+	}
+	g_queueHead = 0;
+	g_queueTail = 0;
+
+	/* The output level of the rows is set once here, a row is an output only while it is driven */
+	for(i = 0 ; i < KEYPAD_NUM_ROWS ; i++)
+	{
+#if (KEYPAD_BUTTON_PRESSED == LOGIC_LOW)
+		CLEAR_BIT(KEYPAD_ROW_OUTPUT_REGISTER, (KEYPAD_FIRST_ROW_PIN_ID + i));
+#else
+		SET_BIT(KEYPAD_ROW_OUTPUT_REGISTER, (KEYPAD_FIRST_ROW_PIN_ID + i));
 #endif
-	while(1)
+	}
+	for(i = 0 ; i < KEYPAD_NUM_COLS ; i++)
 	{
-		for(row=0 ; row<KEYPAD_NUM_ROWS ; row++) /* loop for rows */
-		{
-			_delay_ms(10);
-			/* 
-			 * Each time setup the direction for all keypad port as input pins,
-			 * except this row will be output pin
-			 */
-			GPIO_setupPinDirection(KEYPAD_ROW_PORT_ID,KEYPAD_FIRST_ROW_PIN_ID+row,PIN_OUTPUT);
+		CLEAR_BIT(KEYPAD_COL_DIRECTION_REGISTER, (KEYPAD_FIRST_COL_PIN_ID + i));
+	}
+
+	/* Wake line input with pull-up, INT0 on the low level: the only INT0 sense that wakes from power down */
+	GPIO_setupPinDirection(KEYPAD_WAKE_PORT_ID, KEYPAD_WAKE_PIN_ID, PIN_INPUT);
+	GPIO_writePin(KEYPAD_WAKE_PORT_ID, KEYPAD_WAKE_PIN_ID, LOGIC_HIGH);
+	CLEAR_BIT(GICR,INT0);
+	MCUCR &= ~((1<<ISC01) | (1<<ISC00));
 
-			/* Set/Clear the row output pin */
-			GPIO_writePin(KEYPAD_ROW_PORT_ID, KEYPAD_FIRST_ROW_PIN_ID+row, KEYPAD_BUTTON_PRESSED);
+	KEYPAD_startScan();
+}
 
-			for(col=0 ; col<KEYPAD_NUM_COLS ; col++) /* loop for columns */
+/*
+ * Description :
+ * Take the oldest key event without waiting.
+ * Return FALSE if no event is waiting.
+ */
+boolean KEYPAD_getEvent(KEYPAD_EventType *event)
+{
+	if(g_queueTail == g_queueHead)
+	{
+		return FALSE;
+	}
+	*event = g_queue[g_queueTail];
+	g_queueTail = (g_queueTail + 1) & KEYPAD_QUEUE_MASK;
+	return TRUE;
+}
+
+/*
+ * Description :
+ * Drop the key events waiting in the queue.
+ */
+void KEYPAD_flushEvents(void)
+{
+	g_queueTail = g_queueHead;
+}
+
+/*
+ * Description :
+ * Wait for the next key press and return the pressed button.
+ * Each press is returned once, the key is taken again only after it is released.
+ */
+uint8 KEYPAD_getPressedKey(void)
+{
+	KEYPAD_EventType event;
+
+	while(1)
+	{
+		if(KEYPAD_getEvent(&event))
+		{
+			if(event.kind == KEYPAD_PRESS)
 			{
-				/* Check if the switch is pressed in this column */
-				if(GPIO_readPin(KEYPAD_COL_PORT_ID,KEYPAD_FIRST_COL_PIN_ID+col) == KEYPAD_BUTTON_PRESSED)
-				{
-					#if (KEYPAD_NUM_COLS == 3)
-						#ifdef STANDARD_KEYPAD
-							return ((row*KEYPAD_NUM_COLS)+col+1);
-						#else
-							return KEYPAD_4x3_adjustKeyNumber((row*KEYPAD_NUM_COLS)+col+1);
-						#endif
-					#elif (KEYPAD_NUM_COLS == 4)
-						#ifdef STANDARD_KEYPAD
-							return ((row*KEYPAD_NUM_COLS)+col+1);
-						#else
-							return KEYPAD_4x4_adjustKeyNumber((row*KEYPAD_NUM_COLS)+col+1);
-						#endif
-					#endif
-				}
+				return event.key;
 			}
-			GPIO_setupPinDirection(KEYPAD_ROW_PORT_ID,KEYPAD_FIRST_ROW_PIN_ID+row,PIN_INPUT);
 		}
-	}	
+		else
+		{
+			KEYPAD_sleep();
+		}
+	}
 }
 
-#ifndef STANDARD_KEYPAD
+/*
+ * Description :
+ * Start the row scan on Timer0 with all the keys released:
+ * all the rows and columns are inputs except the first row, that is driven.
+ */
+static void KEYPAD_startScan(void)
+{
+	uint8 i;
+
+	for(i = 0 ; i < KEYPAD_NUM_ROWS ; i++)
+	{
+		CLEAR_BIT(KEYPAD_ROW_DIRECTION_REGISTER, (KEYPAD_FIRST_ROW_PIN_ID + i));
+	}
+	g_row = 0;
+	SET_BIT(KEYPAD_ROW_DIRECTION_REGISTER, KEYPAD_FIRST_ROW_PIN_ID);
+	g_quietScans = 0;
+	g_quiet = FALSE;
+
+	/*
+	 * Configure Timer0 control register
+	 * 1. Compare mode WGM01=1 & WGM00=0, OC0 disconnected COM01:0=0
+	 * 2. clock = F_CPU/64 CS02:0=011
+	 */
+	TCNT0 = 0;
+	OCR0 = KEYPAD_TIMER_COMPARE_VALUE;
+	TIFR = (1<<OCF0);
+	TCCR0 = (1<<WGM01) | (1<<CS01) | (1<<CS00);
+	SET_BIT(TIMSK,OCIE0);
+}
 
-#if (KEYPAD_NUM_COLS == 3)
 /*
  * Description :
- * Update the keypad pressed button value with the correct one in keypad 4x3 shape
+ * Sleep while waiting for a key:
+ * 1. Idle mode while a key was down in the last KEYPAD_SLEEP_DELAY_MS: the CPU stops until
+ *    the next interrupt, the scan, the system tick and the UART go on.
+ * 2. Power down once the keypad is quiet: the scan stops, all the rows are driven and
+ *    INT0 wakes the MCU with the first key pressed. The scan starts again with the key
+ *    still down, so the key press is not lost.
  */
-static uint8 KEYPAD_4x3_adjustKeyNumber(uint8 button_number)
+static void KEYPAD_sleep(void)
 {
-	uint8 keypad_button = 0;
-	switch(button_number)
+	uint8 i;
+
+	if(g_quiet == FALSE)
 	{
-		case 10: keypad_button = '*'; // ASCII Code of *
-				 break;
-		case 11: keypad_button = 0;
-				 break;		
-		case 12: keypad_button = '#'; // ASCII Code of #
-				 break;
-		default: keypad_button = button_number;
-				break;
+		set_sleep_mode(SLEEP_MODE_IDLE);
+		sleep_mode();
+		return;
 	}
-	return keypad_button;
-} 
 
-#elif (KEYPAD_NUM_COLS == 4)
+	CLEAR_BIT(TIMSK,OCIE0);
+	TCCR0 = 0;
+	for(i = 0 ; i < KEYPAD_NUM_ROWS ; i++)
+	{
+		SET_BIT(KEYPAD_ROW_DIRECTION_REGISTER, (KEYPAD_FIRST_ROW_PIN_ID + i));
+	}
+
+	set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+	cli();
+	SET_BIT(GICR,INT0);
+	sleep_enable();
+	/* The instruction after sei runs before any interrupt, so the wake up can not be missed */
+	sei();
+	sleep_cpu();
+	sleep_disable();
+
+	KEYPAD_startScan();
+}
 
 /*
  * Description :
- * Update the keypad pressed button value with the correct one in keypad 4x4 shape
+ * Debounce one key sample: the key takes the sampled level after KEYPAD_DEBOUNCE_SAMPLES
+ * samples in a row, a pressed key counts its samples for the long press.
  */
-static uint8 KEYPAD_4x4_adjustKeyNumber(uint8 button_number)
+static void KEYPAD_sample(uint8 row, uint8 col, boolean pressed)
 {
-	uint8 keypad_button = 0;
-	switch(button_number)
-	{
-		case 1: keypad_button = 7;
-				break;
-		case 2: keypad_button = 8;
-				break;
-		case 3: keypad_button = 9;
-				break;
-		case 4: keypad_button = '%'; // ASCII Code of %
-				break;
-		case 5: keypad_button = 4;
-				break;
-		case 6: keypad_button = 5;
-				break;
-		case 7: keypad_button = 6;
-				break;
-		case 8: keypad_button = '*'; /* ASCII Code of '*' */
-				break;		
-		case 9: keypad_button = 1;
-				break;
-		case 10: keypad_button = 2;
-				break;
-		case 11: keypad_button = 3;
-				break;
-		case 12: keypad_button = '-'; /* ASCII Code of '-' */
-				break;
-		case 13: keypad_button = 13;  /* ASCII of Enter */
-				break;			
-		case 14: keypad_button = 0;
-				break;
-		case 15: keypad_button = '='; /* ASCII Code of '=' */
-				break;
-		case 16: keypad_button = '+'; /* ASCII Code of '+' */
-				break;
-		default: keypad_button = button_number;
-				break;
-	}
-	return keypad_button;
-} 
+	uint8 button = (row * KEYPAD_NUM_COLS) + col;
+	boolean debounced = BIT_IS_SET(g_rowPressed[row],col) ? TRUE : FALSE;
 
-#endif
+	if(pressed == debounced)
+	{
+		/* A bounce back to the debounced level restarts the count */
+		g_debounceCount[button] = 0;
+		CLEAR_BIT(g_rowCounting[row],col);
+		if(pressed && (g_holdCount[button] < KEYPAD_LONG_PRESS_SAMPLES))
+		{
+			g_holdCount[button]++;
+			if(g_holdCount[button] == KEYPAD_LONG_PRESS_SAMPLES)
+			{
+				KEYPAD_postEvent(button, KEYPAD_LONG_PRESS);
+			}
+		}
+		return;
+	}
 
-#endif /* STANDARD_KEYPAD */
+	SET_BIT(g_rowCounting[row],col);
+	g_debounceCount[button]++;
+	if(g_debounceCount[button] == KEYPAD_DEBOUNCE_SAMPLES)
+	{
+		g_debounceCount[button] = 0;
+		CLEAR_BIT(g_rowCounting[row],col);
+		g_holdCount[button] = 0;
+		if(pressed)
+		{
+			SET_BIT(g_rowPressed[row],col);
+			KEYPAD_postEvent(button, KEYPAD_PRESS);
+		}
+		else
+		{
+			CLEAR_BIT(g_rowPressed[row],col);
+			KEYPAD_postEvent(button, KEYPAD_RELEASE);
+		}
+	}
+}
+
+/*
+ * Description :
+ * Queue one key event with the functional value of the button, the event is lost if the queue is full.
+ */
+static void KEYPAD_postEvent(uint8 button, KEYPAD_EventKind kind)
+{
+	uint8 next = (g_queueHead + 1) & KEYPAD_QUEUE_MASK;
+
+	if(next == g_queueTail)
+	{
+		return;
+	}
+	g_queue[g_queueHead].key = pgm_read_byte(&g_keyTable[button]);
+	g_queue[g_queueHead].kind = kind;
+	/* Publish the event only after it is written */
+	g_queueHead = next;
+}
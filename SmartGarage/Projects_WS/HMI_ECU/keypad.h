@@ -1,4 +1,4 @@
- /******************************************************************************
+/******************************************************************************
  *
  * Module: KEYPAD
  *
@@ -30,17 +30,92 @@
 #define KEYPAD_COL_PORT_ID                PORTB_ID
 #define KEYPAD_FIRST_COL_PIN_ID           PIN4_ID
 
+/* Keypad registers of the row and column ports above */
+#define KEYPAD_ROW_DIRECTION_REGISTER     DDRB
+#define KEYPAD_ROW_OUTPUT_REGISTER        PORTB
+#define KEYPAD_COL_DIRECTION_REGISTER     DDRB
+#define KEYPAD_COL_INPUT_REGISTER         PINB
+
 /* Keypad button logic configurations */
 #define KEYPAD_BUTTON_PRESSED            LOGIC_LOW
 #define KEYPAD_BUTTON_RELEASED           LOGIC_HIGH
 
+/*
+ * Background scan on Timer0 compare mode with F_CPU/64: (249 + 1) * 8us = 2ms per row,
+ * each key is sampled every KEYPAD_NUM_ROWS * KEYPAD_SCAN_PERIOD_MS = 8ms.
+ */
+#define KEYPAD_SCAN_PERIOD_MS            2
+#define KEYPAD_TIMER_COMPARE_VALUE       249
+#define KEYPAD_SAMPLE_PERIOD_MS          (KEYPAD_NUM_ROWS * KEYPAD_SCAN_PERIOD_MS)
+
+/* A key changes state after the same level in KEYPAD_DEBOUNCE_SAMPLES samples in a row, 24ms */
+#define KEYPAD_DEBOUNCE_SAMPLES          3
+
+/* A key held for KEYPAD_LONG_PRESS_MS gives one KEYPAD_LONG_PRESS event, less than 256 samples */
+#define KEYPAD_LONG_PRESS_MS             1000
+#define KEYPAD_LONG_PRESS_SAMPLES        (KEYPAD_LONG_PRESS_MS / KEYPAD_SAMPLE_PERIOD_MS)
+
+/* Number of key events kept until they are read, must be a power of 2 */
+#define KEYPAD_QUEUE_SIZE                8
+
+/*
+ * Wake line: each column is joined to INT0 by a diode, cathode on the column, and the line
+ * has the internal pull-up. With all the rows driven any pressed key pulls INT0 low.
+ */
+#define KEYPAD_WAKE_PORT_ID              PORTD_ID
+#define KEYPAD_WAKE_PIN_ID               PIN2_ID
+
+/*
+ * KEYPAD_getPressedKey keeps the CPU in idle sleep between the interrupts, and powers the MCU
+ * down after KEYPAD_SLEEP_DELAY_MS without any key down until a key is pressed.
+ */
+#define KEYPAD_SLEEP_DELAY_MS            10000
+#define KEYPAD_SLEEP_SCANS               (KEYPAD_SLEEP_DELAY_MS / KEYPAD_SCAN_PERIOD_MS)
+
+/*******************************************************************************
+ *                               Types Declaration                             *
+ *******************************************************************************/
+typedef enum
+{
+	KEYPAD_PRESS,KEYPAD_RELEASE,KEYPAD_LONG_PRESS
+}KEYPAD_EventKind;
+
+typedef struct
+{
+	uint8 key;              /* Functional key value, the same values as KEYPAD_getPressedKey */
+	KEYPAD_EventKind kind;
+}KEYPAD_EventType;
+
 /*******************************************************************************
  *                      Functions Prototypes                                   *
  *******************************************************************************/
 
 /*
  * Description :
- * Get the Keypad pressed button
+ * Start the background keypad scan on Timer0, Timer0 belongs to the keypad after this call.
+ * The interrupts must be enabled for the scan to run.
+ */
+void KEYPAD_init(void);
+
+/*
+ * Description :
+ * Take the oldest key event without waiting.
+ * Return FALSE if no event is waiting.
+ */
+boolean KEYPAD_getEvent(KEYPAD_EventType *event);
+
+/*
+ * Description :
+ * Drop the key events waiting in the queue.
+ */
+void KEYPAD_flushEvents(void);
+
+/*
+ * Description :
+ * Wait for the next key press and return the pressed button.
+ * Each press is returned once, the key is taken again only after it is released.
+ * The CPU sleeps while it waits, see KEYPAD_SLEEP_DELAY_MS. In power down all the clocks
+ * stop: the system tick does not count and the received UART bytes are lost.
  */
 uint8 KEYPAD_getPressedKey(void);
 
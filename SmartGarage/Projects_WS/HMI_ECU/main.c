@@ -13,7 +13,8 @@
 #include "uart.h"
 #include "common_macros.h"
 #include "std_types.h"
-#include "timer.h"
+#include "scheduler.h"
+#include "protocol.h"
 #include <util/delay.h>
 
 /*******************************************************************************
@@ -23,26 +24,22 @@
 #define ROW_ONE										1
 #define COLUMN_ZERO									0
 #define COLUMN_TEN									10
-#define PASSWORD_SIZE                               5
-#define READY                                       0xFF
-#define DONE                                        0xFE
-#define PASSWORD_SEND                               0xFD
-#define PASSWORD_MATCH                              0xFC
-#define PASSWORD_NOT_MATCHED                        0xFB
-#define PASSWORD_CONFIRMATION_SEND                  0xFA
-#define CHANGE_PASSWORD                             0xF9
-#define OPEN_DOOR                                   0xF8
-#define CHECK_PASSWORD                              0xF7
-#define WRONG_PASSWORD                              0xF6
-#define CHECK_IF_SAVED                              0xF5
-#define YES_SAVED                                   0xF4
-#define NO_SAVED_PASSWORD                           0xF3
 #define MAX_WRONG_COUNTER                           3
-#define DC_ON_TICKS                                 16
-#define DC_HOLD_TICKS                               19
-#define TIMER_TICKS_STOP                            3
-#define TIMER_TICKS_1MINUTE                         60
-#define TIMER_TOTAL_TICKS							33
+/* The door cycle starts with the unlock reply, its screens follow the DOOR_PROGRESS stream of the CONTROL ECU */
+#define DOOR_PERCENT_COLUMN                         12
+#define DOOR_MESSAGE_TIME_MS                        1000
+/* Door settings screen: the value in use, then the new value typed */
+#define PARAMS_NEW_COLUMN                           8
+#define PARAMS_MAX_DIGITS                           3
+/* ON/C key, stops the door at any time of the door cycle */
+#define EMERGENCY_STOP_KEY                          13
+/* Password entry keys: '*' erases the last digit, ON/C clears the entry */
+#define PASSWORD_BACKSPACE_KEY                      '*'
+#define PASSWORD_CLEAR_KEY                          13
+/* Link statistics screen: 4 counters per row, each one letter + up to 3 digits */
+#define LINK_STATS_FIELD_WIDTH                      4
+#define LINK_STATS_MAX_SHOWN                        999
+#define LINK_STATS_NAME_COLUMN                      13
 
 /*******************************************************************************
  *                             Global Variables                                *
@@ -51,34 +48,71 @@ static volatile uint8 g_flag=0;
 static volatile uint8  g_done;
 uint8 g_key;                                  /*global variable to store the key value */
 uint8 g_password[PASSWORD_SIZE];              /*global array to store the password */
-uint8 command;                                /*global variable to store the commands */
+uint8 g_passmatch[PASSWORD_SIZE];             /*global array to store the password confirmation */
+PROTOCOL_FrameType g_frame;                   /*global frame to store the received reply */
 uint8 g_wrong=0;                              /*global variable to count wrong password entered times */
-uint8 g_tick=0;                               /*global ticks to count timer seconds */
+boolean g_busy=FALSE;                         /*global flag set while a timed screen runs */
+uint32 g_screenStart;                         /*global start time of the timed screen */
+uint32 g_screenTime=0;                        /*global time of the timed screen, 0 if it ends on an event */
+uint8 g_doorState;                            /*global variable to store the last door state shown */
+PROTOCOL_ParamsType g_params;                 /*global copy of the door parameters of the CONTROL ECU */
+uint8 g_doorPercent;                          /*global variable to store the last door opening shown */
+uint32 g_progressTime;                        /*global time of the last door state received */
+SCHEDULER_TimerId g_doorTimer = SCHEDULER_NO_TIMER; /*global id of the door stream watchdog timer */
+uint8 g_statusSeq = PROTOCOL_NO_SEQ;          /*global sequence number of the DOOR_STATUS request without reply */
+uint8 g_statusRetries;                        /*global count of the DOOR_STATUS request retries */
 
-UART_ConfigType UART_configuration = {EIGHT, DISABLED, ONE, 9600};
-Timer1_ConfigType TIMER_configuration= {0, 7812,F_CPU_1024,Compare};
+UART_ConfigType UART_configuration = {EIGHT, DISABLED, ONE, UART_BAUD_9600};
 
 /*******************************************************************************
  *                      Functions Prototypes                                   *
  *******************************************************************************/
 void Password_creatAndStore(void);
-void Password_send(uint8 a_arr[]);
-void Command_send(uint8 command);
-uint8 Command_recieve(void);
+uint8 Password_send(uint8 command, uint8 a_arr[]);
+uint8 Command_send(uint8 command);
+uint8 Command_recieve(uint8 seq);
+uint8 Request_send(uint8 command, const uint8 *payload, uint8 length);
 void Main_options(void);
-void Password_fillIn(uint8 a_arr[]);
+void Password_fillIn(uint8 a_arr[], uint8 col);
+void Password_showEntry(uint8 col, uint8 length);
+boolean Password_isSame(const uint8 a_first[], const uint8 a_second[]);
 void Password_wrongScreen(void);
-void Alert(void);
-void Door_isOpeningClosing(void);
+void Door_progress(const PROTOCOL_FrameType *frame);
+void Door_watchdog(void);
+void Door_status(void);
+void Door_update(uint8 state, uint8 percent);
+void Door_showState(uint8 state);
+void Door_showPercent(uint8 percent);
+void Screen_done(void);
+void Screen_endAfter(uint32 time_ms);
+void Event_loop(void);
+void Link_statsScreen(void);
+void Params_get(void);
+void Params_screen(void);
+uint8 Params_fillIn(const char *name, uint8 value);
+void Link_statsDisplay(const char *name, const PROTOCOL_LinkStatsType *stats);
+void Link_counterDisplay(uint8 row, uint8 field, char label, uint16 value);
 
 int main(void)
 {
 	LCD_init(); /* Initialize the LCD */
 
+	KEYPAD_init(); /* Start the background keypad scan */
+
 	UART_init(&UART_configuration); /* Initialize the UART with configurations */
 
+	PROTOCOL_init(); /* Count the bytes of a peer at another baud rate as link errors */
+
+	SCHEDULER_init(); /* Start the system tick of the virtual timers */
+
+	PROTOCOL_setNotifyCallBack(Door_progress); /* The door cycle screens follow the DOOR_PROGRESS frames */
+
 	SREG |= (1<<7);       /* Enable I-Bit for Interrupts */
 
+	PROTOCOL_negotiateSpeed(); /* Step the link up to the fastest reliable baud rate */
+
+	Params_get(); /* The lockout time is a door parameter of the CONTROL ECU */
+
 	Password_creatAndStore();
 	while(1)
 	{
@@ -96,21 +130,22 @@ void Password_creatAndStore(void)
 	{
 		LCD_clearScreen();
 		LCD_displayString("PLZ Enter PASS:");
-		LCD_moveCursor(ROW_ONE,COLUMN_ZERO);
-		Password_fillIn(g_password);
-		Command_send(PASSWORD_SEND);
-		Password_send(g_password);
+		Password_fillIn(g_password, COLUMN_ZERO);
 
 		LCD_clearScreen();
 		LCD_displayString("PLZ Re-Enter the");
 		LCD_moveCursor(ROW_ONE,COLUMN_ZERO);
 		LCD_displayString("Same PASS:");
-		LCD_moveCursor(ROW_ONE,COLUMN_TEN);
-		Password_fillIn(g_password);
-		Command_send(PASSWORD_CONFIRMATION_SEND);
-		Password_send(g_password);
-
-		switch(Command_recieve())
+		Password_fillIn(g_passmatch, COLUMN_TEN);
+		/* A confirmation that does not match is rejected here, it is never sent */
+		if(Password_isSame(g_password, g_passmatch) == FALSE)
+		{
+			LCD_clearScreen();
+			LCD_displayString("PASS Not Matched");
+			_delay_ms(1000);
+			continue;
+		}
+		switch(Command_recieve(Password_send(PASSWORD_CONFIRMATION_SEND, g_password)))
 		{
 		case PASSWORD_MATCH:
 			g_flag=3;
@@ -124,45 +159,78 @@ void Password_creatAndStore(void)
 }
 /*
  * Description
- * Functions that responsible for Sending the input password.
+ * Functions that responsible for Sending the command and the input password in one frame.
+ * The password confirmation is appended for the PASSWORD_CONFIRMATION_SEND command.
+ * Return the sequence number of the request to wait for its reply.
  */
-void Password_send(uint8 a_arr[])
+uint8 Password_send(uint8 command, uint8 a_arr[])
 {
 	uint8 i;
-	UART_sendByte(READY);
-	while(UART_recieveByte() != READY);
+	uint8 payload[PROTOCOL_MAX_PAYLOAD];
+	uint8 length = PASSWORD_SIZE;
 
 	for(i=0 ; i<PASSWORD_SIZE ; i++)
 	{
-		UART_sendByte(a_arr[i]);
+		payload[i] = a_arr[i];
+	}
+	if(command == PASSWORD_CONFIRMATION_SEND)
+	{
+		for(i=0 ; i<PASSWORD_SIZE ; i++)
+		{
+			payload[PASSWORD_SIZE+i] = g_passmatch[i];
+		}
+		length += PASSWORD_SIZE;
 	}
+	return Request_send(command, payload, length);
 }
 /*
  * Description
- * Functions that responsible for Sending the Command.
+ * Functions that responsible for Sending the Command as a request without payload.
+ * Return the sequence number of the request to wait for its reply.
  */
-void Command_send(uint8 command)
+uint8 Command_send(uint8 command)
 {
-	UART_sendByte(READY);
-	while(UART_recieveByte() != READY);
-	UART_sendByte(command);
+	return Request_send(command, NULL_PTR, 0);
 }
 /*
  * Description
- * Functions that responsible for Receiving the Command.
+ * Functions that responsible for Receiving the reply of the request seq and returning its Command.
+ * Return LINK_LOST if the CONTROL ECU does not answer even after the link resync,
+ * the calling screen then starts again.
  */
-uint8 Command_recieve(void)
+uint8 Command_recieve(uint8 seq)
 {
-	while(UART_recieveByte() != READY);
-	UART_sendByte(READY);
-	command = UART_recieveByte();
-	return command;
+	if(PROTOCOL_waitReply(seq, &g_frame) == FALSE)
+	{
+		LCD_clearScreen();
+		LCD_displayString("Link Lost");
+		_delay_ms(1000);
+		return LINK_LOST;
+	}
+	return g_frame.type;
+}
+/*
+ * Description
+ * Functions that responsible for queuing a request in the send window.
+ * Waits only while the window is full of requests without replies.
+ */
+uint8 Request_send(uint8 command, const uint8 *payload, uint8 length)
+{
+	uint8 seq;
+
+	while((seq = PROTOCOL_request(command, payload, length)) == PROTOCOL_NO_SEQ)
+	{
+		PROTOCOL_poll();
+	}
+	return seq;
 }
 /*
  * Description
  * Functions that responsible for:
  * 1- Open Door.
  * 2- Change Password.
+ * 3- Link statistics ('%' key, diagnostic only).
+ * 4- Door settings ('*' key, after the password).
  */
 void Main_options(void)
 {
@@ -172,6 +240,8 @@ void Main_options(void)
 	LCD_moveCursor(ROW_ONE,COLUMN_ZERO);
 	LCD_displayString("- : Change Pass");
 
+	/* The keys pressed before the menu is shown are not options */
+	KEYPAD_flushEvents();
 	switch(KEYPAD_getPressedKey())
 	{
 	case '-':
@@ -179,11 +249,8 @@ void Main_options(void)
 		{
 			LCD_clearScreen();
 			LCD_displayString("PLZ Enter PASS:");
-			LCD_moveCursor(ROW_ONE,COLUMN_ZERO);
-			Password_fillIn(g_password);
-			Command_send(CHECK_PASSWORD);
-			Password_send(g_password);
-			switch (Command_recieve())
+			Password_fillIn(g_password, COLUMN_ZERO);
+			switch (Command_recieve(Password_send(CHECK_PASSWORD, g_password)))
 			{
 			case PASSWORD_MATCH:
 				Password_creatAndStore();
@@ -202,21 +269,39 @@ void Main_options(void)
 		{
 			LCD_clearScreen();
 			LCD_displayString("PLZ Enter PASS:");
-			LCD_moveCursor(ROW_ONE,COLUMN_ZERO);
-			Password_fillIn(g_password);
-			Command_send(CHECK_PASSWORD);
-			Password_send(g_password);
-			switch (Command_recieve())
+			Password_fillIn(g_password, COLUMN_ZERO);
+			/* One request verifies the password and starts the motor */
+			switch (Command_recieve(Password_send(UNLOCK_DOOR, g_password)))
+			{
+			case DOOR_OPENING:
+				g_busy = TRUE;
+				g_doorState = DOOR_STATE_OPENING;
+				g_doorPercent = 0;
+				Door_showState(DOOR_STATE_OPENING);
+				Door_showPercent(0);
+				g_progressTime = SCHEDULER_getMillis();
+				g_doorTimer = SCHEDULER_startTimer(DOOR_PROGRESS_PERIOD_MS, SCHEDULER_PERIODIC, Door_watchdog);
+				Event_loop();
+				g_done = 1;
+				g_wrong=0;
+				break;
+			case PASSWORD_NOT_MATCHED:
+				Password_wrongScreen();
+				break;
+			}
+		}
+		break;
+
+	case '*':
+		while(g_done != 1)
+		{
+			LCD_clearScreen();
+			LCD_displayString("PLZ Enter PASS:");
+			Password_fillIn(g_password, COLUMN_ZERO);
+			switch (Command_recieve(Password_send(CHECK_PASSWORD, g_password)))
 			{
 			case PASSWORD_MATCH:
-				Command_send(OPEN_DOOR);
-				UART_sendByte(READY);
-				while(UART_recieveByte() != READY){};
-				Timer1_setCallBack(Door_isOpeningClosing);
-				Timer1_init(&TIMER_configuration);
-				while(g_tick != TIMER_TOTAL_TICKS);
-				Timer1_deInit();
-				g_tick = 0;
+				Params_screen();
 				g_done = 1;
 				g_wrong=0;
 				break;
@@ -226,6 +311,10 @@ void Main_options(void)
 			}
 		}
 		break;
+
+	case '%':
+		Link_statsScreen();
+		break;
 	}
 }
 /*
@@ -237,72 +326,460 @@ void Password_wrongScreen(void)
 	g_wrong++;
 	if(g_wrong == MAX_WRONG_COUNTER)
 	{
-		Command_send(WRONG_PASSWORD);
-		UART_sendByte(READY);
-		while(UART_recieveByte() != READY);
-		Timer1_setCallBack(Alert);
-		Timer1_init(&TIMER_configuration);
-		while(g_tick != TIMER_TICKS_1MINUTE);
-		Timer1_deInit();
-		g_tick = 0;
+		Command_recieve(Command_send(WRONG_PASSWORD));
+		LCD_clearScreen();
+		LCD_displayString("ALERT!!!!");
+		g_busy = TRUE;
+		Screen_endAfter((uint32)g_params.lockout_time * 1000);
+		Event_loop();
 		g_done = 1;
 		g_wrong=0;
 	}
 }
 /*
  * Description
- * Functions that responsible for fill in the password.
+ * Functions that responsible for fill in the password on the second row from the column col.
+ * Each key press is taken once, so the digits are read as fast as they are typed:
+ * 1- A digit is added while the entry has less than PASSWORD_SIZE digits.
+ * 2- '*' erases the last digit and ON/C clears the entry.
+ * 3- '=' accepts the entry only once it has PASSWORD_MIN_LENGTH digits, so a short
+ *    password is never sent to the CONTROL ECU.
+ * The places after the last digit are filled with PASSWORD_NO_DIGIT.
  */
-void Password_fillIn(uint8 a_arr[])
+void Password_fillIn(uint8 a_arr[], uint8 col)
 {
 	uint8 counter=0;
-	g_key = 0;
-	while(g_key != '=')
+
+	Password_showEntry(col, counter);
+	while(1)
 	{
 		g_key=KEYPAD_getPressedKey();
-		if(g_key >= 0 && g_key <= 9)
+		if((g_key <= 9) && (counter < PASSWORD_SIZE))
 		{
 			a_arr[counter] = g_key;
-			LCD_displayCharacter('*');
 			counter++;
 		}
-		_delay_ms(250);		/*Delay for 0.25 seconds*/
+		else if((g_key == PASSWORD_BACKSPACE_KEY) && (counter > 0))
+		{
+			counter--;
+		}
+		else if(g_key == PASSWORD_CLEAR_KEY)
+		{
+			counter = 0;
+		}
+		else if((g_key == '=') && (counter >= PASSWORD_MIN_LENGTH))
+		{
+			break;
+		}
+		Password_showEntry(col, counter);
+	}
+	for( ; counter < PASSWORD_SIZE ; counter++)
+	{
+		a_arr[counter] = PASSWORD_NO_DIGIT;
 	}
 }
 /*
  * Description
- * Functions that responsible for showing word (Alert) on the LCD.
+ * Functions that responsible for comparing the password with its confirmation.
  */
-void Alert(void)
+boolean Password_isSame(const uint8 a_first[], const uint8 a_second[])
 {
-	g_tick++;
-	if(g_tick == 1)
+	uint8 i;
+
+	for(i = 0 ; i < PASSWORD_SIZE ; i++)
 	{
-		LCD_clearScreen();
-		LCD_displayString("ALERT!!!!");
+		if(a_first[i] != a_second[i])
+		{
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+/*
+ * Description
+ * Functions that responsible for showing the password entry as its length indicator:
+ * a '*' for each digit typed, a '_' for each digit still needed and a '.' for each optional one.
+ */
+void Password_showEntry(uint8 col, uint8 length)
+{
+	uint8 i;
+
+	LCD_moveCursor(ROW_ONE,col);
+	for(i = 0 ; i < PASSWORD_SIZE ; i++)
+	{
+		if(i < length)
+		{
+			LCD_displayCharacter('*');
+		}
+		else if(i < PASSWORD_MIN_LENGTH)
+		{
+			LCD_displayCharacter('_');
+		}
+		else
+		{
+			LCD_displayCharacter('.');
+		}
+	}
+}
+/*
+ * Description
+ * Functions that responsible for the frames the CONTROL ECU sends without a request,
+ * the DOOR_PROGRESS frames of the running door cycle are shown.
+ */
+void Door_progress(const PROTOCOL_FrameType *frame)
+{
+	if((frame->type == DOOR_PROGRESS) && (frame->length >= DOOR_PROGRESS_SIZE))
+	{
+		g_progressTime = SCHEDULER_getMillis();
+		Door_update(frame->payload[0], frame->payload[1]);
+	}
+}
+/*
+ * Description
+ * Functions that responsible for checking the DOOR_PROGRESS stream, every DOOR_PROGRESS_PERIOD_MS:
+ * when it is silent for DOOR_PROGRESS_TIMEOUT_MS the door state is asked with DOOR_STATUS.
+ * The request is not waited for, Door_status takes its reply. Without a reply it is sent
+ * again each period, after PROTOCOL_MAX_RETRIES retries the door cycle ends as DOOR_STATE_LINK_LOST.
+ */
+void Door_watchdog(void)
+{
+	if(g_statusSeq != PROTOCOL_NO_SEQ)
+	{
+		if(g_statusRetries < PROTOCOL_MAX_RETRIES)
+		{
+			g_statusRetries++;
+			PROTOCOL_resendRequest(g_statusSeq);
+		}
+		else
+		{
+			Door_update(DOOR_STATE_LINK_LOST, g_doorPercent);
+		}
+		return;
+	}
+	if(SCHEDULER_isTimeout(g_progressTime, DOOR_PROGRESS_TIMEOUT_MS) == FALSE)
+	{
+		return;
+	}
+	/* With the send window full the request is tried again at the next period */
+	g_statusSeq = PROTOCOL_request(DOOR_STATUS, NULL_PTR, 0);
+	g_statusRetries = 0;
+}
+/*
+ * Description
+ * Functions that responsible for taking the reply of the DOOR_STATUS request of the watchdog
+ * and showing the door state it carries.
+ */
+void Door_status(void)
+{
+	if((g_statusSeq == PROTOCOL_NO_SEQ) || (PROTOCOL_getReply(g_statusSeq, &g_frame) == FALSE))
+	{
+		return;
+	}
+	g_statusSeq = PROTOCOL_NO_SEQ;
+	g_progressTime = SCHEDULER_getMillis();
+	if((g_frame.type == DOOR_STATUS) && (g_frame.length != 0))
+	{
+		Door_update(g_frame.payload[0], g_doorPercent);
+	}
+}
+/*
+ * Description
+ * Functions that responsible for following the door cycle of the CONTROL ECU:
+ * the door screen changes with the door state and the opening, and ends when the door
+ * is closed, when the motor stops on a fault, after an emergency stop or when the link is lost.
+ * The fault, stop and link messages stay for DOOR_MESSAGE_TIME_MS before the screen ends.
+ */
+void Door_update(uint8 state, uint8 percent)
+{
+	if(g_doorTimer == SCHEDULER_NO_TIMER)
+	{
+		/* No door cycle is shown */
+		return;
+	}
+	if(state != g_doorState)
+	{
+		g_doorState = state;
+		Door_showState(state);
+		Door_showPercent(percent);
+	}
+	else if(percent != g_doorPercent)
+	{
+		Door_showPercent(percent);
+	}
+	g_doorPercent = percent;
+	if((state == DOOR_STATE_CLOSED) || (state == DOOR_STATE_FAULT) || (state == DOOR_STATE_STOPPED) ||
+			(state == DOOR_STATE_LINK_LOST))
+	{
+		SCHEDULER_stopTimer(g_doorTimer);
+		g_doorTimer = SCHEDULER_NO_TIMER;
+		PROTOCOL_dropRequest(g_statusSeq);
+		g_statusSeq = PROTOCOL_NO_SEQ;
+		if(state == DOOR_STATE_CLOSED)
+		{
+			Screen_done();
+		}
+		else
+		{
+			Screen_endAfter(DOOR_MESSAGE_TIME_MS);
+		}
 	}
 }
 /*
  * Description
- * Functions that responsible for showing on the LCD:
- * 1- Door UNLocking..
- * 2- Door Locking..
+ * Functions that responsible for showing a new door state, the hold keeps the opening screen.
  */
-void Door_isOpeningClosing(void)
+void Door_showState(uint8 state)
 {
-	g_tick++;
-	if(g_tick == 1)
+	switch(state)
 	{
+	case DOOR_STATE_OPENING:
 		LCD_clearScreen();
 		LCD_displayString("Door UNLocking..");
+		break;
+	case DOOR_STATE_CLOSING:
+		LCD_clearScreen();
+		LCD_displayString("Door Locking..");
+		break;
+	case DOOR_STATE_OBSTACLE:
+		LCD_clearScreen();
+		LCD_displayString("Obstacle!");
+		LCD_moveCursor(ROW_ONE,COLUMN_ZERO);
+		LCD_displayString("Reopening");
+		break;
+	case DOOR_STATE_STALLED:
+		LCD_clearScreen();
+		LCD_displayString("Door Jammed!");
+		LCD_moveCursor(ROW_ONE,COLUMN_ZERO);
+		LCD_displayString("Reopening");
+		break;
+	case DOOR_STATE_FAULT:
+		LCD_clearScreen();
+		LCD_displayString("Motor Fault");
+		break;
+	case DOOR_STATE_STOPPED:
+		LCD_clearScreen();
+		LCD_displayString("Door Stopped");
+		break;
+	case DOOR_STATE_LINK_LOST:
+		LCD_clearScreen();
+		LCD_displayString("Link Lost");
+		break;
 	}
-	else if(g_tick == DC_ON_TICKS)
+}
+/*
+ * Description
+ * Functions that responsible for showing the door opening at the end of the second row
+ * while the door moves or is held open.
+ */
+void Door_showPercent(uint8 percent)
+{
+	switch(g_doorState)
 	{
-		/*Do Nothing*/
+	case DOOR_STATE_OPENING:
+	case DOOR_STATE_HOLD:
+	case DOOR_STATE_CLOSING:
+	case DOOR_STATE_OBSTACLE:
+	case DOOR_STATE_STALLED:
+		LCD_moveCursor(ROW_ONE,DOOR_PERCENT_COLUMN);
+		if(percent < 100)
+		{
+			LCD_displayCharacter(' ');
+		}
+		if(percent < 10)
+		{
+			LCD_displayCharacter(' ');
+		}
+		LCD_intgerToString(percent);
+		LCD_displayCharacter('%');
+		break;
 	}
-	else if(g_tick == DC_HOLD_TICKS)
+}
+/*
+ * Description
+ * Functions that responsible for ending the running timed screen.
+ */
+void Screen_done(void)
+{
+	g_busy = FALSE;
+	g_screenTime = 0;
+}
+/*
+ * Description
+ * Functions that responsible for ending the running timed screen after time_ms.
+ * The event loop times it, so it needs no scheduler timer.
+ */
+void Screen_endAfter(uint32 time_ms)
+{
+	g_screenStart = SCHEDULER_getMillis();
+	g_screenTime = time_ms;
+}
+/*
+ * Description
+ * Functions that responsible for running the event loop while a timed screen runs:
+ * the timer call backs are dispatched, the received frames are handled and
+ * the screen ends once its time is over. The key events are taken without waiting, a press of the stop key sends
+ * the emergency stop frames and the other keys are dropped.
+ * Nothing in the loop waits, so the stop key is sampled on every turn.
+ */
+void Event_loop(void)
+{
+	KEYPAD_EventType event;
+
+	while(g_busy)
 	{
+		SCHEDULER_dispatch();
+		PROTOCOL_poll();
+		Door_status();
+		if((g_screenTime != 0) && SCHEDULER_isTimeout(g_screenStart, g_screenTime))
+		{
+			Screen_done();
+		}
+		if(KEYPAD_getEvent(&event) && (event.kind == KEYPAD_PRESS) && (event.key == EMERGENCY_STOP_KEY))
+		{
+			PROTOCOL_sendEmergencyStop();
+		}
+	}
+}
+/*
+ * Description
+ * Functions that responsible for showing the link health counters:
+ * 1- CONTROL ECU counters, read with the LINK_STATS requests.
+ * 2- HMI ECU counters.
+ * Each screen stays until a key is pressed.
+ */
+void Link_statsScreen(void)
+{
+	PROTOCOL_LinkStatsType stats = {{0,0,0,0},{0,0,0}};
+	uint8 uart_page = LINK_STATS_UART_PAGE;
+	uint8 protocol_page = LINK_STATS_PROTOCOL_PAGE;
+	uint8 uart_seq;
+	uint8 protocol_seq;
+
+	/* Both pages are in the send window at the same time */
+	uart_seq = Request_send(LINK_STATS, &uart_page, 1);
+	protocol_seq = Request_send(LINK_STATS, &protocol_page, 1);
+	if(Command_recieve(uart_seq) == LINK_STATS)
+	{
+		PROTOCOL_decodeLinkStats(LINK_STATS_UART_PAGE, &g_frame, &stats);
+	}
+	if(Command_recieve(protocol_seq) == LINK_STATS)
+	{
+		PROTOCOL_decodeLinkStats(LINK_STATS_PROTOCOL_PAGE, &g_frame, &stats);
+	}
+	Link_statsDisplay("CTL", &stats);
+	KEYPAD_getPressedKey();
+
+	PROTOCOL_getLinkStats(&stats);
+	Link_statsDisplay("HMI", &stats);
+	KEYPAD_getPressedKey();
+}
+/*
+ * Description
+ * Functions that responsible for showing the counters of one ECU on the LCD:
+ * Row 0: F framing errors, O overruns, P parity errors, V RX buffer overflows.
+ * Row 1: C CRC errors, R retries, S resyncs and the ECU name.
+ */
+void Link_statsDisplay(const char *name, const PROTOCOL_LinkStatsType *stats)
+{
+	LCD_clearScreen();
+	Link_counterDisplay(ROW_ZERO, 0, 'F', stats->uart.framing_errors);
+	Link_counterDisplay(ROW_ZERO, 1, 'O', stats->uart.overrun_errors);
+	Link_counterDisplay(ROW_ZERO, 2, 'P', stats->uart.parity_errors);
+	Link_counterDisplay(ROW_ZERO, 3, 'V', stats->uart.rx_overflows);
+	Link_counterDisplay(ROW_ONE, 0, 'C', stats->protocol.crc_errors);
+	Link_counterDisplay(ROW_ONE, 1, 'R', stats->protocol.retries);
+	Link_counterDisplay(ROW_ONE, 2, 'S', stats->protocol.resyncs);
+	LCD_displayStringRowColumn(ROW_ONE, LINK_STATS_NAME_COLUMN, name);
+}
+/*
+ * Description
+ * Functions that responsible for showing one counter in its field, large values show as 999.
+ */
+void Link_counterDisplay(uint8 row, uint8 field, char label, uint16 value)
+{
+	if(value > LINK_STATS_MAX_SHOWN)
+	{
+		value = LINK_STATS_MAX_SHOWN;
+	}
+	LCD_moveCursor(row, field * LINK_STATS_FIELD_WIDTH);
+	LCD_displayCharacter(label);
+	LCD_intgerToString(value);
+}
+/*
+ * Description
+ * Functions that responsible for Getting the door parameters in use from the CONTROL ECU,
+ * the default values are kept if they can not be read.
+ */
+void Params_get(void)
+{
+	PROTOCOL_defaultParams(&g_params);
+	if(Command_recieve(Command_send(PARAMS_GET)) == PARAMS_GET)
+	{
+		PROTOCOL_decodeParams(g_frame.payload, g_frame.length, &g_params);
+	}
+}
+/*
+ * Description
+ * Functions that responsible for changing the door parameters one by one,
+ * the CONTROL ECU checks and stores them and uses them from the next door cycle.
+ */
+void Params_screen(void)
+{
+	PROTOCOL_ParamsType params = g_params;
+	uint8 payload[PARAMS_SIZE];
+
+	params.open_time = Params_fillIn("Open Time x0.1s", params.open_time);
+	params.hold_time = Params_fillIn("Hold Time x0.1s", params.hold_time);
+	params.close_time = Params_fillIn("Close Time x0.1s", params.close_time);
+	params.ramp_time = Params_fillIn("Ramp Time x0.1s", params.ramp_time);
+	params.speed = Params_fillIn("Speed %", params.speed);
+	params.lockout_time = Params_fillIn("Lockout Time s", params.lockout_time);
+
+	PROTOCOL_encodeParams(&params, payload);
+	switch(Command_recieve(Request_send(PARAMS_SET, payload, PARAMS_SIZE)))
+	{
+	case PARAMS_GET:
+		PROTOCOL_decodeParams(g_frame.payload, g_frame.length, &g_params);
 		LCD_clearScreen();
-		LCD_displayString("Door Locking..");
+		LCD_displayString("Settings Saved");
+		_delay_ms(1000);
+		break;
+	case PARAMS_REJECTED:
+		LCD_clearScreen();
+		LCD_displayString("Invalid Values");
+		_delay_ms(1000);
+		break;
+	}
+}
+/*
+ * Description
+ * Functions that responsible for fill in one door parameter: the value in use is shown,
+ * the typed digits replace it when '=' is pressed, '=' alone keeps it.
+ */
+uint8 Params_fillIn(const char *name, uint8 value)
+{
+	uint16 number = 0;
+	uint8 digits = 0;
+
+	LCD_clearScreen();
+	LCD_displayString(name);
+	LCD_moveCursor(ROW_ONE,COLUMN_ZERO);
+	LCD_intgerToString(value);
+	LCD_moveCursor(ROW_ONE,PARAMS_NEW_COLUMN);
+	g_key = 0;
+	while(g_key != '=')
+	{
+		g_key=KEYPAD_getPressedKey();
+		if((g_key <= 9) && (digits < PARAMS_MAX_DIGITS))
+		{
+			number = number*10 + g_key;
+			LCD_intgerToString(g_key);
+			digits++;
+		}
+	}
+	if((digits == 0) || (number > 0xFF))
+	{
+		return value;
 	}
+	return (uint8)number;
 }
@@ -0,0 +1,1170 @@
+ /******************************************************************************
+ *
+ * Module: PROTOCOL
+ *
+ * File Name: protocol.c
+ *
+ * Description: Source file for the framed HMI <-> CONTROL message protocol
+ *
+ * Author: Shehab Kishta
+ *
+ *******************************************************************************/
+
+#include "protocol.h"
+#include "scheduler.h"
+#include <util/delay.h>
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+#define PROTOCOL_MAX_FRAME_SIZE		(PROTOCOL_HEADER_SIZE + PROTOCOL_MAX_PAYLOAD + PROTOCOL_CRC_SIZE)
+
+#if (LINK_ERROR_LIMIT < PROTOCOL_MAX_FRAME_SIZE)
+#error "LINK_ERROR_LIMIT must be above the bytes of a frame that lost its START byte"
+#endif
+
+/*******************************************************************************
+ *                               Types Declaration                             *
+ *******************************************************************************/
+typedef enum
+{
+	WAIT_START,WAIT_TYPE,WAIT_SEQ,WAIT_LENGTH,WAIT_PAYLOAD,WAIT_CRC
+}PROTOCOL_ParserState;
+
+typedef enum
+{
+	SLOT_FREE,SLOT_PENDING,SLOT_DONE
+}PROTOCOL_SlotState;
+
+typedef struct
+{
+	PROTOCOL_SlotState state;
+	PROTOCOL_FrameType request;
+	PROTOCOL_FrameType reply;
+}PROTOCOL_WindowSlot;
+
+/*******************************************************************************
+ *                           Global Variables                                  *
+ *******************************************************************************/
+static PROTOCOL_ParserState g_parserState = WAIT_START;
+static PROTOCOL_FrameType g_rxFrame;
+static uint8 g_rxIndex = 0;
+static uint8 g_rxCrc = 0;
+static uint8 g_linkErrors = 0;
+
+/* Bytes with a framing or parity error: counted by the RX ISR, taken by the parser */
+static volatile uint8 g_lineErrors = 0;
+static uint8 g_lineErrorsTaken = 0;
+static uint8 g_lineErrorRun = 0;
+
+/*
+ * Raw bytes of the frame being parsed. When the frame turns out to be bad its
+ * bytes after the START byte are parsed again from the replay buffer, so a real
+ * START byte hidden inside a broken frame is not lost.
+ * The replayed bytes were counted once already with their dropped frame,
+ * they add no more link errors.
+ */
+static uint8 g_rawFrame[PROTOCOL_MAX_FRAME_SIZE];
+static uint8 g_rawLength = 0;
+static uint8 g_replayBuffer[PROTOCOL_MAX_FRAME_SIZE];
+static uint8 g_replayIndex = 0;
+static uint8 g_replayLength = 0;
+static boolean g_byteReplayed = FALSE;
+static boolean g_frameReplayed = FALSE;
+
+/* Send window of the requests waiting for their replies */
+static PROTOCOL_WindowSlot g_window[PROTOCOL_WINDOW_SIZE];
+static uint8 g_nextSeq = 1;
+static void (*g_notifyCallBackPtr)(const PROTOCOL_FrameType *frame) = NULL_PTR;
+
+/* Replies of the last handled requests on the responder side, the oldest one is replaced next.
+ * The requester has up to PROTOCOL_WINDOW_SIZE requests in flight, any of them may be retried */
+static PROTOCOL_FrameType g_replyCache[PROTOCOL_WINDOW_SIZE];
+static uint8 g_replyNext = 0;
+
+/* Link error counters of the protocol */
+static PROTOCOL_StatsType g_stats;
+
+/* Test pattern sent in the probe frames, it toggles every bit on the line */
+static const uint8 g_probePattern[] = {0x55, 0xAA, 0x00, 0xFF};
+
+/*
+ * Bytes of the EMERGENCY_STOP frame. The RX ISR follows the frames on the line: the position
+ * in the frame being received (0 between frames), the bytes left after its header, and
+ * whether its bytes so far are the ones of the EMERGENCY_STOP frame.
+ */
+static uint8 g_emergencyFrame[PROTOCOL_HEADER_SIZE + PROTOCOL_CRC_SIZE];
+static uint8 g_emergencyPosition = 0;
+static uint8 g_emergencyLeft = 0;
+static boolean g_emergencyMatched = FALSE;
+static void (*g_emergencyCallBackPtr)(void) = NULL_PTR;
+
+/*******************************************************************************
+ *                      Functions Prototypes(Private)                          *
+ *******************************************************************************/
+static boolean PROTOCOL_nextByte(uint8 *data);
+static void PROTOCOL_dropFrame(void);
+static void PROTOCOL_resetParser(void);
+static void PROTOCOL_linkError(void);
+static void PROTOCOL_takeLineErrors(void);
+static void PROTOCOL_fallBack(void);
+static void PROTOCOL_lineError(void);
+static uint16 PROTOCOL_replyTimeout(const PROTOCOL_FrameType *request);
+static boolean PROTOCOL_probeSpeed(void);
+static void PROTOCOL_copyFrame(PROTOCOL_FrameType *destination, const PROTOCOL_FrameType *source);
+static void PROTOCOL_putWord(uint8 *payload, uint16 value);
+static uint16 PROTOCOL_getWord(const uint8 *payload);
+static void PROTOCOL_matchEmergency(uint8 data);
+static PROTOCOL_FrameType *PROTOCOL_cachedReply(uint8 seq);
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Update the CRC-8 value with one more byte.
+ */
+uint8 PROTOCOL_crc8(uint8 crc, uint8 data)
+{
+	uint8 bit;
+
+	crc ^= data;
+	for(bit = 0 ; bit < 8 ; bit++)
+	{
+		if(crc & 0x80)
+		{
+			crc = (crc << 1) ^ PROTOCOL_CRC8_POLYNOMIAL;
+		}
+		else
+		{
+			crc <<= 1;
+		}
+	}
+	return crc;
+}
+
+/*
+ * Description :
+ * Initialize the protocol, to be called after UART_init:
+ * the bytes received with a framing or parity error are counted as link errors.
+ */
+void PROTOCOL_init(void)
+{
+	PROTOCOL_resetParser();
+	UART_setErrorCallBack(PROTOCOL_lineError);
+}
+
+/*
+ * Description :
+ * Build one frame from the message type, sequence number and payload and queue it on the UART.
+ * Payloads longer than PROTOCOL_MAX_PAYLOAD are cut to PROTOCOL_MAX_PAYLOAD.
+ */
+void PROTOCOL_sendFrame(uint8 type, uint8 seq, const uint8 *payload, uint8 length)
+{
+	uint8 buffer[PROTOCOL_MAX_FRAME_SIZE];
+	uint8 size = 0;
+	uint8 sent = 0;
+	uint8 crc = 0;
+	uint8 i;
+
+	if(length > PROTOCOL_MAX_PAYLOAD)
+	{
+		length = PROTOCOL_MAX_PAYLOAD;
+	}
+
+	buffer[size++] = PROTOCOL_START_BYTE;
+	buffer[size++] = type;
+	buffer[size++] = seq;
+	buffer[size++] = length;
+	crc = PROTOCOL_crc8(crc, type);
+	crc = PROTOCOL_crc8(crc, seq);
+	crc = PROTOCOL_crc8(crc, length);
+	for(i = 0 ; i < length ; i++)
+	{
+		buffer[size++] = payload[i];
+		crc = PROTOCOL_crc8(crc, payload[i]);
+	}
+	buffer[size++] = crc;
+
+	/* Queue the whole frame, waiting only while the TX ring buffer is full */
+	while(sent < size)
+	{
+		sent += UART_write(&buffer[sent], size - sent);
+	}
+}
+
+/*
+ * Description :
+ * Feed the received UART bytes to the frame parser without waiting.
+ * Return TRUE and fill the frame when a complete frame with a valid CRC is received.
+ * Frames with a bad CRC or length are dropped and the parser hunts for the next START byte.
+ */
+boolean PROTOCOL_receiveFrame(PROTOCOL_FrameType *frame)
+{
+	uint8 data;
+
+	PROTOCOL_takeLineErrors();
+
+	/* Read one byte at a time so the bytes of the next frame stay in the RX buffer */
+	while(PROTOCOL_nextByte(&data))
+	{
+		if(g_parserState != WAIT_START)
+		{
+			g_rawFrame[g_rawLength++] = data;
+		}
+
+		switch(g_parserState)
+		{
+		case WAIT_START:
+			if(data == PROTOCOL_START_BYTE)
+			{
+				g_rxCrc = 0;
+				g_rawFrame[0] = data;
+				g_rawLength = 1;
+				g_frameReplayed = g_byteReplayed;
+				g_parserState = WAIT_TYPE;
+			}
+			else if(g_byteReplayed == FALSE)
+			{
+				/* Junk between frames, usually the peer talks at another baud rate */
+				PROTOCOL_linkError();
+			}
+			break;
+
+		case WAIT_TYPE:
+			g_rxFrame.type = data;
+			g_rxCrc = PROTOCOL_crc8(g_rxCrc, data);
+			g_parserState = WAIT_SEQ;
+			break;
+
+		case WAIT_SEQ:
+			g_rxFrame.seq = data;
+			g_rxCrc = PROTOCOL_crc8(g_rxCrc, data);
+			g_parserState = WAIT_LENGTH;
+			break;
+
+		case WAIT_LENGTH:
+			if(data > PROTOCOL_MAX_PAYLOAD)
+			{
+				/* Corrupted length, drop the frame */
+				PROTOCOL_dropFrame();
+			}
+			else
+			{
+				g_rxFrame.length = data;
+				g_rxCrc = PROTOCOL_crc8(g_rxCrc, data);
+				g_rxIndex = 0;
+				g_parserState = (data == 0) ? WAIT_CRC : WAIT_PAYLOAD;
+			}
+			break;
+
+		case WAIT_PAYLOAD:
+			g_rxFrame.payload[g_rxIndex++] = data;
+			g_rxCrc = PROTOCOL_crc8(g_rxCrc, data);
+			if(g_rxIndex == g_rxFrame.length)
+			{
+				g_parserState = WAIT_CRC;
+			}
+			break;
+
+		case WAIT_CRC:
+			if(data == g_rxCrc)
+			{
+				g_parserState = WAIT_START;
+				g_linkErrors = 0;
+				g_lineErrorRun = 0;
+				PROTOCOL_copyFrame(frame, &g_rxFrame);
+				return TRUE;
+			}
+			PROTOCOL_dropFrame();
+			break;
+		}
+	}
+	return FALSE;
+}
+
+/*
+ * Description :
+ * Wait until a complete valid frame is received.
+ */
+void PROTOCOL_waitFrame(PROTOCOL_FrameType *frame)
+{
+	while(PROTOCOL_receiveFrame(frame) == FALSE){}
+}
+
+/*
+ * Description :
+ * Send a request in a free place of the send window without waiting for its reply.
+ * Return the sequence number given to the request, or PROTOCOL_NO_SEQ if the window is full.
+ */
+uint8 PROTOCOL_request(uint8 type, const uint8 *payload, uint8 length)
+{
+	uint8 slot;
+	uint8 i;
+
+	if(length > PROTOCOL_MAX_PAYLOAD)
+	{
+		length = PROTOCOL_MAX_PAYLOAD;
+	}
+
+	for(slot = 0 ; slot < PROTOCOL_WINDOW_SIZE ; slot++)
+	{
+		if(g_window[slot].state == SLOT_FREE)
+		{
+			/* Keep the request so it can be sent again after a reply timeout */
+			g_window[slot].state = SLOT_PENDING;
+			g_window[slot].request.type = type;
+			g_window[slot].request.seq = g_nextSeq;
+			g_window[slot].request.length = length;
+			for(i = 0 ; i < length ; i++)
+			{
+				g_window[slot].request.payload[i] = payload[i];
+			}
+
+			/* Sequence numbers run from 1 to 255, 0 is kept for frames without reply */
+			g_nextSeq++;
+			if(g_nextSeq == PROTOCOL_NO_SEQ)
+			{
+				g_nextSeq = 1;
+			}
+
+			PROTOCOL_sendFrame(type, g_window[slot].request.seq, payload, length);
+			return g_window[slot].request.seq;
+		}
+	}
+	return PROTOCOL_NO_SEQ;
+}
+
+/*
+ * Description :
+ * Receive the waiting frames without blocking and match the replies to the
+ * pending requests by sequence number.
+ * Frames with PROTOCOL_NO_SEQ are passed to the notify call back function.
+ * Replies that match no pending request are dropped.
+ */
+void PROTOCOL_poll(void)
+{
+	PROTOCOL_FrameType frame;
+	uint8 slot;
+
+	while(PROTOCOL_receiveFrame(&frame))
+	{
+		if(frame.seq == PROTOCOL_NO_SEQ)
+		{
+			if(g_notifyCallBackPtr != NULL_PTR)
+			{
+				(*g_notifyCallBackPtr)(&frame);
+			}
+			continue;
+		}
+		for(slot = 0 ; slot < PROTOCOL_WINDOW_SIZE ; slot++)
+		{
+			if((g_window[slot].state == SLOT_PENDING) && (g_window[slot].request.seq == frame.seq))
+			{
+				PROTOCOL_copyFrame(&g_window[slot].reply, &frame);
+				g_window[slot].state = SLOT_DONE;
+				break;
+			}
+		}
+	}
+}
+
+/*
+ * Description :
+ * Return TRUE and copy the reply if the reply of the request seq has arrived.
+ * The window place of the request is freed once its reply is taken.
+ */
+boolean PROTOCOL_getReply(uint8 seq, PROTOCOL_FrameType *frame)
+{
+	uint8 slot;
+
+	PROTOCOL_poll();
+	for(slot = 0 ; slot < PROTOCOL_WINDOW_SIZE ; slot++)
+	{
+		if((g_window[slot].state == SLOT_DONE) && (g_window[slot].request.seq == seq))
+		{
+			PROTOCOL_copyFrame(frame, &g_window[slot].reply);
+			g_window[slot].state = SLOT_FREE;
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+/*
+ * Description :
+ * Wait for the reply of the request seq, other replies keep their window places.
+ * The request is sent again after each reply timeout, the last time after PROTOCOL_resync.
+ * Return TRUE with the reply, or FALSE and free the window place if it never arrives.
+ */
+boolean PROTOCOL_waitReply(uint8 seq, PROTOCOL_FrameType *frame)
+{
+	PROTOCOL_WindowSlot *slot_ptr = NULL_PTR;
+	uint8 attempt;
+	uint32 start;
+	uint8 slot;
+
+	for(slot = 0 ; slot < PROTOCOL_WINDOW_SIZE ; slot++)
+	{
+		if((g_window[slot].state != SLOT_FREE) && (g_window[slot].request.seq == seq))
+		{
+			slot_ptr = &g_window[slot];
+		}
+	}
+	if(slot_ptr == NULL_PTR)
+	{
+		/* Unknown sequence number */
+		return FALSE;
+	}
+
+	for(attempt = 0 ; attempt <= PROTOCOL_MAX_RETRIES ; attempt++)
+	{
+		if(attempt != 0)
+		{
+			if(attempt == PROTOCOL_MAX_RETRIES)
+			{
+				/* Retries at the current rate failed, the peer may have reset */
+				PROTOCOL_resync();
+			}
+			g_stats.retries++;
+			PROTOCOL_sendFrame(slot_ptr->request.type, slot_ptr->request.seq,
+					slot_ptr->request.payload, slot_ptr->request.length);
+		}
+
+		/* Poll until the reply arrives or the attempt times out */
+		start = SCHEDULER_getMillis();
+		while(SCHEDULER_isTimeout(start, PROTOCOL_replyTimeout(&slot_ptr->request)) == FALSE)
+		{
+			if(PROTOCOL_getReply(seq, frame))
+			{
+				return TRUE;
+			}
+		}
+	}
+
+	slot_ptr->state = SLOT_FREE;
+	return FALSE;
+}
+
+/*
+ * Description :
+ * Send the pending request seq again without waiting, for a caller that times its own retries.
+ * Return FALSE if seq is not waiting for its reply.
+ */
+boolean PROTOCOL_resendRequest(uint8 seq)
+{
+	uint8 slot;
+
+	for(slot = 0 ; slot < PROTOCOL_WINDOW_SIZE ; slot++)
+	{
+		if((g_window[slot].state == SLOT_PENDING) && (g_window[slot].request.seq == seq))
+		{
+			g_stats.retries++;
+			PROTOCOL_sendFrame(g_window[slot].request.type, seq, g_window[slot].request.payload,
+					g_window[slot].request.length);
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+/*
+ * Description :
+ * Free the window place of the request seq, its reply is dropped if it arrives later.
+ */
+void PROTOCOL_dropRequest(uint8 seq)
+{
+	uint8 slot;
+
+	for(slot = 0 ; slot < PROTOCOL_WINDOW_SIZE ; slot++)
+	{
+		if((g_window[slot].state != SLOT_FREE) && (g_window[slot].request.seq == seq))
+		{
+			g_window[slot].state = SLOT_FREE;
+		}
+	}
+}
+
+/*
+ * Description :
+ * Bring both ECUs back in step after byte loss or a reset of one of them:
+ * 1. Go back to the base baud rate and restart the frame parser.
+ * 2. Send LINK_LINE_ERROR_LIMIT 0x00 bytes so a peer left at a higher rate falls back too:
+ *    at each faster rate of the table one such byte is received as one framing error.
+ */
+void PROTOCOL_resync(void)
+{
+	uint8 i;
+
+	g_stats.resyncs++;
+	UART_setBaudRate(LINK_BASE_BAUD_RATE);
+	PROTOCOL_resetParser();
+
+	/*
+	 * 0x00 is never a START byte, a peer already at the base rate just drops it.
+	 * Its start bit and data bits keep the line low longer than a whole byte of any faster rate,
+	 * so a faster receiver reads a low stop bit: one framing error for each byte sent.
+	 */
+	for(i = 0 ; i < LINK_LINE_ERROR_LIMIT ; i++)
+	{
+		UART_sendByte(0x00);
+	}
+}
+
+/*
+ * Description :
+ * Receive the next request without waiting (responder side).
+ * A request with the sequence number of one of the last PROTOCOL_WINDOW_SIZE handled ones
+ * is a retry after a lost reply, its cached reply is sent again and the request is not returned.
+ */
+boolean PROTOCOL_receiveRequest(PROTOCOL_FrameType *frame)
+{
+	PROTOCOL_FrameType *cached;
+	uint8 i;
+
+	while(PROTOCOL_receiveFrame(frame))
+	{
+		if(frame->seq == PROTOCOL_NO_SEQ)
+		{
+			if(frame->type == LINK_PING)
+			{
+				/* The master pings after its boot, its sequence numbers start again */
+				for(i = 0 ; i < PROTOCOL_WINDOW_SIZE ; i++)
+				{
+					g_replyCache[i].seq = PROTOCOL_NO_SEQ;
+				}
+			}
+			return TRUE;
+		}
+		cached = PROTOCOL_cachedReply(frame->seq);
+		if(cached != NULL_PTR)
+		{
+			g_stats.retries++;
+			PROTOCOL_sendFrame(cached->type, cached->seq, cached->payload, cached->length);
+			continue;
+		}
+		return TRUE;
+	}
+	return FALSE;
+}
+
+/*
+ * Description :
+ * Return the cached reply of the request seq, or NULL_PTR if it is not cached.
+ */
+static PROTOCOL_FrameType *PROTOCOL_cachedReply(uint8 seq)
+{
+	uint8 i;
+
+	for(i = 0 ; i < PROTOCOL_WINDOW_SIZE ; i++)
+	{
+		if(g_replyCache[i].seq == seq)
+		{
+			return &g_replyCache[i];
+		}
+	}
+	return NULL_PTR;
+}
+
+/*
+ * Description :
+ * Wait until a new request is received (responder side).
+ */
+void PROTOCOL_waitRequest(PROTOCOL_FrameType *frame)
+{
+	while(PROTOCOL_receiveRequest(frame) == FALSE){}
+}
+
+/*
+ * Description :
+ * Send the reply of a request with the request sequence number (responder side).
+ * The reply is cached by sequence number, one place for each place of the send window,
+ * so a retried request gets it again without being handled twice.
+ */
+void PROTOCOL_reply(const PROTOCOL_FrameType *request, uint8 type, const uint8 *payload, uint8 length)
+{
+	PROTOCOL_FrameType *cached;
+	uint8 i;
+
+	if(length > PROTOCOL_MAX_PAYLOAD)
+	{
+		length = PROTOCOL_MAX_PAYLOAD;
+	}
+
+	if(request->seq != PROTOCOL_NO_SEQ)
+	{
+		cached = PROTOCOL_cachedReply(request->seq);
+		if(cached == NULL_PTR)
+		{
+			cached = &g_replyCache[g_replyNext];
+			g_replyNext = (uint8)((g_replyNext + 1) % PROTOCOL_WINDOW_SIZE);
+		}
+		cached->type = type;
+		cached->seq = request->seq;
+		cached->length = length;
+		for(i = 0 ; i < length ; i++)
+		{
+			cached->payload[i] = payload[i];
+		}
+	}
+	PROTOCOL_sendFrame(type, request->seq, payload, length);
+}
+
+/*
+ * Description :
+ * Copy the link health counters of this ECU, the UART receive errors and the protocol errors.
+ */
+void PROTOCOL_getLinkStats(PROTOCOL_LinkStatsType *stats)
+{
+	UART_getStats(&stats->uart);
+	stats->protocol.crc_errors = g_stats.crc_errors;
+	stats->protocol.retries = g_stats.retries;
+	stats->protocol.resyncs = g_stats.resyncs;
+}
+
+/*
+ * Description :
+ * Answer a LINK_STATS request with the counters of the requested page (responder side).
+ */
+void PROTOCOL_replyLinkStats(const PROTOCOL_FrameType *request)
+{
+	PROTOCOL_LinkStatsType stats;
+	uint8 payload[4 * sizeof(uint16)];
+	uint8 length = 0;
+
+	PROTOCOL_getLinkStats(&stats);
+	if((request->length == 1) && (request->payload[0] == LINK_STATS_UART_PAGE))
+	{
+		PROTOCOL_putWord(&payload[0], stats.uart.framing_errors);
+		PROTOCOL_putWord(&payload[2], stats.uart.overrun_errors);
+		PROTOCOL_putWord(&payload[4], stats.uart.parity_errors);
+		PROTOCOL_putWord(&payload[6], stats.uart.rx_overflows);
+		length = 8;
+	}
+	else if((request->length == 1) && (request->payload[0] == LINK_STATS_PROTOCOL_PAGE))
+	{
+		PROTOCOL_putWord(&payload[0], stats.protocol.crc_errors);
+		PROTOCOL_putWord(&payload[2], stats.protocol.retries);
+		PROTOCOL_putWord(&payload[4], stats.protocol.resyncs);
+		length = 6;
+	}
+	/* An unknown page gets an empty reply */
+	PROTOCOL_reply(request, LINK_STATS, payload, length);
+}
+
+/*
+ * Description :
+ * Fill the counters of one page from a LINK_STATS reply, the other counters are not changed.
+ */
+void PROTOCOL_decodeLinkStats(uint8 page, const PROTOCOL_FrameType *reply, PROTOCOL_LinkStatsType *stats)
+{
+	if(reply->type != LINK_STATS)
+	{
+		return;
+	}
+	if((page == LINK_STATS_UART_PAGE) && (reply->length == 8))
+	{
+		stats->uart.framing_errors = PROTOCOL_getWord(&reply->payload[0]);
+		stats->uart.overrun_errors = PROTOCOL_getWord(&reply->payload[2]);
+		stats->uart.parity_errors = PROTOCOL_getWord(&reply->payload[4]);
+		stats->uart.rx_overflows = PROTOCOL_getWord(&reply->payload[6]);
+	}
+	else if((page == LINK_STATS_PROTOCOL_PAGE) && (reply->length == 6))
+	{
+		stats->protocol.crc_errors = PROTOCOL_getWord(&reply->payload[0]);
+		stats->protocol.retries = PROTOCOL_getWord(&reply->payload[2]);
+		stats->protocol.resyncs = PROTOCOL_getWord(&reply->payload[4]);
+	}
+}
+
+/*
+ * Description :
+ * Fill the parameters block with the default values.
+ */
+void PROTOCOL_defaultParams(PROTOCOL_ParamsType *params)
+{
+	params->open_time = PARAMS_DEFAULT_OPEN_TIME;
+	params->hold_time = PARAMS_DEFAULT_HOLD_TIME;
+	params->close_time = PARAMS_DEFAULT_CLOSE_TIME;
+	params->ramp_time = PARAMS_DEFAULT_RAMP_TIME;
+	params->speed = PARAMS_DEFAULT_SPEED;
+	params->lockout_time = PARAMS_DEFAULT_LOCKOUT_TIME;
+}
+
+/*
+ * Description :
+ * Write the parameters block in PARAMS_SIZE bytes, in the payload order.
+ */
+void PROTOCOL_encodeParams(const PROTOCOL_ParamsType *params, uint8 *payload)
+{
+	payload[0] = params->open_time;
+	payload[1] = params->hold_time;
+	payload[2] = params->close_time;
+	payload[3] = params->ramp_time;
+	payload[4] = params->speed;
+	payload[5] = params->lockout_time;
+}
+
+/*
+ * Description :
+ * Read a parameters block from a payload and check its limits.
+ * Return FALSE and keep the parameters if the payload is short or a value is out of its limits.
+ */
+boolean PROTOCOL_decodeParams(const uint8 *payload, uint8 length, PROTOCOL_ParamsType *params)
+{
+	uint16 min_move;
+
+	if(length < PARAMS_SIZE)
+	{
+		return FALSE;
+	}
+	if((payload[3] < PARAMS_MIN_RAMP_TIME) || (payload[4] < PARAMS_MIN_SPEED) || (payload[4] > PARAMS_MAX_SPEED) ||
+			(payload[1] > PARAMS_MAX_HOLD_TIME) ||
+			(payload[5] < PARAMS_MIN_LOCKOUT_TIME) || (payload[5] > PARAMS_MAX_LOCKOUT_TIME))
+	{
+		return FALSE;
+	}
+
+	/* Each move holds its two ramps */
+	min_move = 2 * (uint16)payload[3];
+	if(min_move < PARAMS_MIN_MOVE_TIME)
+	{
+		min_move = PARAMS_MIN_MOVE_TIME;
+	}
+	if((payload[0] < min_move) || (payload[2] < min_move))
+	{
+		return FALSE;
+	}
+
+	params->open_time = payload[0];
+	params->hold_time = payload[1];
+	params->close_time = payload[2];
+	params->ramp_time = payload[3];
+	params->speed = payload[4];
+	params->lockout_time = payload[5];
+	return TRUE;
+}
+
+/*
+ * Description :
+ * Set the call back function for the frames sent with PROTOCOL_NO_SEQ.
+ */
+void PROTOCOL_setNotifyCallBack(void(*a_ptr)(const PROTOCOL_FrameType *frame))
+{
+	g_notifyCallBackPtr = a_ptr;
+}
+
+/*
+ * Description :
+ * Send the EMERGENCY_STOP frame, ahead of any request that is not queued on the UART yet.
+ */
+void PROTOCOL_sendEmergencyStop(void)
+{
+	uint8 i;
+
+	for(i = 0 ; i < PROTOCOL_EMERGENCY_STOP_COPIES ; i++)
+	{
+		PROTOCOL_sendFrame(EMERGENCY_STOP, PROTOCOL_NO_SEQ, NULL_PTR, 0);
+	}
+}
+
+/*
+ * Description :
+ * Set the call back function called from the UART RX interrupt as soon as the last byte
+ * of an EMERGENCY_STOP frame is received, before the frame reaches the parser.
+ * The frame is still returned by the parser later, with PROTOCOL_NO_SEQ.
+ */
+void PROTOCOL_setEmergencyCallBack(void(*a_ptr)(void))
+{
+	uint8 crc = 0;
+	uint8 i;
+
+	g_emergencyFrame[0] = PROTOCOL_START_BYTE;
+	g_emergencyFrame[1] = EMERGENCY_STOP;
+	g_emergencyFrame[2] = PROTOCOL_NO_SEQ;
+	g_emergencyFrame[3] = 0;
+	for(i = 1 ; i < PROTOCOL_HEADER_SIZE ; i++)
+	{
+		crc = PROTOCOL_crc8(crc, g_emergencyFrame[i]);
+	}
+	g_emergencyFrame[PROTOCOL_HEADER_SIZE] = crc;
+
+	g_emergencyPosition = 0;
+	g_emergencyMatched = FALSE;
+	g_emergencyCallBackPtr = a_ptr;
+	UART_setRxCallBack(PROTOCOL_matchEmergency);
+}
+
+/*
+ * Description :
+ * Wait up to timeout_ms milliseconds for a complete valid frame.
+ * Return TRUE if a frame is received, FALSE on timeout.
+ */
+boolean PROTOCOL_waitFrameTimeout(PROTOCOL_FrameType *frame, uint16 timeout_ms)
+{
+	uint32 start = SCHEDULER_getMillis();
+
+	while(SCHEDULER_isTimeout(start, timeout_ms) == FALSE)
+	{
+		if(PROTOCOL_receiveFrame(frame))
+		{
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+/*
+ * Description :
+ * Master side (HMI) of the link speed negotiation, called after boot:
+ * 1. Ping the peer at the base rate until it answers.
+ * 2. Try the rates from the fastest one, each rate is accepted by the peer then
+ *    checked with LINK_PROBE_COUNT echoed probe frames.
+ * 3. Keep the first rate that passes, or stay at the base rate.
+ * Return the baud rate index used by the link.
+ */
+UART_BaudRate PROTOCOL_negotiateSpeed(void)
+{
+	PROTOCOL_FrameType frame;
+	uint8 retry;
+	uint8 rate;
+	boolean found = FALSE;
+
+	UART_setBaudRate(LINK_BASE_BAUD_RATE);
+
+	/* The peer may still be booting, ping it until it answers */
+	for(retry = 0 ; (retry < LINK_PING_RETRIES) && (found == FALSE) ; retry++)
+	{
+		PROTOCOL_sendFrame(LINK_PING, PROTOCOL_NO_SEQ, NULL_PTR, 0);
+		if(PROTOCOL_waitFrameTimeout(&frame, LINK_REPLY_TIMEOUT_MS) && (frame.type == LINK_PING))
+		{
+			found = TRUE;
+		}
+	}
+	if(found == FALSE)
+	{
+		return LINK_BASE_BAUD_RATE;
+	}
+
+	for(rate = UART_BAUD_COUNT - 1 ; rate > LINK_BASE_BAUD_RATE ; rate--)
+	{
+		PROTOCOL_sendFrame(LINK_SPEED_REQUEST, PROTOCOL_NO_SEQ, &rate, 1);
+		if((PROTOCOL_waitFrameTimeout(&frame, LINK_REPLY_TIMEOUT_MS) == FALSE) ||
+				(frame.type != LINK_SPEED_ACCEPT) || (frame.payload[0] != rate))
+		{
+			continue;
+		}
+
+		UART_setBaudRate(rate);
+		_delay_ms(LINK_SETTLE_TIME_MS);
+		if(PROTOCOL_probeSpeed())
+		{
+			return rate;
+		}
+
+		/* Probe failed, wait until the peer gives up on the probes and goes back too */
+		UART_setBaudRate(LINK_BASE_BAUD_RATE);
+		_delay_ms(LINK_PROBE_TIMEOUT_MS);
+		PROTOCOL_resetParser();
+	}
+	return LINK_BASE_BAUD_RATE;
+}
+
+/*
+ * Description :
+ * Slave side (CONTROL) of the link speed negotiation, called on a LINK_SPEED_REQUEST frame.
+ * Accept the rate, switch to it and echo the probe frames.
+ * Go back to the base rate if the probes do not arrive in time.
+ */
+void PROTOCOL_acceptSpeed(const PROTOCOL_FrameType *frame)
+{
+	PROTOCOL_FrameType probe;
+	uint8 rate = frame->payload[0];
+	uint8 count = 0;
+
+	if((frame->length != 1) || (rate >= UART_BAUD_COUNT))
+	{
+		/* Unknown rate, do not answer so the master tries the next one */
+		return;
+	}
+
+	PROTOCOL_sendFrame(LINK_SPEED_ACCEPT, frame->seq, &rate, 1);
+	UART_setBaudRate(rate);
+	PROTOCOL_resetParser();
+
+	while(count < LINK_PROBE_COUNT)
+	{
+		if(PROTOCOL_waitFrameTimeout(&probe, LINK_PROBE_TIMEOUT_MS) == FALSE)
+		{
+			/* The master gave up on this rate */
+			UART_setBaudRate(LINK_BASE_BAUD_RATE);
+			PROTOCOL_resetParser();
+			return;
+		}
+		if(probe.type == LINK_PROBE)
+		{
+			PROTOCOL_sendFrame(LINK_PROBE, probe.seq, probe.payload, probe.length);
+			count++;
+		}
+	}
+}
+
+/*
+ * Description :
+ * Take the next byte to parse, first from the replay buffer then from the UART.
+ */
+static boolean PROTOCOL_nextByte(uint8 *data)
+{
+	g_byteReplayed = (g_replayIndex < g_replayLength);
+	if(g_byteReplayed)
+	{
+		*data = g_replayBuffer[g_replayIndex++];
+		return TRUE;
+	}
+	return (UART_read(data,1) != 0);
+}
+
+/*
+ * Description :
+ * Drop the frame being parsed and queue its bytes after the START byte to be parsed again.
+ * The replay buffer cannot overflow: while it is not empty all the raw bytes came from it.
+ * One link error is counted for the frame, none for a frame that started in the replayed bytes.
+ */
+static void PROTOCOL_dropFrame(void)
+{
+	uint8 buffer[PROTOCOL_MAX_FRAME_SIZE];
+	uint8 length = 0;
+	uint8 i;
+
+	for(i = 1 ; i < g_rawLength ; i++)
+	{
+		buffer[length++] = g_rawFrame[i];
+	}
+	for(i = g_replayIndex ; i < g_replayLength ; i++)
+	{
+		buffer[length++] = g_replayBuffer[i];
+	}
+	for(i = 0 ; i < length ; i++)
+	{
+		g_replayBuffer[i] = buffer[i];
+	}
+	g_replayIndex = 0;
+	g_replayLength = length;
+
+	g_rawLength = 0;
+	g_parserState = WAIT_START;
+	if(g_frameReplayed == FALSE)
+	{
+		g_stats.crc_errors++;
+		PROTOCOL_linkError();
+	}
+}
+
+/*
+ * Description :
+ * Restart the frame parser and forget the bytes parsed so far.
+ */
+static void PROTOCOL_resetParser(void)
+{
+	g_parserState = WAIT_START;
+	g_rawLength = 0;
+	g_replayIndex = 0;
+	g_replayLength = 0;
+	g_linkErrors = 0;
+	g_lineErrorsTaken = g_lineErrors;
+	g_lineErrorRun = 0;
+}
+
+/*
+ * Description :
+ * Count one link error, fall back to the base baud rate after LINK_ERROR_LIMIT errors in a row.
+ */
+static void PROTOCOL_linkError(void)
+{
+	g_linkErrors++;
+	if(g_linkErrors >= LINK_ERROR_LIMIT)
+	{
+		g_linkErrors = 0;
+		PROTOCOL_fallBack();
+	}
+}
+
+/*
+ * Description :
+ * Take the bytes with a framing or parity error counted by the RX ISR since the last call,
+ * fall back to the base baud rate after LINK_LINE_ERROR_LIMIT of them without a good frame.
+ * The fall back is done here and not in the ISR, changing the rate waits for the TX buffer.
+ */
+static void PROTOCOL_takeLineErrors(void)
+{
+	uint8 count = g_lineErrors;
+	uint8 errors = count - g_lineErrorsTaken;
+
+	g_lineErrorsTaken = count;
+	if(errors >= (LINK_LINE_ERROR_LIMIT - g_lineErrorRun))
+	{
+		g_lineErrorRun = 0;
+		PROTOCOL_fallBack();
+	}
+	else
+	{
+		g_lineErrorRun += errors;
+	}
+}
+
+/*
+ * Description :
+ * Go back to the base baud rate and restart the frame parser, the peer has changed its rate.
+ */
+static void PROTOCOL_fallBack(void)
+{
+	if(UART_getBaudRate() != LINK_BASE_BAUD_RATE)
+	{
+		g_stats.resyncs++;
+		UART_setBaudRate(LINK_BASE_BAUD_RATE);
+		PROTOCOL_resetParser();
+	}
+}
+
+/*
+ * Description :
+ * Reply timeout of one attempt in milliseconds: line time of the request and of
+ * the longest reply at the current baud rate + the peer processing time.
+ */
+static uint16 PROTOCOL_replyTimeout(const PROTOCOL_FrameType *request)
+{
+	uint16 bytes = PROTOCOL_HEADER_SIZE + request->length + PROTOCOL_CRC_SIZE + PROTOCOL_MAX_FRAME_SIZE;
+
+	return (uint16)(((uint32)bytes * UART_getByteTimeUs() + 999) / 1000) + PROTOCOL_PROCESSING_TIME_MS;
+}
+
+/*
+ * Description :
+ * Send LINK_PROBE_COUNT probe frames and check that each one is echoed back unchanged.
+ */
+static boolean PROTOCOL_probeSpeed(void)
+{
+	PROTOCOL_FrameType frame;
+	uint8 payload[sizeof(g_probePattern) + 1];
+	uint8 probe;
+	uint8 i;
+
+	for(i = 0 ; i < sizeof(g_probePattern) ; i++)
+	{
+		payload[i] = g_probePattern[i];
+	}
+
+	for(probe = 0 ; probe < LINK_PROBE_COUNT ; probe++)
+	{
+		/* The last byte numbers the probe so a late echo is not taken for the current one */
+		payload[sizeof(g_probePattern)] = probe;
+		PROTOCOL_sendFrame(LINK_PROBE, PROTOCOL_NO_SEQ, payload, sizeof(payload));
+		if((PROTOCOL_waitFrameTimeout(&frame, LINK_REPLY_TIMEOUT_MS) == FALSE) ||
+				(frame.type != LINK_PROBE) || (frame.length != sizeof(payload)))
+		{
+			return FALSE;
+		}
+		for(i = 0 ; i < sizeof(payload) ; i++)
+		{
+			if(frame.payload[i] != payload[i])
+			{
+				return FALSE;
+			}
+		}
+	}
+	return TRUE;
+}
+
+/*
+ * Description :
+ * Copy the header and the used payload bytes of a frame.
+ */
+static void PROTOCOL_copyFrame(PROTOCOL_FrameType *destination, const PROTOCOL_FrameType *source)
+{
+	uint8 i;
+
+	destination->type = source->type;
+	destination->seq = source->seq;
+	destination->length = source->length;
+	for(i = 0 ; i < source->length ; i++)
+	{
+		destination->payload[i] = source->payload[i];
+	}
+}
+
+/*
+ * Description :
+ * Write a 16-bit value in the payload, low byte first.
+ */
+static void PROTOCOL_putWord(uint8 *payload, uint16 value)
+{
+	payload[0] = (uint8)value;
+	payload[1] = (uint8)(value >> 8);
+}
+
+/*
+ * Description :
+ * Read a 16-bit value from the payload, low byte first.
+ */
+static uint16 PROTOCOL_getWord(const uint8 *payload)
+{
+	return (uint16)payload[0] | ((uint16)payload[1] << 8);
+}
+
+/*
+ * Description :
+ * UART error call back, runs in the RX ISR: count one byte with a framing or parity error.
+ */
+static void PROTOCOL_lineError(void)
+{
+	g_lineErrors++;
+}
+
+/*
+ * Description :
+ * UART RX call back, runs in the RX ISR: match the received frames with the EMERGENCY_STOP frame.
+ * A frame starts on a START byte between frames and ends after the payload of its length byte
+ * and its CRC, so a START byte in a payload does not start a match.
+ * A corrupted length ends the frame at once and the next START byte starts one, like the parser.
+ */
+static void PROTOCOL_matchEmergency(uint8 data)
+{
+	if(g_emergencyPosition == 0)
+	{
+		if(data == PROTOCOL_START_BYTE)
+		{
+			g_emergencyPosition = 1;
+			g_emergencyMatched = TRUE;
+		}
+		return;
+	}
+
+	if(g_emergencyPosition < PROTOCOL_HEADER_SIZE)
+	{
+		g_emergencyMatched = g_emergencyMatched && (data == g_emergencyFrame[g_emergencyPosition]);
+		g_emergencyPosition++;
+		if(g_emergencyPosition == PROTOCOL_HEADER_SIZE)
+		{
+			/* Length byte: the payload and the CRC are left */
+			if(data > PROTOCOL_MAX_PAYLOAD)
+			{
+				g_emergencyPosition = 0;
+			}
+			g_emergencyLeft = data + PROTOCOL_CRC_SIZE;
+		}
+		return;
+	}
+
+	g_emergencyLeft--;
+	if(g_emergencyLeft != 0)
+	{
+		return;
+	}
+	/* CRC byte, the last one of the frame */
+	g_emergencyPosition = 0;
+	if(g_emergencyMatched && (data == g_emergencyFrame[PROTOCOL_HEADER_SIZE]) && (g_emergencyCallBackPtr != NULL_PTR))
+	{
+		(*g_emergencyCallBackPtr)();
+	}
+}
@@ -0,0 +1,420 @@
+ /******************************************************************************
+ *
+ * Module: PROTOCOL
+ *
+ * File Name: protocol.h
+ *
+ * Description: Header file for the framed HMI <-> CONTROL message protocol
+ *
+ * Author: Shehab Kishta
+ *
+ *******************************************************************************/
+
+#ifndef PROTOCOL_H_
+#define PROTOCOL_H_
+
+#include "std_types.h"
+#include "uart.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+
+/*
+ * Frame format on the wire:
+ * | START | TYPE | SEQ | LENGTH | PAYLOAD (LENGTH bytes) | CRC-8 |
+ * The CRC-8 (polynomial 0x07, initial value 0x00) covers TYPE, SEQ, LENGTH and PAYLOAD.
+ * A reply carries the SEQ of its request, SEQ 0 is used by frames that expect no reply.
+ */
+#define PROTOCOL_START_BYTE                         0x7E
+#define PROTOCOL_CRC8_POLYNOMIAL                    0x07
+#define PROTOCOL_HEADER_SIZE                        4
+#define PROTOCOL_CRC_SIZE                           1
+#define PROTOCOL_NO_SEQ                             0
+
+/* Number of requests that can wait for their replies at the same time */
+#define PROTOCOL_WINDOW_SIZE                        4
+
+/*
+ * Reply timeout of one attempt = line time of the request and of a reply with the
+ * largest payload at the current baud rate + PROTOCOL_PROCESSING_TIME_MS for the peer.
+ * A request is sent again PROTOCOL_MAX_RETRIES times, the last time after a link resync,
+ * so the worst case recovery is (PROTOCOL_MAX_RETRIES + 1) timeouts + the resync preamble:
+ * about 98ms at 9600 and about 58ms from 38400 (two short timeouts, then the base rate).
+ * All the timeouts are measured with SCHEDULER_getMillis, so SCHEDULER_init must run
+ * and the interrupts must be enabled before the link is used.
+ */
+#define PROTOCOL_PROCESSING_TIME_MS                 3
+#define PROTOCOL_MAX_RETRIES                        2
+
+/* Pseudo message type returned when a request gets no reply even after the resync */
+#define LINK_LOST                                   0x00
+
+/*
+ * Password length shared by both ECUs: PASSWORD_SIZE places, at least PASSWORD_MIN_LENGTH of them typed.
+ * PASSWORD_SIZE is also the EEPROM space of the saved password, 15 at most before the parameters block.
+ * The places after the last digit are sent and saved as PASSWORD_NO_DIGIT, so all the places are compared.
+ */
+#define PASSWORD_SIZE                               5
+#define PASSWORD_MIN_LENGTH                         4
+#define PASSWORD_NO_DIGIT                           0xFF
+
+/* Largest payload is a new password and its confirmation in one frame */
+#define PROTOCOL_MAX_PAYLOAD                        (2 * PASSWORD_SIZE)
+
+/* Message types shared by both ECUs */
+#define DONE                                        0xFE
+#define PASSWORD_MATCH                              0xFC
+#define PASSWORD_NOT_MATCHED                        0xFB
+#define PASSWORD_CONFIRMATION_SEND                  0xFA
+#define UNLOCK_DOOR                                 0xF8
+#define CHECK_PASSWORD                              0xF7
+#define WRONG_PASSWORD                              0xF6
+#define CHECK_IF_SAVED                              0xF5
+#define YES_SAVED                                   0xF4
+#define NO_SAVED_PASSWORD                           0xF3
+#define DOOR_OPENING                                0xF2
+#define LINK_PING                                   0xF1
+#define LINK_SPEED_REQUEST                          0xF0
+#define LINK_SPEED_ACCEPT                           0xEF
+#define LINK_PROBE                                  0xEE
+#define LINK_STATS                                  0xED
+#define DOOR_STATUS                                 0xEC
+#define EMERGENCY_STOP                              0xEB
+#define DOOR_PROGRESS                               0xEA
+#define PARAMS_GET                                  0xE9
+#define PARAMS_SET                                  0xE8
+#define PARAMS_REJECTED                             0xE7
+
+/*
+ * LINK_STATS request payload: one page number. The reply carries the counters of
+ * the page as 16-bit values, low byte first, in the order of their structure.
+ */
+#define LINK_STATS_UART_PAGE                        0
+#define LINK_STATS_PROTOCOL_PAGE                    1
+
+/*
+ * DOOR_STATUS reply payload: the step of the door cycle running on the CONTROL ECU.
+ * DOOR_STATE_OBSTACLE is the opening again after the obstacle beam stopped the closing,
+ * DOOR_STATE_STOPPED is a cycle ended by EMERGENCY_STOP with the door where it stopped,
+ * DOOR_STATE_STALLED is the opening again after the door jammed while closing.
+ */
+#define DOOR_STATE_OPENING                          0
+#define DOOR_STATE_HOLD                             1
+#define DOOR_STATE_CLOSING                          2
+#define DOOR_STATE_CLOSED                           3
+#define DOOR_STATE_FAULT                            4
+#define DOOR_STATE_OBSTACLE                         5
+#define DOOR_STATE_STOPPED                          6
+#define DOOR_STATE_STALLED                          7
+/* Never sent: shown by the HMI when DOOR_STATUS gets no reply during the door cycle */
+#define DOOR_STATE_LINK_LOST                        8
+
+/*
+ * DOOR_PROGRESS is pushed by the CONTROL ECU with PROTOCOL_NO_SEQ during the door cycle,
+ * every DOOR_PROGRESS_PERIOD_MS and at once on each state change, until the cycle ends.
+ * Payload: | door state | door opening 0 --> 100% |
+ * The HMI asks DOOR_STATUS when the stream is silent for DOOR_PROGRESS_TIMEOUT_MS.
+ */
+#define DOOR_PROGRESS_PERIOD_MS                     200
+#define DOOR_PROGRESS_TIMEOUT_MS                    (3 * DOOR_PROGRESS_PERIOD_MS)
+#define DOOR_PROGRESS_SIZE                          2
+
+/*
+ * Door parameters block, kept in the CONTROL ECU EEPROM and used from the next door cycle.
+ * PARAMS_GET has no payload, PARAMS_SET carries a new block. Both are answered with
+ * PARAMS_GET and the block in use, or PARAMS_REJECTED when a value is out of its limits.
+ * Payload: | open time | hold time | close time | ramp time | speed | lockout time |
+ * The door times are in PARAMS_TIME_UNIT_MS units, the lockout time in seconds.
+ */
+#define PARAMS_SIZE                                 6
+#define PARAMS_TIME_UNIT_MS                         100
+
+#define PARAMS_DEFAULT_OPEN_TIME                    150
+#define PARAMS_DEFAULT_HOLD_TIME                    10
+#define PARAMS_DEFAULT_CLOSE_TIME                   140
+#define PARAMS_DEFAULT_RAMP_TIME                    10
+#define PARAMS_DEFAULT_SPEED                        100
+#define PARAMS_DEFAULT_LOCKOUT_TIME                 60
+
+/* A move is at least its two ramps, the slowest speed still reaches the limit switches */
+#define PARAMS_MIN_MOVE_TIME                        20
+#define PARAMS_MAX_HOLD_TIME                        250
+#define PARAMS_MIN_RAMP_TIME                        1
+#define PARAMS_MIN_SPEED                            25
+#define PARAMS_MAX_SPEED                            100
+/* The lockout screen runs on a 16-bit millisecond timer */
+#define PARAMS_MIN_LOCKOUT_TIME                     10
+#define PARAMS_MAX_LOCKOUT_TIME                     65
+
+/*
+ * EMERGENCY_STOP is sent with PROTOCOL_NO_SEQ and no payload, so its frame is a fixed
+ * byte string the receiving UART interrupt matches without the frame parser.
+ * It is sent PROTOCOL_EMERGENCY_STOP_COPIES times so one corrupted copy does not lose it.
+ */
+#define PROTOCOL_EMERGENCY_STOP_COPIES              2
+
+/* Link speed negotiation configurations */
+#define LINK_BASE_BAUD_RATE                         UART_BAUD_9600
+#define LINK_PING_RETRIES                           10
+#define LINK_REPLY_TIMEOUT_MS                       50
+#define LINK_PROBE_COUNT                            8
+#define LINK_PROBE_TIMEOUT_MS                       200
+#define LINK_SETTLE_TIME_MS                         2
+
+/*
+ * Number of consecutive link errors (bad CRC, bad length or junk bytes between
+ * frames) after which the link falls back to LINK_BASE_BAUD_RATE.
+ * Both ECUs see errors when only one of them falls back, so they meet again at the base rate.
+ * A frame that lost its START byte leaves up to 14 junk bytes at the right rate,
+ * so the limit is above that: one lost byte never costs a fall back.
+ */
+#define LINK_ERROR_LIMIT                            16
+
+/*
+ * Number of bytes received with a framing or parity error, without a good frame between
+ * them, after which the link falls back to LINK_BASE_BAUD_RATE. A peer at the same rate
+ * sends none of them, a peer at another rate sends little else.
+ */
+#define LINK_LINE_ERROR_LIMIT                       8
+
+/*******************************************************************************
+ *                               Types Declaration                             *
+ *******************************************************************************/
+typedef struct
+{
+	uint8 type;
+	uint8 seq;
+	uint8 length;
+	uint8 payload[PROTOCOL_MAX_PAYLOAD];
+}PROTOCOL_FrameType;
+
+/*
+ * Link error counters kept by the protocol since boot:
+ * crc_errors : frames dropped by the CRC or length check.
+ * retries    : requests sent again on the requesting side, retried requests received on the responder side.
+ * resyncs    : PROTOCOL_resync calls and fall backs to the base rate after LINK_ERROR_LIMIT errors
+ *              or LINK_LINE_ERROR_LIMIT framing errors.
+ */
+typedef struct
+{
+	uint16 crc_errors;
+	uint16 retries;
+	uint16 resyncs;
+}PROTOCOL_StatsType;
+
+typedef struct
+{
+	UART_StatsType uart;
+	PROTOCOL_StatsType protocol;
+}PROTOCOL_LinkStatsType;
+
+typedef struct
+{
+	uint8 open_time;
+	uint8 hold_time;
+	uint8 close_time;
+	uint8 ramp_time;
+	uint8 speed;
+	uint8 lockout_time;
+}PROTOCOL_ParamsType;
+
+/*******************************************************************************
+ *                      Functions Prototypes                                   *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Initialize the protocol, to be called after UART_init:
+ * the bytes received with a framing or parity error are counted as link errors.
+ */
+void PROTOCOL_init(void);
+
+/*
+ * Description :
+ * Build one frame from the message type, sequence number and payload and queue it on the UART.
+ * Payloads longer than PROTOCOL_MAX_PAYLOAD are cut to PROTOCOL_MAX_PAYLOAD.
+ */
+void PROTOCOL_sendFrame(uint8 type, uint8 seq, const uint8 *payload, uint8 length);
+
+/*
+ * Description :
+ * Send a request in a free place of the send window without waiting for its reply.
+ * Return the sequence number given to the request, or PROTOCOL_NO_SEQ if the window is full.
+ */
+uint8 PROTOCOL_request(uint8 type, const uint8 *payload, uint8 length);
+
+/*
+ * Description :
+ * Receive the waiting frames without blocking and match the replies to the
+ * pending requests by sequence number.
+ * Frames with PROTOCOL_NO_SEQ are passed to the notify call back function.
+ * Replies that match no pending request are dropped.
+ */
+void PROTOCOL_poll(void);
+
+/*
+ * Description :
+ * Return TRUE and copy the reply if the reply of the request seq has arrived.
+ * The window place of the request is freed once its reply is taken.
+ */
+boolean PROTOCOL_getReply(uint8 seq, PROTOCOL_FrameType *frame);
+
+/*
+ * Description :
+ * Wait for the reply of the request seq, other replies keep their window places.
+ * The request is sent again after each reply timeout, the last time after PROTOCOL_resync.
+ * Return TRUE with the reply, or FALSE and free the window place if it never arrives.
+ */
+boolean PROTOCOL_waitReply(uint8 seq, PROTOCOL_FrameType *frame);
+
+/*
+ * Description :
+ * Send the pending request seq again without waiting, for a caller that times its own retries.
+ * Return FALSE if seq is not waiting for its reply.
+ */
+boolean PROTOCOL_resendRequest(uint8 seq);
+
+/*
+ * Description :
+ * Free the window place of the request seq, its reply is dropped if it arrives later.
+ */
+void PROTOCOL_dropRequest(uint8 seq);
+
+/*
+ * Description :
+ * Bring both ECUs back in step after byte loss or a reset of one of them:
+ * 1. Go back to the base baud rate and restart the frame parser.
+ * 2. Send LINK_LINE_ERROR_LIMIT 0x00 bytes so a peer left at a higher rate falls back too:
+ *    at each faster rate of the table one such byte is received as one framing error.
+ */
+void PROTOCOL_resync(void);
+
+/*
+ * Description :
+ * Receive the next request without waiting (responder side).
+ * A request with the sequence number of one of the last PROTOCOL_WINDOW_SIZE handled ones
+ * is a retry after a lost reply, its cached reply is sent again and the request is not returned.
+ */
+boolean PROTOCOL_receiveRequest(PROTOCOL_FrameType *frame);
+
+/*
+ * Description :
+ * Wait until a new request is received (responder side).
+ */
+void PROTOCOL_waitRequest(PROTOCOL_FrameType *frame);
+
+/*
+ * Description :
+ * Send the reply of a request with the request sequence number (responder side).
+ * The reply is cached by sequence number, one place for each place of the send window,
+ * so a retried request gets it again without being handled twice.
+ */
+void PROTOCOL_reply(const PROTOCOL_FrameType *request, uint8 type, const uint8 *payload, uint8 length);
+
+/*
+ * Description :
+ * Copy the link health counters of this ECU, the UART receive errors and the protocol errors.
+ */
+void PROTOCOL_getLinkStats(PROTOCOL_LinkStatsType *stats);
+
+/*
+ * Description :
+ * Answer a LINK_STATS request with the counters of the requested page (responder side).
+ */
+void PROTOCOL_replyLinkStats(const PROTOCOL_FrameType *request);
+
+/*
+ * Description :
+ * Fill the counters of one page from a LINK_STATS reply, the other counters are not changed.
+ */
+void PROTOCOL_decodeLinkStats(uint8 page, const PROTOCOL_FrameType *reply, PROTOCOL_LinkStatsType *stats);
+
+/*
+ * Description :
+ * Fill the parameters block with the default values.
+ */
+void PROTOCOL_defaultParams(PROTOCOL_ParamsType *params);
+
+/*
+ * Description :
+ * Write the parameters block in PARAMS_SIZE bytes, in the payload order.
+ */
+void PROTOCOL_encodeParams(const PROTOCOL_ParamsType *params, uint8 *payload);
+
+/*
+ * Description :
+ * Read a parameters block from a payload and check its limits.
+ * Return FALSE and keep the parameters if the payload is short or a value is out of its limits.
+ */
+boolean PROTOCOL_decodeParams(const uint8 *payload, uint8 length, PROTOCOL_ParamsType *params);
+
+/*
+ * Description :
+ * Set the call back function for the frames sent with PROTOCOL_NO_SEQ.
+ */
+void PROTOCOL_setNotifyCallBack(void(*a_ptr)(const PROTOCOL_FrameType *frame));
+
+/*
+ * Description :
+ * Send the EMERGENCY_STOP frame, ahead of any request that is not queued on the UART yet.
+ */
+void PROTOCOL_sendEmergencyStop(void);
+
+/*
+ * Description :
+ * Set the call back function called from the UART RX interrupt as soon as the last byte
+ * of an EMERGENCY_STOP frame is received, before the frame reaches the parser.
+ * The RX interrupt follows the frame lengths, so the same bytes inside the payload of
+ * another frame are not taken for it. The frame is still returned by the parser later,
+ * with PROTOCOL_NO_SEQ.
+ */
+void PROTOCOL_setEmergencyCallBack(void(*a_ptr)(void));
+
+/*
+ * Description :
+ * Feed the received UART bytes to the frame parser without waiting.
+ * Return TRUE and fill the frame when a complete frame with a valid CRC is received.
+ * Frames with a bad CRC or length are dropped and the parser hunts for the next START byte.
+ */
+boolean PROTOCOL_receiveFrame(PROTOCOL_FrameType *frame);
+
+/*
+ * Description :
+ * Wait until a complete valid frame is received.
+ */
+void PROTOCOL_waitFrame(PROTOCOL_FrameType *frame);
+
+/*
+ * Description :
+ * Wait up to timeout_ms milliseconds for a complete valid frame.
+ * Return TRUE if a frame is received, FALSE on timeout.
+ */
+boolean PROTOCOL_waitFrameTimeout(PROTOCOL_FrameType *frame, uint16 timeout_ms);
+
+/*
+ * Description :
+ * Master side (HMI) of the link speed negotiation, called after boot:
+ * 1. Ping the peer at the base rate until it answers.
+ * 2. Try the rates from the fastest one, each rate is accepted by the peer then
+ *    checked with LINK_PROBE_COUNT echoed probe frames.
+ * 3. Keep the first rate that passes, or stay at the base rate.
+ * Return the baud rate index used by the link.
+ */
+UART_BaudRate PROTOCOL_negotiateSpeed(void);
+
+/*
+ * Description :
+ * Slave side (CONTROL) of the link speed negotiation, called on a LINK_SPEED_REQUEST frame.
+ * Accept the rate, switch to it and echo the probe frames.
+ * Go back to the base rate if the probes do not arrive in time.
+ */
+void PROTOCOL_acceptSpeed(const PROTOCOL_FrameType *frame);
+
+/*
+ * Description :
+ * Update the CRC-8 value with one more byte.
+ */
+uint8 PROTOCOL_crc8(uint8 crc, uint8 data);
+
+#endif /* PROTOCOL_H_ */
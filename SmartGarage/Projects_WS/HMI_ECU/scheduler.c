@@ -0,0 +1,366 @@
+/******************************************************************************
+ *
+ * Module: SCHEDULER
+ *
+ * File Name: scheduler.c
+ *
+ * Description: Source file for the Timer1 system tick and the software timer wheel
+ *
+ * Author: Shehab Kishta
+ *
+ *******************************************************************************/
+
+#include "scheduler.h"
+#include "timer.h"
+
+#define SCHEDULER_WHEEL_MASK		(SCHEDULER_WHEEL_SIZE - 1)
+#define SCHEDULER_END_OF_LIST		0xFF
+
+#define SCHEDULER_QUEUE_MASK		(SCHEDULER_QUEUE_SIZE - 1)
+
+#if ((SCHEDULER_WHEEL_SIZE & SCHEDULER_WHEEL_MASK) != 0)
+#error "SCHEDULER_WHEEL_SIZE must be a power of 2"
+#endif
+#if ((SCHEDULER_QUEUE_SIZE & SCHEDULER_QUEUE_MASK) != 0)
+#error "SCHEDULER_QUEUE_SIZE must be a power of 2"
+#endif
+
+/*******************************************************************************
+ *                               Types Declaration                             *
+ *******************************************************************************/
+typedef struct
+{
+	void (*callBackPtr)(void);
+	uint16 period;             /* Ticks between two calls */
+	uint16 rounds;             /* Wheel turns left before the timer expires */
+	SCHEDULER_TimerMode mode;
+	boolean running;
+	boolean due;               /* Expired in the slot being processed */
+	uint8 slot;
+	uint8 next;                /* Next timer in the same slot */
+}SCHEDULER_TimerType;
+
+typedef struct
+{
+	void (*handlerPtr)(uint8 data);
+	uint8 data;
+}SCHEDULER_EventType;
+
+/*******************************************************************************
+ *                           Global Variables                                  *
+ *******************************************************************************/
+static const Timer1_ConfigType g_tickConfiguration = {0, SCHEDULER_TICK_COMPARE_VALUE, F_CPU_64, Compare};
+
+static SCHEDULER_TimerType g_timers[SCHEDULER_MAX_TIMERS];
+static uint8 g_wheel[SCHEDULER_WHEEL_SIZE];
+static uint8 g_wheelPosition = 0;
+
+/*
+ * Monotonic time counted by the ISR and time handled by the dispatcher, each one is
+ * written by one side only so the dispatcher can catch up after a long call back.
+ */
+static volatile uint32 g_millis = 0;
+static uint32 g_handledMillis = 0;
+
+/*
+ * Events posted by the ISRs: the head index is written by the ISRs only and the
+ * tail index by the dispatcher only, so one byte indices need no locking.
+ */
+static SCHEDULER_EventType g_queue[SCHEDULER_QUEUE_SIZE];
+static volatile uint8 g_queueHead = 0;
+static volatile uint8 g_queueTail = 0;
+
+static volatile SCHEDULER_IsrTimeType g_isrTime;
+
+/*******************************************************************************
+ *                      Functions Prototypes(Private)                          *
+ *******************************************************************************/
+static void SCHEDULER_tick(void);
+static void SCHEDULER_insert(SCHEDULER_TimerId id, uint16 ticks);
+static void SCHEDULER_unlink(SCHEDULER_TimerId id);
+static void SCHEDULER_advance(void);
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Start the system tick on Timer1 and clear all the virtual timers.
+ * Timer1 belongs to the scheduler after this call.
+ */
+void SCHEDULER_init(void)
+{
+	uint8 i;
+
+	for(i = 0 ; i < SCHEDULER_MAX_TIMERS ; i++)
+	{
+		g_timers[i].running = FALSE;
+	}
+	for(i = 0 ; i < SCHEDULER_WHEEL_SIZE ; i++)
+	{
+		g_wheel[i] = SCHEDULER_END_OF_LIST;
+	}
+	g_wheelPosition = 0;
+	g_millis = 0;
+	g_handledMillis = 0;
+	g_queueHead = 0;
+	g_queueTail = 0;
+	g_isrTime.last = 0;
+	g_isrTime.max = 0;
+
+	Timer1_setCallBack(SCHEDULER_tick);
+	Timer1_init(&g_tickConfiguration);
+}
+
+/*
+ * Description :
+ * Start a virtual timer that calls a_ptr from SCHEDULER_dispatch after time_ms,
+ * once or every time_ms according to the mode.
+ * Return the timer id, or SCHEDULER_NO_TIMER if all the timers are used.
+ * The id of a one-shot timer is free again once its call back is called.
+ */
+SCHEDULER_TimerId SCHEDULER_startTimer(uint16 time_ms, SCHEDULER_TimerMode mode, void(*a_ptr)(void))
+{
+	SCHEDULER_TimerId id;
+	uint16 ticks = SCHEDULER_MS_TO_TICKS((uint32)time_ms);
+
+	if(ticks == 0)
+	{
+		/* Shortest timer is one tick */
+		ticks = 1;
+	}
+
+	for(id = 0 ; id < SCHEDULER_MAX_TIMERS ; id++)
+	{
+		if(g_timers[id].running == FALSE)
+		{
+			g_timers[id].callBackPtr = a_ptr;
+			g_timers[id].period = ticks;
+			g_timers[id].mode = mode;
+			g_timers[id].running = TRUE;
+			SCHEDULER_insert(id, ticks);
+			return id;
+		}
+	}
+	return SCHEDULER_NO_TIMER;
+}
+
+/*
+ * Description :
+ * Stop a running virtual timer, its call back is not called any more.
+ */
+void SCHEDULER_stopTimer(SCHEDULER_TimerId id)
+{
+	if((id < SCHEDULER_MAX_TIMERS) && (g_timers[id].running))
+	{
+		SCHEDULER_unlink(id);
+		g_timers[id].running = FALSE;
+	}
+}
+
+/*
+ * Description :
+ * Main loop event dispatcher: call the events posted by the ISRs, then advance the wheel
+ * by the ticks elapsed since the last call and call the call backs of the timers that expired.
+ * A timer expires on its tick even if the dispatcher runs late, so periodic timers do not drift.
+ */
+void SCHEDULER_dispatch(void)
+{
+	SCHEDULER_EventType event;
+	uint32 now;
+
+	while(g_queueTail != g_queueHead)
+	{
+		event = g_queue[g_queueTail];
+		g_queueTail = (g_queueTail + 1) & SCHEDULER_QUEUE_MASK;
+		(*event.handlerPtr)(event.data);
+	}
+
+	now = SCHEDULER_getMillis();
+	while(g_handledMillis != now)
+	{
+		g_handledMillis += SCHEDULER_TICK_MS;
+		SCHEDULER_advance();
+	}
+}
+
+/*
+ * Description :
+ * Queue a call of a_ptr(data) from the next SCHEDULER_dispatch, the bottom half of an ISR.
+ * Call it from ISRs only: they do not nest, so together they are the single producer of
+ * the lock-free queue. The emergency stop ISR of the CONTROL_ECU is its only user, the
+ * keypad scan of the HMI_ECU keeps its own key event queue.
+ * Return FALSE if the queue is full and the event is lost.
+ */
+boolean SCHEDULER_postEvent(void(*a_ptr)(uint8 data), uint8 data)
+{
+	uint8 next = (g_queueHead + 1) & SCHEDULER_QUEUE_MASK;
+
+	if((a_ptr == NULL_PTR) || (next == g_queueTail))
+	{
+		return FALSE;
+	}
+	g_queue[g_queueHead].handlerPtr = a_ptr;
+	g_queue[g_queueHead].data = data;
+	/* Publish the event only after it is written */
+	g_queueHead = next;
+	return TRUE;
+}
+
+/*
+ * Description :
+ * Copy the time measured for the Timer1 tick ISR.
+ */
+void SCHEDULER_getIsrTime(SCHEDULER_IsrTimeType *time)
+{
+	time->last = g_isrTime.last;
+	time->max = g_isrTime.max;
+}
+
+/*
+ * Description :
+ * Return the monotonic time in milliseconds since SCHEDULER_init, it wraps after about 49 days.
+ */
+uint32 SCHEDULER_getMillis(void)
+{
+	uint8 sreg = SREG;
+	uint32 now;
+
+	/*
+	 * 32-bit value shared with the tick ISR, read it with the interrupts off. The I-bit is
+	 * restored as it was, so a call from an ISR or a critical section keeps it cleared.
+	 */
+	cli();
+	now = g_millis;
+	SREG = sreg;
+	return now;
+}
+
+/*
+ * Description :
+ * Return the milliseconds elapsed since start_ms, a value taken from SCHEDULER_getMillis.
+ * The unsigned subtraction stays right when the time wraps.
+ */
+uint32 SCHEDULER_elapsedMs(uint32 start_ms)
+{
+	return SCHEDULER_getMillis() - start_ms;
+}
+
+/*
+ * Description :
+ * Return TRUE if timeout_ms milliseconds have elapsed since start_ms.
+ */
+boolean SCHEDULER_isTimeout(uint32 start_ms, uint32 timeout_ms)
+{
+	return (SCHEDULER_elapsedMs(start_ms) >= timeout_ms);
+}
+
+/*
+ * Description :
+ * Timer1 call back, only counts the time so the ISR stays short.
+ * TCNT1 restarts from 0 on the compare match, so its value at the end of the
+ * tick is the time spent since the interrupt was raised.
+ */
+static void SCHEDULER_tick(void)
+{
+	uint8 time;
+
+	g_millis += SCHEDULER_TICK_MS;
+
+	time = (uint8)TIMER1_INITIAL_VALUE_REGISTER;
+	g_isrTime.last = time;
+	if(time > g_isrTime.max)
+	{
+		g_isrTime.max = time;
+	}
+}
+
+/*
+ * Description :
+ * Link a timer in the wheel slot it expires in, ticks after the current position.
+ */
+static void SCHEDULER_insert(SCHEDULER_TimerId id, uint16 ticks)
+{
+	uint8 slot = (g_wheelPosition + ticks) & SCHEDULER_WHEEL_MASK;
+
+	g_timers[id].rounds = (ticks - 1) / SCHEDULER_WHEEL_SIZE;
+	g_timers[id].due = FALSE;
+	g_timers[id].slot = slot;
+	g_timers[id].next = g_wheel[slot];
+	g_wheel[slot] = id;
+}
+
+/*
+ * Description :
+ * Remove a timer from its wheel slot.
+ */
+static void SCHEDULER_unlink(SCHEDULER_TimerId id)
+{
+	uint8 *link_ptr = &g_wheel[g_timers[id].slot];
+
+	while(*link_ptr != SCHEDULER_END_OF_LIST)
+	{
+		if(*link_ptr == id)
+		{
+			*link_ptr = g_timers[id].next;
+			return;
+		}
+		link_ptr = &g_timers[*link_ptr].next;
+	}
+}
+
+/*
+ * Description :
+ * Move the wheel one tick and handle its new slot:
+ * 1. Mark the timers of the slot that expire now, the others wait one more turn.
+ * 2. Take the marked timers one by one: put a periodic timer back in the wheel,
+ *    free a one-shot timer, then call the call back.
+ * The call backs may start and stop any timer, the slot is searched again after each call.
+ */
+static void SCHEDULER_advance(void)
+{
+	SCHEDULER_TimerId id;
+	void (*callBackPtr)(void);
+
+	g_wheelPosition = (g_wheelPosition + 1) & SCHEDULER_WHEEL_MASK;
+
+	for(id = g_wheel[g_wheelPosition] ; id != SCHEDULER_END_OF_LIST ; id = g_timers[id].next)
+	{
+		if(g_timers[id].rounds == 0)
+		{
+			g_timers[id].due = TRUE;
+		}
+		else
+		{
+			g_timers[id].rounds--;
+		}
+	}
+
+	id = g_wheel[g_wheelPosition];
+	while(id != SCHEDULER_END_OF_LIST)
+	{
+		if(g_timers[id].due == FALSE)
+		{
+			id = g_timers[id].next;
+			continue;
+		}
+
+		SCHEDULER_unlink(id);
+		callBackPtr = g_timers[id].callBackPtr;
+		if(g_timers[id].mode == SCHEDULER_PERIODIC)
+		{
+			SCHEDULER_insert(id, g_timers[id].period);
+		}
+		else
+		{
+			g_timers[id].running = FALSE;
+		}
+
+		if(callBackPtr != NULL_PTR)
+		{
+			(*callBackPtr)();
+		}
+		id = g_wheel[g_wheelPosition];
+	}
+}
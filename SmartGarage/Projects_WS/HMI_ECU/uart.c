@@ -13,6 +13,146 @@
 #include "uart.h"
 #include "avr/io.h" /* To use the UART Registers */
 #include "common_macros.h" /* To use the macros like SET_BIT */
+#include <avr/interrupt.h> /* For USART RXC/UDRE ISR */
+
+#define UART_RX_BUFFER_MASK		(UART_RX_BUFFER_SIZE - 1)
+#define UART_TX_BUFFER_MASK		(UART_TX_BUFFER_SIZE - 1)
+
+/* Check every rate of the UBRR table at compile time */
+#if (UART_BAUD_ERROR_PERMILLE(9600UL) > UART_MAX_BAUD_ERROR_PERMILLE)
+#error "Baud rate 9600 error is too high for this Freq_CPU"
+#endif
+#if (UART_BAUD_ERROR_PERMILLE(19200UL) > UART_MAX_BAUD_ERROR_PERMILLE)
+#error "Baud rate 19200 error is too high for this Freq_CPU"
+#endif
+#if (UART_BAUD_ERROR_PERMILLE(38400UL) > UART_MAX_BAUD_ERROR_PERMILLE)
+#error "Baud rate 38400 error is too high for this Freq_CPU"
+#endif
+#if (UART_BAUD_ERROR_PERMILLE(76800UL) > UART_MAX_BAUD_ERROR_PERMILLE)
+#error "Baud rate 76800 error is too high for this Freq_CPU"
+#endif
+#if (UART_BAUD_ERROR_PERMILLE(250000UL) > UART_MAX_BAUD_ERROR_PERMILLE)
+#error "Baud rate 250000 error is too high for this Freq_CPU"
+#endif
+
+/*******************************************************************************
+ *                           Global Variables                                  *
+ *******************************************************************************/
+
+/*
+ * Ring buffers: the head index is written by the producer only and the tail
+ * index by the consumer only, so one byte indices need no locking.
+ */
+static volatile uint8 g_rxBuffer[UART_RX_BUFFER_SIZE];
+static volatile uint8 g_rxHead = 0;
+static volatile uint8 g_rxTail = 0;
+
+static volatile uint8 g_txBuffer[UART_TX_BUFFER_SIZE];
+static volatile uint8 g_txHead = 0;
+static volatile uint8 g_txTail = 0;
+
+static volatile UART_StatsType g_stats;
+
+/* Set when a byte is loaded in UDR, so the TXC flag can tell when the line is idle */
+static volatile boolean g_txStarted = FALSE;
+
+static void (*g_rxCallBackPtr)(uint8 data) = NULL_PTR;
+static void (*g_errorCallBackPtr)(void) = NULL_PTR;
+
+/* UBRR values for U2X = 1, indexed by UART_BaudRate */
+static const uint16 g_ubrrTable[UART_BAUD_COUNT] =
+{
+	UART_UBRR_VALUE(9600UL),
+	UART_UBRR_VALUE(19200UL),
+	UART_UBRR_VALUE(38400UL),
+	UART_UBRR_VALUE(76800UL),
+	UART_UBRR_VALUE(250000UL)
+};
+
+/* Character times in microseconds, indexed by UART_BaudRate */
+static const uint16 g_byteTimeTable[UART_BAUD_COUNT] =
+{
+	UART_BYTE_TIME_US(9600UL),
+	UART_BYTE_TIME_US(19200UL),
+	UART_BYTE_TIME_US(38400UL),
+	UART_BYTE_TIME_US(76800UL),
+	UART_BYTE_TIME_US(250000UL)
+};
+
+static UART_BaudRate g_baudRate = UART_BAUD_9600;
+
+/*******************************************************************************
+ *                       Interrupt Service Routines                            *
+ *******************************************************************************/
+
+ISR(USART_RXC_vect)
+{
+	/* The error flags belong to the byte in UDR, read them before UDR */
+	uint8 status = UCSRA;
+	/* Reading UDR clears the RXC flag, it must be read even if the byte is dropped */
+	uint8 data = UDR;
+	uint8 next = (g_rxHead + 1) & UART_RX_BUFFER_MASK;
+
+	if(BIT_IS_SET(status,DOR))
+	{
+		/* Bytes were lost before this one, this byte itself is good */
+		g_stats.overrun_errors++;
+	}
+	if(BIT_IS_SET(status,FE))
+	{
+		/* No stop bit, usually noise or the peer talks at another baud rate */
+		g_stats.framing_errors++;
+	}
+	else if(BIT_IS_SET(status,PE))
+	{
+		g_stats.parity_errors++;
+	}
+	else if(next != g_rxTail)
+	{
+		g_rxBuffer[g_rxHead] = data;
+		g_rxHead = next;
+	}
+	else
+	{
+		/* RX buffer is full, the main loop did not read fast enough */
+		g_stats.rx_overflows++;
+	}
+
+	if(BIT_IS_SET(status,FE) || BIT_IS_SET(status,PE))
+	{
+		if(g_errorCallBackPtr != NULL_PTR)
+		{
+			/* Tell the application about the bad byte, it may decide the baud rate is wrong */
+			(*g_errorCallBackPtr)();
+		}
+	}
+	else if(g_rxCallBackPtr != NULL_PTR)
+	{
+		/* Call the Call Back function in the application with the good byte, even if the buffer was full */
+		(*g_rxCallBackPtr)(data);
+	}
+}
+
+ISR(USART_UDRE_vect)
+{
+	if(g_txTail != g_txHead)
+	{
+		/*
+		 * Clear TXC by writing one, it is set again when this byte is shifted out.
+		 * Write U2X back as it is and zero to the other bits, a read-modify-write
+		 * would write the error flags and MPCM back.
+		 */
+		UCSRA = (UCSRA & (1<<U2X)) | (1<<TXC);
+		g_txStarted = TRUE;
+		UDR = g_txBuffer[g_txTail];
+		g_txTail = (g_txTail + 1) & UART_TX_BUFFER_MASK;
+	}
+	else
+	{
+		/* Nothing left to send, disable the UDRE interrupt until the next write */
+		CLEAR_BIT(UCSRB,UDRIE);
+	}
+}
 
 /*******************************************************************************
  *                      Functions Definitions                                  *
@@ -24,15 +164,25 @@
  */
 void UART_init(const UART_ConfigType *Config_Ptr)
 {
-	uint16 ubrr_value = 0;
-
 	UCSRA = (1<<U2X);
 
+	/* Start with empty RX/TX ring buffers */
+	g_rxHead = 0;
+	g_rxTail = 0;
+	g_txHead = 0;
+	g_txTail = 0;
+	g_stats.framing_errors = 0;
+	g_stats.overrun_errors = 0;
+	g_stats.parity_errors = 0;
+	g_stats.rx_overflows = 0;
+
 	/************************** UCSRB Description **************************
+	 * RXCIE = 1 RX Complete Interrupt Enable
+	 * UDRIE = 0 Data Register Empty Interrupt is enabled only while sending
 	 * RXEN  = 1 Receiver Enable
 	 * TXEN  = 1 Transmitter Enable
 	 ***********************************************************************/ 
-	UCSRB = (1<<RXEN) | (1<<TXEN);
+	UCSRB = (1<<RXCIE) | (1<<RXEN) | (1<<TXEN);
 
 	/************************** UCSRC Description **************************
 	 * URSEL   = 1 The URSEL must be one when writing the UCSRC
@@ -46,52 +196,178 @@ void UART_init(const UART_ConfigType *Config_Ptr)
 	UCSRC = (UCSRC & 0xF9) | (((Config_Ptr-> bit_data) & 0x03) << 1);
 	UCSRB = (UCSRB & 0xFB) | (((Config_Ptr-> bit_data) & 0x04) << 2);
 
-	ubrr_value = (uint16)((Freq_CPU/(8*(Config_Ptr-> baud_rate))) - 1);
+	/* UBRR comes from the precomputed table, no division at run time */
+	g_baudRate = Config_Ptr-> baud_rate;
 
 	/* First 8 bits from the BAUD_PRESCALE inside UBRRL and last 4 bits in UBRRH*/
-	UBRRH = ubrr_value>>8;
-	UBRRL = ubrr_value;
+	UBRRH = g_ubrrTable[g_baudRate]>>8;
+	UBRRL = g_ubrrTable[g_baudRate];
 }
 
 /*
  * Description :
- * Functional responsible for send byte to another UART device.
+ * Change the baud rate of the running UART from the precomputed UBRR table.
+ * Wait until all the queued TX bytes are sent, then drop any partly received bytes.
  */
-void UART_sendByte(const uint8 data)
+void UART_setBaudRate(UART_BaudRate baud_rate)
 {
-	/*
-	 * UDRE flag is set when the Tx buffer (UDR) is empty and ready for
-	 * transmitting a new byte so wait until this flag is set to one
-	 */
-	while(BIT_IS_CLEAR(UCSRA,UDRE)){}
+	if(baud_rate >= UART_BAUD_COUNT)
+	{
+		/* Invalid baud rate - Do Nothing */
+		return;
+	}
 
-	/*
-	 * Put the required data in the UDR register and it also clear the UDRE flag as
-	 * the UDR register is not empty now
-	 */
-	UDR = data;
+	/* Wait until the TX buffer is drained and the last byte left the shift register */
+	while((g_txHead != g_txTail) || BIT_IS_SET(UCSRB,UDRIE)){}
+	if(g_txStarted)
+	{
+		while(BIT_IS_CLEAR(UCSRA,TXC)){}
+	}
 
-	/************************* Another Method *************************
-	UDR = data;
-	while(BIT_IS_CLEAR(UCSRA,TXC)){} // Wait until the transmission is complete TXC = 1
-	SET_BIT(UCSRA,TXC); // Clear the TXC flag
-	 *******************************************************************/
+	g_baudRate = baud_rate;
+	UBRRH = g_ubrrTable[g_baudRate]>>8;
+	UBRRL = g_ubrrTable[g_baudRate];
+
+	/* Bytes received around the switch are not valid at any of the two rates */
+	g_rxTail = g_rxHead;
+}
+
+/*
+ * Description :
+ * Return the baud rate index currently used by the UART.
+ */
+UART_BaudRate UART_getBaudRate(void)
+{
+	return g_baudRate;
+}
+
+/*
+ * Description :
+ * Return the time of one character on the line at the current baud rate in microseconds.
+ */
+uint16 UART_getByteTimeUs(void)
+{
+	return g_byteTimeTable[g_baudRate];
+}
+
+/*
+ * Description :
+ * Queue up to size bytes in the TX ring buffer without waiting.
+ * The bytes are sent in the background by the UDRE interrupt.
+ * Return the number of bytes queued, it is less than size if the buffer is full.
+ */
+uint8 UART_write(const uint8 *data, uint8 size)
+{
+	uint8 count = 0;
+	uint8 next;
+
+	while(count < size)
+	{
+		next = (g_txHead + 1) & UART_TX_BUFFER_MASK;
+		if(next == g_txTail)
+		{
+			/* TX buffer is full */
+			break;
+		}
+		g_txBuffer[g_txHead] = data[count];
+		g_txHead = next;
+		count++;
+	}
+
+	if(count != 0)
+	{
+		/* Kick the UDRE interrupt, it will drain the buffer then disable itself */
+		SET_BIT(UCSRB,UDRIE);
+	}
+	return count;
+}
+
+/*
+ * Description :
+ * Copy up to size received bytes from the RX ring buffer without waiting.
+ * Return the number of bytes copied, zero if nothing was received.
+ */
+uint8 UART_read(uint8 *data, uint8 size)
+{
+	uint8 count = 0;
+
+	while((count < size) && (g_rxTail != g_rxHead))
+	{
+		data[count] = g_rxBuffer[g_rxTail];
+		g_rxTail = (g_rxTail + 1) & UART_RX_BUFFER_MASK;
+		count++;
+	}
+	return count;
+}
+
+/*
+ * Description :
+ * Return the number of received bytes waiting in the RX ring buffer.
+ */
+uint8 UART_available(void)
+{
+	return (g_rxHead - g_rxTail) & UART_RX_BUFFER_MASK;
+}
+
+/*
+ * Description :
+ * Copy the receive error counters: framing errors (FE), data overruns (DOR),
+ * parity errors (PE) and bytes dropped because the RX ring buffer was full.
+ */
+void UART_getStats(UART_StatsType *stats)
+{
+	/* 16-bit values shared with the RX ISR, read them with interrupts masked */
+	CLEAR_BIT(UCSRB,RXCIE);
+	stats->framing_errors = g_stats.framing_errors;
+	stats->overrun_errors = g_stats.overrun_errors;
+	stats->parity_errors = g_stats.parity_errors;
+	stats->rx_overflows = g_stats.rx_overflows;
+	SET_BIT(UCSRB,RXCIE);
+}
+
+/*
+ * Description :
+ * Set the call back function called from the RX interrupt with each good received byte,
+ * after the byte is put in the RX ring buffer. It must stay short, it runs in the ISR.
+ */
+void UART_setRxCallBack(void(*a_ptr)(uint8 data))
+{
+	g_rxCallBackPtr = a_ptr;
+}
+
+/*
+ * Description :
+ * Set the call back function called from the RX interrupt with each byte dropped for a
+ * framing or parity error. It must stay short, it runs in the ISR.
+ */
+void UART_setErrorCallBack(void(*a_ptr)(void))
+{
+	g_errorCallBackPtr = a_ptr;
+}
+
+/*
+ * Description :
+ * Functional responsible for send byte to another UART device.
+ * Blocking wrapper over UART_write, waits only while the TX buffer is full.
+ */
+void UART_sendByte(const uint8 data)
+{
+	/* The UDRE interrupt frees one place in the buffer every byte time */
+	while(UART_write(&data,1) == 0){}
 }
 
 /*
  * Description :
  * Functional responsible for receive byte from another UART device.
+ * Blocking wrapper over UART_read, waits until a byte is received.
  */
 uint8 UART_recieveByte(void)
 {
-	/* RXC flag is set when the UART receive data so wait until this flag is set to one */
-	while(BIT_IS_CLEAR(UCSRA,RXC)){}
+	uint8 data;
 
-	/*
-	 * Read the received data from the Rx buffer (UDR)
-	 * The RXC flag will be cleared after read the data
-	 */
-	return UDR;
+	/* The RXC interrupt fills the buffer in the background */
+	while(UART_read(&data,1) == 0){}
+	return data;
 }
 
 /*
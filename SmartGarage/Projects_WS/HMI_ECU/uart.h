@@ -18,9 +18,44 @@
 /*******************************************************************************
  *                                Definitions                                  *
  *******************************************************************************/
-#define UART_BaudRate		 	uint32
-#define Freq_CPU				8000000
+#define Freq_CPU				8000000UL
 #define returnByte_data			uint8
+
+/*
+ * UBRR value for the double speed mode (U2X = 1) rounded to the nearest integer:
+ * UBRR = Freq_CPU / (8 * BAUD) - 1
+ */
+#define UART_UBRR_VALUE(BAUD)			(((Freq_CPU) + 4UL * (BAUD)) / (8UL * (BAUD)) - 1)
+
+/* Real baud rate given by the rounded UBRR value */
+#define UART_REAL_BAUD(BAUD)			((Freq_CPU) / (8UL * (UART_UBRR_VALUE(BAUD) + 1)))
+
+/* Absolute baud rate error in per mille */
+#define UART_BAUD_ERROR_PERMILLE(BAUD)	((UART_REAL_BAUD(BAUD) > (BAUD)) ? \
+		((UART_REAL_BAUD(BAUD) - (BAUD)) * 1000UL / (BAUD)) : \
+		(((BAUD) - UART_REAL_BAUD(BAUD)) * 1000UL / (BAUD)))
+
+/* Time of one 8N1 character (10 bits) on the line in microseconds */
+#define UART_BYTE_TIME_US(BAUD)			((10000000UL + (BAUD) - 1) / (BAUD))
+
+/* Largest baud rate error accepted in the table, 2% keeps a safe sampling margin */
+#define UART_MAX_BAUD_ERROR_PERMILLE	20
+
+/*
+ * Size of the RX/TX software ring buffers in bytes.
+ * Each size must be a power of two and not more than 128 so the buffer
+ * indices can be wrapped with a mask and stay inside one byte.
+ */
+#define UART_RX_BUFFER_SIZE		64
+#define UART_TX_BUFFER_SIZE		32
+
+#if ((UART_RX_BUFFER_SIZE & (UART_RX_BUFFER_SIZE - 1)) != 0) || (UART_RX_BUFFER_SIZE > 128)
+#error "UART_RX_BUFFER_SIZE should be a power of two and not more than 128"
+#endif
+
+#if ((UART_TX_BUFFER_SIZE & (UART_TX_BUFFER_SIZE - 1)) != 0) || (UART_TX_BUFFER_SIZE > 128)
+#error "UART_TX_BUFFER_SIZE should be a power of two and not more than 128"
+#endif
 /*******************************************************************************
  *                         Configurations                                      *
  *******************************************************************************/
@@ -39,6 +74,28 @@ typedef enum
 	ONE,TWO
 }UART_StopBit;
 
+/*
+ * Supported baud rates, each one is an index in the precomputed UBRR table.
+ * Rates are sorted from the slowest to the fastest so the link can step down
+ * to the lower index when errors appear.
+ */
+typedef enum
+{
+	UART_BAUD_9600,UART_BAUD_19200,UART_BAUD_38400,UART_BAUD_76800,UART_BAUD_250000,UART_BAUD_COUNT
+}UART_BaudRate;
+
+/*
+ * Receive error counters, kept by the RX interrupt since UART_init.
+ * Bytes with a framing or parity error are not put in the RX buffer,
+ * they are reported to the call back set by UART_setErrorCallBack.
+ */
+typedef struct{
+	uint16 framing_errors;
+	uint16 overrun_errors;
+	uint16 parity_errors;
+	uint16 rx_overflows;
+}UART_StatsType;
+
 typedef struct{
 	UART_BitData bit_data;
 	UART_Parity parity;
@@ -56,15 +113,78 @@ typedef struct{
  */
 void UART_init(const UART_ConfigType *Config_Ptr);
 
+/*
+ * Description :
+ * Change the baud rate of the running UART from the precomputed UBRR table.
+ * Wait until all the queued TX bytes are sent, then drop any partly received bytes.
+ */
+void UART_setBaudRate(UART_BaudRate baud_rate);
+
+/*
+ * Description :
+ * Return the baud rate index currently used by the UART.
+ */
+UART_BaudRate UART_getBaudRate(void);
+
+/*
+ * Description :
+ * Queue up to size bytes in the TX ring buffer without waiting.
+ * The bytes are sent in the background by the UDRE interrupt.
+ * Return the number of bytes queued, it is less than size if the buffer is full.
+ */
+uint8 UART_write(const uint8 *data, uint8 size);
+
+/*
+ * Description :
+ * Copy up to size received bytes from the RX ring buffer without waiting.
+ * Return the number of bytes copied, zero if nothing was received.
+ */
+uint8 UART_read(uint8 *data, uint8 size);
+
+/*
+ * Description :
+ * Return the number of received bytes waiting in the RX ring buffer.
+ */
+uint8 UART_available(void);
+
+/*
+ * Description :
+ * Copy the receive error counters: framing errors (FE), data overruns (DOR),
+ * parity errors (PE) and bytes dropped because the RX ring buffer was full.
+ */
+void UART_getStats(UART_StatsType *stats);
+
+/*
+ * Description :
+ * Return the time of one character on the line at the current baud rate in microseconds.
+ */
+uint16 UART_getByteTimeUs(void);
+
+/*
+ * Description :
+ * Set the call back function called from the RX interrupt with each good received byte,
+ * after the byte is put in the RX ring buffer. It must stay short, it runs in the ISR.
+ */
+void UART_setRxCallBack(void(*a_ptr)(uint8 data));
+
+/*
+ * Description :
+ * Set the call back function called from the RX interrupt with each byte dropped for a
+ * framing or parity error. It must stay short, it runs in the ISR.
+ */
+void UART_setErrorCallBack(void(*a_ptr)(void));
+
 /*
  * Description :
  * Functional responsible for send byte to another UART device.
+ * Blocking wrapper over UART_write, waits only while the TX buffer is full.
  */
 void UART_sendByte(const uint8 data);
 
 /*
  * Description :
  * Functional responsible for receive byte from another UART device.
+ * Blocking wrapper over UART_read, waits until a byte is received.
  */
 uint8 UART_recieveByte(void);
 
@@ -0,0 +1,230 @@
+/******************************************************************************
+ *
+ * File Name: bench_old.c
+ *
+ * Description: READY/DONE byte handshake of the baseline main.c files, kept for
+ * the protocol benchmark. Both roles are built in one library, g_role selects one.
+ * The functions are the baseline ones over the blocking UART_sendByte and
+ * UART_recieveByte wrappers. The CONTROL role compares and stores the password in
+ * RAM, so the benchmark measures the handshake and not the EEPROM delays.
+ *
+ *******************************************************************************/
+
+#include "uart.h"
+#include <avr/io.h>
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+#define READY                                       0xFF
+#define DONE                                        0xFE
+#define PASSWORD_SEND                               0xFD
+#define PASSWORD_MATCH                              0xFC
+#define PASSWORD_NOT_MATCHED                        0xFB
+#define PASSWORD_CONFIRMATION_SEND                  0xFA
+#define OPEN_DOOR                                   0xF8
+#define CHECK_PASSWORD                              0xF7
+#define PASSWORD_SIZE                               5
+
+/* Roles and HMI transactions, the same numbers in bench_protocol.c */
+#define BENCH_ROLE_HMI                              0
+#define BENCH_ROLE_CONTROL                          1
+#define BENCH_IDLE                                  0
+#define BENCH_CHECK_PASSWORD                        1
+#define BENCH_NEW_PASSWORD                          2
+#define BENCH_OPEN_DOOR                             3
+
+/*******************************************************************************
+ *                             Global Variables                                *
+ *******************************************************************************/
+volatile uint8 g_role = BENCH_ROLE_HMI;
+volatile uint8 g_transaction = BENCH_IDLE;
+volatile uint8 g_result;
+
+uint8 g_password[PASSWORD_SIZE] = {1, 2, 3, 4, 5};
+uint8 g_passmatch[PASSWORD_SIZE];
+uint8 savedpass[PASSWORD_SIZE] = {1, 2, 3, 4, 5};
+uint8 command;
+
+UART_ConfigType UART_configuration = {EIGHT, DISABLED, ONE, UART_BAUD_9600};
+
+/*******************************************************************************
+ *                      Functions Prototypes(Private)                          *
+ *******************************************************************************/
+static void Hmi_passwordSend(uint8 a_arr[]);
+static void Hmi_commandSend(uint8 command);
+static uint8 Hmi_commandRecieve(void);
+static void Hmi_run(void);
+static void Control_passwordRecieve(uint8 a_arr[]);
+static uint8 Control_match(uint8 a_arr1[], uint8 a_arr2[]);
+static uint8 Control_commandRecieve(void);
+static void Control_commandSend(uint8 command);
+static void Control_run(void);
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
+
+int bench_main(void)
+{
+	UART_init(&UART_configuration);
+	SREG |= (1<<7);
+
+	if(g_role == BENCH_ROLE_HMI)
+	{
+		Hmi_run();
+	}
+	Control_run();
+	return 0;
+}
+
+/*
+ * Description :
+ * HMI role: run the transaction written by the benchmark, the steps of the baseline
+ * Password_creatAndStore and Main_options without the keypad and the LCD.
+ */
+static void Hmi_run(void)
+{
+	while(1)
+	{
+		switch(g_transaction)
+		{
+		case BENCH_CHECK_PASSWORD:
+			Hmi_commandSend(CHECK_PASSWORD);
+			Hmi_passwordSend(g_password);
+			g_result = Hmi_commandRecieve();
+			break;
+		case BENCH_NEW_PASSWORD:
+			Hmi_commandSend(PASSWORD_SEND);
+			Hmi_passwordSend(g_password);
+			Hmi_commandSend(PASSWORD_CONFIRMATION_SEND);
+			Hmi_passwordSend(g_password);
+			g_result = Hmi_commandRecieve();
+			break;
+		case BENCH_OPEN_DOOR:
+			Hmi_commandSend(CHECK_PASSWORD);
+			Hmi_passwordSend(g_password);
+			g_result = Hmi_commandRecieve();
+			if(g_result == PASSWORD_MATCH)
+			{
+				Hmi_commandSend(OPEN_DOOR);
+				UART_sendByte(READY);
+				while(UART_recieveByte() != READY){};
+			}
+			break;
+		default:
+			continue;
+		}
+		g_transaction = BENCH_IDLE;
+	}
+}
+
+static void Hmi_passwordSend(uint8 a_arr[])
+{
+	uint8 i;
+	UART_sendByte(READY);
+	while(UART_recieveByte() != READY);
+
+	for(i=0 ; i<PASSWORD_SIZE ; i++)
+	{
+		UART_sendByte(a_arr[i]);
+	}
+}
+
+static void Hmi_commandSend(uint8 command)
+{
+	UART_sendByte(READY);
+	while(UART_recieveByte() != READY);
+	UART_sendByte(command);
+}
+
+static uint8 Hmi_commandRecieve(void)
+{
+	while(UART_recieveByte() != READY);
+	UART_sendByte(READY);
+	command = UART_recieveByte();
+	return command;
+}
+
+/*
+ * Description :
+ * CONTROL role: the baseline main loop, the door run after OPEN_DOOR is left out.
+ */
+static void Control_run(void)
+{
+	uint8 i;
+
+	while(1){
+		switch(Control_commandRecieve())
+		{
+		case PASSWORD_SEND:
+			Control_passwordRecieve(g_password);
+			break;
+		case PASSWORD_CONFIRMATION_SEND:
+			Control_passwordRecieve(g_passmatch);
+			if(Control_match(g_password,g_passmatch)){
+				for(i=0;i<PASSWORD_SIZE;i++){
+					savedpass[i]=g_password[i];
+				}
+				Control_commandSend(PASSWORD_MATCH);
+			}
+			else
+			{
+				Control_commandSend(PASSWORD_NOT_MATCHED);
+			}
+			break;
+		case CHECK_PASSWORD:
+			Control_passwordRecieve(g_password);
+			if(Control_match(g_password,savedpass))
+			{
+				Control_commandSend(PASSWORD_MATCH);
+			}
+			else
+			{
+				Control_commandSend(PASSWORD_NOT_MATCHED);
+			}
+			break;
+		case OPEN_DOOR:
+			while(UART_recieveByte() != READY){};
+			UART_sendByte(READY);
+			break;
+		}
+	}
+}
+
+static void Control_passwordRecieve(uint8 a_arr[])
+{
+	while(UART_recieveByte() != READY){};
+	UART_sendByte(READY);
+	for(uint8 i=0 ; i<PASSWORD_SIZE ; i++){
+		a_arr[i]=UART_recieveByte();
+	}
+}
+
+static uint8 Control_match(uint8 a_arr1[],uint8 a_arr2[])
+{
+	uint8 counter=0;
+	for(uint8 i=0 ; i<PASSWORD_SIZE ; i++)
+	{
+		if(a_arr1[i]==a_arr2[i]){
+			counter++;
+		}
+	}
+	return (counter==PASSWORD_SIZE);
+}
+
+static uint8 Control_commandRecieve(void)
+{
+	while(UART_recieveByte() != READY){};
+	UART_sendByte(READY);
+	command=UART_recieveByte();
+	UART_sendByte(DONE);
+	return command;
+}
+
+static void Control_commandSend(uint8 command)
+{
+	UART_sendByte(READY);
+	while(UART_recieveByte() != READY){};
+	UART_sendByte(command);
+}
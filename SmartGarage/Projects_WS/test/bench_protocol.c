@@ -0,0 +1,210 @@
+/******************************************************************************
+ *
+ * File Name: bench_protocol.c
+ *
+ * Description: Benchmark of the link protocol at 9600 baud, before and after the
+ * framed protocol. Before: the READY/DONE handshake of the baseline main.c files
+ * (bench_old.c) on both ECUs. After: the HMI requests of link_hmi.c against the
+ * real CONTROL_ECU. For each transaction it counts the bytes on the wire in both
+ * directions, the line turnarounds and the time from the request to its reply.
+ *
+ *******************************************************************************/
+
+#include "sim.h"
+#include "link_host.h"
+#include "protocol.h"
+#include <stdio.h>
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+/* Same numbers as in bench_old.c */
+#define BENCH_ROLE_CONTROL          1
+#define BENCH_IDLE                  0
+#define BENCH_TRANSACTIONS          3
+#define BENCH_TIMEOUT_NS            SIM_MS(1000)
+#define BENCH_BOOT_NS               SIM_MS(200)
+
+typedef struct
+{
+	uint32_t bytes;
+	uint32_t turnarounds;
+	uint64_t time_ns;
+	uint16_t reply;
+}BENCH_ResultType;
+
+/* Counts the turnarounds: the direction of the last byte received by one of the nodes */
+typedef struct
+{
+	SIM_NodeType *hmi;
+	SIM_NodeType *control;
+	uint32_t hmiBytes;
+	uint32_t controlBytes;
+	uint32_t startBytes;
+	int direction;
+	uint32_t turnarounds;
+}BENCH_WireType;
+
+/*******************************************************************************
+ *                           Global Variables                                  *
+ *******************************************************************************/
+static const char *const g_names[BENCH_TRANSACTIONS] =
+{
+	"check password", "new password", "open door"
+};
+
+static BENCH_WireType g_wire;
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
+
+static void Bench_wireUpdate(void *context, uint64_t now)
+{
+	BENCH_WireType *wire = (BENCH_WireType *)context;
+	int direction = wire->direction;
+
+	(void)now;
+	if(wire->control->rxBytes != wire->controlBytes)
+	{
+		direction = 1;
+	}
+	if(wire->hmi->rxBytes != wire->hmiBytes)
+	{
+		direction = 2;
+	}
+	if((direction != wire->direction) && (wire->direction != 0))
+	{
+		wire->turnarounds++;
+	}
+	wire->direction = direction;
+	wire->controlBytes = wire->control->rxBytes;
+	wire->hmiBytes = wire->hmi->rxBytes;
+}
+
+static void Bench_wireStart(BENCH_WireType *wire)
+{
+	wire->direction = 0;
+	wire->turnarounds = 0;
+	wire->hmiBytes = wire->hmi->rxBytes;
+	wire->controlBytes = wire->control->rxBytes;
+	wire->startBytes = wire->hmiBytes + wire->controlBytes;
+}
+
+/*
+ * Description :
+ * End of a transaction when the HMI has its reply: the bytes received by both nodes since
+ * Bench_wireStart. A door stream that follows the reply is not complete yet, it is not counted.
+ */
+static void Bench_wireEnd(BENCH_WireType *wire, BENCH_ResultType *result, uint64_t start)
+{
+	Bench_wireUpdate(wire, 0);
+	result->time_ns = SIM_now() - start;
+	result->turnarounds = wire->turnarounds;
+	result->bytes = (wire->hmi->rxBytes + wire->control->rxBytes) - wire->startBytes;
+}
+
+static int Bench_oldIdle(void *context)
+{
+	return *(volatile uint8_t *)context == BENCH_IDLE;
+}
+
+/*
+ * Description :
+ * The baseline handshake, the HMI role runs each transaction when it is written in g_transaction.
+ */
+static void Bench_old(BENCH_ResultType results[BENCH_TRANSACTIONS])
+{
+	volatile uint8_t *transaction;
+	volatile uint8_t *result;
+	uint64_t start;
+	uint8_t i;
+
+	SIM_init();
+	g_wire.hmi = SIM_addNode("hmi", "build/bench_old_hmi.so", "bench_main");
+	g_wire.control = SIM_addNode("control", "build/bench_old_control.so", "bench_main");
+	SIM_connect(g_wire.hmi, g_wire.control);
+	*(volatile uint8_t *)SIM_symbol(g_wire.control, "g_role") = BENCH_ROLE_CONTROL;
+	transaction = SIM_symbol(g_wire.hmi, "g_transaction");
+	result = SIM_symbol(g_wire.hmi, "g_result");
+	SIM_addDevice(Bench_wireUpdate, &g_wire);
+	SIM_run(BENCH_BOOT_NS);
+
+	for(i = 0 ; i < BENCH_TRANSACTIONS ; i++)
+	{
+		Bench_wireStart(&g_wire);
+		start = SIM_now();
+		*transaction = (uint8_t)(i + 1);
+		results[i].reply = SIM_runUntil(Bench_oldIdle, (void *)transaction, BENCH_TIMEOUT_NS) ?
+				*result : LINK_HOST_TIMEOUT;
+		Bench_wireEnd(&g_wire, &results[i], start);
+		SIM_run(SIM_MS(20));
+	}
+}
+
+/*
+ * Description :
+ * The framed protocol: one request frame and one reply frame for each transaction.
+ */
+static void Bench_new(BENCH_ResultType results[BENCH_TRANSACTIONS])
+{
+	static const uint8_t types[BENCH_TRANSACTIONS] = {CHECK_PASSWORD, PASSWORD_CONFIRMATION_SEND, UNLOCK_DOOR};
+	LINK_HOST_Type link;
+	uint8_t payload[2 * PASSWORD_SIZE];
+	uint64_t start;
+	uint8_t length;
+	uint8_t i;
+
+	SIM_init();
+	LINK_HOST_addHmi(&link, "build/link_hmi.so");
+	g_wire.hmi = link.node;
+	g_wire.control = LINK_HOST_addControl("build/control.so");
+	SIM_connect(g_wire.hmi, g_wire.control);
+	SIM_addDevice(Bench_wireUpdate, &g_wire);
+	SIM_run(BENCH_BOOT_NS);
+
+	for(i = 0 ; i < PASSWORD_SIZE ; i++)
+	{
+		payload[i] = LINK_HOST_password[i];
+		payload[PASSWORD_SIZE + i] = LINK_HOST_password[i];
+	}
+	for(i = 0 ; i < BENCH_TRANSACTIONS ; i++)
+	{
+		length = (types[i] == PASSWORD_CONFIRMATION_SEND) ? 2 * PASSWORD_SIZE : PASSWORD_SIZE;
+		Bench_wireStart(&g_wire);
+		start = SIM_now();
+		results[i].reply = LINK_HOST_request(&link, types[i], payload, length, BENCH_TIMEOUT_NS);
+		Bench_wireEnd(&g_wire, &results[i], start);
+		/* The password is written in the EEPROM after the reply */
+		SIM_run(SIM_MS(100));
+	}
+}
+
+int main(void)
+{
+	static const uint16_t old_replies[BENCH_TRANSACTIONS] = {0xFC, 0xFC, 0xFC};
+	static const uint16_t new_replies[BENCH_TRANSACTIONS] = {PASSWORD_MATCH, PASSWORD_MATCH, DOOR_OPENING};
+	BENCH_ResultType before[BENCH_TRANSACTIONS];
+	BENCH_ResultType after[BENCH_TRANSACTIONS];
+	uint8_t i;
+
+	Bench_old(before);
+	Bench_new(after);
+
+	printf("%-16s %17s %17s %21s\n", "9600 baud", "bytes", "turnarounds", "time ms");
+	printf("%-16s %8s %8s %8s %8s %10s %10s\n", "", "before", "after", "before", "after", "before", "after");
+	for(i = 0 ; i < BENCH_TRANSACTIONS ; i++)
+	{
+		printf("%-16s %8u %8u %8u %8u %10.2f %10.2f\n", g_names[i],
+				(unsigned)before[i].bytes, (unsigned)after[i].bytes,
+				(unsigned)before[i].turnarounds, (unsigned)after[i].turnarounds,
+				before[i].time_ns / 1e6, after[i].time_ns / 1e6);
+	}
+	for(i = 0 ; i < BENCH_TRANSACTIONS ; i++)
+	{
+		SIM_CHECK(before[i].reply == old_replies[i], "%s before: reply 0x%02X", g_names[i], before[i].reply);
+		SIM_CHECK(after[i].reply == new_replies[i], "%s after: reply 0x%02X", g_names[i], after[i].reply);
+		SIM_CHECK(after[i].turnarounds == 1, "%s after: one turnaround, the request then the reply", g_names[i]);
+	}
+	return SIM_exitCode();
+}
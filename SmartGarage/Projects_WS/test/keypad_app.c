@@ -0,0 +1,50 @@
+/******************************************************************************
+ *
+ * File Name: keypad_app.c
+ *
+ * Description: Keypad application for the host tests, built with the HMI_ECU keypad
+ * driver. The main loop reads the key events in the way chosen by g_mode and logs
+ * them in order in g_log, the test adds the time of each one.
+ *
+ *******************************************************************************/
+
+#include "keypad_app.h"
+#include "keypad.h"
+#include <avr/io.h>
+
+/*******************************************************************************
+ *                             Global Variables                                *
+ *******************************************************************************/
+volatile uint8 g_mode = KEYPAD_APP_EVENTS;
+KEYPAD_EventType g_log[KEYPAD_APP_LOG_SIZE];
+volatile uint16 g_logCount = 0;
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
+
+int keypad_main(void)
+{
+	KEYPAD_EventType event;
+
+	KEYPAD_init();
+	SREG |= (1<<7);
+
+	while(1)
+	{
+		if(g_mode == KEYPAD_APP_PRESSED_KEY)
+		{
+			event.key = KEYPAD_getPressedKey();
+			event.kind = KEYPAD_PRESS;
+		}
+		else if((g_mode != KEYPAD_APP_EVENTS) || !KEYPAD_getEvent(&event))
+		{
+			continue;
+		}
+		if(g_logCount < KEYPAD_APP_LOG_SIZE)
+		{
+			g_log[g_logCount] = event;
+			g_logCount++;
+		}
+	}
+}
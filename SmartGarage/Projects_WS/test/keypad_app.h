@@ -0,0 +1,22 @@
+/******************************************************************************
+ *
+ * File Name: keypad_app.h
+ *
+ * Description: Modes of the keypad application used by the host tests.
+ *
+ *******************************************************************************/
+
+#ifndef KEYPAD_APP_H_
+#define KEYPAD_APP_H_
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+#define KEYPAD_APP_LOG_SIZE         4096
+
+/* Set in g_mode by the test */
+#define KEYPAD_APP_EVENTS           0   /* KEYPAD_getEvent --> g_log */
+#define KEYPAD_APP_PAUSED           1   /* Nothing is read, the event queue fills */
+#define KEYPAD_APP_PRESSED_KEY      2   /* KEYPAD_getPressedKey --> g_log as KEYPAD_PRESS events */
+
+#endif /* KEYPAD_APP_H_ */
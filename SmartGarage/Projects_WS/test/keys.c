@@ -0,0 +1,120 @@
+/******************************************************************************
+ *
+ * File Name: keys.c
+ *
+ * Description: Model of the 4x4 keypad of the HMI_ECU, for the host tests.
+ *
+ *******************************************************************************/
+
+#include "keys.h"
+#include <stdlib.h>
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+#define KEYS_FIRST_ROW_PIN          0
+#define KEYS_FIRST_COL_PIN          4
+#define KEYS_WAKE_PIN               2
+
+/*******************************************************************************
+ *                           Global Variables                                  *
+ *******************************************************************************/
+const uint8_t KEYS_values[KEYS_COUNT] =
+{
+	7, 8, 9, '%', 4, 5, 6, '*', 1, 2, 3, '-', 13, 0, '=', '+'
+};
+
+/*******************************************************************************
+ *                      Functions Prototypes(Private)                          *
+ *******************************************************************************/
+static void KEYS_update(void *context, uint64_t now);
+static void KEYS_setContact(KEYS_Type *keys, uint8_t closed);
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
+
+void KEYS_init(KEYS_Type *keys, SIM_NodeType *node)
+{
+	keys->node = node;
+	keys->key = KEYS_NO_KEY;
+	keys->closed = 0;
+	keys->contact = 0;
+	keys->bounceEnd = 0;
+	keys->nextToggle = 0;
+	SIM_addDevice(KEYS_update, keys);
+}
+
+void KEYS_press(KEYS_Type *keys, uint8_t key, uint64_t hold_ns, uint64_t gap_ns)
+{
+	keys->key = key;
+	KEYS_setContact(keys, 1);
+	SIM_run(hold_ns);
+	KEYS_setContact(keys, 0);
+	SIM_run(gap_ns);
+}
+
+void KEYS_type(KEYS_Type *keys, const uint8_t *values, uint8_t count)
+{
+	uint8_t i;
+	uint8_t key;
+
+	for(i = 0 ; i < count ; i++)
+	{
+		for(key = 0 ; (key < KEYS_COUNT) && (KEYS_values[key] != values[i]) ; key++)
+		{
+		}
+		KEYS_press(keys, key, SIM_MS(KEYS_TYPE_HOLD_MS), SIM_MS(KEYS_TYPE_GAP_MS));
+	}
+}
+
+uint64_t KEYS_random(uint64_t min, uint64_t max)
+{
+	return min + (uint64_t)rand() % (max - min + 1);
+}
+
+/*
+ * Description :
+ * Called every quantum: bounce the contact, pull the column of the closed key low
+ * while its row is driven low, and the wake line low with any column.
+ */
+static void KEYS_update(void *context, uint64_t now)
+{
+	KEYS_Type *keys = (KEYS_Type *)context;
+	volatile uint8_t *reg = keys->node->reg8;
+	uint8_t row_bit;
+	uint8_t any_low = 0;
+	uint8_t low;
+	uint8_t col;
+
+	if(now >= keys->bounceEnd)
+	{
+		keys->contact = keys->closed;
+	}
+	else if(now >= keys->nextToggle)
+	{
+		keys->contact ^= 1;
+		keys->nextToggle = now + SIM_US(KEYS_random(KEYS_MIN_TOGGLE_US, KEYS_MAX_TOGGLE_US));
+	}
+
+	for(col = 0 ; col < KEYS_COLS ; col++)
+	{
+		low = 0;
+		if(keys->contact && (keys->key != KEYS_NO_KEY) && (keys->key % KEYS_COLS == col))
+		{
+			row_bit = (uint8_t)(1 << (KEYS_FIRST_ROW_PIN + keys->key / KEYS_COLS));
+			low = (reg[STUB_DDRB] & row_bit) && !(reg[STUB_PORTB] & row_bit);
+		}
+		SIM_setPin(keys->node, STUB_PINB, (uint8_t)(KEYS_FIRST_COL_PIN + col), (uint8_t)!low);
+		any_low |= low;
+	}
+	SIM_setPin(keys->node, STUB_PIND, KEYS_WAKE_PIN, (uint8_t)!any_low);
+}
+
+/* Close or open the contact of the key, it bounces for up to KEYS_MAX_BOUNCE_US */
+static void KEYS_setContact(KEYS_Type *keys, uint8_t closed)
+{
+	keys->closed = closed;
+	keys->bounceEnd = SIM_now() + SIM_US(KEYS_random(0, KEYS_MAX_BOUNCE_US));
+	keys->nextToggle = SIM_now();
+}
@@ -0,0 +1,84 @@
+/******************************************************************************
+ *
+ * File Name: keys.h
+ *
+ * Description: Model of the 4x4 keypad of the HMI_ECU, for the host tests.
+ *
+ * One key at a time is closed, with contact bounce after each edge. A column on
+ * PB4-PB7 reads low while the key is closed and the ECU drives its row on PB0-PB3
+ * low. Each column joins the wake line on PD2/INT0 through a diode, the line reads
+ * low while a column is low.
+ *
+ *******************************************************************************/
+
+#ifndef KEYS_H_
+#define KEYS_H_
+
+#include "sim.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+#define KEYS_ROWS                   4
+#define KEYS_COLS                   4
+#define KEYS_COUNT                  (KEYS_ROWS * KEYS_COLS)
+#define KEYS_NO_KEY                 (-1)
+
+/* Contact bounce after each edge, the contact toggles at random inside it */
+#define KEYS_MAX_BOUNCE_US          5000
+#define KEYS_MIN_TOGGLE_US          100
+#define KEYS_MAX_TOGGLE_US          600
+
+/* Hold and gap of the keys typed by KEYS_type */
+#define KEYS_TYPE_HOLD_MS           80
+#define KEYS_TYPE_GAP_MS            80
+
+/*******************************************************************************
+ *                               Types Declaration                             *
+ *******************************************************************************/
+typedef struct
+{
+	SIM_NodeType *node;
+	int key;                            /* Key index row by row, or KEYS_NO_KEY */
+	uint8_t closed;
+	uint8_t contact;                    /* Contact level, bouncing after an edge */
+	uint64_t bounceEnd;
+	uint64_t nextToggle;
+}KEYS_Type;
+
+/*******************************************************************************
+ *                           Global Variables                                  *
+ *******************************************************************************/
+
+/* Functional values of the keys row by row, the ones of the old 4x4 switch */
+extern const uint8_t KEYS_values[KEYS_COUNT];
+
+/*******************************************************************************
+ *                      Functions Prototypes                                   *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Wire the keypad to a node with all the keys released.
+ */
+void KEYS_init(KEYS_Type *keys, SIM_NodeType *node);
+
+/*
+ * Description :
+ * Press a key for hold_ns with a random bounce at each edge, then leave the keypad alone for gap_ns.
+ */
+void KEYS_press(KEYS_Type *keys, uint8_t key, uint64_t hold_ns, uint64_t gap_ns);
+
+/*
+ * Description :
+ * Press the keys of the functional values in turn, KEYS_TYPE_HOLD_MS each with KEYS_TYPE_GAP_MS after it.
+ */
+void KEYS_type(KEYS_Type *keys, const uint8_t *values, uint8_t count);
+
+/*
+ * Description :
+ * Random number from min to max, both included.
+ */
+uint64_t KEYS_random(uint64_t min, uint64_t max);
+
+#endif /* KEYS_H_ */
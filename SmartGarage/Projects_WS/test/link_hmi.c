@@ -0,0 +1,169 @@
+/******************************************************************************
+ *
+ * File Name: link_hmi.c
+ *
+ * Description: HMI side of the link for the host tests, built with the HMI_ECU
+ * UART, protocol and scheduler drivers. The test writes one command in the
+ * mailbox below and waits until g_command goes back to LINK_APP_IDLE.
+ * Between the commands the frames sent with PROTOCOL_NO_SEQ are counted.
+ *
+ *******************************************************************************/
+
+#include "link_hmi.h"
+#include "uart.h"
+#include "protocol.h"
+#include "scheduler.h"
+#include <avr/io.h>
+#include <util/delay.h>
+
+/*******************************************************************************
+ *                             Global Variables                                *
+ *******************************************************************************/
+volatile uint8 g_command = LINK_APP_IDLE;
+volatile uint8 g_type;
+volatile uint8 g_payload[PROTOCOL_MAX_PAYLOAD];
+volatile uint8 g_length;
+volatile uint8 g_rate;
+
+/* Result of the last command: reply type or LINK_LOST, or the baud rate index */
+volatile uint8 g_result;
+volatile uint8 g_reply[PROTOCOL_MAX_PAYLOAD];
+volatile uint8 g_replyLength;
+
+/* Frames received with PROTOCOL_NO_SEQ and the last one of them */
+volatile uint16 g_notifyCount = 0;
+volatile uint8 g_notifyType;
+volatile uint8 g_notify[PROTOCOL_MAX_PAYLOAD];
+
+UART_ConfigType g_uartConfig = {EIGHT, DISABLED, ONE, UART_BAUD_9600};
+
+/*******************************************************************************
+ *                      Functions Prototypes(Private)                          *
+ *******************************************************************************/
+static void Link_notify(const PROTOCOL_FrameType *frame);
+static void Link_request(void);
+static uint8 Link_setRate(uint8 rate);
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
+
+int link_main(void)
+{
+	UART_init(&g_uartConfig);
+	PROTOCOL_init();
+	SCHEDULER_init();
+	PROTOCOL_setNotifyCallBack(Link_notify);
+	SREG |= (1<<7);
+
+	while(1)
+	{
+		switch(g_command)
+		{
+		case LINK_APP_REQUEST:
+			Link_request();
+			break;
+		case LINK_APP_NEGOTIATE:
+			g_result = PROTOCOL_negotiateSpeed();
+			break;
+		case LINK_APP_SET_RATE:
+			g_result = Link_setRate(g_rate);
+			break;
+		case LINK_APP_RESYNC:
+			PROTOCOL_resync();
+			break;
+		case LINK_APP_EMERGENCY_STOP:
+			PROTOCOL_sendEmergencyStop();
+			break;
+		default:
+			/* Idle, keep the notifications flowing */
+			PROTOCOL_poll();
+			continue;
+		}
+		g_command = LINK_APP_IDLE;
+	}
+}
+
+/*
+ * Description :
+ * Count a frame sent with PROTOCOL_NO_SEQ and keep it for the test.
+ */
+static void Link_notify(const PROTOCOL_FrameType *frame)
+{
+	uint8 i;
+
+	g_notifyType = frame->type;
+	for(i = 0 ; i < frame->length ; i++)
+	{
+		g_notify[i] = frame->payload[i];
+	}
+	g_notifyCount++;
+}
+
+/*
+ * Description :
+ * Send the request of the mailbox and wait for its reply, like Request_send and
+ * Command_recieve of the HMI_ECU.
+ */
+static void Link_request(void)
+{
+	PROTOCOL_FrameType reply;
+	uint8 seq;
+	uint8 i;
+
+	while((seq = PROTOCOL_request(g_type, (const uint8 *)g_payload, g_length)) == PROTOCOL_NO_SEQ)
+	{
+		PROTOCOL_poll();
+	}
+	if(PROTOCOL_waitReply(seq, &reply) == FALSE)
+	{
+		g_result = LINK_LOST;
+		return;
+	}
+	for(i = 0 ; i < reply.length ; i++)
+	{
+		g_reply[i] = reply.payload[i];
+	}
+	g_replyLength = reply.length;
+	g_result = reply.type;
+}
+
+/*
+ * Description :
+ * Move the link to one rate of the table, the steps of PROTOCOL_negotiateSpeed for that
+ * rate only. Return the rate in use at the end.
+ */
+static uint8 Link_setRate(uint8 rate)
+{
+	PROTOCOL_FrameType frame;
+	uint8 payload[LINK_APP_PROBE_SIZE] = {0x55, 0xAA, 0x00, 0xFF, 0};
+	uint8 probe;
+
+	PROTOCOL_sendFrame(LINK_PING, PROTOCOL_NO_SEQ, NULL_PTR, 0);
+	if((PROTOCOL_waitFrameTimeout(&frame, LINK_REPLY_TIMEOUT_MS) == FALSE) || (frame.type != LINK_PING))
+	{
+		return UART_getBaudRate();
+	}
+	if(rate == LINK_BASE_BAUD_RATE)
+	{
+		return rate;
+	}
+	PROTOCOL_sendFrame(LINK_SPEED_REQUEST, PROTOCOL_NO_SEQ, &rate, 1);
+	if((PROTOCOL_waitFrameTimeout(&frame, LINK_REPLY_TIMEOUT_MS) == FALSE) ||
+			(frame.type != LINK_SPEED_ACCEPT) || (frame.payload[0] != rate))
+	{
+		return UART_getBaudRate();
+	}
+	UART_setBaudRate(rate);
+	_delay_ms(LINK_SETTLE_TIME_MS);
+	for(probe = 0 ; probe < LINK_PROBE_COUNT ; probe++)
+	{
+		payload[LINK_APP_PROBE_SIZE - 1] = probe;
+		PROTOCOL_sendFrame(LINK_PROBE, PROTOCOL_NO_SEQ, payload, LINK_APP_PROBE_SIZE);
+		if((PROTOCOL_waitFrameTimeout(&frame, LINK_REPLY_TIMEOUT_MS) == FALSE) || (frame.type != LINK_PROBE))
+		{
+			break;
+		}
+	}
+	return UART_getBaudRate();
+}
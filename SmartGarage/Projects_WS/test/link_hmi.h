@@ -0,0 +1,25 @@
+/******************************************************************************
+ *
+ * File Name: link_hmi.h
+ *
+ * Description: Mailbox commands of the HMI side of the link used by the host tests.
+ *
+ *******************************************************************************/
+
+#ifndef LINK_HMI_H_
+#define LINK_HMI_H_
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+#define LINK_APP_IDLE               0
+#define LINK_APP_REQUEST            1   /* g_type, g_payload, g_length --> g_result, g_reply */
+#define LINK_APP_NEGOTIATE          2   /* --> g_result rate index */
+#define LINK_APP_SET_RATE           3   /* g_rate --> g_result rate index */
+#define LINK_APP_RESYNC             4
+#define LINK_APP_EMERGENCY_STOP     5
+
+/* Probe payload of the negotiation: the test pattern and the probe number */
+#define LINK_APP_PROBE_SIZE         5
+
+#endif /* LINK_HMI_H_ */
@@ -0,0 +1,105 @@
+/******************************************************************************
+ *
+ * File Name: link_host.c
+ *
+ * Description: Test side of the link_hmi.c mailbox, and the CONTROL_ECU node
+ * with its saved password, shared by the host tests of the link.
+ *
+ *******************************************************************************/
+
+#include "link_host.h"
+#include <string.h>
+
+/*******************************************************************************
+ *                           Global Variables                                  *
+ *******************************************************************************/
+const uint8_t LINK_HOST_password[5] = {1, 2, 3, 4, 5};
+
+/*******************************************************************************
+ *                      Functions Prototypes(Private)                          *
+ *******************************************************************************/
+static int LINK_HOST_idle(void *context);
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
+
+void LINK_HOST_addHmi(LINK_HOST_Type *link, const char *path)
+{
+	link->node = SIM_addNode("hmi", path, "link_main");
+	LINK_HOST_attach(link);
+}
+
+SIM_NodeType *LINK_HOST_addControl(const char *path)
+{
+	SIM_NodeType *node = SIM_addNode("control", path, "control_main");
+
+	memcpy(&node->eeprom[LINK_HOST_PASSWORD_ADDRESS], LINK_HOST_password, sizeof(LINK_HOST_password));
+	return node;
+}
+
+void LINK_HOST_setParams(SIM_NodeType *node, const uint8_t *params, uint8_t size)
+{
+	uint8_t crc = 0;
+	uint8_t i;
+
+	for(i = 0 ; i < size ; i++)
+	{
+		node->eeprom[LINK_HOST_PARAMS_ADDRESS + i] = params[i];
+		crc = SIM_crc8(crc, params[i]);
+	}
+	node->eeprom[LINK_HOST_PARAMS_ADDRESS + size] = crc;
+}
+
+void LINK_HOST_attach(LINK_HOST_Type *link)
+{
+	SIM_NodeType *node = link->node;
+
+	link->command = SIM_symbol(node, "g_command");
+	link->type = SIM_symbol(node, "g_type");
+	link->payload = SIM_symbol(node, "g_payload");
+	link->length = SIM_symbol(node, "g_length");
+	link->rate = SIM_symbol(node, "g_rate");
+	link->result = SIM_symbol(node, "g_result");
+	link->reply = SIM_symbol(node, "g_reply");
+	link->replyLength = SIM_symbol(node, "g_replyLength");
+	link->notifyCount = SIM_symbol(node, "g_notifyCount");
+	link->notifyType = SIM_symbol(node, "g_notifyType");
+	link->notify = SIM_symbol(node, "g_notify");
+}
+
+int LINK_HOST_run(LINK_HOST_Type *link, uint8_t command, uint64_t timeout_ns)
+{
+	*link->command = command;
+	return SIM_runUntil(LINK_HOST_idle, link, timeout_ns);
+}
+
+uint16_t LINK_HOST_request(LINK_HOST_Type *link, uint8_t type, const uint8_t *payload, uint8_t length,
+		uint64_t timeout_ns)
+{
+	uint8_t i;
+
+	*link->type = type;
+	for(i = 0 ; i < length ; i++)
+	{
+		link->payload[i] = payload[i];
+	}
+	*link->length = length;
+	if(!LINK_HOST_run(link, LINK_APP_REQUEST, timeout_ns))
+	{
+		return LINK_HOST_TIMEOUT;
+	}
+	return *link->result;
+}
+
+uint8_t LINK_HOST_setRate(LINK_HOST_Type *link, uint8_t rate)
+{
+	*link->rate = rate;
+	LINK_HOST_run(link, LINK_APP_SET_RATE, SIM_MS(1000));
+	return *link->result;
+}
+
+static int LINK_HOST_idle(void *context)
+{
+	return *((LINK_HOST_Type *)context)->command == LINK_APP_IDLE;
+}
@@ -0,0 +1,96 @@
+/******************************************************************************
+ *
+ * File Name: link_host.h
+ *
+ * Description: Test side of the link_hmi.c mailbox, and the CONTROL_ECU node
+ * with its saved password, shared by the host tests of the link.
+ *
+ *******************************************************************************/
+
+#ifndef LINK_HOST_H_
+#define LINK_HOST_H_
+
+#include "sim.h"
+#include "link_hmi.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+/* Returned by LINK_HOST_request when the command did not finish in time */
+#define LINK_HOST_TIMEOUT           0x100
+
+/* Password saved in the CONTROL_ECU EEPROM by LINK_HOST_addControl */
+#define LINK_HOST_PASSWORD_ADDRESS  0x0311
+/* Door parameters block and its CRC-8, PARAMS_EEPROM_ADDRESS of the CONTROL_ECU main.c */
+#define LINK_HOST_PARAMS_ADDRESS    0x0320
+extern const uint8_t LINK_HOST_password[5];
+
+/*******************************************************************************
+ *                               Types Declaration                             *
+ *******************************************************************************/
+typedef struct
+{
+	SIM_NodeType *node;
+	volatile uint8_t *command;
+	volatile uint8_t *type;
+	volatile uint8_t *payload;
+	volatile uint8_t *length;
+	volatile uint8_t *rate;
+	volatile uint8_t *result;
+	volatile uint8_t *reply;
+	volatile uint8_t *replyLength;
+	volatile uint16_t *notifyCount;
+	volatile uint8_t *notifyType;
+	volatile uint8_t *notify;
+}LINK_HOST_Type;
+
+/*******************************************************************************
+ *                      Functions Prototypes                                   *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Add the HMI side of the link as a node and find its mailbox.
+ */
+void LINK_HOST_addHmi(LINK_HOST_Type *link, const char *path);
+
+/*
+ * Description :
+ * Add the CONTROL_ECU as a node with LINK_HOST_password saved in its EEPROM.
+ */
+SIM_NodeType *LINK_HOST_addControl(const char *path);
+
+/*
+ * Description :
+ * Save a door parameters block of PARAMS_SIZE bytes and its CRC-8 in the CONTROL_ECU EEPROM,
+ * before the node boots.
+ */
+void LINK_HOST_setParams(SIM_NodeType *node, const uint8_t *params, uint8_t size);
+
+/*
+ * Description :
+ * Find the mailbox again after SIM_resetNode of the HMI side.
+ */
+void LINK_HOST_attach(LINK_HOST_Type *link);
+
+/*
+ * Description :
+ * Run one mailbox command to its end. Return non zero if it ended before the timeout.
+ */
+int LINK_HOST_run(LINK_HOST_Type *link, uint8_t command, uint64_t timeout_ns);
+
+/*
+ * Description :
+ * Send a request and wait for its reply. Return the reply type, LINK_LOST, or
+ * LINK_HOST_TIMEOUT if the request did not end before the timeout.
+ */
+uint16_t LINK_HOST_request(LINK_HOST_Type *link, uint8_t type, const uint8_t *payload, uint8_t length,
+		uint64_t timeout_ns);
+
+/*
+ * Description :
+ * Move the link to a rate of the UART table. Return the rate in use at the end.
+ */
+uint8_t LINK_HOST_setRate(LINK_HOST_Type *link, uint8_t rate);
+
+#endif /* LINK_HOST_H_ */
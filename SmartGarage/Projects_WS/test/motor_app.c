@@ -0,0 +1,81 @@
+/******************************************************************************
+ *
+ * File Name: motor_app.c
+ *
+ * Description: DC motor application for the host tests, built with the CONTROL_ECU
+ * DC motor, PWM, ADC and scheduler drivers. The test writes one command in the
+ * mailbox below and waits until g_command goes back to MOTOR_APP_IDLE.
+ * The main loop runs the scheduler dispatcher between the commands.
+ *
+ *******************************************************************************/
+
+#include "motor_app.h"
+#include "dc_motor.h"
+#include "scheduler.h"
+#include <avr/io.h>
+
+/*******************************************************************************
+ *                             Global Variables                                *
+ *******************************************************************************/
+volatile uint8 g_command = MOTOR_APP_IDLE;
+volatile uint8 g_state;
+volatile uint8 g_speed;
+DcMotor_ProfileType g_profile;
+
+/* Profile done call backs since the start */
+volatile uint16 g_doneCount = 0;
+
+/* Scheduler timers taken by MOTOR_APP_FILL_TIMERS */
+volatile uint8 g_filledTimers = 0;
+
+/*******************************************************************************
+ *                      Functions Prototypes(Private)                          *
+ *******************************************************************************/
+static void Motor_profileDone(void);
+static void Motor_timerFiller(void);
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
+
+int motor_main(void)
+{
+	DcMotor_Init();
+	SCHEDULER_init();
+	SREG |= (1<<7);
+
+	while(1)
+	{
+		SCHEDULER_dispatch();
+		switch(g_command)
+		{
+		case MOTOR_APP_ROTATE:
+			DcMotor_Rotate((DcMotor_State)g_state, g_speed);
+			break;
+		case MOTOR_APP_PROFILE:
+			DcMotor_startProfile((DcMotor_State)g_state, &g_profile, Motor_profileDone);
+			break;
+		case MOTOR_APP_CLEAR_FAULT:
+			DcMotor_clearFault();
+			break;
+		case MOTOR_APP_FILL_TIMERS:
+			while(SCHEDULER_startTimer(60000, SCHEDULER_ONE_SHOT, Motor_timerFiller) != SCHEDULER_NO_TIMER)
+			{
+				g_filledTimers++;
+			}
+			break;
+		default:
+			continue;
+		}
+		g_command = MOTOR_APP_IDLE;
+	}
+}
+
+static void Motor_profileDone(void)
+{
+	g_doneCount++;
+}
+
+static void Motor_timerFiller(void)
+{
+}
@@ -0,0 +1,21 @@
+/******************************************************************************
+ *
+ * File Name: motor_app.h
+ *
+ * Description: Mailbox commands of the DC motor application used by the host tests.
+ *
+ *******************************************************************************/
+
+#ifndef MOTOR_APP_H_
+#define MOTOR_APP_H_
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+#define MOTOR_APP_IDLE              0
+#define MOTOR_APP_ROTATE            1   /* g_state, g_speed */
+#define MOTOR_APP_PROFILE           2   /* g_state, g_profile --> g_doneCount at its end */
+#define MOTOR_APP_CLEAR_FAULT       3
+#define MOTOR_APP_FILL_TIMERS       4   /* take every free scheduler timer --> g_filledTimers */
+
+#endif /* MOTOR_APP_H_ */
@@ -0,0 +1,214 @@
+/******************************************************************************
+ *
+ * File Name: plant.c
+ *
+ * Description: Model of the garage door driven by the CONTROL_ECU, for the host tests.
+ *
+ *******************************************************************************/
+
+#include "plant.h"
+#include <math.h>
+
+/*******************************************************************************
+ *                      Functions Prototypes(Private)                          *
+ *******************************************************************************/
+static void PLANT_update(void *context, uint64_t now);
+static void PLANT_readMotor(PLANT_Type *plant, uint64_t now);
+static void PLANT_move(PLANT_Type *plant, double dt);
+static void PLANT_writeInputs(PLANT_Type *plant, uint64_t now);
+static uint16_t PLANT_current(SIM_NodeType *node, uint8_t channel, void *context);
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
+
+void PLANT_init(PLANT_Type *plant, SIM_NodeType *node, double position, uint8_t sensors)
+{
+	plant->node = node;
+	plant->sensors = sensors;
+	plant->obstacle = 0;
+	plant->obstacleTime = 0;
+	plant->jam = PLANT_NO_JAM;
+	plant->drive = PLANT_COAST;
+	plant->direction = 0;
+	plant->duty = 0;
+	plant->driveTime = SIM_now();
+	plant->position = position;
+	plant->speed = 0;
+	plant->count = (int32_t)floor(position);
+	plant->pulses = 0;
+	plant->pluggings = 0;
+	plant->plugging = 0;
+	plant->endStops = 0;
+	plant->endStopSpeed = 0;
+	plant->last = SIM_now();
+
+	node->adcInput = PLANT_current;
+	node->adcContext = plant;
+	PLANT_writeInputs(plant, SIM_now());
+	SIM_addDevice(PLANT_update, plant);
+}
+
+int PLANT_isDriven(void *context)
+{
+	return ((PLANT_Type *)context)->drive == PLANT_DRIVE;
+}
+
+int PLANT_isStopped(void *context)
+{
+	PLANT_Type *plant = (PLANT_Type *)context;
+
+	return (plant->drive != PLANT_DRIVE) && (fabs(plant->speed) < PLANT_STILL_SPEED);
+}
+
+static void PLANT_update(void *context, uint64_t now)
+{
+	PLANT_Type *plant = (PLANT_Type *)context;
+
+	PLANT_readMotor(plant, now);
+	PLANT_move(plant, (double)(now - plant->last) * 1e-9);
+	PLANT_writeInputs(plant, now);
+	plant->last = now;
+}
+
+/*
+ * Description :
+ * Read the H-bridge inputs and the enable. Fast PWM non inverting keeps OC0 high for
+ * OCR0 + 1 counts of 256 while COM01 connects it, PB3 gives the enable otherwise.
+ */
+static void PLANT_readMotor(PLANT_Type *plant, uint64_t now)
+{
+	const volatile uint8_t *reg = plant->node->reg8;
+	uint8_t in1 = reg[STUB_PORTB] & 0x01;
+	uint8_t in2 = (reg[STUB_PORTB] >> 1) & 0x01;
+	PLANT_DriveType drive;
+	int8_t direction = 0;
+	double duty;
+
+	if(reg[STUB_TCCR0] & (1<<COM01))
+	{
+		duty = (reg[STUB_OCR0] + 1) / 256.0;
+	}
+	else
+	{
+		duty = (reg[STUB_PORTB] & (1<<3)) ? 1.0 : 0.0;
+	}
+
+	if(duty == 0)
+	{
+		drive = PLANT_COAST;
+	}
+	else if(in1 == in2)
+	{
+		drive = PLANT_BRAKE;
+	}
+	else
+	{
+		drive = PLANT_DRIVE;
+		direction = in2 ? 1 : -1;
+	}
+
+	if((drive != plant->drive) || (direction != plant->direction))
+	{
+		plant->driveTime = now;
+	}
+	plant->drive = drive;
+	plant->direction = direction;
+	plant->duty = duty;
+}
+
+/*
+ * Description :
+ * Move the door for dt seconds, with its jam and its end stops.
+ */
+static void PLANT_move(PLANT_Type *plant, double dt)
+{
+	double old = plant->position;
+	int plugging;
+
+	switch(plant->drive)
+	{
+	case PLANT_DRIVE:
+		plant->speed += (plant->direction * plant->duty * PLANT_MAX_SPEED - plant->speed) * dt / PLANT_DRIVE_TAU_S;
+		break;
+	case PLANT_BRAKE:
+		plant->speed -= plant->speed * plant->duty * dt / PLANT_BRAKE_TAU_S;
+		break;
+	default:
+		plant->speed -= plant->speed * dt / PLANT_COAST_TAU_S;
+		break;
+	}
+	plant->position += plant->speed * dt;
+
+	plugging = (plant->drive == PLANT_DRIVE) && ((plant->direction * plant->speed) < -PLANT_PLUGGING_SPEED);
+	if(plugging && !plant->plugging)
+	{
+		plant->pluggings++;
+	}
+	plant->plugging = (uint8_t)plugging;
+
+	if((plant->jam != PLANT_NO_JAM) && (old >= plant->jam) && (plant->position < plant->jam))
+	{
+		plant->position = plant->jam;
+		plant->speed = 0;
+	}
+	if((plant->position > PLANT_TRAVEL_COUNTS + PLANT_OVERTRAVEL_COUNTS) || (plant->position < -PLANT_OVERTRAVEL_COUNTS))
+	{
+		plant->position = (plant->position > 0) ? (PLANT_TRAVEL_COUNTS + PLANT_OVERTRAVEL_COUNTS) : -PLANT_OVERTRAVEL_COUNTS;
+		plant->endStops++;
+		if(fabs(plant->speed) > plant->endStopSpeed)
+		{
+			plant->endStopSpeed = fabs(plant->speed);
+		}
+		plant->speed = 0;
+	}
+}
+
+/*
+ * Description :
+ * Give one encoder pulse for each count crossed, and the levels of the switches and the beam.
+ */
+static void PLANT_writeInputs(PLANT_Type *plant, uint64_t now)
+{
+	int32_t count = (int32_t)floor(plant->position);
+
+	while(count != plant->count)
+	{
+		plant->count += (count > plant->count) ? 1 : -1;
+		plant->pulses++;
+		if(plant->sensors & PLANT_ENCODER)
+		{
+			SIM_setPin(plant->node, STUB_PIND, 2, 0);
+			SIM_setPin(plant->node, STUB_PIND, 2, 1);
+		}
+	}
+	if(plant->sensors & PLANT_SWITCHES)
+	{
+		SIM_setPin(plant->node, STUB_PIND, 4, plant->position < PLANT_TRAVEL_COUNTS);
+		SIM_setPin(plant->node, STUB_PIND, 5, plant->position > 0);
+	}
+	if(((plant->node->reg8[STUB_PIND] >> 3) & 1) == plant->obstacle)
+	{
+		plant->obstacleTime = now;
+		SIM_setPin(plant->node, STUB_PIND, 3, !plant->obstacle);
+	}
+}
+
+/*
+ * Description :
+ * ADC input of the shunt: the current of a driven motor grows with the gap between
+ * the drive and the speed, the back EMF of a braked or coasting motor is not measured.
+ */
+static uint16_t PLANT_current(SIM_NodeType *node, uint8_t channel, void *context)
+{
+	PLANT_Type *plant = (PLANT_Type *)context;
+	double gap;
+
+	(void)node;
+	if((channel != 0) || (plant->drive != PLANT_DRIVE))
+	{
+		return 0;
+	}
+	gap = fabs(plant->direction * plant->duty - plant->speed / PLANT_MAX_SPEED);
+	return (uint16_t)(PLANT_LOAD_CURRENT + (PLANT_STALL_CURRENT - PLANT_LOAD_CURRENT) * gap);
+}
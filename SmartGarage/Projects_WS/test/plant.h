@@ -0,0 +1,102 @@
+/******************************************************************************
+ *
+ * File Name: plant.h
+ *
+ * Description: Model of the garage door driven by the CONTROL_ECU, for the host tests.
+ *
+ * The motor is read from the H-bridge inputs on PB0/PB1 and the enable on OC0/PB3:
+ * the enable high with the inputs apart drives the door, with the inputs equal it
+ * brakes, the enable low lets the door coast. The speed follows the drive with a first
+ * order lag. The door moves its encoder on PD2/INT0, presses the limit switches on PD4
+ * (open) and PD5 (closed) at the ends of the travel, and stops on its end stops a few
+ * counts further. The obstacle beam is on PD3/INT1. The motor current is given to the
+ * ADC in counts of the shunt voltage.
+ *
+ *******************************************************************************/
+
+#ifndef PLANT_H_
+#define PLANT_H_
+
+#include "sim.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+#define PLANT_TRAVEL_COUNTS         1200        /* Closed to open, between the two limit switches */
+#define PLANT_OVERTRAVEL_COUNTS     30          /* Switch to end stop */
+#define PLANT_MAX_SPEED             400.0       /* Counts/s at 100% duty */
+#define PLANT_DRIVE_TAU_S           0.15
+#define PLANT_BRAKE_TAU_S           0.02
+#define PLANT_COAST_TAU_S           0.3
+#define PLANT_STILL_SPEED           0.5         /* Counts/s taken as standstill */
+
+/* Shunt ADC counts: running at the load, and at standstill with 100% duty */
+#define PLANT_LOAD_CURRENT          25
+#define PLANT_STALL_CURRENT         130
+
+/* A drive against the motion faster than this is counted as a plugging reversal */
+#define PLANT_PLUGGING_SPEED        (0.1 * PLANT_MAX_SPEED)
+
+/* Sensors fitted on the door */
+#define PLANT_ENCODER               0x01
+#define PLANT_SWITCHES              0x02
+
+#define PLANT_NO_JAM                (-1.0)
+
+/*******************************************************************************
+ *                               Types Declaration                             *
+ *******************************************************************************/
+typedef enum
+{
+	PLANT_COAST,PLANT_DRIVE,PLANT_BRAKE
+}PLANT_DriveType;
+
+typedef struct
+{
+	SIM_NodeType *node;
+	/* Set by the test */
+	uint8_t sensors;
+	uint8_t obstacle;
+	uint64_t obstacleTime;              /* Time the beam pin changed last */
+	double jam;                         /* Something under the door: it cannot close below, PLANT_NO_JAM for none */
+	/* Motor read from the outputs of the last quantum */
+	PLANT_DriveType drive;
+	int8_t direction;                   /* +1 opens, -1 closes */
+	double duty;
+	uint64_t driveTime;                 /* Time the drive changed last */
+	/* Door */
+	double position;                    /* Counts from the closed switch */
+	double speed;                       /* Counts/s, positive while opening */
+	int32_t count;                      /* Position of the last encoder pulse */
+	uint32_t pulses;
+	uint32_t pluggings;
+	uint8_t plugging;
+	uint32_t endStops;                  /* Times the door ran into an end stop */
+	double endStopSpeed;                /* Fastest of them */
+	uint64_t last;
+}PLANT_Type;
+
+/*******************************************************************************
+ *                      Functions Prototypes                                   *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Put the door at a position with the given sensors, wire it to the node and add it to the
+ * simulation. Call it after SIM_addNode, before the node runs.
+ */
+void PLANT_init(PLANT_Type *plant, SIM_NodeType *node, double position, uint8_t sensors);
+
+/*
+ * Description :
+ * Return non zero while the motor is driven in a direction, the context is the plant.
+ */
+int PLANT_isDriven(void *context);
+
+/*
+ * Description :
+ * Return non zero once the door stands still with the motor not driven, the context is the plant.
+ */
+int PLANT_isStopped(void *context);
+
+#endif /* PLANT_H_ */
@@ -0,0 +1,146 @@
+/******************************************************************************
+ *
+ * File Name: sched_app.c
+ *
+ * Description: Scheduler application for the host tests, built with the CONTROL_ECU
+ * scheduler and timer drivers. The test writes one command in the mailbox below and
+ * waits until g_command goes back to SCHED_APP_IDLE. The main loop runs the scheduler
+ * dispatcher between the commands, each timer call back logs its tag and the time.
+ *
+ *******************************************************************************/
+
+#include "sched_app.h"
+#include "scheduler.h"
+#include <avr/io.h>
+#include <util/delay.h>
+
+/*******************************************************************************
+ *                             Global Variables                                *
+ *******************************************************************************/
+volatile uint8 g_command = SCHED_APP_IDLE;
+volatile uint16 g_time;
+volatile uint8 g_mode;
+volatile uint8 g_tag;
+volatile uint8 g_id;
+volatile uint32 g_now;
+volatile uint32 g_start;
+volatile uint32 g_timeout;
+volatile uint32 g_elapsed;
+volatile uint8 g_isTimeout;
+SCHEDULER_IsrTimeType g_isrTime;
+
+SCHED_APP_CallType g_log[SCHED_APP_LOG_SIZE];
+volatile uint16 g_logCount = 0;
+
+/*******************************************************************************
+ *                      Functions Prototypes(Private)                          *
+ *******************************************************************************/
+static void Sched_log(uint8 tag);
+static void Sched_call0(void);
+static void Sched_call1(void);
+static void Sched_call2(void);
+static void Sched_call3(void);
+static void Sched_call4(void);
+static void Sched_call5(void);
+static void Sched_call6(void);
+static void Sched_call7(void);
+
+/* Call back of each tag */
+static void (*const g_callBacks[SCHED_APP_TAGS])(void) =
+{
+	Sched_call0,Sched_call1,Sched_call2,Sched_call3,Sched_call4,Sched_call5,Sched_call6,Sched_call7
+};
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
+
+int sched_main(void)
+{
+	SCHEDULER_init();
+	SREG |= (1<<7);
+
+	while(1)
+	{
+		SCHEDULER_dispatch();
+		switch(g_command)
+		{
+		case SCHED_APP_START:
+			g_now = SCHEDULER_getMillis();
+			g_id = SCHEDULER_startTimer(g_time, (SCHEDULER_TimerMode)g_mode, g_callBacks[g_tag]);
+			break;
+		case SCHED_APP_ISR_TIME:
+			SCHEDULER_getIsrTime(&g_isrTime);
+			break;
+		case SCHED_APP_STOP:
+			SCHEDULER_stopTimer(g_id);
+			break;
+		case SCHED_APP_ELAPSED:
+			g_now = SCHEDULER_getMillis();
+			g_elapsed = SCHEDULER_elapsedMs(g_start);
+			g_isTimeout = SCHEDULER_isTimeout(g_start, g_timeout);
+			break;
+		case SCHED_APP_BUSY:
+			_delay_ms(g_time);
+			break;
+		case SCHED_APP_MASK:
+			SREG &= ~(1<<7);
+			_delay_us(SCHED_APP_MASK_US);
+			SREG |= (1<<7);
+			break;
+		default:
+			continue;
+		}
+		g_command = SCHED_APP_IDLE;
+	}
+}
+
+static void Sched_log(uint8 tag)
+{
+	if(g_logCount < SCHED_APP_LOG_SIZE)
+	{
+		g_log[g_logCount].tag = tag;
+		g_log[g_logCount].millis = SCHEDULER_getMillis();
+		g_logCount++;
+	}
+}
+
+static void Sched_call0(void)
+{
+	Sched_log(0);
+}
+
+static void Sched_call1(void)
+{
+	Sched_log(1);
+}
+
+static void Sched_call2(void)
+{
+	Sched_log(2);
+}
+
+static void Sched_call3(void)
+{
+	Sched_log(3);
+}
+
+static void Sched_call4(void)
+{
+	Sched_log(4);
+}
+
+static void Sched_call5(void)
+{
+	Sched_log(5);
+}
+
+static void Sched_call6(void)
+{
+	Sched_log(6);
+}
+
+static void Sched_call7(void)
+{
+	Sched_log(7);
+}
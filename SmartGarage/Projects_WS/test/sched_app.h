@@ -0,0 +1,41 @@
+/******************************************************************************
+ *
+ * File Name: sched_app.h
+ *
+ * Description: Mailbox commands of the scheduler application used by the host tests.
+ *
+ *******************************************************************************/
+
+#ifndef SCHED_APP_H_
+#define SCHED_APP_H_
+
+#include "std_types.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+#define SCHED_APP_LOG_SIZE          4096
+#define SCHED_APP_TAGS              8
+/* One tick with the interrupts off, the compare match in it waits until the end */
+#define SCHED_APP_MASK_US           1000
+
+#define SCHED_APP_IDLE              0
+#define SCHED_APP_START             1   /* g_time, g_mode, g_tag --> g_id, g_now, each call logged in g_log */
+#define SCHED_APP_ISR_TIME          2   /* --> g_isrTime */
+#define SCHED_APP_MASK              3   /* interrupts off for SCHED_APP_MASK_US */
+#define SCHED_APP_STOP              4   /* g_id */
+#define SCHED_APP_ELAPSED           5   /* g_start, g_timeout --> g_now, g_elapsed, g_isTimeout */
+#define SCHED_APP_BUSY              6   /* the main loop is held for g_time ms, the dispatcher runs late */
+
+/*******************************************************************************
+ *                               Types Declaration                             *
+ *******************************************************************************/
+
+/* One call back: the tag of its timer and SCHEDULER_getMillis in it */
+typedef struct
+{
+	uint8 tag;
+	uint32 millis;
+}SCHED_APP_CallType;
+
+#endif /* SCHED_APP_H_ */
@@ -0,0 +1,1214 @@
+/******************************************************************************
+ *
+ * Module: SIM
+ *
+ * File Name: sim.c
+ *
+ * Description: Host simulator of the ATmega32 ECUs for the tests.
+ *
+ *******************************************************************************/
+
+#define _GNU_SOURCE
+#include "sim.h"
+#include <dlfcn.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+#define SIM_FOREVER                 UINT64_MAX
+
+/* RX decoder states */
+#define SIM_RX_WAIT_HIGH            0
+#define SIM_RX_IDLE                 1
+#define SIM_RX_FRAME                2
+
+/* TWI phases of the EEPROM */
+#define SIM_TWI_IDLE                0
+#define SIM_TWI_DEVICE              1
+#define SIM_TWI_ADDRESS             2
+#define SIM_TWI_WRITE               3
+#define SIM_TWI_READ                4
+
+/* Reserved TWCR bit used to mark an operation as done */
+#define SIM_TWI_DONE_MARK           (1<<1)
+
+/*******************************************************************************
+ *                           Global Variables                                  *
+ *******************************************************************************/
+static const char *const g_vectorNames[SIM_VECTOR_COUNT] =
+{
+	"INT0_vect","INT1_vect","TIMER2_COMP_vect","TIMER1_COMPA_vect","TIMER0_COMP_vect",
+	"USART_RXC_vect","USART_UDRE_vect","ADC_vect"
+};
+
+/* Clock prescalers of Timer0 and Timer1 by their CS bits */
+static const uint16_t g_prescalers01[8] = {0, 1, 8, 64, 256, 1024, 0, 0};
+
+static uint64_t g_now;
+static uint64_t g_sliceEnd;
+static ucontext_t g_mainContext;
+static SIM_NodeType g_nodes[SIM_MAX_NODES];
+static uint8_t g_nodeCount;
+static SIM_PeerType g_peers[SIM_MAX_PEERS];
+static uint8_t g_peerCount;
+static void (*g_devices[SIM_MAX_DEVICES])(void *context, uint64_t now);
+static void *g_deviceContexts[SIM_MAX_DEVICES];
+static uint8_t g_deviceCount;
+static int g_checks;
+static int g_failures;
+
+/*******************************************************************************
+ *                      Functions Prototypes(Private)                          *
+ *******************************************************************************/
+static void SIM_load(SIM_NodeType *node);
+static void SIM_nodeStart(int index);
+static void SIM_hook(void *context, int event, uint32_t ns);
+static void SIM_spend(SIM_NodeType *node, uint64_t ns);
+static void SIM_yield(SIM_NodeType *node);
+static int SIM_pending(const SIM_NodeType *node);
+static int SIM_external(const SIM_NodeType *node, int vector);
+static int SIM_canWake(const SIM_NodeType *node);
+static void SIM_takeInterrupts(SIM_NodeType *node);
+static void SIM_clearFlags(SIM_NodeType *node);
+static void SIM_twiAccess(SIM_NodeType *node);
+static void SIM_step(void);
+static void SIM_updateTimers(SIM_NodeType *node, uint64_t now);
+static void SIM_timer1Count(SIM_NodeType *node);
+static void SIM_updateAdc(SIM_NodeType *node, uint64_t now);
+static uint8_t SIM_lineLevel(const SIM_LineType *line, uint64_t time);
+static int SIM_lineBusy(const SIM_LineType *line, uint64_t time);
+static void SIM_txPush(SIM_TxType *tx, uint8_t data, uint64_t time, uint32_t bit_ns);
+static void SIM_txUpdate(SIM_TxType *tx, uint64_t now);
+static void SIM_rxUpdate(SIM_RxType *rx, uint32_t bit_ns, uint64_t now);
+static void SIM_nodeReceive(void *owner, uint8_t data, uint8_t frame_error, uint64_t time);
+static void SIM_peerReceive(void *owner, uint8_t data, uint8_t frame_error, uint64_t time);
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
+
+void SIM_init(void)
+{
+	uint8_t i;
+
+	for(i = 0 ; i < g_nodeCount ; i++)
+	{
+		dlclose(g_nodes[i].library);
+		free(g_nodes[i].stack);
+	}
+	memset(g_nodes, 0, sizeof(g_nodes));
+	memset(g_peers, 0, sizeof(g_peers));
+	g_nodeCount = 0;
+	g_peerCount = 0;
+	g_deviceCount = 0;
+	g_now = 0;
+}
+
+SIM_NodeType *SIM_addNode(const char *name, const char *path, const char *entry)
+{
+	SIM_NodeType *node = &g_nodes[g_nodeCount++];
+
+	node->name = name;
+	snprintf(node->path, sizeof(node->path), "%s", path);
+	node->entryName = entry;
+	memset(node->eeprom, 0xFF, sizeof(node->eeprom));
+	SIM_load(node);
+	return node;
+}
+
+void SIM_resetNode(SIM_NodeType *node)
+{
+	uint8_t i;
+
+	/* The TX pin is released at once, the byte on the line is cut */
+	for(i = 0 ; i < SIM_LINE_FRAMES ; i++)
+	{
+		if(node->tx.line.cut[i] > g_now)
+		{
+			node->tx.line.cut[i] = g_now;
+		}
+	}
+	node->tx.count = 0;
+	node->tx.faultCount = 0;
+	node->rxCount = 0;
+	node->rxOverrun = 0;
+
+	dlclose(node->library);
+	free(node->stack);
+	SIM_load(node);
+}
+
+void SIM_connect(SIM_NodeType *a, SIM_NodeType *b)
+{
+	a->rx.line = &b->tx.line;
+	b->rx.line = &a->tx.line;
+}
+
+SIM_PeerType *SIM_addPeer(SIM_NodeType *node, uint32_t bit_ns)
+{
+	SIM_PeerType *peer = &g_peers[g_peerCount++];
+
+	peer->bit_ns = bit_ns;
+	peer->rx.line = &node->tx.line;
+	peer->rx.done = SIM_peerReceive;
+	peer->rx.owner = peer;
+	node->rx.line = &peer->tx.line;
+	return peer;
+}
+
+void SIM_peerSend(SIM_PeerType *peer, const uint8_t *data, uint16_t size)
+{
+	uint16_t i;
+
+	for(i = 0 ; i < size ; i++)
+	{
+		SIM_txPush(&peer->tx, data[i], g_now, peer->bit_ns);
+	}
+}
+
+void SIM_peerSendFrame(SIM_PeerType *peer, uint8_t type, uint8_t seq, const uint8_t *payload, uint8_t length)
+{
+	uint8_t frame[32];
+	uint8_t size = 0;
+	uint8_t crc = 0;
+	uint8_t i;
+
+	frame[size++] = 0x7E;
+	frame[size++] = type;
+	frame[size++] = seq;
+	frame[size++] = length;
+	for(i = 0 ; i < length ; i++)
+	{
+		frame[size++] = payload[i];
+	}
+	for(i = 1 ; i < size ; i++)
+	{
+		crc = SIM_crc8(crc, frame[i]);
+	}
+	frame[size++] = crc;
+	SIM_peerSend(peer, frame, size);
+}
+
+int SIM_peerNextFrame(const SIM_PeerType *peer, uint32_t *from, uint8_t *type, uint8_t *seq,
+		uint8_t *payload, uint8_t *length, uint64_t *time)
+{
+	uint32_t start;
+	uint32_t i;
+	uint8_t crc;
+	uint8_t size;
+
+	for(start = *from ; start + 5 <= peer->logCount ; start++)
+	{
+		if((peer->log[start] != 0x7E) || peer->logError[start] || (peer->log[start + 3] > 10))
+		{
+			continue;
+		}
+		size = 5 + peer->log[start + 3];
+		if(start + size > peer->logCount)
+		{
+			return 0;
+		}
+		crc = 0;
+		for(i = 1 ; i < (uint32_t)size - 1 ; i++)
+		{
+			crc = SIM_crc8(crc, peer->log[start + i]);
+		}
+		if(crc != peer->log[start + size - 1])
+		{
+			continue;
+		}
+		*type = peer->log[start + 1];
+		*seq = peer->log[start + 2];
+		*length = peer->log[start + 3];
+		for(i = 0 ; i < *length ; i++)
+		{
+			payload[i] = peer->log[start + 4 + i];
+		}
+		*time = peer->logTime[start + size - 1];
+		*from = start + size;
+		return 1;
+	}
+	return 0;
+}
+
+void SIM_peerClearLog(SIM_PeerType *peer)
+{
+	peer->logCount = 0;
+}
+
+void SIM_addTxFault(SIM_TxType *tx, uint32_t index, SIM_FaultKind kind, uint8_t mask)
+{
+	SIM_FaultType *fault = &tx->faults[tx->faultCount++];
+
+	fault->index = tx->sent + index;
+	fault->kind = kind;
+	fault->mask = mask;
+}
+
+void SIM_addDevice(void (*update)(void *context, uint64_t now), void *context)
+{
+	g_devices[g_deviceCount] = update;
+	g_deviceContexts[g_deviceCount] = context;
+	g_deviceCount++;
+}
+
+void SIM_setPin(SIM_NodeType *node, int pin_register, uint8_t bit, uint8_t level)
+{
+	uint8_t old = (node->reg8[pin_register] >> bit) & 1;
+	uint8_t sense;
+	int vector;
+
+	if(level)
+	{
+		node->reg8[pin_register] |= (uint8_t)(1 << bit);
+	}
+	else
+	{
+		node->reg8[pin_register] &= (uint8_t)~(1 << bit);
+	}
+	if((pin_register != STUB_PIND) || ((bit != 2) && (bit != 3)) || (old == level))
+	{
+		return;
+	}
+
+	/* INT0 on PD2 with ISC01:ISC00, INT1 on PD3 with ISC11:ISC10 */
+	vector = (bit == 2) ? SIM_INT0 : SIM_INT1;
+	sense = (node->reg8[STUB_MCUCR] >> ((bit == 2) ? 0 : 2)) & 3;
+	if(((sense == 1)) || ((sense == 2) && !level) || ((sense == 3) && level))
+	{
+		node->flags[vector] = 1;
+	}
+}
+
+void SIM_run(uint64_t duration_ns)
+{
+	uint64_t end = g_now + duration_ns;
+
+	while(g_now < end)
+	{
+		SIM_step();
+	}
+}
+
+int SIM_runUntil(int (*done)(void *context), void *context, uint64_t timeout_ns)
+{
+	uint64_t end = g_now + timeout_ns;
+
+	while(g_now < end)
+	{
+		if((*done)(context))
+		{
+			return 1;
+		}
+		SIM_step();
+	}
+	return (*done)(context);
+}
+
+uint64_t SIM_now(void)
+{
+	return g_now;
+}
+
+void *SIM_symbol(SIM_NodeType *node, const char *name)
+{
+	void *address = dlsym(node->library, name);
+
+	if(address == NULL)
+	{
+		fprintf(stderr, "%s: missing symbol %s\n", node->name, name);
+		exit(2);
+	}
+	return address;
+}
+
+uint32_t SIM_uartBitNs(const SIM_NodeType *node)
+{
+	uint32_t ubrr = ((uint32_t)(node->reg8[STUB_UBRRH] & 0x0F) << 8) | node->reg8[STUB_UBRRL];
+	uint32_t divider = (node->reg8[STUB_UCSRA] & (1<<U2X)) ? 8 : 16;
+
+	return (uint32_t)(((uint64_t)(ubrr + 1) * divider * 1000000000ULL) / SIM_CPU_HZ);
+}
+
+uint8_t SIM_crc8(uint8_t crc, uint8_t data)
+{
+	uint8_t bit;
+
+	crc ^= data;
+	for(bit = 0 ; bit < 8 ; bit++)
+	{
+		crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+	}
+	return crc;
+}
+
+void SIM_check(int passed, const char *file, int line, const char *format, ...)
+{
+	va_list args;
+
+	g_checks++;
+	printf("%s ", passed ? "ok  " : "FAIL");
+	va_start(args, format);
+	vprintf(format, args);
+	va_end(args);
+	if(!passed)
+	{
+		printf("  (%s:%d)", file, line);
+		g_failures++;
+	}
+	printf("\n");
+	fflush(stdout);
+}
+
+int SIM_exitCode(void)
+{
+	printf("%d checks, %d failed\n", g_checks, g_failures);
+	return (g_failures == 0) ? 0 : 1;
+}
+
+/*
+ * Description :
+ * Open the library of a node, clear its registers and start its coroutine.
+ */
+static void SIM_load(SIM_NodeType *node)
+{
+	void (*setHook)(STUB_HookType hook, void *context);
+	uint8_t i;
+
+	node->library = dlopen(node->path, RTLD_NOW | RTLD_LOCAL);
+	if(node->library == NULL)
+	{
+		fprintf(stderr, "%s\n", dlerror());
+		exit(2);
+	}
+	node->reg8 = SIM_symbol(node, "STUB_reg8");
+	node->reg16 = SIM_symbol(node, "STUB_reg16");
+	node->entry = (void (*)(void))SIM_symbol(node, node->entryName);
+	for(i = 0 ; i < SIM_VECTOR_COUNT ; i++)
+	{
+		node->vectors[i] = (void (*)(void))dlsym(node->library, g_vectorNames[i]);
+		node->flags[i] = 0;
+	}
+	setHook = (void (*)(STUB_HookType, void *))SIM_symbol(node, "STUB_setHook");
+	(*setHook)(SIM_hook, node);
+
+	/* Input pins read high until a model drives them */
+	node->reg8[STUB_PINA] = 0xFF;
+	node->reg8[STUB_PINB] = 0xFF;
+	node->reg8[STUB_PINC] = 0xFF;
+	node->reg8[STUB_PIND] = 0xFF;
+
+	node->clock = g_now;
+	node->running = 0;
+	node->inIsr = 0;
+	node->finished = 0;
+	node->sleepMode = SIM_AWAKE;
+	node->timerNext[0] = 0;
+	node->timerNext[1] = 0;
+	node->timerNext[2] = 0;
+	node->adcDone = 0;
+	node->twiPhase = SIM_TWI_IDLE;
+	node->rx.state = SIM_RX_WAIT_HIGH;
+	node->rx.nextSample = g_now;
+	node->rx.done = SIM_nodeReceive;
+	node->rx.owner = node;
+
+	node->stack = malloc(SIM_STACK_SIZE);
+	getcontext(&node->context);
+	node->context.uc_stack.ss_sp = node->stack;
+	node->context.uc_stack.ss_size = SIM_STACK_SIZE;
+	node->context.uc_link = NULL;
+	makecontext(&node->context, (void (*)(void))SIM_nodeStart, 1, (int)(node - g_nodes));
+}
+
+/*
+ * Description :
+ * First function of a node coroutine, the entry function of an ECU never returns.
+ */
+static void SIM_nodeStart(int index)
+{
+	SIM_NodeType *node = &g_nodes[index];
+
+	(*node->entry)();
+	node->finished = 1;
+	for(;;)
+	{
+		node->clock = SIM_FOREVER;
+		SIM_yield(node);
+	}
+}
+
+/*
+ * Description :
+ * Hook of the stub, runs in the node coroutine: charge the CPU time of the event,
+ * keep the peripherals in step with the registers and take the interrupts.
+ */
+static void SIM_hook(void *context, int event, uint32_t ns)
+{
+	SIM_NodeType *node = (SIM_NodeType *)context;
+	uint64_t left;
+
+	if(!node->running)
+	{
+		/* A test reads the ECU state from outside of the simulation */
+		return;
+	}
+	SIM_clearFlags(node);
+
+	if(event == STUB_EVENT_CALL)
+	{
+		SIM_spend(node, SIM_CALL_NS);
+	}
+	else if(event == STUB_EVENT_BLOCK)
+	{
+		SIM_spend(node, SIM_BLOCK_NS);
+	}
+	else if(event == STUB_EVENT_DELAY)
+	{
+		/* Interrupts are taken during a delay */
+		for(left = ns ; left != 0 ; )
+		{
+			uint64_t chunk = (left > SIM_QUANTUM_NS) ? SIM_QUANTUM_NS : left;
+			SIM_spend(node, chunk);
+			left -= chunk;
+		}
+	}
+	else if(event == STUB_EVENT_SLEEP)
+	{
+		node->sleepMode = ((node->reg8[STUB_MCUCR] & ((1<<SM2) | (1<<SM1) | (1<<SM0))) == (1<<SM1)) ?
+				SIM_SLEEP_POWER_DOWN : SIM_SLEEP_IDLE;
+		while(!SIM_canWake(node))
+		{
+			if(node->clock < g_sliceEnd)
+			{
+				node->sleepTime[node->sleepMode] += g_sliceEnd - node->clock;
+				node->clock = g_sliceEnd;
+			}
+			SIM_yield(node);
+		}
+		node->sleepMode = SIM_AWAKE;
+		SIM_spend(node, SIM_REGISTER_NS);
+	}
+	else
+	{
+		if((event == STUB_UDR) && (node->inIsr == SIM_USART_UDRE + 1))
+		{
+			node->udrWritten = 1;
+		}
+		else if(event == STUB_TWCR)
+		{
+			SIM_twiAccess(node);
+		}
+		else if(event == STUB_REG8_COUNT + STUB_TCNT1)
+		{
+			SIM_timer1Count(node);
+		}
+		node->accessTime[event] = node->clock;
+		SIM_spend(node, SIM_REGISTER_NS);
+	}
+}
+
+/*
+ * Description :
+ * Charge CPU time to a node, take its interrupts and give the CPU back at the end of the slice.
+ */
+static void SIM_spend(SIM_NodeType *node, uint64_t ns)
+{
+	node->clock += ns;
+	SIM_takeInterrupts(node);
+	while(node->clock >= g_sliceEnd)
+	{
+		SIM_yield(node);
+		SIM_takeInterrupts(node);
+	}
+}
+
+static void SIM_yield(SIM_NodeType *node)
+{
+	swapcontext(&node->context, &g_mainContext);
+}
+
+/*
+ * Description :
+ * Return the pending interrupt of the highest priority + 1, or 0.
+ */
+static int SIM_pending(const SIM_NodeType *node)
+{
+	const volatile uint8_t *reg = node->reg8;
+	int vector;
+	int enabled;
+
+	for(vector = 0 ; vector < SIM_VECTOR_COUNT ; vector++)
+	{
+		if(node->vectors[vector] == NULL)
+		{
+			continue;
+		}
+		switch(vector)
+		{
+		case SIM_INT0:
+			enabled = SIM_external(node, vector) && (reg[STUB_GICR] & (1<<INT0));
+			break;
+		case SIM_INT1:
+			enabled = SIM_external(node, vector) && (reg[STUB_GICR] & (1<<INT1));
+			break;
+		case SIM_TIMER2_COMP:
+			enabled = node->flags[vector] && (reg[STUB_TIMSK] & (1<<OCIE2));
+			break;
+		case SIM_TIMER1_COMPA:
+			enabled = node->flags[vector] && (reg[STUB_TIMSK] & (1<<OCIE1A));
+			break;
+		case SIM_TIMER0_COMP:
+			enabled = node->flags[vector] && (reg[STUB_TIMSK] & (1<<OCIE0));
+			break;
+		case SIM_USART_RXC:
+			enabled = (node->rxCount != 0) && (reg[STUB_UCSRB] & (1<<RXCIE));
+			break;
+		case SIM_USART_UDRE:
+			enabled = (node->tx.count == 0) && (reg[STUB_UCSRB] & (1<<UDRIE));
+			break;
+		default:
+			enabled = node->flags[vector] && (reg[STUB_ADCSRA] & (1<<ADIE));
+			break;
+		}
+		if(enabled)
+		{
+			return vector + 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Description :
+ * INT0/INT1 request: the pin is low for the low level sense, else the flag of the edge.
+ */
+static int SIM_external(const SIM_NodeType *node, int vector)
+{
+	uint8_t bit = (vector == SIM_INT0) ? 2 : 3;
+	uint8_t sense = (node->reg8[STUB_MCUCR] >> ((vector == SIM_INT0) ? 0 : 2)) & 3;
+
+	if(sense == 0)
+	{
+		return !(node->reg8[STUB_PIND] & (1 << bit));
+	}
+	return node->flags[vector];
+}
+
+/*
+ * Description :
+ * Return non zero if a pending interrupt ends the sleep of a node, only INT0/INT1 in power down.
+ */
+static int SIM_canWake(const SIM_NodeType *node)
+{
+	int vector = SIM_pending(node);
+
+	if(node->sleepMode == SIM_SLEEP_POWER_DOWN)
+	{
+		return (vector == SIM_INT0 + 1) || (vector == SIM_INT1 + 1);
+	}
+	return vector != 0;
+}
+
+/*
+ * Description :
+ * Run the pending interrupts while the I-bit is set, like the AVR between two instructions.
+ */
+static void SIM_takeInterrupts(SIM_NodeType *node)
+{
+	volatile uint8_t *reg = node->reg8;
+	int vector;
+	uint8_t i;
+
+	while(!node->inIsr && (reg[STUB_SREG] & 0x80) && ((vector = SIM_pending(node)) != 0))
+	{
+		vector--;
+		node->flags[vector] = 0;
+		if(vector == SIM_USART_RXC)
+		{
+			/* The flags of the byte are read from UCSRA before UDR */
+			reg[STUB_UDR] = node->rxData[0];
+			reg[STUB_UCSRA] = (uint8_t)((reg[STUB_UCSRA] & ~((1<<FE) | (1<<DOR) | (1<<PE))) |
+					(1<<RXC) | node->rxError[0]);
+			for(i = 1 ; i < node->rxCount ; i++)
+			{
+				node->rxData[i - 1] = node->rxData[i];
+				node->rxError[i - 1] = node->rxError[i];
+			}
+			node->rxCount--;
+		}
+		node->udrWritten = 0;
+		node->inIsr = (uint8_t)(vector + 1);
+		reg[STUB_SREG] &= 0x7F;
+		node->clock += SIM_ISR_NS;
+		node->isrCount[vector]++;
+		(*node->vectors[vector])();
+		reg[STUB_SREG] |= 0x80;
+		node->inIsr = 0;
+
+		if(vector == SIM_USART_RXC)
+		{
+			reg[STUB_UCSRA] &= (uint8_t)~(1<<RXC);
+		}
+		else if((vector == SIM_USART_UDRE) && node->udrWritten)
+		{
+			/* Writing UDR takes the TX buffer and clears TXC */
+			SIM_txPush(&node->tx, reg[STUB_UDR], node->clock, SIM_uartBitNs(node));
+			reg[STUB_UCSRA] &= (uint8_t)~(1<<TXC);
+		}
+	}
+}
+
+/*
+ * Description :
+ * Interrupt flags are cleared by writing one: take the ones written since the last event.
+ */
+static void SIM_clearFlags(SIM_NodeType *node)
+{
+	volatile uint8_t *reg = node->reg8;
+
+	if(reg[STUB_GIFR] != 0)
+	{
+		if(reg[STUB_GIFR] & (1<<INTF0))
+		{
+			node->flags[SIM_INT0] = 0;
+		}
+		if(reg[STUB_GIFR] & (1<<INTF1))
+		{
+			node->flags[SIM_INT1] = 0;
+		}
+		reg[STUB_GIFR] = 0;
+	}
+	if(reg[STUB_TIFR] != 0)
+	{
+		if(reg[STUB_TIFR] & (1<<OCF2))
+		{
+			node->flags[SIM_TIMER2_COMP] = 0;
+		}
+		if(reg[STUB_TIFR] & (1<<OCF1A))
+		{
+			node->flags[SIM_TIMER1_COMPA] = 0;
+		}
+		if(reg[STUB_TIFR] & (1<<OCF0))
+		{
+			node->flags[SIM_TIMER0_COMP] = 0;
+		}
+		reg[STUB_TIFR] = 0;
+	}
+	if(reg[STUB_ADCSRA] & (1<<ADIF))
+	{
+		node->flags[SIM_ADC] = 0;
+		reg[STUB_ADCSRA] &= (uint8_t)~(1<<ADIF);
+	}
+}
+
+/*
+ * Description :
+ * TWI master with a 24C16 EEPROM on the bus: an operation written in TWCR with TWINT
+ * is done when TWCR is accessed next, TWINT reads set and TWSR holds the status.
+ */
+static void SIM_twiAccess(SIM_NodeType *node)
+{
+	volatile uint8_t *reg = node->reg8;
+	uint8_t control = reg[STUB_TWCR];
+	uint8_t data = reg[STUB_TWDR];
+	uint8_t status = 0;
+
+	if(!(control & (1<<TWINT)) || (control & SIM_TWI_DONE_MARK))
+	{
+		return;
+	}
+	if(control & (1<<TWSTA))
+	{
+		status = (node->twiPhase == SIM_TWI_IDLE) ? 0x08 : 0x10;
+		node->twiPhase = SIM_TWI_DEVICE;
+	}
+	else if(control & (1<<TWSTO))
+	{
+		node->twiPhase = SIM_TWI_IDLE;
+		reg[STUB_TWCR] = (uint8_t)((control & ~(1<<TWSTO)) | SIM_TWI_DONE_MARK);
+		return;
+	}
+	else
+	{
+		switch(node->twiPhase)
+		{
+		case SIM_TWI_DEVICE:
+			if((data & 0xF0) == 0xA0)
+			{
+				node->twiAddress = (uint16_t)((node->twiAddress & 0xFF) | ((uint16_t)(data & 0x0E) << 7));
+				status = (data & 1) ? 0x40 : 0x18;
+				node->twiPhase = (data & 1) ? SIM_TWI_READ : SIM_TWI_ADDRESS;
+			}
+			else
+			{
+				status = (data & 1) ? 0x48 : 0x20;
+			}
+			break;
+		case SIM_TWI_ADDRESS:
+			node->twiAddress = (uint16_t)((node->twiAddress & 0x700) | data);
+			status = 0x28;
+			node->twiPhase = SIM_TWI_WRITE;
+			break;
+		case SIM_TWI_WRITE:
+			node->eeprom[node->twiAddress % SIM_EEPROM_SIZE] = data;
+			node->eepromWrites++;
+			node->twiAddress++;
+			status = 0x28;
+			break;
+		case SIM_TWI_READ:
+			reg[STUB_TWDR] = node->eeprom[node->twiAddress % SIM_EEPROM_SIZE];
+			node->twiAddress++;
+			status = (control & (1<<TWEA)) ? 0x50 : 0x58;
+			break;
+		default:
+			status = 0xF8;
+			break;
+		}
+	}
+	reg[STUB_TWSR] = (uint8_t)((reg[STUB_TWSR] & 0x07) | status);
+	reg[STUB_TWCR] = (uint8_t)(control | SIM_TWI_DONE_MARK);
+}
+
+/*
+ * Description :
+ * One quantum: run the nodes to the end of it, then bring the peripherals and the models to it.
+ */
+static void SIM_step(void)
+{
+	SIM_NodeType *node;
+	uint8_t i;
+
+	g_now += SIM_QUANTUM_NS;
+	g_sliceEnd = g_now;
+	for(i = 0 ; i < g_nodeCount ; i++)
+	{
+		node = &g_nodes[i];
+		if((node->sleepMode == SIM_SLEEP_POWER_DOWN) && !SIM_canWake(node))
+		{
+			/* Nothing runs in power down until a wake up interrupt */
+			node->sleepTime[SIM_SLEEP_POWER_DOWN] += g_now - node->clock;
+			node->clock = g_now;
+		}
+		else if(node->clock < g_now)
+		{
+			node->running = 1;
+			swapcontext(&g_mainContext, &node->context);
+			node->running = 0;
+		}
+	}
+
+	for(i = 0 ; i < g_nodeCount ; i++)
+	{
+		SIM_txUpdate(&g_nodes[i].tx, g_now);
+		if(g_nodes[i].tx.count == 0 && g_nodes[i].tx.shiftEnd <= g_now)
+		{
+			g_nodes[i].reg8[STUB_UCSRA] |= (1<<TXC);
+		}
+	}
+	for(i = 0 ; i < g_peerCount ; i++)
+	{
+		SIM_txUpdate(&g_peers[i].tx, g_now);
+	}
+	for(i = 0 ; i < g_nodeCount ; i++)
+	{
+		node = &g_nodes[i];
+		if((node->rx.line != NULL) && (node->reg8[STUB_UCSRB] & (1<<RXEN)) && (node->sleepMode != SIM_SLEEP_POWER_DOWN))
+		{
+			SIM_rxUpdate(&node->rx, SIM_uartBitNs(node), g_now);
+		}
+		else
+		{
+			node->rx.nextSample = g_now;
+			node->rx.state = SIM_RX_WAIT_HIGH;
+		}
+		SIM_updateTimers(node, g_now);
+		SIM_updateAdc(node, g_now);
+	}
+	for(i = 0 ; i < g_peerCount ; i++)
+	{
+		SIM_rxUpdate(&g_peers[i].rx, g_peers[i].bit_ns, g_now);
+	}
+	for(i = 0 ; i < g_deviceCount ; i++)
+	{
+		(*g_devices[i])(g_deviceContexts[i], g_now);
+	}
+}
+
+/*
+ * Description :
+ * Compare match flags of the three timers in CTC mode, stopped in power down.
+ */
+static void SIM_updateTimers(SIM_NodeType *node, uint64_t now)
+{
+	static const uint16_t prescalers2[8] = {0, 1, 8, 32, 64, 128, 256, 1024};
+	volatile uint8_t *reg = node->reg8;
+	uint64_t period[3] = {0, 0, 0};
+	const int vectors[3] = {SIM_TIMER0_COMP, SIM_TIMER1_COMPA, SIM_TIMER2_COMP};
+	uint8_t i;
+
+	if(node->sleepMode == SIM_SLEEP_POWER_DOWN)
+	{
+		/* The clocks stop, the timers go on from the same count after the wake up */
+		for(i = 0 ; i < 3 ; i++)
+		{
+			if(node->timerNext[i] != 0)
+			{
+				node->timerNext[i] += SIM_QUANTUM_NS;
+			}
+		}
+		return;
+	}
+	if((reg[STUB_TCCR0] & (1<<WGM01)) && !(reg[STUB_TCCR0] & (1<<WGM00)))
+	{
+		period[0] = (uint64_t)(reg[STUB_OCR0] + 1) * g_prescalers01[reg[STUB_TCCR0] & 7];
+	}
+	if(reg[STUB_TCCR1B] & (1<<WGM12))
+	{
+		period[1] = (uint64_t)(node->reg16[STUB_OCR1A] + 1UL) * g_prescalers01[reg[STUB_TCCR1B] & 7];
+	}
+	if(reg[STUB_TCCR2] & (1<<WGM21))
+	{
+		period[2] = (uint64_t)(reg[STUB_OCR2] + 1) * prescalers2[reg[STUB_TCCR2] & 7];
+	}
+
+	for(i = 0 ; i < 3 ; i++)
+	{
+		period[i] = period[i] * 1000000000ULL / SIM_CPU_HZ;
+		if(period[i] == 0)
+		{
+			node->timerNext[i] = 0;
+			continue;
+		}
+		if(node->timerNext[i] == 0)
+		{
+			node->timerNext[i] = now + period[i];
+		}
+		while(node->timerNext[i] <= now)
+		{
+			node->flags[vectors[i]] = 1;
+			node->timerNext[i] += period[i];
+		}
+	}
+}
+
+/*
+ * Description :
+ * TCNT1 in CTC mode, given before each access: the counts since the last compare match
+ * at the clock of the node. A write sets the register only until the next access.
+ */
+static void SIM_timer1Count(SIM_NodeType *node)
+{
+	uint64_t count_ns = (uint64_t)g_prescalers01[node->reg8[STUB_TCCR1B] & 7] * 1000000000ULL / SIM_CPU_HZ;
+	uint64_t period = (node->reg16[STUB_OCR1A] + 1ULL) * count_ns;
+	uint64_t match;
+
+	if((period == 0) || !(node->reg8[STUB_TCCR1B] & (1<<WGM12)) || (node->timerNext[1] < period))
+	{
+		return;
+	}
+	/* The flags are updated once a quantum, the node clock may be past the next match */
+	match = node->timerNext[1] - period;
+	node->reg16[STUB_TCNT1] = (node->clock > match) ? (uint16_t)(((node->clock - match) % period) / count_ns) : 0;
+}
+
+/*
+ * Description :
+ * ADC conversions of 13 ADC clocks, 25 for the first one after the start.
+ */
+static void SIM_updateAdc(SIM_NodeType *node, uint64_t now)
+{
+	volatile uint8_t *reg = node->reg8;
+	uint8_t control = reg[STUB_ADCSRA];
+	uint32_t division = 1U << (control & 7);
+	uint64_t clock_ns;
+
+	if(division == 1)
+	{
+		division = 2;
+	}
+	clock_ns = (uint64_t)division * 1000000000ULL / SIM_CPU_HZ;
+
+	if(!(control & (1<<ADEN)) || (!(control & (1<<ADSC)) && (node->adcDone == 0)))
+	{
+		node->adcDone = 0;
+		return;
+	}
+	if(node->adcDone == 0)
+	{
+		node->adcDone = now + 25 * clock_ns;
+	}
+	while((node->adcDone != 0) && (node->adcDone <= now))
+	{
+		uint8_t channel = reg[STUB_ADMUX] & 0x07;
+		node->reg16[STUB_ADC] = (node->adcInput != NULL) ? (*node->adcInput)(node, channel, node->adcContext) : 0;
+		node->flags[SIM_ADC] = 1;
+		if(reg[STUB_ADCSRA] & (1<<ADATE))
+		{
+			node->adcDone += 13 * clock_ns;
+		}
+		else
+		{
+			reg[STUB_ADCSRA] &= (uint8_t)~(1<<ADSC);
+			node->adcDone = 0;
+		}
+	}
+}
+
+/*
+ * Description :
+ * Level of a line at a time: start bit low, 8 data bits LSB first, stop bit high.
+ */
+static uint8_t SIM_lineLevel(const SIM_LineType *line, uint64_t time)
+{
+	uint8_t i;
+	uint64_t bit;
+
+	for(i = 0 ; i < SIM_LINE_FRAMES ; i++)
+	{
+		if((line->bit_ns[i] == 0) || (time < line->start[i]) || (time >= line->cut[i]))
+		{
+			continue;
+		}
+		bit = (time - line->start[i]) / line->bit_ns[i];
+		if(bit == 0)
+		{
+			return 0;
+		}
+		if(bit <= 8)
+		{
+			return (line->value[i] >> (bit - 1)) & 1;
+		}
+	}
+	return 1;
+}
+
+/*
+ * Description :
+ * Return non zero if a frame of the line is on the wire at or after the time.
+ */
+static int SIM_lineBusy(const SIM_LineType *line, uint64_t time)
+{
+	uint8_t i;
+
+	for(i = 0 ; i < SIM_LINE_FRAMES ; i++)
+	{
+		if((line->bit_ns[i] != 0) && (line->cut[i] > time))
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void SIM_txPush(SIM_TxType *tx, uint8_t data, uint64_t time, uint32_t bit_ns)
+{
+	uint16_t index = (uint16_t)((tx->head + tx->count) % SIM_TX_QUEUE_SIZE);
+
+	if(tx->count == SIM_TX_QUEUE_SIZE)
+	{
+		return;
+	}
+	tx->queue[index] = data;
+	tx->queueTime[index] = time;
+	tx->queueBit[index] = bit_ns;
+	tx->count++;
+}
+
+/*
+ * Description :
+ * Move the queued bytes to the shift register when it is free and put them on the line.
+ */
+static void SIM_txUpdate(SIM_TxType *tx, uint64_t now)
+{
+	SIM_LineType *line = &tx->line;
+	uint64_t start;
+	uint32_t bit_ns;
+	uint8_t value;
+	uint8_t drop;
+	uint8_t i;
+
+	while(tx->count != 0)
+	{
+		start = tx->queueTime[tx->head];
+		if(start < tx->shiftEnd)
+		{
+			start = tx->shiftEnd;
+		}
+		if(start > now)
+		{
+			return;
+		}
+		value = tx->queue[tx->head];
+		bit_ns = tx->queueBit[tx->head];
+		tx->head = (uint16_t)((tx->head + 1) % SIM_TX_QUEUE_SIZE);
+		tx->count--;
+
+		drop = 0;
+		for(i = 0 ; i < tx->faultCount ; i++)
+		{
+			if(tx->faults[i].index != tx->sent)
+			{
+				continue;
+			}
+			if(tx->faults[i].kind == SIM_FAULT_FLIP)
+			{
+				value ^= tx->faults[i].mask;
+			}
+			else if(tx->faults[i].kind == SIM_FAULT_DROP)
+			{
+				drop = 1;
+			}
+			else if(tx->count < SIM_TX_QUEUE_SIZE)
+			{
+				/* Send the byte again before the next one */
+				tx->head = (uint16_t)((tx->head + SIM_TX_QUEUE_SIZE - 1) % SIM_TX_QUEUE_SIZE);
+				tx->queue[tx->head] = value;
+				tx->queueTime[tx->head] = start;
+				tx->queueBit[tx->head] = bit_ns;
+				tx->count++;
+				tx->faults[i].index = UINT32_MAX;
+			}
+		}
+		tx->sent++;
+		tx->shiftEnd = start + 10ULL * bit_ns;
+		if(!drop)
+		{
+			line->start[line->next] = start;
+			line->cut[line->next] = tx->shiftEnd;
+			line->bit_ns[line->next] = bit_ns;
+			line->value[line->next] = value;
+			line->next = (uint8_t)((line->next + 1) % SIM_LINE_FRAMES);
+		}
+	}
+}
+
+/*
+ * Description :
+ * AVR receiver in double speed mode: 8 samples per bit, a falling edge after a high
+ * sample starts a frame, each bit is the majority of its samples 4, 5 and 6.
+ */
+static void SIM_rxUpdate(SIM_RxType *rx, uint32_t bit_ns, uint64_t now)
+{
+	uint64_t sample_ns = bit_ns / 8;
+	uint64_t skip;
+	uint8_t level;
+
+	if(sample_ns == 0)
+	{
+		return;
+	}
+	while(rx->nextSample <= now)
+	{
+		if((rx->state != SIM_RX_FRAME) && !SIM_lineBusy(rx->line, rx->nextSample))
+		{
+			/* The line stays high, jump to the first sample after now */
+			skip = (now - rx->nextSample) / sample_ns + 1;
+			rx->nextSample += skip * sample_ns;
+			rx->state = SIM_RX_IDLE;
+			return;
+		}
+		level = SIM_lineLevel(rx->line, rx->nextSample);
+		switch(rx->state)
+		{
+		case SIM_RX_WAIT_HIGH:
+			if(level)
+			{
+				rx->state = SIM_RX_IDLE;
+			}
+			rx->nextSample += sample_ns;
+			break;
+		case SIM_RX_IDLE:
+			if(!level)
+			{
+				rx->state = SIM_RX_FRAME;
+				rx->firstLow = rx->nextSample;
+				rx->bit = 0;
+				rx->vote = 0;
+				rx->votes = 0;
+				rx->shift = 0;
+				rx->nextSample = rx->firstLow + 3 * sample_ns;
+			}
+			else
+			{
+				rx->nextSample += sample_ns;
+			}
+			break;
+		default:
+			rx->votes += level;
+			rx->vote++;
+			if(rx->vote < 3)
+			{
+				rx->nextSample += sample_ns;
+				break;
+			}
+			level = (rx->votes >= 2);
+			if((rx->bit == 0) && level)
+			{
+				/* False start bit */
+				rx->state = SIM_RX_IDLE;
+				rx->nextSample = rx->firstLow + 6 * sample_ns;
+				break;
+			}
+			if((rx->bit >= 1) && (rx->bit <= 8))
+			{
+				rx->shift |= (uint16_t)(level << (rx->bit - 1));
+			}
+			if(rx->bit == 9)
+			{
+				(*rx->done)(rx->owner, (uint8_t)rx->shift, (uint8_t)!level, rx->nextSample);
+				rx->state = level ? SIM_RX_IDLE : SIM_RX_WAIT_HIGH;
+				rx->nextSample += sample_ns;
+				break;
+			}
+			rx->bit++;
+			rx->vote = 0;
+			rx->votes = 0;
+			rx->nextSample = rx->firstLow + (8ULL * rx->bit + 3) * sample_ns;
+			break;
+		}
+	}
+}
+
+/*
+ * Description :
+ * Byte received by a node: two bytes wait in the RX buffer, the next one is lost with DOR.
+ */
+static void SIM_nodeReceive(void *owner, uint8_t data, uint8_t frame_error, uint64_t time)
+{
+	SIM_NodeType *node = (SIM_NodeType *)owner;
+
+	(void)time;
+	node->rxBytes++;
+	if(frame_error)
+	{
+		node->rxFrameErrors++;
+	}
+	if(node->rxCount == SIM_RX_FIFO_SIZE)
+	{
+		node->rxError[SIM_RX_FIFO_SIZE - 1] |= (1<<DOR);
+		node->rxOverrun++;
+		return;
+	}
+	node->rxData[node->rxCount] = data;
+	node->rxError[node->rxCount] = (uint8_t)(frame_error ? (1<<FE) : 0);
+	node->rxCount++;
+}
+
+static void SIM_peerReceive(void *owner, uint8_t data, uint8_t frame_error, uint64_t time)
+{
+	SIM_PeerType *peer = (SIM_PeerType *)owner;
+
+	if(peer->logCount == SIM_PEER_LOG_SIZE)
+	{
+		return;
+	}
+	peer->log[peer->logCount] = data;
+	peer->logError[peer->logCount] = frame_error;
+	peer->logTime[peer->logCount] = time;
+	peer->logCount++;
+}
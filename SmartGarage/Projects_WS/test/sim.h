@@ -0,0 +1,296 @@
+/******************************************************************************
+ *
+ * Module: SIM
+ *
+ * File Name: sim.h
+ *
+ * Description: Host simulator of the ATmega32 ECUs for the tests.
+ *
+ * Each ECU is built as a shared library with the stub registers and loaded on its own,
+ * so two ECUs built from the same sources keep their own globals. The ECU code runs in
+ * a coroutine and is charged simulated CPU time on each function entry, basic block and
+ * register access. Between two slices of SIM_QUANTUM_NS the simulator models:
+ * 1. The UART at the bit level: the TX double buffer and shift register, and the RX
+ *    sampling of the peer line at 8 samples per bit (U2X) with framing errors.
+ * 2. Timer0/Timer1/Timer2 compare interrupts in CTC mode, the ADC free running mode,
+ *    INT0/INT1 edges and the TWI with a 24C16 EEPROM.
+ * 3. The interrupts with their enable bits, the I-bit and the vector priorities.
+ * 4. The idle and power down sleep modes: in power down the timers and the UART
+ *    receiver stop, and only INT0/INT1 wake the node.
+ *
+ *******************************************************************************/
+
+#ifndef SIM_H_
+#define SIM_H_
+
+#include <stdint.h>
+#include <ucontext.h>
+#include "stub.h"
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+#define SIM_CPU_HZ                  8000000UL
+#define SIM_QUANTUM_NS              4000UL
+#define SIM_CALL_NS                 1000UL      /* Charged on each function entry */
+#define SIM_BLOCK_NS                250UL       /* Charged on each basic block */
+#define SIM_REGISTER_NS             125UL       /* Charged on each register access */
+#define SIM_ISR_NS                  500UL       /* Interrupt entry and return */
+#define SIM_STACK_SIZE              (1024UL * 1024UL)
+#define SIM_LINE_FRAMES             16
+#define SIM_TX_QUEUE_SIZE           256
+#define SIM_RX_FIFO_SIZE            2
+#define SIM_PEER_LOG_SIZE           8192
+#define SIM_MAX_NODES               2
+#define SIM_MAX_PEERS               2
+#define SIM_MAX_DEVICES             4
+#define SIM_MAX_FAULTS              8
+#define SIM_EEPROM_SIZE             2048
+
+#define SIM_MS(ms)                  ((uint64_t)(ms) * 1000000ULL)
+#define SIM_US(us)                  ((uint64_t)(us) * 1000ULL)
+#define SIM_BIT_NS(baud)            ((uint32_t)(1000000000ULL / (baud)))
+
+/* Interrupt vectors in the order of their priority */
+typedef enum
+{
+	SIM_INT0,SIM_INT1,SIM_TIMER2_COMP,SIM_TIMER1_COMPA,SIM_TIMER0_COMP,
+	SIM_USART_RXC,SIM_USART_UDRE,SIM_ADC,SIM_VECTOR_COUNT
+}SIM_VectorType;
+
+/* Sleep mode of a node, the time spent in each sleep mode is counted */
+typedef enum
+{
+	SIM_AWAKE,SIM_SLEEP_IDLE,SIM_SLEEP_POWER_DOWN
+}SIM_SleepType;
+
+/* Faults applied to one byte when it enters the TX shift register */
+typedef enum
+{
+	SIM_FAULT_FLIP,SIM_FAULT_DROP,SIM_FAULT_DUPLICATE
+}SIM_FaultKind;
+
+/*******************************************************************************
+ *                               Types Declaration                             *
+ *******************************************************************************/
+
+/* Frames sent on one line, the line is high outside of them */
+typedef struct
+{
+	uint64_t start[SIM_LINE_FRAMES];
+	uint64_t cut[SIM_LINE_FRAMES];      /* The line is released from this time, after a reset */
+	uint32_t bit_ns[SIM_LINE_FRAMES];
+	uint8_t value[SIM_LINE_FRAMES];
+	uint8_t next;
+}SIM_LineType;
+
+typedef struct
+{
+	uint32_t index;                     /* Byte number counted from the start of the TX */
+	SIM_FaultKind kind;
+	uint8_t mask;
+}SIM_FaultType;
+
+typedef struct
+{
+	SIM_LineType line;
+	uint8_t queue[SIM_TX_QUEUE_SIZE];
+	uint64_t queueTime[SIM_TX_QUEUE_SIZE];
+	uint32_t queueBit[SIM_TX_QUEUE_SIZE];
+	uint16_t head;
+	uint16_t count;
+	uint64_t shiftEnd;
+	uint32_t sent;
+	SIM_FaultType faults[SIM_MAX_FAULTS];
+	uint8_t faultCount;
+}SIM_TxType;
+
+typedef struct
+{
+	const SIM_LineType *line;
+	uint64_t nextSample;
+	uint64_t firstLow;
+	uint8_t state;
+	uint8_t bit;
+	uint8_t vote;
+	uint8_t votes;
+	uint16_t shift;
+	/* Completed byte, taken by the owner */
+	void (*done)(void *owner, uint8_t data, uint8_t frame_error, uint64_t time);
+	void *owner;
+}SIM_RxType;
+
+typedef struct SIM_Node SIM_NodeType;
+
+struct SIM_Node
+{
+	const char *name;
+	char path[256];
+	const char *entryName;
+	void *library;
+	void (*entry)(void);
+	volatile uint8_t *reg8;
+	volatile uint16_t *reg16;
+	void (*vectors[SIM_VECTOR_COUNT])(void);
+	ucontext_t context;
+	void *stack;
+	uint64_t clock;
+	uint8_t running;
+	uint8_t inIsr;
+	uint8_t udrWritten;
+	uint8_t finished;
+	uint8_t flags[SIM_VECTOR_COUNT];
+	uint64_t accessTime[STUB_REG8_COUNT + STUB_REG16_COUNT];     /* Last access of each register */
+	uint32_t isrCount[SIM_VECTOR_COUNT];
+	SIM_SleepType sleepMode;
+	uint64_t sleepTime[SIM_SLEEP_POWER_DOWN + 1];     /* Indexed by the sleep mode */
+	uint64_t timerNext[3];
+	uint64_t adcDone;
+	uint8_t adcFirst;
+	uint16_t (*adcInput)(SIM_NodeType *node, uint8_t channel, void *context);
+	void *adcContext;
+	/* UART */
+	SIM_TxType tx;
+	SIM_RxType rx;
+	uint8_t rxData[SIM_RX_FIFO_SIZE];
+	uint8_t rxError[SIM_RX_FIFO_SIZE];
+	uint8_t rxCount;
+	uint32_t rxOverrun;                 /* Bytes lost with the hardware FIFO full */
+	uint32_t rxBytes;
+	uint32_t rxFrameErrors;
+	/* TWI and EEPROM */
+	uint8_t eeprom[SIM_EEPROM_SIZE];
+	uint8_t twiPhase;
+	uint16_t twiAddress;
+	uint32_t eepromWrites;
+};
+
+/* Scripted UART end of a line, sends bytes and logs the received ones with their time */
+typedef struct
+{
+	SIM_TxType tx;
+	SIM_RxType rx;
+	uint32_t bit_ns;
+	uint8_t log[SIM_PEER_LOG_SIZE];
+	uint8_t logError[SIM_PEER_LOG_SIZE];
+	uint64_t logTime[SIM_PEER_LOG_SIZE];
+	uint32_t logCount;
+}SIM_PeerType;
+
+/*******************************************************************************
+ *                      Functions Prototypes                                   *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Forget all the nodes, peers and devices and restart the time from zero.
+ */
+void SIM_init(void);
+
+/*
+ * Description :
+ * Load an ECU library and start it at its entry function at the current time.
+ */
+SIM_NodeType *SIM_addNode(const char *name, const char *path, const char *entry);
+
+/*
+ * Description :
+ * Reload the ECU library of a node, like a power on reset: all its globals and registers
+ * start again from zero, its EEPROM is kept, a byte it was sending is cut.
+ */
+void SIM_resetNode(SIM_NodeType *node);
+
+/*
+ * Description :
+ * Wire the TX of each node to the RX of the other one.
+ */
+void SIM_connect(SIM_NodeType *a, SIM_NodeType *b);
+
+/*
+ * Description :
+ * Add a scripted peer wired to the UART of the node at the given bit time.
+ */
+SIM_PeerType *SIM_addPeer(SIM_NodeType *node, uint32_t bit_ns);
+
+/*
+ * Description :
+ * Queue bytes or one protocol frame on the TX of a peer, sent back to back from now.
+ */
+void SIM_peerSend(SIM_PeerType *peer, const uint8_t *data, uint16_t size);
+void SIM_peerSendFrame(SIM_PeerType *peer, uint8_t type, uint8_t seq, const uint8_t *payload, uint8_t length);
+
+/*
+ * Description :
+ * Find the next valid protocol frame in the peer log from the log index *from.
+ * Return 1 and fill the frame fields and *from after it, or 0 if there is none yet.
+ */
+int SIM_peerNextFrame(const SIM_PeerType *peer, uint32_t *from, uint8_t *type, uint8_t *seq,
+		uint8_t *payload, uint8_t *length, uint64_t *time);
+
+/*
+ * Description :
+ * Empty the peer log, for runs longer than SIM_PEER_LOG_SIZE bytes. A frame being
+ * received is cut, the log indexes of the test start again from zero.
+ */
+void SIM_peerClearLog(SIM_PeerType *peer);
+
+/*
+ * Description :
+ * Add a fault on the TX of a node, index counts the bytes from the next one to be sent.
+ */
+void SIM_addTxFault(SIM_TxType *tx, uint32_t index, SIM_FaultKind kind, uint8_t mask);
+
+/*
+ * Description :
+ * Add a model called every quantum after the nodes, for a plant or a scripted input.
+ */
+void SIM_addDevice(void (*update)(void *context, uint64_t now), void *context);
+
+/*
+ * Description :
+ * Set the level of an input pin, edges on PD2/PD3 set the INT0/INT1 flags.
+ * INT0/INT1 on the low level have no flag, they are pending while the pin is low.
+ */
+void SIM_setPin(SIM_NodeType *node, int pin_register, uint8_t bit, uint8_t level);
+
+/*
+ * Description :
+ * Run the simulation for duration_ns, or until done returns non zero.
+ * Return non zero if done returned non zero.
+ */
+void SIM_run(uint64_t duration_ns);
+int SIM_runUntil(int (*done)(void *context), void *context, uint64_t timeout_ns);
+
+/*
+ * Description :
+ * Current simulated time in nanoseconds.
+ */
+uint64_t SIM_now(void);
+
+/*
+ * Description :
+ * Address of a global or a function of the ECU library of a node, the test stops if it is missing.
+ */
+void *SIM_symbol(SIM_NodeType *node, const char *name);
+
+/*
+ * Description :
+ * Current bit time of the UART of a node from UBRR and U2X.
+ */
+uint32_t SIM_uartBitNs(const SIM_NodeType *node);
+
+/*
+ * Description :
+ * CRC-8 of the protocol (polynomial 0x07), to build and check the frames on the host.
+ */
+uint8_t SIM_crc8(uint8_t crc, uint8_t data);
+
+/*
+ * Description :
+ * Report a check, count the failures for SIM_exitCode.
+ */
+#define SIM_CHECK(condition, ...)   SIM_check((condition) != 0, __FILE__, __LINE__, __VA_ARGS__)
+void SIM_check(int passed, const char *file, int line, const char *format, ...);
+int SIM_exitCode(void);
+
+#endif /* SIM_H_ */
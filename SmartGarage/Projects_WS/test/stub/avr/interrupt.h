@@ -0,0 +1,20 @@
+/******************************************************************************
+ *
+ * File Name: interrupt.h
+ *
+ * Description: Host stub of <avr/interrupt.h>. An ISR is a plain function called
+ * by the simulator with its vector name, the I-bit is bit 7 of the stub SREG.
+ *
+ *******************************************************************************/
+
+#ifndef STUB_AVR_INTERRUPT_H_
+#define STUB_AVR_INTERRUPT_H_
+
+#include <avr/io.h>
+
+#define ISR(vector, ...)    void vector(void); void vector(void)
+#define ISR_NOBLOCK
+#define sei()               (SREG |= (1<<7))
+#define cli()               (SREG &= (uint8_t)~(1<<7))
+
+#endif /* STUB_AVR_INTERRUPT_H_ */
@@ -0,0 +1,280 @@
+/******************************************************************************
+ *
+ * File Name: io.h
+ *
+ * Description: Host stub of <avr/io.h> for the ATmega32 used by the host tests.
+ * Each register is read and written through STUB_io8/STUB_io16, so the simulator
+ * sees every access: it charges the CPU time and models the peripherals.
+ *
+ *******************************************************************************/
+
+#ifndef STUB_AVR_IO_H_
+#define STUB_AVR_IO_H_
+
+#include <stdint.h>
+
+/* Register ids, the index of each register in STUB_reg8/STUB_reg16 */
+enum
+{
+	STUB_PORTA,
+	STUB_PORTB,
+	STUB_PORTC,
+	STUB_PORTD,
+	STUB_DDRA,
+	STUB_DDRB,
+	STUB_DDRC,
+	STUB_DDRD,
+	STUB_PINA,
+	STUB_PINB,
+	STUB_PINC,
+	STUB_PIND,
+	STUB_UDR,
+	STUB_UCSRA,
+	STUB_UCSRB,
+	STUB_UCSRC,
+	STUB_UBRRH,
+	STUB_UBRRL,
+	STUB_TCCR0,
+	STUB_TCNT0,
+	STUB_OCR0,
+	STUB_TIMSK,
+	STUB_TIFR,
+	STUB_TCCR1A,
+	STUB_TCCR1B,
+	STUB_TCCR2,
+	STUB_TCNT2,
+	STUB_OCR2,
+	STUB_ASSR,
+	STUB_GICR,
+	STUB_GIFR,
+	STUB_MCUCR,
+	STUB_MCUCSR,
+	STUB_ADMUX,
+	STUB_ADCSRA,
+	STUB_ADCL,
+	STUB_ADCH,
+	STUB_SFIOR,
+	STUB_SREG,
+	STUB_TWBR,
+	STUB_TWSR,
+	STUB_TWAR,
+	STUB_TWDR,
+	STUB_TWCR,
+	STUB_SPH,
+	STUB_SPL,
+	STUB_REG8_COUNT
+};
+
+enum
+{
+	STUB_TCNT1,
+	STUB_OCR1A,
+	STUB_OCR1B,
+	STUB_ICR1,
+	STUB_ADC,
+	STUB_REG16_COUNT
+};
+
+volatile uint8_t *STUB_io8(int id);
+volatile uint16_t *STUB_io16(int id);
+
+#define PORTA    (*STUB_io8(STUB_PORTA))
+#define PORTB    (*STUB_io8(STUB_PORTB))
+#define PORTC    (*STUB_io8(STUB_PORTC))
+#define PORTD    (*STUB_io8(STUB_PORTD))
+#define DDRA     (*STUB_io8(STUB_DDRA))
+#define DDRB     (*STUB_io8(STUB_DDRB))
+#define DDRC     (*STUB_io8(STUB_DDRC))
+#define DDRD     (*STUB_io8(STUB_DDRD))
+#define PINA     (*STUB_io8(STUB_PINA))
+#define PINB     (*STUB_io8(STUB_PINB))
+#define PINC     (*STUB_io8(STUB_PINC))
+#define PIND     (*STUB_io8(STUB_PIND))
+#define UDR      (*STUB_io8(STUB_UDR))
+#define UCSRA    (*STUB_io8(STUB_UCSRA))
+#define UCSRB    (*STUB_io8(STUB_UCSRB))
+#define UCSRC    (*STUB_io8(STUB_UCSRC))
+#define UBRRH    (*STUB_io8(STUB_UBRRH))
+#define UBRRL    (*STUB_io8(STUB_UBRRL))
+#define TCCR0    (*STUB_io8(STUB_TCCR0))
+#define TCNT0    (*STUB_io8(STUB_TCNT0))
+#define OCR0     (*STUB_io8(STUB_OCR0))
+#define TIMSK    (*STUB_io8(STUB_TIMSK))
+#define TIFR     (*STUB_io8(STUB_TIFR))
+#define TCCR1A   (*STUB_io8(STUB_TCCR1A))
+#define TCCR1B   (*STUB_io8(STUB_TCCR1B))
+#define TCCR2    (*STUB_io8(STUB_TCCR2))
+#define TCNT2    (*STUB_io8(STUB_TCNT2))
+#define OCR2     (*STUB_io8(STUB_OCR2))
+#define ASSR     (*STUB_io8(STUB_ASSR))
+#define GICR     (*STUB_io8(STUB_GICR))
+#define GIFR     (*STUB_io8(STUB_GIFR))
+#define MCUCR    (*STUB_io8(STUB_MCUCR))
+#define MCUCSR   (*STUB_io8(STUB_MCUCSR))
+#define ADMUX    (*STUB_io8(STUB_ADMUX))
+#define ADCSRA   (*STUB_io8(STUB_ADCSRA))
+#define ADCL     (*STUB_io8(STUB_ADCL))
+#define ADCH     (*STUB_io8(STUB_ADCH))
+#define SFIOR    (*STUB_io8(STUB_SFIOR))
+#define SREG     (*STUB_io8(STUB_SREG))
+#define TWBR     (*STUB_io8(STUB_TWBR))
+#define TWSR     (*STUB_io8(STUB_TWSR))
+#define TWAR     (*STUB_io8(STUB_TWAR))
+#define TWDR     (*STUB_io8(STUB_TWDR))
+#define TWCR     (*STUB_io8(STUB_TWCR))
+#define SPH      (*STUB_io8(STUB_SPH))
+#define SPL      (*STUB_io8(STUB_SPL))
+#define TCNT1    (*STUB_io16(STUB_TCNT1))
+#define OCR1A    (*STUB_io16(STUB_OCR1A))
+#define OCR1B    (*STUB_io16(STUB_OCR1B))
+#define ICR1     (*STUB_io16(STUB_ICR1))
+#define ADC      (*STUB_io16(STUB_ADC))
+
+#define RXC      7
+#define TXC      6
+#define UDRE     5
+#define FE       4
+#define DOR      3
+#define PE       2
+#define U2X      1
+#define MPCM     0
+#define RXCIE    7
+#define TXCIE    6
+#define UDRIE    5
+#define RXEN     4
+#define TXEN     3
+#define UCSZ2    2
+#define RXB8     1
+#define TXB8     0
+#define URSEL    7
+#define UMSEL    6
+#define UPM1     5
+#define UPM0     4
+#define USBS     3
+#define UCSZ1    2
+#define UCSZ0    1
+#define UCPOL    0
+#define FOC0     7
+#define WGM00    6
+#define COM01    5
+#define COM00    4
+#define WGM01    3
+#define CS02     2
+#define CS01     1
+#define CS00     0
+#define OCIE2    7
+#define TOIE2    6
+#define TICIE1   5
+#define OCIE1A   4
+#define OCIE1B   3
+#define TOIE1    2
+#define OCIE0    1
+#define TOIE0    0
+#define OCF2     7
+#define TOV2     6
+#define ICF1     5
+#define OCF1A    4
+#define OCF1B    3
+#define TOV1     2
+#define OCF0     1
+#define TOV0     0
+#define COM1A1   7
+#define COM1A0   6
+#define COM1B1   5
+#define COM1B0   4
+#define FOC1A    3
+#define FOC1B    2
+#define WGM11    1
+#define WGM10    0
+#define ICNC1    7
+#define ICES1    6
+#define WGM13    4
+#define WGM12    3
+#define CS12     2
+#define CS11     1
+#define CS10     0
+#define FOC2     7
+#define WGM20    6
+#define COM21    5
+#define COM20    4
+#define WGM21    3
+#define CS22     2
+#define CS21     1
+#define CS20     0
+#define INT1     7
+#define INT0     6
+#define INT2     5
+#define INTF1    7
+#define INTF0    6
+#define INTF2    5
+#define SE       7
+#define SM2      6
+#define SM1      5
+#define SM0      4
+#define ISC11    3
+#define ISC10    2
+#define ISC01    1
+#define ISC00    0
+#define ISC2     6
+#define REFS1    7
+#define REFS0    6
+#define ADLAR    5
+#define MUX4     4
+#define MUX3     3
+#define MUX2     2
+#define MUX1     1
+#define MUX0     0
+#define ADEN     7
+#define ADSC     6
+#define ADATE    5
+#define ADIF     4
+#define ADIE     3
+#define ADPS2    2
+#define ADPS1    1
+#define ADPS0    0
+#define ADTS2    7
+#define ADTS1    6
+#define ADTS0    5
+#define TWINT    7
+#define TWEA     6
+#define TWSTA    5
+#define TWSTO    4
+#define TWWC     3
+#define TWEN     2
+#define TWIE     0
+#define TWPS1    1
+#define TWPS0    0
+#define PA0 0
+#define PA1 1
+#define PA2 2
+#define PA3 3
+#define PA4 4
+#define PA5 5
+#define PA6 6
+#define PA7 7
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PB6 6
+#define PB7 7
+#define PC0 0
+#define PC1 1
+#define PC2 2
+#define PC3 3
+#define PC4 4
+#define PC5 5
+#define PC6 6
+#define PC7 7
+#define PD0 0
+#define PD1 1
+#define PD2 2
+#define PD3 3
+#define PD4 4
+#define PD5 5
+#define PD6 6
+#define PD7 7
+
+#endif /* STUB_AVR_IO_H_ */
@@ -0,0 +1,18 @@
+/******************************************************************************
+ *
+ * File Name: pgmspace.h
+ *
+ * Description: Host stub of <avr/pgmspace.h>, the flash data is plain constant data.
+ *
+ *******************************************************************************/
+
+#ifndef STUB_AVR_PGMSPACE_H_
+#define STUB_AVR_PGMSPACE_H_
+
+#include <stdint.h>
+
+#define PROGMEM
+#define pgm_read_byte(address)  (*(const uint8_t *)(address))
+#define pgm_read_word(address)  (*(const uint16_t *)(address))
+
+#endif /* STUB_AVR_PGMSPACE_H_ */
@@ -0,0 +1,25 @@
+/******************************************************************************
+ *
+ * File Name: sleep.h
+ *
+ * Description: Host stub of <avr/sleep.h>, the CPU sleeps until the next interrupt.
+ *
+ *******************************************************************************/
+
+#ifndef STUB_AVR_SLEEP_H_
+#define STUB_AVR_SLEEP_H_
+
+#include <avr/io.h>
+
+#define SLEEP_MODE_IDLE         0
+#define SLEEP_MODE_PWR_DOWN     ((1<<SM1))
+
+void STUB_sleep(void);
+
+#define set_sleep_mode(mode)    (MCUCR = (MCUCR & (uint8_t)~((1<<SM2) | (1<<SM1) | (1<<SM0))) | (mode))
+#define sleep_enable()          (MCUCR |= (1<<SE))
+#define sleep_disable()         (MCUCR &= (uint8_t)~(1<<SE))
+#define sleep_cpu()             STUB_sleep()
+#define sleep_mode()            STUB_sleep()
+
+#endif /* STUB_AVR_SLEEP_H_ */
@@ -0,0 +1,35 @@
+/******************************************************************************
+ *
+ * File Name: stub.h
+ *
+ * Description: Interface between the ECU code built for the host and the simulator.
+ * The stub calls STUB_hook on each register access, each function entry and each basic
+ * block (the ECU code is built with -finstrument-functions -fsanitize-coverage=trace-pc),
+ * each delay and each sleep.
+ *
+ *******************************************************************************/
+
+#ifndef STUB_H_
+#define STUB_H_
+
+#include <stdint.h>
+#include <avr/io.h>
+
+/* Events given to the hook, a register access gives its id: STUB_REG8_COUNT + id for the 16-bit ones */
+#define STUB_EVENT_CALL         (-1)
+#define STUB_EVENT_DELAY        (-2)
+#define STUB_EVENT_SLEEP        (-3)
+#define STUB_EVENT_BLOCK        (-4)
+
+typedef void (*STUB_HookType)(void *context, int event, uint32_t ns);
+
+extern volatile uint8_t STUB_reg8[STUB_REG8_COUNT];
+extern volatile uint16_t STUB_reg16[STUB_REG16_COUNT];
+
+/*
+ * Description :
+ * Set the hook of the simulator and its context, NULL runs the code without a simulator.
+ */
+void STUB_setHook(STUB_HookType hook, void *context);
+
+#endif /* STUB_H_ */
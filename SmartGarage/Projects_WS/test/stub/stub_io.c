@@ -0,0 +1,112 @@
+/******************************************************************************
+ *
+ * File Name: stub_io.c
+ *
+ * Description: Registers, hook and C library helpers of the ECU code built for the host.
+ * This file is built without the instrumentation flags, it is the one calling the hook.
+ *
+ *******************************************************************************/
+
+#include "stub.h"
+#include <stdlib.h>
+
+volatile uint8_t STUB_reg8[STUB_REG8_COUNT];
+volatile uint16_t STUB_reg16[STUB_REG16_COUNT];
+
+static STUB_HookType g_hook = NULL;
+static void *g_hookContext = NULL;
+
+void STUB_setHook(STUB_HookType hook, void *context)
+{
+	g_hook = hook;
+	g_hookContext = context;
+}
+
+volatile uint8_t *STUB_io8(int id)
+{
+	if(g_hook != NULL)
+	{
+		(*g_hook)(g_hookContext, id, 0);
+	}
+	return &STUB_reg8[id];
+}
+
+volatile uint16_t *STUB_io16(int id)
+{
+	if(g_hook != NULL)
+	{
+		(*g_hook)(g_hookContext, STUB_REG8_COUNT + id, 0);
+	}
+	return &STUB_reg16[id];
+}
+
+void STUB_delayUs(double us)
+{
+	if(g_hook != NULL)
+	{
+		(*g_hook)(g_hookContext, STUB_EVENT_DELAY, (uint32_t)(us * 1000.0));
+	}
+}
+
+void STUB_sleep(void)
+{
+	if(g_hook != NULL)
+	{
+		(*g_hook)(g_hookContext, STUB_EVENT_SLEEP, 0);
+	}
+}
+
+void __cyg_profile_func_enter(void *function, void *caller);
+void __cyg_profile_func_exit(void *function, void *caller);
+
+void __cyg_profile_func_enter(void *function, void *caller)
+{
+	(void)function;
+	(void)caller;
+	if(g_hook != NULL)
+	{
+		(*g_hook)(g_hookContext, STUB_EVENT_CALL, 0);
+	}
+}
+
+void __cyg_profile_func_exit(void *function, void *caller)
+{
+	(void)function;
+	(void)caller;
+}
+
+void __sanitizer_cov_trace_pc(void);
+
+void __sanitizer_cov_trace_pc(void)
+{
+	/* Every loop of the ECU code goes through a basic block, even one polling a global */
+	if(g_hook != NULL)
+	{
+		(*g_hook)(g_hookContext, STUB_EVENT_BLOCK, 0);
+	}
+}
+
+/* avr-libc itoa, used by the LCD driver */
+char *itoa(int value, char *string, int radix)
+{
+	char digits[sizeof(int) * 8 + 1];
+	unsigned int magnitude = (value < 0 && radix == 10) ? (unsigned int)-value : (unsigned int)value;
+	int length = 0;
+	int i = 0;
+
+	do
+	{
+		digits[length++] = "0123456789abcdefghijklmnopqrstuvwxyz"[magnitude % (unsigned int)radix];
+		magnitude /= (unsigned int)radix;
+	}while(magnitude != 0);
+	if(value < 0 && radix == 10)
+	{
+		string[i++] = '-';
+	}
+	while(length != 0)
+	{
+		string[i++] = digits[--length];
+	}
+	string[i] = '\0';
+	return string;
+}
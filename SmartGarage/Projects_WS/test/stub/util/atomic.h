@@ -0,0 +1,19 @@
+/******************************************************************************
+ *
+ * File Name: atomic.h
+ *
+ * Description: Host stub of <util/atomic.h>, the block runs with the I-bit cleared.
+ *
+ *******************************************************************************/
+
+#ifndef STUB_UTIL_ATOMIC_H_
+#define STUB_UTIL_ATOMIC_H_
+
+#include <avr/interrupt.h>
+
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_FORCEON
+#define ATOMIC_BLOCK(type) \
+	for(uint8_t stub_sreg = SREG, stub_once = (cli(), 1) ; stub_once ; stub_once = 0, SREG = stub_sreg)
+
+#endif /* STUB_UTIL_ATOMIC_H_ */
@@ -0,0 +1,17 @@
+/******************************************************************************
+ *
+ * File Name: delay.h
+ *
+ * Description: Host stub of <util/delay.h>, the delay is spent in simulated time.
+ *
+ *******************************************************************************/
+
+#ifndef STUB_UTIL_DELAY_H_
+#define STUB_UTIL_DELAY_H_
+
+void STUB_delayUs(double us);
+
+#define _delay_ms(ms)   STUB_delayUs((double)(ms) * 1000.0)
+#define _delay_us(us)   STUB_delayUs((double)(us))
+
+#endif /* STUB_UTIL_DELAY_H_ */
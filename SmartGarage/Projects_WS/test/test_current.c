@@ -0,0 +1,202 @@
+/******************************************************************************
+ *
+ * File Name: test_current.c
+ *
+ * Description: Replay test of the motor current monitor. The shunt samples of a
+ * trace in data/ are given to the free running ADC of the CONTROL_ECU DC motor
+ * driver one per conversion, from the start of the drive. The test checks the fault
+ * the monitor latches, and the time from the event of the trace to the motor cut.
+ *
+ * Trace file: lines with # are comments, "expect none|stall|overcurrent", "event n"
+ * with the sample number of the event, then the samples in ADC counts.
+ *
+ *******************************************************************************/
+
+#include "sim.h"
+#include "motor_app.h"
+#include "dc_motor.h"
+#include "adc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+#define REPLAY_MAX_SAMPLES          8192
+#define REPLAY_BOOT_NS              SIM_MS(10)
+#define REPLAY_COMMAND_NS           SIM_MS(10)
+/* Samples/s of the current monitor: F_CPU/128 and 13 ADC clocks per conversion */
+#define REPLAY_SAMPLE_RATE          (SIM_CPU_HZ / 128.0 / ADC_CONVERSION_CLOCKS)
+/* Rise time of the stall current in the traces */
+#define REPLAY_STALL_RISE_MS        20.0
+/* Time of the running average window */
+#define REPLAY_AVERAGE_MS           (ADC_BUFFER_SIZE * 1000.0 / REPLAY_SAMPLE_RATE)
+
+typedef struct
+{
+	const char *name;
+	DcMotor_FaultType expect;
+	uint32_t event;
+	uint16_t samples[REPLAY_MAX_SAMPLES];
+	uint32_t count;
+	/* Replay */
+	SIM_NodeType *node;
+	uint32_t next;
+	uint32_t cut;                       /* Samples given before the motor was cut, 0 while it runs */
+}REPLAY_TraceType;
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
+
+/* Read a trace file, return 0 if it cannot be read */
+static int Replay_load(REPLAY_TraceType *trace, const char *name)
+{
+	char path[128];
+	char line[256];
+	char *next;
+	char *end;
+	long value;
+	FILE *file;
+
+	trace->name = name;
+	trace->expect = DC_MOTOR_NO_FAULT;
+	trace->event = 0;
+	trace->count = 0;
+	snprintf(path, sizeof(path), "data/%s", name);
+	file = fopen(path, "r");
+	if(file == NULL)
+	{
+		return 0;
+	}
+	while(fgets(line, sizeof(line), file) != NULL)
+	{
+		if(line[0] == '#')
+		{
+			continue;
+		}
+		if(strncmp(line, "expect ", 7) == 0)
+		{
+			trace->expect = (strncmp(&line[7], "stall", 5) == 0) ? DC_MOTOR_STALL :
+					(strncmp(&line[7], "overcurrent", 11) == 0) ? DC_MOTOR_OVERCURRENT : DC_MOTOR_NO_FAULT;
+			continue;
+		}
+		if(strncmp(line, "event ", 6) == 0)
+		{
+			trace->event = (uint32_t)strtoul(&line[6], NULL, 10);
+			continue;
+		}
+		next = line;
+		value = strtol(next, &end, 10);
+		while((end != next) && (trace->count < REPLAY_MAX_SAMPLES))
+		{
+			trace->samples[trace->count++] = (uint16_t)value;
+			next = end;
+			value = strtol(next, &end, 10);
+		}
+	}
+	fclose(file);
+	return trace->count != 0;
+}
+
+/*
+ * Description :
+ * ADC input: the next sample of the trace while the H-bridge drives the motor,
+ * no current once it is cut.
+ */
+static uint16_t Replay_sample(SIM_NodeType *node, uint8_t channel, void *context)
+{
+	REPLAY_TraceType *trace = (REPLAY_TraceType *)context;
+	uint8_t inputs = node->reg8[STUB_PORTB] & 0x03;
+
+	if((channel != DC_MOTOR_CURRENT_CHANNEL) || (trace->next == trace->count))
+	{
+		return 0;
+	}
+	if((inputs != 0x01) && (inputs != 0x02))
+	{
+		if((trace->next != 0) && (trace->cut == 0))
+		{
+			trace->cut = trace->next;
+		}
+		return 0;
+	}
+	return trace->samples[trace->next++];
+}
+
+static int Replay_idle(void *context)
+{
+	return *(volatile uint8 *)context == MOTOR_APP_IDLE;
+}
+
+static double Replay_ms(uint32_t samples)
+{
+	return samples * 1000.0 / REPLAY_SAMPLE_RATE;
+}
+
+static void Test_trace(const char *name)
+{
+	static REPLAY_TraceType trace;
+	volatile uint8 *command;
+	DcMotor_FaultType fault;
+	double cut_ms;
+
+	if(!Replay_load(&trace, name))
+	{
+		SIM_CHECK(0, "%s: trace read", name);
+		return;
+	}
+
+	SIM_init();
+	trace.node = SIM_addNode("control", "build/motor_app.so", "motor_main");
+	trace.node->adcInput = Replay_sample;
+	trace.node->adcContext = &trace;
+	trace.next = 0;
+	trace.cut = 0;
+	command = SIM_symbol(trace.node, "g_command");
+	SIM_run(REPLAY_BOOT_NS);
+
+	*(volatile uint8 *)SIM_symbol(trace.node, "g_state") = DC_MOTOR_CW;
+	*(volatile uint8 *)SIM_symbol(trace.node, "g_speed") = 100;
+	*command = MOTOR_APP_ROTATE;
+	SIM_runUntil(Replay_idle, (void *)command, REPLAY_COMMAND_NS);
+	SIM_run(SIM_US(Replay_ms(trace.count) * 1000.0) + SIM_MS(5));
+
+	fault = ((DcMotor_FaultType (*)(void))SIM_symbol(trace.node, "DcMotor_getFault"))();
+	cut_ms = Replay_ms(trace.cut) - Replay_ms(trace.event);
+	if(trace.expect == DC_MOTOR_NO_FAULT)
+	{
+		SIM_CHECK((fault == DC_MOTOR_NO_FAULT) && (trace.cut == 0) && (trace.next == trace.count),
+				"%s: %.0f ms replayed, no fault, the motor still runs", name, Replay_ms(trace.next));
+		return;
+	}
+
+	SIM_CHECK(fault == trace.expect, "%s: %s latched (fault %u)", name,
+			(trace.expect == DC_MOTOR_STALL) ? "stall" : "over-current", fault);
+	if(trace.expect == DC_MOTOR_STALL)
+	{
+		SIM_CHECK((trace.cut != 0) && (cut_ms >= DC_MOTOR_STALL_TIME_MS) &&
+				(cut_ms <= DC_MOTOR_STALL_TIME_MS + REPLAY_STALL_RISE_MS + REPLAY_AVERAGE_MS),
+				"%s: cut %.1f ms after the jam, limit %u ms + %.0f ms rise + %.1f ms average", name, cut_ms,
+				DC_MOTOR_STALL_TIME_MS, REPLAY_STALL_RISE_MS, REPLAY_AVERAGE_MS);
+	}
+	else
+	{
+		SIM_CHECK((trace.cut > trace.event) && (cut_ms <= REPLAY_AVERAGE_MS),
+				"%s: cut %.2f ms after the short, within the %.1f ms average", name, cut_ms, REPLAY_AVERAGE_MS);
+	}
+	SIM_CHECK((trace.node->reg8[STUB_PORTB] & 0x03) == 0, "%s: the motor coasts after the cut", name);
+}
+
+int main(void)
+{
+	static const char *const traces[] = {"normal_run.txt", "inrush.txt", "spike.txt", "stall.txt", "overcurrent.txt"};
+	uint8_t i;
+
+	for(i = 0 ; i < sizeof(traces) / sizeof(traces[0]) ; i++)
+	{
+		Test_trace(traces[i]);
+	}
+	return SIM_exitCode();
+}
@@ -0,0 +1,242 @@
+/******************************************************************************
+ *
+ * File Name: test_door.c
+ *
+ * Description: Host test of the closed loop door position control. The real
+ * CONTROL_ECU drives the door model of plant.c through one full cycle, opened by
+ * an UNLOCK_DOOR request of a scripted peer with the default door parameters.
+ * With the encoder, the limit switches or both, each move brakes when the door
+ * arrives: before the end of its profile and without reaching the end stop.
+ * The DOOR_PROGRESS stream of the cycle is checked on the peer: its period, its
+ * load on the line and its end.
+ * Without any sensor no move can see the door arrive: the opening ends on the end
+ * stop or on its profile time, the cycle ends as DOOR_STATE_FAULT with the door where
+ * it stopped. It is never taken as open and closed after the hold.
+ *
+ *******************************************************************************/
+
+#include "sim.h"
+#include "plant.h"
+#include "link_host.h"
+#include "protocol.h"
+#include "door_control.h"
+#include <math.h>
+#include <stdio.h>
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+#define DOOR_TEST_BOOT_NS           SIM_MS(200)
+#define DOOR_TEST_MOVE_NS           SIM_MS(20000)
+/* Default profiles of the door parameters, the limit of each move */
+#define DOOR_TEST_OPEN_MS           (PARAMS_DEFAULT_OPEN_TIME * PARAMS_TIME_UNIT_MS)
+#define DOOR_TEST_HOLD_MS           (PARAMS_DEFAULT_HOLD_TIME * PARAMS_TIME_UNIT_MS)
+#define DOOR_TEST_CLOSE_MS          (PARAMS_DEFAULT_CLOSE_TIME * PARAMS_TIME_UNIT_MS)
+/* Position of a door that arrived on its encoder: the braking distance from the creep speed and one step */
+#define DOOR_TEST_ARRIVED_COUNTS    10.0
+/* A DOOR_PROGRESS frame on the line, and the longest gap: the period and one control step */
+#define DOOR_TEST_PROGRESS_BYTES    (PROTOCOL_HEADER_SIZE + DOOR_PROGRESS_SIZE + PROTOCOL_CRC_SIZE)
+#define DOOR_TEST_PROGRESS_GAP_MS   (DOOR_PROGRESS_PERIOD_MS + DOOR_CONTROL_STEP_MS)
+/* 5% of the 960 B/s of the 9600 line */
+#define DOOR_TEST_PROGRESS_MAX_RATE 48.0
+/* The stream is silent after the cycle ends */
+#define DOOR_TEST_SILENT_NS         SIM_MS(2000)
+
+typedef struct
+{
+	SIM_NodeType *control;
+	SIM_PeerType *peer;
+	PLANT_Type plant;
+	volatile uint8 *doorState;
+	uint8_t seq;
+	uint8_t waitState;
+}DOOR_TEST_Type;
+
+typedef struct
+{
+	const char *name;
+	uint8_t sensors;
+}DOOR_TEST_CaseType;
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
+
+static void Door_start(DOOR_TEST_Type *test, uint8_t sensors)
+{
+	SIM_init();
+	test->control = LINK_HOST_addControl("build/control.so");
+	PLANT_init(&test->plant, test->control, 0, sensors);
+	test->peer = SIM_addPeer(test->control, SIM_BIT_NS(9600));
+	test->doorState = SIM_symbol(test->control, "g_doorState");
+	test->seq = 0;
+	SIM_run(DOOR_TEST_BOOT_NS);
+}
+
+static void Door_unlock(DOOR_TEST_Type *test)
+{
+	SIM_peerSendFrame(test->peer, UNLOCK_DOOR, ++test->seq, LINK_HOST_password, PASSWORD_SIZE);
+}
+
+static int Door_inState(void *context)
+{
+	DOOR_TEST_Type *test = (DOOR_TEST_Type *)context;
+
+	return *test->doorState == test->waitState;
+}
+
+/* Run until the door cycle reaches a state, return the time taken in ms or -1 */
+static double Door_wait(DOOR_TEST_Type *test, uint8_t state, uint64_t start)
+{
+	test->waitState = state;
+	if(!SIM_runUntil(Door_inState, test, DOOR_TEST_MOVE_NS))
+	{
+		return -1;
+	}
+	return (SIM_now() - start) / 1e6;
+}
+
+/*
+ * Description :
+ * Check the end of one move: its time against the profile and the position of the door.
+ */
+static void Door_checkMove(DOOR_TEST_Type *test, const DOOR_TEST_CaseType *item, const char *move,
+		double time_ms, uint32_t profile_ms, double end)
+{
+	PLANT_Type *plant = &test->plant;
+	double arrived = (item->sensors & PLANT_ENCODER) ? DOOR_TEST_ARRIVED_COUNTS : PLANT_OVERTRAVEL_COUNTS;
+
+	SIM_CHECK((time_ms > 0) && (time_ms < profile_ms), "%s: %s in %.0f ms, profile %lu ms", item->name, move,
+			time_ms, (unsigned long)profile_ms);
+	SIM_CHECK((fabs(plant->position - end) < arrived) && (plant->endStops == 0),
+			"%s: %s, stopped at %.1f counts without an end stop", item->name, move, plant->position);
+}
+
+/*
+ * Description :
+ * Check the DOOR_PROGRESS frames the peer received since the unlock: the gap between two
+ * frames, the states of the cycle in order, and no frame after the CLOSED one.
+ */
+static void Door_checkStream(DOOR_TEST_Type *test, const DOOR_TEST_CaseType *item, uint64_t start)
+{
+	uint8_t payload[PROTOCOL_MAX_PAYLOAD];
+	uint8_t type;
+	uint8_t seq;
+	uint8_t length;
+	uint64_t time;
+	uint64_t last = start;
+	uint64_t closed = 0;
+	uint32_t from = 0;
+	uint32_t frames = 0;
+	uint32_t after = 0;
+	uint8_t state = DOOR_STATE_OPENING;
+	uint8_t percent = 0xFF;
+	int ordered = 1;
+	double gap_ms = 0;
+	double rate;
+
+	while(SIM_peerNextFrame(test->peer, &from, &type, &seq, payload, &length, &time))
+	{
+		if((type != DOOR_PROGRESS) || (length < DOOR_PROGRESS_SIZE))
+		{
+			continue;
+		}
+		if(closed != 0)
+		{
+			after++;
+			continue;
+		}
+		if(payload[0] < state)
+		{
+			ordered = 0;
+		}
+		state = payload[0];
+		if((frames != 0) && ((time - last) / 1e6 > gap_ms))
+		{
+			gap_ms = (time - last) / 1e6;
+		}
+		last = time;
+		frames++;
+		if(state == DOOR_STATE_CLOSED)
+		{
+			closed = time;
+			percent = payload[1];
+		}
+	}
+
+	rate = (closed > start) ? frames * DOOR_TEST_PROGRESS_BYTES / ((closed - start) / 1e9) : 0;
+	SIM_CHECK((closed != 0) && ordered && (percent == 0), "%s: %lu DOOR_PROGRESS frames, opening to closed at 0%%",
+			item->name, (unsigned long)frames);
+	SIM_CHECK(gap_ms <= DOOR_TEST_PROGRESS_GAP_MS, "%s: %.1f ms at most between two frames, limit %u ms",
+			item->name, gap_ms, DOOR_TEST_PROGRESS_GAP_MS);
+	SIM_CHECK((rate > 0) && (rate < DOOR_TEST_PROGRESS_MAX_RATE), "%s: %.1f B/s in %.1f s, under 5%% of the 9600 line",
+			item->name, rate, (closed - start) / 1e9);
+	SIM_CHECK(after == 0, "%s: no frame after the door closed (%lu)", item->name, (unsigned long)after);
+}
+
+static void Test_cycle(const DOOR_TEST_CaseType *item)
+{
+	DOOR_TEST_Type test;
+	uint64_t start;
+	uint64_t unlock;
+	double open_ms;
+	double close_ms;
+
+	Door_start(&test, item->sensors);
+
+	start = SIM_now();
+	unlock = start;
+	Door_unlock(&test);
+	open_ms = Door_wait(&test, DOOR_STATE_HOLD, start);
+	Door_checkMove(&test, item, "opened", open_ms, DOOR_TEST_OPEN_MS, PLANT_TRAVEL_COUNTS);
+
+	start = SIM_now();
+	close_ms = Door_wait(&test, DOOR_STATE_CLOSED, start);
+	SIM_runUntil(PLANT_isStopped, &test.plant, SIM_MS(500));
+	Door_checkMove(&test, item, "closed after the hold", close_ms, DOOR_TEST_HOLD_MS + DOOR_TEST_CLOSE_MS, 0);
+
+	SIM_CHECK(PLANT_isStopped(&test.plant) && (test.plant.drive == PLANT_BRAKE),
+			"%s: the door stands still with the motor braked", item->name);
+	SIM_CHECK(test.plant.pluggings == 0, "%s: no drive against the motion", item->name);
+
+	SIM_run(DOOR_TEST_SILENT_NS);
+	Door_checkStream(&test, item, unlock);
+}
+
+static void Test_noSensors(void)
+{
+	DOOR_TEST_Type test;
+	uint64_t start;
+	double fault_ms;
+
+	Door_start(&test, 0);
+	start = SIM_now();
+	Door_unlock(&test);
+	fault_ms = Door_wait(&test, DOOR_STATE_FAULT, start);
+	SIM_runUntil(PLANT_isStopped, &test.plant, SIM_MS(500));
+	SIM_CHECK((fault_ms > 0) && (fault_ms <= DOOR_TEST_OPEN_MS + DOOR_CONTROL_STEP_MS),
+			"no sensors: fault at the end of the opening in %.0f ms, profile %u ms", fault_ms, DOOR_TEST_OPEN_MS);
+	SIM_CHECK(PLANT_isStopped(&test.plant), "no sensors: the door stands still at %.1f counts", test.plant.position);
+
+	SIM_run(SIM_MS(DOOR_TEST_HOLD_MS + DOOR_TEST_CLOSE_MS));
+	SIM_CHECK((*test.doorState == DOOR_STATE_FAULT) && PLANT_isStopped(&test.plant),
+			"no sensors: no hold and no closing after the fault");
+}
+
+int main(void)
+{
+	static const DOOR_TEST_CaseType cases[] =
+	{
+		{"encoder and switches", PLANT_ENCODER | PLANT_SWITCHES},
+		{"switches only", PLANT_SWITCHES},
+		{"encoder only", PLANT_ENCODER}
+	};
+	uint8_t i;
+
+	for(i = 0 ; i < sizeof(cases) / sizeof(cases[0]) ; i++)
+	{
+		Test_cycle(&cases[i]);
+	}
+	Test_noSensors();
+	return SIM_exitCode();
+}
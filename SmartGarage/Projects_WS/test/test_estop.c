@@ -0,0 +1,272 @@
+/******************************************************************************
+ *
+ * File Name: test_estop.c
+ *
+ * Description: Host test of the emergency stop. The HMI side of the link built with
+ * the HMI_ECU protocol sends the EMERGENCY_STOP frames to the real CONTROL_ECU,
+ * which drives the door model of plant.c. The key press is the mailbox command of
+ * the HMI side, the keypad scan of the HMI_ECU is not simulated.
+ * The stops come at random times while the door opens and closes, every fourth one
+ * races the obstacle beam on a closing door: the beam breaks from 150 ms before the
+ * key press, when the door already reopens, to 10 ms after it. For each stop the
+ * test checks:
+ * 1. The cycle ends as DOOR_STATE_STOPPED, also after the beam, and the HMI side gets it.
+ * 2. The key press to the brake of the motor, once the frame is received.
+ * 3. The standstill, the travel after the key press, and no drive after the stop.
+ * Then a request carrying the bytes of the EMERGENCY_STOP frame in its payload does
+ * not stop the moving door, and the key press after it still does.
+ *
+ *******************************************************************************/
+
+#include "sim.h"
+#include "plant.h"
+#include "link_host.h"
+#include "protocol.h"
+#include "door_control.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+#define ESTOP_STOPS                 200
+#define ESTOP_RACE_EVERY            4
+#define ESTOP_SEED                  18
+#define ESTOP_BOOT_NS               SIM_MS(200)
+#define ESTOP_REQUEST_NS            SIM_MS(500)
+#define ESTOP_STATE_NS              SIM_MS(15000)
+#define ESTOP_STOP_NS               SIM_MS(500)
+#define ESTOP_MOVE_TIME             40          /* Short moves, so the door cycles often */
+#define ESTOP_MAX_DELAY_MS          2000
+
+/* Race offsets of the beam from the key press, negative when the beam breaks first */
+#define ESTOP_RACE_MIN_MS           (-150)
+#define ESTOP_RACE_MAX_MS           10
+
+/* The 5 bytes of the frame at 9600, with one more byte time for the HMI side to start it */
+#define ESTOP_FRAME_US              (((PROTOCOL_HEADER_SIZE + PROTOCOL_CRC_SIZE + 1) * 10 * 1000000UL) / 9600)
+/* The full speed door until the frame is received, then its braking distance */
+#define ESTOP_TRAVEL_BUDGET         (PLANT_MAX_SPEED * (ESTOP_FRAME_US / 1e6 + PLANT_BRAKE_TAU_S) + 1)
+/* No drive after the stop for longer than the dead time and the hold */
+#define ESTOP_HELD_NS               SIM_MS(1000)
+
+typedef struct
+{
+	LINK_HOST_Type hmi;
+	SIM_NodeType *control;
+	PLANT_Type plant;
+	volatile uint8 *doorState;
+	uint8_t waitState;
+	uint64_t press;
+}ESTOP_TestType;
+
+/* Counts and worst case of each measure over the stops */
+typedef struct
+{
+	uint32_t stops;
+	uint32_t races;
+	uint32_t braked;
+	uint32_t stopped;
+	uint32_t held;
+	uint32_t ended;
+	uint32_t reported;
+	double brakeUs;
+	double stillMs;
+	double travel;
+}ESTOP_ResultType;
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
+
+static int Estop_unlock(ESTOP_TestType *test)
+{
+	return LINK_HOST_request(&test->hmi, UNLOCK_DOOR, LINK_HOST_password, PASSWORD_SIZE, ESTOP_REQUEST_NS) ==
+			DOOR_OPENING;
+}
+
+static int Estop_inState(void *context)
+{
+	ESTOP_TestType *test = (ESTOP_TestType *)context;
+
+	return *test->doorState == test->waitState;
+}
+
+static int Estop_isIdle(void *context)
+{
+	return *((ESTOP_TestType *)context)->hmi.command == LINK_APP_IDLE;
+}
+
+static void Estop_worst(double *worst, double value)
+{
+	if(value > *worst)
+	{
+		*worst = value;
+	}
+}
+
+/* Press the stop key: the HMI side sends the EMERGENCY_STOP frames */
+static void Estop_press(ESTOP_TestType *test)
+{
+	test->press = SIM_now();
+	*test->hmi.command = LINK_APP_EMERGENCY_STOP;
+}
+
+/*
+ * Description :
+ * Run a random time of the door cycle, then until the motor drives the door.
+ * Return 0 if the cycle ended first, the door is unlocked again for the next try.
+ */
+static int Estop_moving(ESTOP_TestType *test, uint32_t time_ms)
+{
+	SIM_run(SIM_MS(rand() % time_ms));
+	if(!PLANT_isDriven(&test->plant) && !SIM_runUntil(PLANT_isDriven, &test->plant, SIM_MS(500)))
+	{
+		if(*test->doorState == DOOR_STATE_CLOSED)
+		{
+			Estop_unlock(test);
+		}
+		return 0;
+	}
+	return 1;
+}
+
+/*
+ * Description :
+ * Press the stop key on the moving door, with the beam at an offset for a race,
+ * and follow the door until the cycle ends.
+ */
+static void Estop_stop(ESTOP_TestType *test, ESTOP_ResultType *result, int race, int32_t offset_ms)
+{
+	PLANT_Type *plant = &test->plant;
+	double position;
+
+	result->stops++;
+	if(race)
+	{
+		result->races++;
+		if(offset_ms < 0)
+		{
+			plant->obstacle = 1;
+			SIM_run(SIM_MS(-offset_ms));
+		}
+	}
+	position = plant->position;
+	Estop_press(test);
+	if(race && (offset_ms >= 0))
+	{
+		SIM_run(SIM_MS(offset_ms));
+		plant->obstacle = 1;
+	}
+
+	/* The cycle ends once the frame is received: the motor is braked from then on */
+	test->waitState = DOOR_STATE_STOPPED;
+	if(SIM_runUntil(Estop_inState, test, ESTOP_STOP_NS))
+	{
+		result->ended++;
+	}
+	if(plant->drive == PLANT_BRAKE)
+	{
+		result->braked++;
+		if(plant->driveTime > test->press)
+		{
+			Estop_worst(&result->brakeUs, (plant->driveTime - test->press) / 1e3);
+		}
+	}
+	if(SIM_runUntil(PLANT_isStopped, plant, ESTOP_STOP_NS))
+	{
+		result->stopped++;
+		Estop_worst(&result->stillMs, (SIM_now() - test->press) / 1e6);
+		Estop_worst(&result->travel, fabs(plant->position - position));
+	}
+	if(!SIM_runUntil(PLANT_isDriven, plant, ESTOP_HELD_NS))
+	{
+		result->held++;
+	}
+	if((*test->hmi.notifyType == DOOR_PROGRESS) && (test->hmi.notify[0] == DOOR_STATE_STOPPED))
+	{
+		result->reported++;
+	}
+	plant->obstacle = 0;
+	SIM_runUntil(Estop_isIdle, test, ESTOP_REQUEST_NS);
+	Estop_unlock(test);
+}
+
+int main(void)
+{
+	static const uint8_t params[PARAMS_SIZE] = {ESTOP_MOVE_TIME, 2, ESTOP_MOVE_TIME, 3, 100, 60};
+	ESTOP_TestType test;
+	ESTOP_ResultType result = {0};
+	int race;
+	int32_t offset_ms = 0;
+	uint8_t hidden[PARAMS_SIZE];
+	uint16_t reply;
+
+	srand(ESTOP_SEED);
+	SIM_init();
+	LINK_HOST_addHmi(&test.hmi, "build/link_hmi.so");
+	test.control = LINK_HOST_addControl("build/control.so");
+	LINK_HOST_setParams(test.control, params, PARAMS_SIZE);
+	SIM_connect(test.hmi.node, test.control);
+	PLANT_init(&test.plant, test.control, 0, PLANT_ENCODER | PLANT_SWITCHES);
+	test.doorState = SIM_symbol(test.control, "g_doorState");
+	SIM_run(ESTOP_BOOT_NS);
+
+	SIM_CHECK(Estop_unlock(&test), "the door opens on the password");
+	while(result.stops < ESTOP_STOPS)
+	{
+		race = ((result.stops % ESTOP_RACE_EVERY) == ESTOP_RACE_EVERY - 1);
+		if(race)
+		{
+			/* The beam works on a closing door only */
+			test.waitState = DOOR_STATE_CLOSING;
+			if(!SIM_runUntil(Estop_inState, &test, ESTOP_STATE_NS))
+			{
+				break;
+			}
+			offset_ms = ESTOP_RACE_MIN_MS + rand() % (ESTOP_RACE_MAX_MS - ESTOP_RACE_MIN_MS + 1);
+		}
+		if(!Estop_moving(&test, ESTOP_MAX_DELAY_MS) ||
+				(race && (*test.doorState != DOOR_STATE_CLOSING)))
+		{
+			continue;
+		}
+		Estop_stop(&test, &result, race, offset_ms);
+	}
+
+	printf("%lu stops, %lu of them racing the obstacle beam\n", (unsigned long)result.stops,
+			(unsigned long)result.races);
+	printf("worst: key to brake %.1f us, key to standstill %.1f ms, travel %.1f counts\n",
+			result.brakeUs, result.stillMs, result.travel);
+
+	SIM_CHECK(result.stops == ESTOP_STOPS, "%lu of %u stops while the door moves",
+			(unsigned long)result.stops, ESTOP_STOPS);
+	SIM_CHECK((result.braked == result.stops) && (result.brakeUs <= ESTOP_FRAME_US),
+			"%lu stops braked, worst key to brake %.1f us, budget %lu us", (unsigned long)result.braked,
+			result.brakeUs, ESTOP_FRAME_US);
+	SIM_CHECK((result.stopped == result.stops) && (result.travel <= ESTOP_TRAVEL_BUDGET),
+			"%lu doors stopped, worst travel after the key %.1f counts, budget %.0f", (unsigned long)result.stopped,
+			result.travel, ESTOP_TRAVEL_BUDGET);
+	SIM_CHECK(result.held == result.stops, "%lu doors not driven again after the stop", (unsigned long)result.held);
+	SIM_CHECK(result.ended == result.stops, "%lu cycles ended as stopped", (unsigned long)result.ended);
+	SIM_CHECK(result.reported == result.stops, "%lu stops reported to the HMI", (unsigned long)result.reported);
+	SIM_CHECK(test.plant.pluggings == 0, "no drive against the motion");
+
+	/* A PARAMS_SET block made of the EMERGENCY_STOP frame, rejected for its speed */
+	hidden[0] = PROTOCOL_START_BYTE;
+	hidden[1] = EMERGENCY_STOP;
+	hidden[2] = PROTOCOL_NO_SEQ;
+	hidden[3] = 0;
+	hidden[4] = SIM_crc8(SIM_crc8(SIM_crc8(0, hidden[1]), hidden[2]), hidden[3]);
+	hidden[5] = 0;
+	SIM_runUntil(Estop_isIdle, &test, ESTOP_REQUEST_NS);
+	SIM_runUntil(PLANT_isDriven, &test.plant, ESTOP_STOP_NS);
+	reply = LINK_HOST_request(&test.hmi, PARAMS_SET, hidden, PARAMS_SIZE, ESTOP_REQUEST_NS);
+	SIM_CHECK((reply == PARAMS_REJECTED) && (*test.doorState != DOOR_STATE_STOPPED) && PLANT_isDriven(&test.plant),
+			"EMERGENCY_STOP bytes in a payload: the door goes on (reply 0x%02X, state %u)", reply, *test.doorState);
+	Estop_press(&test);
+	test.waitState = DOOR_STATE_STOPPED;
+	SIM_CHECK(SIM_runUntil(Estop_inState, &test, ESTOP_STOP_NS), "the key press after it stops the door");
+	return SIM_exitCode();
+}
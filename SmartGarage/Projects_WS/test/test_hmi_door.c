@@ -0,0 +1,150 @@
+/******************************************************************************
+ *
+ * File Name: test_hmi_door.c
+ *
+ * Description: Host test of the door cycle screens of the HMI_ECU when the link is
+ * lost. The real HMI_ECU and CONTROL_ECU run on one link, the keys are typed on the
+ * keypad model of keys.c. The door is opened, then the line from the CONTROL_ECU is cut:
+ * 1. The healthy cycle sends no request, the screens follow the DOOR_PROGRESS stream.
+ * 2. The silent stream gives DOOR_STATUS requests and their retries, then the cycle
+ *    ends as DOOR_STATE_LINK_LOST within its bound, never as DOOR_STATE_CLOSED.
+ * 3. The stop key sends the EMERGENCY_STOP frames at once while the DOOR_STATUS
+ *    request waits for its reply and while the "Link Lost" message is shown.
+ *
+ *******************************************************************************/
+
+#include "sim.h"
+#include "keys.h"
+#include "link_host.h"
+#include "protocol.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+#define HMI_DOOR_TEST_SEED          19
+#define HMI_DOOR_TEST_BOOT_NS       SIM_MS(1000)
+#define HMI_DOOR_TEST_REPLY_NS      SIM_MS(500)
+#define HMI_DOOR_TEST_HEALTHY_NS    SIM_MS(2000)
+#define HMI_DOOR_TEST_STOP_KEY      13
+/* The silence, the first DOOR_STATUS at the next period, its retries and the last period */
+#define HMI_DOOR_TEST_LOST_MS       (DOOR_PROGRESS_TIMEOUT_MS + (PROTOCOL_MAX_RETRIES + 2) * DOOR_PROGRESS_PERIOD_MS)
+/* Stop key: the press debounce of the keypad scan (28 ms at most in test_keypad), then the first byte */
+#define HMI_DOOR_TEST_STOP_NS       SIM_MS(35)
+/* DOOR_MESSAGE_TIME_MS of the HMI_ECU main.c */
+#define HMI_DOOR_TEST_MESSAGE_MS    1000
+
+typedef struct
+{
+	SIM_NodeType *hmi;
+	SIM_NodeType *control;
+	KEYS_Type keys;
+	volatile uint8 *doorState;
+	volatile uint8 *statusSeq;
+	volatile uint8 *busy;
+	uint8_t sawClosed;
+	/* First byte sent by the HMI_ECU after the stop key press */
+	uint32_t sentAtPress;
+	uint64_t press;
+	uint64_t firstByte;
+}HMI_DOOR_TestType;
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
+
+static void Door_type(HMI_DOOR_TestType *test, const uint8_t *values, uint8_t count)
+{
+	KEYS_type(&test->keys, values, count);
+	SIM_run(HMI_DOOR_TEST_REPLY_NS);
+}
+
+static void Door_watch(void *context, uint64_t now)
+{
+	HMI_DOOR_TestType *test = (HMI_DOOR_TestType *)context;
+
+	test->sawClosed |= (*test->doorState == DOOR_STATE_CLOSED);
+	if((test->press != 0) && (test->firstByte == 0) && (test->hmi->tx.sent != test->sentAtPress))
+	{
+		test->firstByte = now;
+	}
+}
+
+static int Door_isLost(void *context)
+{
+	return *((HMI_DOOR_TestType *)context)->doorState == DOOR_STATE_LINK_LOST;
+}
+
+/* Press the stop key, return the time to the first byte sent or 0 if none is sent */
+static uint64_t Door_stop(HMI_DOOR_TestType *test)
+{
+	static const uint8_t stop = HMI_DOOR_TEST_STOP_KEY;
+	uint64_t elapsed;
+
+	test->sentAtPress = test->hmi->tx.sent;
+	test->press = SIM_now();
+	test->firstByte = 0;
+	KEYS_type(&test->keys, &stop, 1);
+	elapsed = (test->firstByte == 0) ? 0 : test->firstByte - test->press;
+	test->press = 0;
+	return elapsed;
+}
+
+int main(void)
+{
+	static HMI_DOOR_TestType test;
+	static const uint8_t password[] = {1, 2, 4, 5, '='};
+	static const uint8_t open[] = {'+', 1, 2, 4, 5, '='};
+	uint32_t sent;
+	uint64_t cut;
+	uint64_t lost;
+	uint64_t stop;
+
+	srand(HMI_DOOR_TEST_SEED);
+	SIM_init();
+	test.control = LINK_HOST_addControl("build/control.so");
+	test.hmi = SIM_addNode("HMI", "build/hmi.so", "hmi_main");
+	SIM_connect(test.hmi, test.control);
+	KEYS_init(&test.keys, test.hmi);
+	test.doorState = SIM_symbol(test.hmi, "g_doorState");
+	test.statusSeq = SIM_symbol(test.hmi, "g_statusSeq");
+	test.busy = SIM_symbol(test.hmi, "g_busy");
+	SIM_addDevice(Door_watch, &test);
+	SIM_run(HMI_DOOR_TEST_BOOT_NS);
+
+	/* New password, then open the door */
+	Door_type(&test, password, sizeof(password));
+	Door_type(&test, password, sizeof(password));
+	Door_type(&test, open, sizeof(open));
+
+	sent = test.hmi->tx.sent;
+	SIM_run(HMI_DOOR_TEST_HEALTHY_NS);
+	SIM_CHECK(*test.busy && (*test.doorState == DOOR_STATE_OPENING) && (test.hmi->tx.sent == sent),
+			"healthy cycle: opening shown, %u bytes sent by the HMI_ECU", (unsigned)(test.hmi->tx.sent - sent));
+
+	/* The HMI_ECU hears a silent peer from now on, the CONTROL_ECU still hears the HMI_ECU */
+	SIM_addPeer(test.hmi, SIM_BIT_NS(9600));
+	cut = SIM_now();
+	SIM_run(SIM_MS(DOOR_PROGRESS_TIMEOUT_MS + DOOR_PROGRESS_PERIOD_MS + DOOR_PROGRESS_PERIOD_MS / 2));
+	SIM_CHECK(*test.statusSeq != PROTOCOL_NO_SEQ, "silent stream: DOOR_STATUS asked, waiting for its reply");
+	stop = Door_stop(&test);
+	SIM_CHECK((stop != 0) && (stop <= HMI_DOOR_TEST_STOP_NS),
+			"stop key while DOOR_STATUS waits: first byte after %.1f ms (limit %.1f ms)", stop / 1e6,
+			HMI_DOOR_TEST_STOP_NS / 1e6);
+
+	SIM_runUntil(Door_isLost, &test, SIM_MS(HMI_DOOR_TEST_LOST_MS));
+	lost = SIM_now() - cut;
+	SIM_CHECK(Door_isLost(&test) && !test.sawClosed, "link lost: shown after %.0f ms (limit %u ms), never as closed",
+			lost / 1e6, HMI_DOOR_TEST_LOST_MS);
+
+	SIM_run(SIM_MS(HMI_DOOR_TEST_MESSAGE_MS / 2));
+	SIM_CHECK(*test.busy, "link lost: the message is shown");
+	stop = Door_stop(&test);
+	SIM_CHECK((stop != 0) && (stop <= HMI_DOOR_TEST_STOP_NS),
+			"stop key during the message: first byte after %.1f ms (limit %.1f ms)", stop / 1e6,
+			HMI_DOOR_TEST_STOP_NS / 1e6);
+	SIM_run(SIM_MS(HMI_DOOR_TEST_MESSAGE_MS));
+	SIM_CHECK(!*test.busy && !test.sawClosed, "link lost: the door screen ends after the message");
+	return SIM_exitCode();
+}
@@ -0,0 +1,365 @@
+/******************************************************************************
+ *
+ * File Name: test_keypad.c
+ *
+ * Description: Host test of the background keypad scan of the HMI_ECU, on the keypad
+ * model of keys.c. The test checks:
+ * 1. The functional value of each of the 16 keys.
+ * 2. Random presses with bounce: one press and one release event for each of them,
+ *    one long press event for the keys held over KEYPAD_LONG_PRESS_MS, and the time
+ *    from the key to its press event.
+ * 3. A full event queue keeps its oldest events and drops the new ones.
+ * 4. Fast typing read with KEYPAD_getPressedKey: each press returned once, none lost,
+ *    and a key held down returned once.
+ * 5. The key wait powers the MCU down after KEYPAD_SLEEP_DELAY_MS without a key, and
+ *    the key that wakes it is returned. Key sessions at random times over
+ *    KEYPAD_TEST_RUN_S give the time spent powered down, in idle sleep and running.
+ *
+ *******************************************************************************/
+
+#include "sim.h"
+#include "keys.h"
+#include "keypad_app.h"
+#include "keypad.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+#define KEYPAD_TEST_SEED            21
+#define KEYPAD_TEST_PRESSES         500
+#define KEYPAD_TEST_BOOT_NS         SIM_MS(10)
+
+/* Holds away from the long press time by more than the debounce and the bounce */
+#define KEYPAD_TEST_MIN_HOLD_MS     40
+#define KEYPAD_TEST_MAX_SHORT_MS    (KEYPAD_LONG_PRESS_MS - 100)
+#define KEYPAD_TEST_MIN_LONG_MS     (KEYPAD_LONG_PRESS_MS + 100)
+#define KEYPAD_TEST_MAX_LONG_MS     1500
+#define KEYPAD_TEST_MIN_GAP_MS      30
+#define KEYPAD_TEST_MAX_GAP_MS      200
+#define KEYPAD_TEST_SETTLE_NS       SIM_MS(100)
+
+/* Fast typing: short holds and gaps, about 12 keys a second */
+#define KEYPAD_TEST_MIN_TYPING_MS   35
+#define KEYPAD_TEST_MAX_TYPING_MS   65
+#define KEYPAD_TEST_TYPING_GAP_MS   35
+#define KEYPAD_TEST_HELD_MS         3000
+
+/* Sessions of key presses, one starts at a random time in each slot of the run */
+#define KEYPAD_TEST_RUN_S           600
+#define KEYPAD_TEST_SESSIONS        10
+#define KEYPAD_TEST_SESSION_KEYS    7
+#define KEYPAD_TEST_SLOT_S          (KEYPAD_TEST_RUN_S / KEYPAD_TEST_SESSIONS)
+#define KEYPAD_TEST_MIN_SESSION_HOLD_MS 60
+#define KEYPAD_TEST_MAX_SESSION_HOLD_MS 200
+#define KEYPAD_TEST_MIN_SESSION_GAP_MS  200
+#define KEYPAD_TEST_MAX_SESSION_GAP_MS  800
+/* Longest awake time of a session: its keys, then the quiet delay, with 1 s to spare */
+#define KEYPAD_TEST_MAX_AWAKE_MS    (KEYPAD_TEST_SESSION_KEYS * \
+	(KEYPAD_TEST_MAX_SESSION_HOLD_MS + KEYPAD_TEST_MAX_SESSION_GAP_MS) + KEYPAD_SLEEP_DELAY_MS + 1000)
+
+/* The debounce samples after one sample period to reach the key, after the bounce */
+#define KEYPAD_TEST_LATENCY_BUDGET_MS \
+	((KEYPAD_DEBOUNCE_SAMPLES + 1) * KEYPAD_SAMPLE_PERIOD_MS + KEYS_MAX_BOUNCE_US / 1000)
+
+typedef struct
+{
+	SIM_NodeType *hmi;
+	volatile uint8 *mode;
+	KEYPAD_EventType *log;
+	volatile uint16 *logCount;
+	uint64_t time[KEYPAD_APP_LOG_SIZE];
+	uint16_t stamped;
+	KEYS_Type keys;
+}KEYPAD_TestType;
+
+typedef struct
+{
+	uint8_t key;
+	uint8_t isLong;
+	uint64_t start;
+}KEYPAD_PressType;
+
+/*******************************************************************************
+ *                           Global Variables                                  *
+ *******************************************************************************/
+
+static KEYPAD_PressType g_presses[KEYPAD_TEST_PRESSES];
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
+
+/* Time of the new events of the log, called every quantum */
+static void Keypad_stamp(void *context, uint64_t now)
+{
+	KEYPAD_TestType *test = (KEYPAD_TestType *)context;
+
+	while(test->stamped < *test->logCount)
+	{
+		test->time[test->stamped++] = now;
+	}
+}
+
+static void Keypad_boot(KEYPAD_TestType *test)
+{
+	SIM_init();
+	test->hmi = SIM_addNode("HMI", "build/keypad_app.so", "keypad_main");
+	test->mode = SIM_symbol(test->hmi, "g_mode");
+	test->log = SIM_symbol(test->hmi, "g_log");
+	test->logCount = SIM_symbol(test->hmi, "g_logCount");
+	test->stamped = 0;
+	KEYS_init(&test->keys, test->hmi);
+	SIM_addDevice(Keypad_stamp, test);
+	SIM_run(KEYPAD_TEST_BOOT_NS);
+}
+
+static int Keypad_isEvent(const KEYPAD_TestType *test, uint16_t index, uint8_t key, KEYPAD_EventKind kind)
+{
+	return (index < *test->logCount) && (test->log[index].key == key) && (test->log[index].kind == kind);
+}
+
+static void Test_values(KEYPAD_TestType *test)
+{
+	uint16_t start;
+	uint8_t matched = 0;
+	uint8_t key;
+
+	Keypad_boot(test);
+	for(key = 0 ; key < KEYS_COUNT ; key++)
+	{
+		start = *test->logCount;
+		KEYS_press(&test->keys, key, SIM_MS(100), SIM_MS(100));
+		if((*test->logCount == start + 2) && Keypad_isEvent(test, start, KEYS_values[key], KEYPAD_PRESS) &&
+				Keypad_isEvent(test, start + 1, KEYS_values[key], KEYPAD_RELEASE))
+		{
+			matched++;
+		}
+	}
+	SIM_CHECK(matched == KEYS_COUNT, "%u of %u keys give their functional value", matched, KEYS_COUNT);
+}
+
+static void Test_random(KEYPAD_TestType *test)
+{
+	uint32_t matched = 0;
+	uint32_t longs = 0;
+	uint32_t longMatched = 0;
+	double latencyMs;
+	double totalMs = 0;
+	double worstMs = 0;
+	uint16_t index = 0;
+	uint16_t i;
+
+	Keypad_boot(test);
+	for(i = 0 ; i < KEYPAD_TEST_PRESSES ; i++)
+	{
+		KEYPAD_PressType *press = &g_presses[i];
+		uint64_t hold_ms;
+
+		press->key = (uint8_t)KEYS_random(0, KEYS_COUNT - 1);
+		press->isLong = (rand() % 5) == 0;
+		hold_ms = press->isLong ? KEYS_random(KEYPAD_TEST_MIN_LONG_MS, KEYPAD_TEST_MAX_LONG_MS) :
+				KEYS_random(KEYPAD_TEST_MIN_HOLD_MS, KEYPAD_TEST_MAX_SHORT_MS);
+		press->start = SIM_now();
+		KEYS_press(&test->keys, press->key, SIM_MS(hold_ms), SIM_MS(KEYS_random(KEYPAD_TEST_MIN_GAP_MS,
+				KEYPAD_TEST_MAX_GAP_MS)));
+	}
+	SIM_run(KEYPAD_TEST_SETTLE_NS);
+
+	/* Each press: its press event, a long press event only if held long enough, its release event */
+	for(i = 0 ; i < KEYPAD_TEST_PRESSES ; i++)
+	{
+		const KEYPAD_PressType *press = &g_presses[i];
+		uint8_t value = KEYS_values[press->key];
+
+		if(!Keypad_isEvent(test, index, value, KEYPAD_PRESS))
+		{
+			break;
+		}
+		latencyMs = (test->time[index] - press->start) / 1e6;
+		totalMs += latencyMs;
+		if(latencyMs > worstMs)
+		{
+			worstMs = latencyMs;
+		}
+		index++;
+		if(press->isLong)
+		{
+			longs++;
+			if(!Keypad_isEvent(test, index, value, KEYPAD_LONG_PRESS))
+			{
+				break;
+			}
+			longMatched++;
+			index++;
+		}
+		if(!Keypad_isEvent(test, index, value, KEYPAD_RELEASE))
+		{
+			break;
+		}
+		index++;
+		matched++;
+	}
+
+	printf("%u presses, %lu held over %u ms, press to event %.1f ms average, %.1f ms worst\n",
+			KEYPAD_TEST_PRESSES, (unsigned long)longs, KEYPAD_LONG_PRESS_MS, totalMs / KEYPAD_TEST_PRESSES, worstMs);
+	SIM_CHECK((matched == KEYPAD_TEST_PRESSES) && (index == *test->logCount),
+			"%lu of %u bouncing presses give exactly one press and one release event",
+			(unsigned long)matched, KEYPAD_TEST_PRESSES);
+	SIM_CHECK(longMatched == longs, "%lu of %lu long holds give one long press event",
+			(unsigned long)longMatched, (unsigned long)longs);
+	SIM_CHECK(worstMs <= KEYPAD_TEST_LATENCY_BUDGET_MS, "worst press to event %.1f ms, budget %u ms",
+			worstMs, KEYPAD_TEST_LATENCY_BUDGET_MS);
+}
+
+static void Test_overflow(KEYPAD_TestType *test)
+{
+	uint8_t ordered = 1;
+	uint8_t key;
+	uint16_t i;
+
+	/* Nothing reads the queue: the first KEYPAD_QUEUE_SIZE - 1 events are kept */
+	Keypad_boot(test);
+	*test->mode = KEYPAD_APP_PAUSED;
+	for(key = 0 ; key < KEYPAD_QUEUE_SIZE ; key++)
+	{
+		KEYS_press(&test->keys, key, SIM_MS(100), SIM_MS(100));
+	}
+	*test->mode = KEYPAD_APP_EVENTS;
+	SIM_run(KEYPAD_TEST_SETTLE_NS);
+	for(i = 0 ; i < *test->logCount ; i++)
+	{
+		if(!Keypad_isEvent(test, i, KEYS_values[i / 2], (i & 1) ? KEYPAD_RELEASE : KEYPAD_PRESS))
+		{
+			ordered = 0;
+		}
+	}
+	SIM_CHECK((*test->logCount == KEYPAD_QUEUE_SIZE - 1) && ordered,
+			"full queue: the %u oldest of %u events kept in order, got %u", KEYPAD_QUEUE_SIZE - 1,
+			2 * KEYPAD_QUEUE_SIZE, *test->logCount);
+
+	/* The keys work again once the queue is read */
+	KEYS_press(&test->keys, 0, SIM_MS(100), SIM_MS(100));
+	SIM_CHECK((*test->logCount == KEYPAD_QUEUE_SIZE + 1) &&
+			Keypad_isEvent(test, KEYPAD_QUEUE_SIZE - 1, KEYS_values[0], KEYPAD_PRESS) &&
+			Keypad_isEvent(test, KEYPAD_QUEUE_SIZE, KEYS_values[0], KEYPAD_RELEASE),
+			"full queue: the next press after the read gives its two events");
+}
+
+static void Test_typing(KEYPAD_TestType *test)
+{
+	uint32_t matched = 0;
+	uint64_t start;
+	uint16_t i;
+
+	Keypad_boot(test);
+	*test->mode = KEYPAD_APP_PRESSED_KEY;
+	start = SIM_now();
+	for(i = 0 ; i < KEYPAD_TEST_PRESSES ; i++)
+	{
+		g_presses[i].key = (uint8_t)KEYS_random(0, KEYS_COUNT - 1);
+		KEYS_press(&test->keys, g_presses[i].key, SIM_MS(KEYS_random(KEYPAD_TEST_MIN_TYPING_MS,
+				KEYPAD_TEST_MAX_TYPING_MS)), SIM_MS(KEYPAD_TEST_TYPING_GAP_MS));
+	}
+	SIM_run(KEYPAD_TEST_SETTLE_NS);
+	for(i = 0 ; i < KEYPAD_TEST_PRESSES ; i++)
+	{
+		if(Keypad_isEvent(test, i, KEYS_values[g_presses[i].key], KEYPAD_PRESS))
+		{
+			matched++;
+		}
+	}
+	printf("%u presses typed at %.1f keys/s\n", KEYPAD_TEST_PRESSES,
+			KEYPAD_TEST_PRESSES / ((SIM_now() - start - KEYPAD_TEST_SETTLE_NS) / 1e9));
+	SIM_CHECK((matched == KEYPAD_TEST_PRESSES) && (*test->logCount == KEYPAD_TEST_PRESSES),
+			"fast typing: %lu of %u presses returned once, %u keys returned", (unsigned long)matched,
+			KEYPAD_TEST_PRESSES, *test->logCount);
+
+	/* A key held down is returned once, the next one only after its release */
+	KEYS_press(&test->keys, 0, SIM_MS(KEYPAD_TEST_HELD_MS), SIM_MS(KEYPAD_TEST_TYPING_GAP_MS));
+	KEYS_press(&test->keys, 0, SIM_MS(KEYPAD_TEST_MIN_TYPING_MS), KEYPAD_TEST_SETTLE_NS);
+	SIM_CHECK(*test->logCount == KEYPAD_TEST_PRESSES + 2, "key held %u ms then pressed again: returned %u times",
+			KEYPAD_TEST_HELD_MS, *test->logCount - KEYPAD_TEST_PRESSES);
+}
+
+static void Test_sleep(KEYPAD_TestType *test)
+{
+	const uint8_t rows = (1 << KEYPAD_NUM_ROWS) - 1;
+	uint64_t start;
+	uint64_t sessionStart;
+	uint64_t elapsed;
+	uint32_t matched = 0;
+	uint16_t count = 0;
+	uint8_t session;
+	uint8_t i;
+
+	Keypad_boot(test);
+	*test->mode = KEYPAD_APP_PRESSED_KEY;
+	SIM_run(SIM_MS(KEYPAD_SLEEP_DELAY_MS - 100));
+	SIM_CHECK((test->hmi->sleepTime[SIM_SLEEP_POWER_DOWN] == 0) && (test->hmi->sleepTime[SIM_SLEEP_IDLE] != 0),
+			"quiet keypad for %u ms: idle sleep only", KEYPAD_SLEEP_DELAY_MS - 100);
+	SIM_run(SIM_MS(200));
+	SIM_CHECK((test->hmi->sleepMode == SIM_SLEEP_POWER_DOWN) && (test->hmi->reg8[STUB_TCCR0] == 0) &&
+			((test->hmi->reg8[STUB_DDRB] & rows) == rows),
+			"quiet keypad for %u ms: powered down, Timer0 stopped and all the rows driven", KEYPAD_SLEEP_DELAY_MS + 100);
+
+	start = SIM_now();
+	KEYS_press(&test->keys, 5, SIM_MS(100), SIM_MS(100));
+	SIM_CHECK((*test->logCount == 1) && Keypad_isEvent(test, 0, KEYS_values[5], KEYPAD_PRESS) &&
+			((test->time[0] - start) <= SIM_MS(KEYPAD_TEST_LATENCY_BUDGET_MS)),
+			"the key that wakes the MCU is returned after %.1f ms, budget %u ms",
+			(test->time[0] - start) / 1e6, KEYPAD_TEST_LATENCY_BUDGET_MS);
+
+	/* Sessions of key presses over the run, the sleep times are counted from here */
+	Keypad_boot(test);
+	*test->mode = KEYPAD_APP_PRESSED_KEY;
+	start = SIM_now();
+	for(session = 0 ; session < KEYPAD_TEST_SESSIONS ; session++)
+	{
+		sessionStart = start + SIM_MS(1000ULL * session * KEYPAD_TEST_SLOT_S) +
+				SIM_MS(KEYS_random(0, 1000ULL * KEYPAD_TEST_SLOT_S / 2));
+		SIM_run(sessionStart - SIM_now());
+		for(i = 0 ; i < KEYPAD_TEST_SESSION_KEYS ; i++)
+		{
+			g_presses[count].key = (uint8_t)KEYS_random(0, KEYS_COUNT - 1);
+			KEYS_press(&test->keys, g_presses[count].key,
+					SIM_MS(KEYS_random(KEYPAD_TEST_MIN_SESSION_HOLD_MS, KEYPAD_TEST_MAX_SESSION_HOLD_MS)),
+					SIM_MS(KEYS_random(KEYPAD_TEST_MIN_SESSION_GAP_MS, KEYPAD_TEST_MAX_SESSION_GAP_MS)));
+			count++;
+		}
+	}
+	SIM_run(start + SIM_MS(1000ULL * KEYPAD_TEST_RUN_S) - SIM_now());
+	elapsed = SIM_now() - start;
+
+	for(i = 0 ; i < count ; i++)
+	{
+		if(Keypad_isEvent(test, i, KEYS_values[g_presses[i].key], KEYPAD_PRESS))
+		{
+			matched++;
+		}
+	}
+	printf("%u s with %u sessions of %u keys: powered down %.1f%%, idle sleep %.1f%%, running %.2f%%\n",
+			KEYPAD_TEST_RUN_S, KEYPAD_TEST_SESSIONS, KEYPAD_TEST_SESSION_KEYS,
+			100.0 * test->hmi->sleepTime[SIM_SLEEP_POWER_DOWN] / elapsed,
+			100.0 * test->hmi->sleepTime[SIM_SLEEP_IDLE] / elapsed,
+			100.0 * (elapsed - test->hmi->sleepTime[SIM_SLEEP_POWER_DOWN] - test->hmi->sleepTime[SIM_SLEEP_IDLE]) /
+			elapsed);
+	SIM_CHECK((matched == count) && (*test->logCount == count),
+			"sessions: %lu of %u keys returned, the keys that wake the MCU included", (unsigned long)matched, count);
+	SIM_CHECK(test->hmi->sleepTime[SIM_SLEEP_POWER_DOWN] >= elapsed - SIM_MS((uint64_t)KEYPAD_TEST_SESSIONS *
+			KEYPAD_TEST_MAX_AWAKE_MS), "sessions: powered down outside of the sessions and their quiet delay");
+}
+
+int main(void)
+{
+	static KEYPAD_TestType test;
+
+	srand(KEYPAD_TEST_SEED);
+	Test_values(&test);
+	Test_random(&test);
+	Test_overflow(&test);
+	Test_typing(&test);
+	Test_sleep(&test);
+	return SIM_exitCode();
+}
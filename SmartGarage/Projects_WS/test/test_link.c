@@ -0,0 +1,319 @@
+/******************************************************************************
+ *
+ * File Name: test_link.c
+ *
+ * Description: Fault injection test of the link between link_hmi.c and the real
+ * CONTROL_ECU, at each rate of the UBRR table:
+ * 1. One corrupted request and one corrupted long reply: one CRC error, one retry, no fall back.
+ * 2. A lost START byte, a lost byte in the frame and a duplicated byte: one retry, no fall back.
+ * 3. A reset of the CONTROL_ECU: the HMI gets its reply after its retries and the resync,
+ *    within the timeouts of the protocol.
+ * 4. A reset of the HMI side: the CONTROL_ECU falls back on the framing errors of the
+ *    base rate bytes and the negotiation finds the fastest rate again.
+ * 5. The resync preamble alone moves a CONTROL_ECU left at a faster rate to the base rate.
+ * 6. A scripted peer retries each request of a full send window after the last one:
+ *    every retry gets the cached reply of its own sequence number and is not handled again.
+ *
+ *******************************************************************************/
+
+#include "sim.h"
+#include "link_host.h"
+#include "protocol.h"
+#include <stdio.h>
+#include <string.h>
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+#define LINK_TEST_BOOT_NS           SIM_MS(200)
+#define LINK_TEST_TIMEOUT_NS        SIM_MS(2000)
+/* Scheduler tick rounding of each timeout, and the processing of both ECUs */
+#define LINK_TEST_SLACK_US          5000UL
+#define LINK_TEST_REQUEST_SIZE      (PROTOCOL_HEADER_SIZE + PASSWORD_SIZE + PROTOCOL_CRC_SIZE)
+
+typedef struct
+{
+	LINK_HOST_Type hmi;
+	SIM_NodeType *control;
+}LINK_TEST_Type;
+
+/* One reply read by the scripted peer */
+typedef struct
+{
+	uint8_t type;
+	uint8_t seq;
+	uint8_t payload[PROTOCOL_MAX_PAYLOAD];
+	uint8_t length;
+}LINK_TEST_ReplyType;
+
+/*******************************************************************************
+ *                           Global Variables                                  *
+ *******************************************************************************/
+static const uint32_t g_rates[UART_BAUD_COUNT] = {9600, 19200, 38400, 76800, 250000};
+static const char *const g_faultNames[] = {"lost START byte", "lost byte in the frame", "duplicated byte"};
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
+
+static uint32_t Link_byteUs(uint8_t rate)
+{
+	return (uint32_t)UART_BYTE_TIME_US(g_rates[rate]);
+}
+
+/* Reply timeout of one attempt of a CHECK_PASSWORD request, like PROTOCOL_replyTimeout */
+static uint32_t Link_timeoutUs(uint8_t rate)
+{
+	uint32_t bytes = LINK_TEST_REQUEST_SIZE + PROTOCOL_HEADER_SIZE + PROTOCOL_MAX_PAYLOAD + PROTOCOL_CRC_SIZE;
+
+	return ((bytes * Link_byteUs(rate) + 999) / 1000 + PROTOCOL_PROCESSING_TIME_MS) * 1000;
+}
+
+static uint8_t Link_rate(SIM_NodeType *node)
+{
+	return ((uint8_t (*)(void))SIM_symbol(node, "UART_getBaudRate"))();
+}
+
+static void Link_stats(SIM_NodeType *node, PROTOCOL_LinkStatsType *stats)
+{
+	((void (*)(PROTOCOL_LinkStatsType *))SIM_symbol(node, "PROTOCOL_getLinkStats"))(stats);
+}
+
+static uint16_t Link_checkPassword(LINK_TEST_Type *test)
+{
+	return LINK_HOST_request(&test->hmi, CHECK_PASSWORD, LINK_HOST_password, PASSWORD_SIZE, LINK_TEST_TIMEOUT_NS);
+}
+
+/*
+ * Description :
+ * Boot both sides and move the link to the rate.
+ */
+static void Link_start(LINK_TEST_Type *test, uint8_t rate)
+{
+	SIM_init();
+	LINK_HOST_addHmi(&test->hmi, "build/link_hmi.so");
+	test->control = LINK_HOST_addControl("build/control.so");
+	SIM_connect(test->hmi.node, test->control);
+	SIM_run(LINK_TEST_BOOT_NS);
+	LINK_HOST_setRate(&test->hmi, rate);
+}
+
+static void Test_corruptedFrames(uint8_t rate)
+{
+	LINK_TEST_Type test;
+	PROTOCOL_LinkStatsType hmi;
+	PROTOCOL_LinkStatsType control;
+	uint8_t page = LINK_STATS_UART_PAGE;
+	uint16_t reply;
+
+	Link_start(&test, rate);
+	SIM_CHECK(Link_rate(test.control) == rate, "%6lu: link up", (unsigned long)g_rates[rate]);
+
+	/* One bit of the password in the request */
+	SIM_addTxFault(&test.hmi.node->tx, PROTOCOL_HEADER_SIZE + 2, SIM_FAULT_FLIP, 0x10);
+	reply = Link_checkPassword(&test);
+	Link_stats(test.hmi.node, &hmi);
+	Link_stats(test.control, &control);
+	SIM_CHECK(reply == PASSWORD_MATCH, "%6lu: corrupted request answered after a retry (0x%02X)",
+			(unsigned long)g_rates[rate], reply);
+	SIM_CHECK((control.protocol.crc_errors == 1) && (hmi.protocol.retries == 1),
+			"%6lu: one CRC error on the CONTROL side (%u), one retry (%u)", (unsigned long)g_rates[rate],
+			control.protocol.crc_errors, hmi.protocol.retries);
+
+	/* One bit of the last counter in the longest LINK_STATS reply */
+	SIM_addTxFault(&test.control->tx, PROTOCOL_HEADER_SIZE + 7, SIM_FAULT_FLIP, 0x01);
+	reply = LINK_HOST_request(&test.hmi, LINK_STATS, &page, 1, LINK_TEST_TIMEOUT_NS);
+	Link_stats(test.hmi.node, &hmi);
+	Link_stats(test.control, &control);
+	SIM_CHECK((reply == LINK_STATS) && (*test.hmi.replyLength == 8),
+			"%6lu: corrupted reply received again after a retry", (unsigned long)g_rates[rate]);
+	SIM_CHECK((hmi.protocol.crc_errors == 1) && (hmi.protocol.retries == 2) && (control.protocol.retries == 1),
+			"%6lu: one CRC error on the HMI side (%u), the reply sent again from the cache",
+			(unsigned long)g_rates[rate], hmi.protocol.crc_errors);
+	SIM_CHECK((Link_rate(test.control) == rate) && (Link_rate(test.hmi.node) == rate) &&
+			(hmi.protocol.resyncs == 0) && (control.protocol.resyncs == 0),
+			"%6lu: no fall back for one bad frame", (unsigned long)g_rates[rate]);
+}
+
+static void Test_byteLoss(uint8_t rate)
+{
+	static const struct
+	{
+		uint32_t index;
+		SIM_FaultKind kind;
+	}faults[] = {{0, SIM_FAULT_DROP}, {PROTOCOL_HEADER_SIZE + 1, SIM_FAULT_DROP}, {2, SIM_FAULT_DUPLICATE}};
+	LINK_TEST_Type test;
+	PROTOCOL_LinkStatsType hmi;
+	PROTOCOL_LinkStatsType control;
+	uint16_t reply;
+	uint8_t i;
+
+	Link_start(&test, rate);
+	for(i = 0 ; i < sizeof(faults) / sizeof(faults[0]) ; i++)
+	{
+		SIM_addTxFault(&test.hmi.node->tx, faults[i].index, faults[i].kind, 0);
+		reply = Link_checkPassword(&test);
+		Link_stats(test.hmi.node, &hmi);
+		Link_stats(test.control, &control);
+		SIM_CHECK((reply == PASSWORD_MATCH) && (hmi.protocol.retries == i + 1U),
+				"%6lu: %s, answered after one retry (retries %u)", (unsigned long)g_rates[rate],
+				g_faultNames[i], hmi.protocol.retries);
+		SIM_CHECK((Link_rate(test.control) == rate) && (control.protocol.resyncs == 0) && (hmi.protocol.resyncs == 0),
+				"%6lu: %s, no fall back", (unsigned long)g_rates[rate], g_faultNames[i]);
+	}
+}
+
+static void Test_controlReset(uint8_t rate)
+{
+	LINK_TEST_Type test;
+	PROTOCOL_LinkStatsType hmi;
+	uint64_t start;
+	uint64_t elapsed_us;
+	uint64_t limit_us;
+	uint16_t reply;
+
+	Link_start(&test, rate);
+	SIM_resetNode(test.control);
+	SIM_run(LINK_TEST_BOOT_NS);
+
+	start = SIM_now();
+	reply = Link_checkPassword(&test);
+	elapsed_us = (SIM_now() - start) / 1000;
+	Link_stats(test.hmi.node, &hmi);
+
+	/* At the base rate the first attempt is answered, above it two attempts time out then the resync */
+	limit_us = Link_timeoutUs(LINK_BASE_BAUD_RATE) + LINK_TEST_SLACK_US;
+	if(rate != LINK_BASE_BAUD_RATE)
+	{
+		limit_us += PROTOCOL_MAX_RETRIES * Link_timeoutUs(rate) + LINK_LINE_ERROR_LIMIT * Link_byteUs(LINK_BASE_BAUD_RATE);
+	}
+	SIM_CHECK(reply == PASSWORD_MATCH, "%6lu: CONTROL reset, request answered (0x%02X)",
+			(unsigned long)g_rates[rate], reply);
+	SIM_CHECK(elapsed_us <= limit_us, "%6lu: CONTROL reset, recovered in %.1f ms (limit %.1f ms)",
+			(unsigned long)g_rates[rate], elapsed_us / 1000.0, limit_us / 1000.0);
+	SIM_CHECK((Link_rate(test.hmi.node) == LINK_BASE_BAUD_RATE) &&
+			(hmi.protocol.resyncs == (rate != LINK_BASE_BAUD_RATE)),
+			"%6lu: CONTROL reset, HMI back at the base rate (resyncs %u)", (unsigned long)g_rates[rate],
+			hmi.protocol.resyncs);
+}
+
+static void Test_hmiReset(uint8_t rate)
+{
+	LINK_TEST_Type test;
+	PROTOCOL_LinkStatsType control;
+	int done;
+
+	Link_start(&test, rate);
+	SIM_resetNode(test.hmi.node);
+	LINK_HOST_attach(&test.hmi);
+	SIM_run(SIM_MS(10));
+
+	/* The boot of the HMI_ECU: ping at the base rate, then step the link up */
+	done = LINK_HOST_run(&test.hmi, LINK_APP_NEGOTIATE, LINK_TEST_TIMEOUT_NS);
+	Link_stats(test.control, &control);
+	SIM_CHECK(done && (*test.hmi.result == UART_BAUD_COUNT - 1) && (Link_rate(test.control) == UART_BAUD_COUNT - 1),
+			"%6lu: HMI reset, negotiated %lu again", (unsigned long)g_rates[rate],
+			(unsigned long)g_rates[*test.hmi.result % UART_BAUD_COUNT]);
+	if(rate != LINK_BASE_BAUD_RATE)
+	{
+		SIM_CHECK((control.uart.framing_errors >= LINK_LINE_ERROR_LIMIT) && (control.protocol.resyncs >= 1),
+				"%6lu: HMI reset, CONTROL fell back on %u framing errors", (unsigned long)g_rates[rate],
+				control.uart.framing_errors);
+	}
+	SIM_CHECK(Link_checkPassword(&test) == PASSWORD_MATCH, "%6lu: HMI reset, requests answered",
+			(unsigned long)g_rates[rate]);
+}
+
+/* Send a request from the peer and read the next reply, return 0 if none arrives */
+static int Link_peerRequest(SIM_PeerType *peer, uint32_t *from, uint8_t type, uint8_t seq, const uint8_t *payload,
+		uint8_t length, LINK_TEST_ReplyType *reply)
+{
+	uint64_t time;
+
+	SIM_peerSendFrame(peer, type, seq, payload, length);
+	SIM_run(SIM_MS(100));
+	return SIM_peerNextFrame(peer, from, &reply->type, &reply->seq, reply->payload, &reply->length, &time);
+}
+
+static void Test_replyCache(void)
+{
+	static const uint8_t page = LINK_STATS_PROTOCOL_PAGE;
+	static const struct
+	{
+		uint8_t type;
+		const uint8_t *payload;
+		uint8_t length;
+	}requests[PROTOCOL_WINDOW_SIZE] = {{LINK_STATS, &page, 1}, {DOOR_STATUS, NULL, 0}, {PARAMS_GET, NULL, 0},
+			{DOOR_STATUS, NULL, 0}};
+	LINK_TEST_ReplyType replies[PROTOCOL_WINDOW_SIZE];
+	LINK_TEST_ReplyType retry;
+	PROTOCOL_LinkStatsType control;
+	SIM_NodeType *node;
+	SIM_PeerType *peer;
+	uint32_t from = 0;
+	uint8_t answered = 0;
+	uint8_t same = 0;
+	uint8_t i;
+
+	SIM_init();
+	node = LINK_HOST_addControl("build/control.so");
+	peer = SIM_addPeer(node, SIM_BIT_NS(g_rates[LINK_BASE_BAUD_RATE]));
+	SIM_run(LINK_TEST_BOOT_NS);
+
+	for(i = 0 ; i < PROTOCOL_WINDOW_SIZE ; i++)
+	{
+		answered += Link_peerRequest(peer, &from, requests[i].type, i + 1, requests[i].payload, requests[i].length,
+				&replies[i]) && (replies[i].seq == i + 1);
+	}
+	SIM_CHECK(answered == PROTOCOL_WINDOW_SIZE, "reply cache: %u requests answered", answered);
+
+	/* Oldest first, a retry handled again as a new request would not be counted */
+	for(i = 0 ; i < PROTOCOL_WINDOW_SIZE ; i++)
+	{
+		same += Link_peerRequest(peer, &from, requests[i].type, i + 1, requests[i].payload, requests[i].length, &retry) &&
+				(retry.type == replies[i].type) && (retry.seq == replies[i].seq) && (retry.length == replies[i].length) &&
+				(memcmp(retry.payload, replies[i].payload, retry.length) == 0);
+	}
+	Link_stats(node, &control);
+	SIM_CHECK(same == PROTOCOL_WINDOW_SIZE, "reply cache: %u retries of the window get their first reply", same);
+	SIM_CHECK(control.protocol.retries == PROTOCOL_WINDOW_SIZE, "reply cache: %u retries counted, none handled again",
+			control.protocol.retries);
+}
+
+static void Test_preamble(uint8_t rate)
+{
+	LINK_TEST_Type test;
+	PROTOCOL_LinkStatsType control;
+
+	Link_start(&test, rate);
+	LINK_HOST_run(&test.hmi, LINK_APP_RESYNC, LINK_TEST_TIMEOUT_NS);
+	/* The command ends when the preamble is queued, let it out on the line */
+	SIM_run(SIM_US(LINK_LINE_ERROR_LIMIT * Link_byteUs(LINK_BASE_BAUD_RATE)) + SIM_MS(1));
+	Link_stats(test.control, &control);
+	SIM_CHECK((Link_rate(test.control) == LINK_BASE_BAUD_RATE) && (control.uart.framing_errors >= LINK_LINE_ERROR_LIMIT),
+			"%6lu: resync preamble alone, CONTROL at the base rate after %u framing errors",
+			(unsigned long)g_rates[rate], control.uart.framing_errors);
+	SIM_CHECK((control.protocol.crc_errors == 0) && (control.protocol.resyncs == 1),
+			"%6lu: resync preamble alone, no frame error, one fall back", (unsigned long)g_rates[rate]);
+	SIM_CHECK(Link_checkPassword(&test) == PASSWORD_MATCH, "%6lu: resync preamble alone, requests answered",
+			(unsigned long)g_rates[rate]);
+}
+
+int main(void)
+{
+	uint8_t rate;
+
+	for(rate = 0 ; rate < UART_BAUD_COUNT ; rate++)
+	{
+		Test_corruptedFrames(rate);
+		Test_byteLoss(rate);
+		Test_controlReset(rate);
+		Test_hmiReset(rate);
+		if(rate != LINK_BASE_BAUD_RATE)
+		{
+			Test_preamble(rate);
+		}
+	}
+	Test_replyCache();
+	return SIM_exitCode();
+}
@@ -0,0 +1,257 @@
+/******************************************************************************
+ *
+ * File Name: test_obstacle.c
+ *
+ * Description: Host test of the obstacle beam latency. The real CONTROL_ECU runs
+ * door cycles on the door model of plant.c, and the beam is broken at random times
+ * while the door closes, every other time while another interrupt of the CONTROL_ECU
+ * runs. For each break the test measures from the beam edge on INT1:
+ * 1. The brake: the write of the H-bridge inputs on PORTB, in the INT1 interrupt.
+ * 2. The standstill of the door, and the travel of the door after the beam.
+ * 3. The reverse drive that opens the door again, after the dead time of the motor.
+ * 4. The DOOR_STATE_OBSTACLE report received on the HMI side of the link.
+ *
+ *******************************************************************************/
+
+#include "sim.h"
+#include "plant.h"
+#include "link_host.h"
+#include "protocol.h"
+#include "door_control.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+#define OBSTACLE_BREAKS             50
+#define OBSTACLE_SEED               16
+#define OBSTACLE_BOOT_NS            SIM_MS(200)
+#define OBSTACLE_STATE_NS           SIM_MS(15000)
+#define OBSTACLE_STOP_NS            SIM_MS(500)
+#define OBSTACLE_CLOSE_TIME         60          /* Short moves, so the door closes often */
+
+/* Budgets: the INT1 path behind the longest other interrupt, the dead time with two steps */
+#define OBSTACLE_BRAKE_BUDGET_US    50
+#define OBSTACLE_REVERSE_BUDGET_MS  (DC_MOTOR_DEAD_TIME_MS + 2 * DOOR_CONTROL_STEP_MS)
+/* One step, then the 6 bytes of the DOOR_PROGRESS frame at 9600 */
+#define OBSTACLE_REPORT_BUDGET_MS   (DOOR_CONTROL_STEP_MS + 10)
+/* Braking distance of the door from the full speed */
+#define OBSTACLE_TRAVEL_BUDGET      (PLANT_MAX_SPEED * PLANT_BRAKE_TAU_S + 1)
+
+typedef struct
+{
+	SIM_NodeType *control;
+	SIM_PeerType *peer;
+	PLANT_Type plant;
+	volatile uint8 *doorState;
+	uint8_t seq;
+	uint8_t waitState;
+	uint32_t from;
+}OBSTACLE_TestType;
+
+/* Counts and worst case of each measure over the breaks */
+typedef struct
+{
+	uint32_t breaks;
+	uint32_t inIsr;
+	uint32_t braked;
+	uint32_t stopped;
+	uint32_t reversed;
+	uint32_t reported;
+	double brakeUs;
+	double stillMs;
+	double travel;
+	double reverseMs;
+	double reportMs;
+}OBSTACLE_ResultType;
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
+
+static void Obstacle_unlock(OBSTACLE_TestType *test)
+{
+	SIM_peerSendFrame(test->peer, UNLOCK_DOOR, ++test->seq, LINK_HOST_password, PASSWORD_SIZE);
+}
+
+static int Obstacle_inState(void *context)
+{
+	OBSTACLE_TestType *test = (OBSTACLE_TestType *)context;
+
+	return *test->doorState == test->waitState;
+}
+
+static int Obstacle_leftState(void *context)
+{
+	return !Obstacle_inState(context);
+}
+
+static int Obstacle_inIsr(void *context)
+{
+	return ((OBSTACLE_TestType *)context)->control->inIsr != 0;
+}
+
+static int Obstacle_isBraked(void *context)
+{
+	return !PLANT_isDriven(context);
+}
+
+/* The closing motion has stopped: the door stands still or already moves up */
+static int Obstacle_isStill(void *context)
+{
+	return ((PLANT_Type *)context)->speed > -PLANT_STILL_SPEED;
+}
+
+/* The door opens again, or holds open when the beam broke where the closing started */
+static int Obstacle_isReopened(void *context)
+{
+	OBSTACLE_TestType *test = (OBSTACLE_TestType *)context;
+	PLANT_Type *plant = &test->plant;
+
+	return ((plant->drive == PLANT_DRIVE) && (plant->direction > 0)) || (*test->doorState == DOOR_STATE_HOLD);
+}
+
+/* Time of the next DOOR_PROGRESS frame with the state received by the peer after a time, 0 if none */
+static uint64_t Obstacle_report(OBSTACLE_TestType *test, uint8_t state, uint64_t after)
+{
+	uint8_t payload[PROTOCOL_MAX_PAYLOAD];
+	uint8_t type;
+	uint8_t seq;
+	uint8_t length;
+	uint64_t time;
+
+	while(SIM_peerNextFrame(test->peer, &test->from, &type, &seq, payload, &length, &time))
+	{
+		if((type == DOOR_PROGRESS) && (length >= 1) && (payload[0] == state) && (time > after))
+		{
+			return time;
+		}
+	}
+	return 0;
+}
+
+static void Obstacle_worst(double *worst, double value)
+{
+	if(value > *worst)
+	{
+		*worst = value;
+	}
+}
+
+/*
+ * Description :
+ * Break the beam on the closing door and follow the door until it opens again,
+ * then clear the beam.
+ */
+static void Obstacle_break(OBSTACLE_TestType *test, OBSTACLE_ResultType *result)
+{
+	PLANT_Type *plant = &test->plant;
+	double position = plant->position;
+	uint64_t report;
+
+	result->breaks++;
+	if(test->control->inIsr != 0)
+	{
+		result->inIsr++;
+	}
+	plant->obstacle = 1;
+
+	if(SIM_runUntil(Obstacle_isBraked, plant, SIM_MS(DOOR_CONTROL_STEP_MS)) && (plant->drive == PLANT_BRAKE))
+	{
+		result->braked++;
+		Obstacle_worst(&result->brakeUs, (test->control->accessTime[STUB_PORTB] - plant->obstacleTime) / 1e3);
+	}
+	if(SIM_runUntil(Obstacle_isStill, plant, OBSTACLE_STOP_NS))
+	{
+		result->stopped++;
+		Obstacle_worst(&result->stillMs, (SIM_now() - plant->obstacleTime) / 1e6);
+		Obstacle_worst(&result->travel, fabs(plant->position - position));
+	}
+	if(SIM_runUntil(Obstacle_isReopened, test, OBSTACLE_STOP_NS))
+	{
+		result->reversed++;
+		if(plant->drive == PLANT_DRIVE)
+		{
+			Obstacle_worst(&result->reverseMs, (plant->driveTime - plant->obstacleTime) / 1e6);
+		}
+	}
+	report = Obstacle_report(test, DOOR_STATE_OBSTACLE, plant->obstacleTime);
+	if(report != 0)
+	{
+		result->reported++;
+		Obstacle_worst(&result->reportMs, (report - plant->obstacleTime) / 1e6);
+	}
+	SIM_peerClearLog(test->peer);
+	test->from = 0;
+	plant->obstacle = 0;
+}
+
+int main(void)
+{
+	static const uint8_t params[PARAMS_SIZE] = {OBSTACLE_CLOSE_TIME, 2, OBSTACLE_CLOSE_TIME, 3, 100, 60};
+	OBSTACLE_TestType test;
+	OBSTACLE_ResultType result = {0};
+	uint32_t cycles = 0;
+
+	srand(OBSTACLE_SEED);
+	SIM_init();
+	test.control = LINK_HOST_addControl("build/control.so");
+	LINK_HOST_setParams(test.control, params, PARAMS_SIZE);
+	PLANT_init(&test.plant, test.control, 0, PLANT_ENCODER | PLANT_SWITCHES);
+	test.peer = SIM_addPeer(test.control, SIM_BIT_NS(9600));
+	test.doorState = SIM_symbol(test.control, "g_doorState");
+	test.seq = 0;
+	test.from = 0;
+	SIM_run(OBSTACLE_BOOT_NS);
+
+	Obstacle_unlock(&test);
+	while(result.breaks < OBSTACLE_BREAKS)
+	{
+		test.waitState = DOOR_STATE_CLOSING;
+		if(!SIM_runUntil(Obstacle_inState, &test, OBSTACLE_STATE_NS))
+		{
+			break;
+		}
+		/* Break the beam at a random point of the closing, open again if the door closed first */
+		if(SIM_runUntil(Obstacle_leftState, &test, SIM_MS(rand() % (OBSTACLE_CLOSE_TIME * PARAMS_TIME_UNIT_MS))))
+		{
+			if(*test.doorState == DOOR_STATE_CLOSED)
+			{
+				cycles++;
+				Obstacle_unlock(&test);
+			}
+			continue;
+		}
+		if(result.breaks & 1)
+		{
+			SIM_runUntil(Obstacle_inIsr, &test, SIM_MS(1));
+		}
+		Obstacle_break(&test, &result);
+	}
+
+	printf("%lu breaks, %lu in another interrupt, %lu full cycles\n", (unsigned long)result.breaks,
+			(unsigned long)result.inIsr, (unsigned long)cycles);
+	printf("worst: brake %.1f us, standstill %.1f ms, travel %.1f counts, reverse %.1f ms, report %.1f ms\n",
+			result.brakeUs, result.stillMs, result.travel, result.reverseMs, result.reportMs);
+
+	SIM_CHECK(result.breaks == OBSTACLE_BREAKS, "%lu of %u beam breaks while closing",
+			(unsigned long)result.breaks, OBSTACLE_BREAKS);
+	SIM_CHECK(result.inIsr >= OBSTACLE_BREAKS / 4, "%lu breaks while another interrupt runs",
+			(unsigned long)result.inIsr);
+	SIM_CHECK((result.braked == result.breaks) && (result.brakeUs <= OBSTACLE_BRAKE_BUDGET_US),
+			"%lu breaks braked, worst beam to brake %.1f us, budget %u us", (unsigned long)result.braked,
+			result.brakeUs, OBSTACLE_BRAKE_BUDGET_US);
+	SIM_CHECK((result.stopped == result.breaks) && (result.travel <= OBSTACLE_TRAVEL_BUDGET),
+			"%lu doors stopped, worst travel after the beam %.1f counts, budget %.0f", (unsigned long)result.stopped,
+			result.travel, OBSTACLE_TRAVEL_BUDGET);
+	SIM_CHECK((result.reversed == result.breaks) && (result.reverseMs <= OBSTACLE_REVERSE_BUDGET_MS),
+			"%lu doors opened again, worst beam to reverse %.1f ms, budget %u ms", (unsigned long)result.reversed,
+			result.reverseMs, OBSTACLE_REVERSE_BUDGET_MS);
+	SIM_CHECK((result.reported == result.breaks) && (result.reportMs <= OBSTACLE_REPORT_BUDGET_MS),
+			"%lu breaks reported to the HMI, worst %.1f ms, budget %u ms", (unsigned long)result.reported,
+			result.reportMs, OBSTACLE_REPORT_BUDGET_MS);
+	SIM_CHECK(test.plant.pluggings == 0, "no drive against the motion");
+	return SIM_exitCode();
+}
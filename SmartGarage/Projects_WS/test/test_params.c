@@ -0,0 +1,247 @@
+/******************************************************************************
+ *
+ * File Name: test_params.c
+ *
+ * Description: Host test of the door parameters block of the real CONTROL_ECU,
+ * asked and changed by a scripted peer:
+ * 1. At boot a saved block is used, a blank EEPROM, a wrong CRC or a value out of
+ *    its limits gives the default values.
+ * 2. PARAMS_SET accepts the blocks on the limits and rejects the blocks one step
+ *    past them, an accepted block is saved with its CRC and a rejected one is not.
+ * 3. The default values build the door profiles of the old constants, a new block
+ *    builds the profiles of the next door cycle.
+ * 4. The EEPROM bytes of an accepted block are written in the background: a request
+ *    sent after the PARAMS_SET reply is answered before the last byte is written.
+ *
+ *******************************************************************************/
+
+#include "sim.h"
+#include "link_host.h"
+#include "protocol.h"
+#include "dc_motor.h"
+#include <stdio.h>
+#include <string.h>
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+#define PARAMS_TEST_BOOT_NS         SIM_MS(200)
+#define PARAMS_TEST_REPLY_NS        SIM_MS(500)
+/* The reply goes first, then the PARAMS_SIZE + 1 EEPROM writes of 10 ms each */
+#define PARAMS_TEST_STORE_NS        SIM_MS(200)
+#define PARAMS_TEST_NO_REPLY        0
+
+typedef struct
+{
+	SIM_NodeType *control;
+	SIM_PeerType *peer;
+	uint8_t seq;
+	uint32_t from;
+	uint8_t type;
+	uint8_t payload[PROTOCOL_MAX_PAYLOAD];
+	uint8_t length;
+}PARAMS_TestType;
+
+typedef struct
+{
+	const char *name;
+	uint8_t block[PARAMS_SIZE];
+	uint8_t length;
+	uint8_t accepted;
+}PARAMS_TestCaseType;
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
+
+/*
+ * Description :
+ * Boot the CONTROL_ECU with a saved block, its CRC changed by crc_flip, or with a blank EEPROM.
+ */
+static void Params_boot(PARAMS_TestType *test, const uint8_t *block, uint8_t crc_flip)
+{
+	SIM_init();
+	test->control = LINK_HOST_addControl("build/control.so");
+	if(block != NULL)
+	{
+		LINK_HOST_setParams(test->control, block, PARAMS_SIZE);
+		test->control->eeprom[LINK_HOST_PARAMS_ADDRESS + PARAMS_SIZE] ^= crc_flip;
+	}
+	test->peer = SIM_addPeer(test->control, SIM_BIT_NS(9600));
+	test->seq = 0;
+	test->from = 0;
+	SIM_run(PARAMS_TEST_BOOT_NS);
+}
+
+static int Params_replied(void *context)
+{
+	PARAMS_TestType *test = (PARAMS_TestType *)context;
+	uint64_t time;
+	uint8_t seq;
+
+	while(SIM_peerNextFrame(test->peer, &test->from, &test->type, &seq, test->payload, &test->length, &time))
+	{
+		if(seq == test->seq)
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* Send a request from the peer, return the type of its reply or PARAMS_TEST_NO_REPLY */
+static uint8_t Params_request(PARAMS_TestType *test, uint8_t type, const uint8_t *payload, uint8_t length)
+{
+	SIM_peerSendFrame(test->peer, type, ++test->seq, payload, length);
+	if(!SIM_runUntil(Params_replied, test, PARAMS_TEST_REPLY_NS))
+	{
+		return PARAMS_TEST_NO_REPLY;
+	}
+	return test->type;
+}
+
+/* The block in use, read with PARAMS_GET */
+static int Params_inUse(PARAMS_TestType *test, const uint8_t *block)
+{
+	return (Params_request(test, PARAMS_GET, NULL, 0) == PARAMS_GET) && (test->length == PARAMS_SIZE) &&
+			(memcmp(test->payload, block, PARAMS_SIZE) == 0);
+}
+
+/* The block and its CRC-8 in the EEPROM */
+static int Params_isSaved(PARAMS_TestType *test, const uint8_t *block)
+{
+	const uint8_t *saved = &test->control->eeprom[LINK_HOST_PARAMS_ADDRESS];
+	uint8_t crc = 0;
+	uint8_t i;
+
+	for(i = 0 ; i < PARAMS_SIZE ; i++)
+	{
+		crc = SIM_crc8(crc, block[i]);
+	}
+	return (memcmp(saved, block, PARAMS_SIZE) == 0) && (saved[PARAMS_SIZE] == crc);
+}
+
+static int Params_isProfile(const DcMotor_ProfileType *profile, uint8_t speed, uint16_t ramp_ms, uint16_t move_ms)
+{
+	return (profile->cruise_speed == speed) && (profile->accel_time_ms == ramp_ms) &&
+			(profile->cruise_time_ms == move_ms - 2 * ramp_ms) && (profile->decel_time_ms == ramp_ms);
+}
+
+static void Test_boot(void)
+{
+	static const uint8_t defaults[PARAMS_SIZE] = {PARAMS_DEFAULT_OPEN_TIME, PARAMS_DEFAULT_HOLD_TIME,
+			PARAMS_DEFAULT_CLOSE_TIME, PARAMS_DEFAULT_RAMP_TIME, PARAMS_DEFAULT_SPEED, PARAMS_DEFAULT_LOCKOUT_TIME};
+	static const uint8_t saved[PARAMS_SIZE] = {60, 2, 50, 3, 80, 30};
+	static const uint8_t too_fast[PARAMS_SIZE] = {60, 2, 50, 3, PARAMS_MAX_SPEED + 1, 30};
+	PARAMS_TestType test;
+
+	Params_boot(&test, NULL, 0);
+	SIM_CHECK(Params_inUse(&test, defaults), "blank EEPROM: the default values");
+	Params_boot(&test, saved, 0);
+	SIM_CHECK(Params_inUse(&test, saved), "saved block: loaded at boot");
+	Params_boot(&test, saved, 0x01);
+	SIM_CHECK(Params_inUse(&test, defaults), "saved block with a wrong CRC: the default values");
+	Params_boot(&test, too_fast, 0);
+	SIM_CHECK(Params_inUse(&test, defaults), "saved block out of its limits: the default values");
+}
+
+static void Test_set(void)
+{
+	static const PARAMS_TestCaseType cases[] =
+	{
+		{"shortest moves, no hold, slowest", {PARAMS_MIN_MOVE_TIME, 0, PARAMS_MIN_MOVE_TIME, PARAMS_MIN_RAMP_TIME,
+				PARAMS_MIN_SPEED, PARAMS_MIN_LOCKOUT_TIME}, PARAMS_SIZE, 1},
+		{"moves of their two ramps", {30, 10, 30, 15, 100, 60}, PARAMS_SIZE, 1},
+		{"longest values", {255, PARAMS_MAX_HOLD_TIME, 255, 127, PARAMS_MAX_SPEED, PARAMS_MAX_LOCKOUT_TIME},
+				PARAMS_SIZE, 1},
+		{"open shorter than the shortest move", {PARAMS_MIN_MOVE_TIME - 1, 10, 30, 1, 100, 60}, PARAMS_SIZE, 0},
+		{"close shorter than the shortest move", {30, 10, PARAMS_MIN_MOVE_TIME - 1, 1, 100, 60}, PARAMS_SIZE, 0},
+		{"open shorter than its two ramps", {29, 10, 30, 15, 100, 60}, PARAMS_SIZE, 0},
+		{"no ramp", {30, 10, 30, PARAMS_MIN_RAMP_TIME - 1, 100, 60}, PARAMS_SIZE, 0},
+		{"speed below the limit switches", {30, 10, 30, 1, PARAMS_MIN_SPEED - 1, 60}, PARAMS_SIZE, 0},
+		{"speed over 100%", {30, 10, 30, 1, PARAMS_MAX_SPEED + 1, 60}, PARAMS_SIZE, 0},
+		{"hold too long", {30, PARAMS_MAX_HOLD_TIME + 1, 30, 1, 100, 60}, PARAMS_SIZE, 0},
+		{"lockout too short", {30, 10, 30, 1, 100, PARAMS_MIN_LOCKOUT_TIME - 1}, PARAMS_SIZE, 0},
+		{"lockout too long", {30, 10, 30, 1, 100, PARAMS_MAX_LOCKOUT_TIME + 1}, PARAMS_SIZE, 0},
+		{"short payload", {30, 10, 30, 1, 100, 60}, PARAMS_SIZE - 1, 0}
+	};
+	PARAMS_TestType test;
+	uint8_t before[PARAMS_SIZE + 1];
+	uint8_t reply;
+	uint8_t i;
+
+	Params_boot(&test, NULL, 0);
+	for(i = 0 ; i < sizeof(cases) / sizeof(cases[0]) ; i++)
+	{
+		const PARAMS_TestCaseType *item = &cases[i];
+
+		memcpy(before, &test.control->eeprom[LINK_HOST_PARAMS_ADDRESS], sizeof(before));
+		reply = Params_request(&test, PARAMS_SET, item->block, item->length);
+		SIM_run(PARAMS_TEST_STORE_NS);
+		if(item->accepted)
+		{
+			SIM_CHECK((reply == PARAMS_GET) && (memcmp(test.payload, item->block, PARAMS_SIZE) == 0),
+					"%s: accepted, the reply has the new block", item->name);
+			SIM_CHECK(Params_isSaved(&test, item->block) && Params_inUse(&test, item->block),
+					"%s: saved with its CRC and in use", item->name);
+		}
+		else
+		{
+			SIM_CHECK(reply == PARAMS_REJECTED, "%s: rejected (reply 0x%02X)", item->name, reply);
+			SIM_CHECK(memcmp(before, &test.control->eeprom[LINK_HOST_PARAMS_ADDRESS], sizeof(before)) == 0,
+					"%s: the saved block is kept", item->name);
+		}
+	}
+}
+
+static void Test_profiles(void)
+{
+	static const uint8_t block[PARAMS_SIZE] = {60, 2, 50, 3, 80, 30};
+	PARAMS_TestType test;
+	DcMotor_ProfileType *open_profile;
+	DcMotor_ProfileType *close_profile;
+	uint16_t *hold_time;
+
+	Params_boot(&test, NULL, 0);
+	open_profile = SIM_symbol(test.control, "g_openProfile");
+	close_profile = SIM_symbol(test.control, "g_closeProfile");
+	hold_time = SIM_symbol(test.control, "g_holdTime");
+
+	Params_request(&test, UNLOCK_DOOR, LINK_HOST_password, PASSWORD_SIZE);
+	SIM_CHECK(Params_isProfile(open_profile, 100, 1000, 15000) && Params_isProfile(close_profile, 100, 1000, 14000) &&
+			(*hold_time == 1000), "default values: 15 s open and 14 s close with 1 s ramps at 100%%, 1 s hold");
+
+	/* The new block applies from the next door cycle, not to the running one */
+	Params_request(&test, PARAMS_SET, block, PARAMS_SIZE);
+	SIM_CHECK(Params_isProfile(open_profile, 100, 1000, 15000), "new block: the running cycle keeps its profiles");
+	SIM_run(SIM_MS(35000));
+	Params_request(&test, UNLOCK_DOOR, LINK_HOST_password, PASSWORD_SIZE);
+	SIM_CHECK(Params_isProfile(open_profile, 80, 300, 6000) && Params_isProfile(close_profile, 80, 300, 5000) &&
+			(*hold_time == 200), "new block: the next cycle opens in 6 s and closes in 5 s at 80%%, 0.2 s hold");
+}
+
+static void Test_background(void)
+{
+	static const uint8_t block[PARAMS_SIZE] = {60, 2, 50, 3, 80, 30};
+	PARAMS_TestType test;
+	uint32_t writes;
+
+	Params_boot(&test, NULL, 0);
+	writes = test.control->eepromWrites;
+	Params_request(&test, PARAMS_SET, block, PARAMS_SIZE);
+	SIM_CHECK(Params_inUse(&test, block) && (test.control->eepromWrites - writes < PARAMS_SIZE + 1),
+			"PARAMS_GET after PARAMS_SET: answered with %u of the %u bytes written", test.control->eepromWrites - writes,
+			PARAMS_SIZE + 1);
+	SIM_run(PARAMS_TEST_STORE_NS);
+	SIM_CHECK(Params_isSaved(&test, block) && (test.control->eepromWrites - writes == PARAMS_SIZE + 1),
+			"PARAMS_SET: every byte written once, the block saved with its CRC");
+}
+
+int main(void)
+{
+	Test_boot();
+	Test_set();
+	Test_profiles();
+	Test_background();
+	return SIM_exitCode();
+}
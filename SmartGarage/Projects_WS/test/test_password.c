@@ -0,0 +1,128 @@
+/******************************************************************************
+ *
+ * File Name: test_password.c
+ *
+ * Description: Host test of the password entry of the HMI_ECU. The real HMI_ECU and
+ * CONTROL_ECU run on one link, and the keys are typed on the keypad model of keys.c
+ * at the first password screens:
+ * 1. '=' is taken only after PASSWORD_MIN_LENGTH digits, '*' erases the last digit,
+ *    ON/C clears the entry and the digits after PASSWORD_SIZE are dropped.
+ * 2. The places after the last digit hold PASSWORD_NO_DIGIT.
+ * 3. A confirmation that does not match is not sent to the CONTROL_ECU, a matching
+ *    one is saved by the CONTROL_ECU with its padding.
+ * 4. The third wrong password locks the keypad for the lockout time, timed by the
+ *    event loop of the HMI_ECU.
+ *
+ *******************************************************************************/
+
+#include "sim.h"
+#include "keys.h"
+#include "link_host.h"
+#include "protocol.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+#define PASSWORD_TEST_SEED          25
+#define PASSWORD_TEST_BOOT_NS       SIM_MS(1000)
+/* The "PASS Not Matched" screen, then the first screen again */
+#define PASSWORD_TEST_MESSAGE_NS    SIM_MS(1500)
+#define PASSWORD_TEST_REPLY_NS      SIM_MS(500)
+#define PASSWORD_TEST_CLEAR_KEY     13
+#define PASSWORD_TEST_ERASE_KEY     '*'
+/* Lockout time of the default door parameters, read back around its end */
+#define PASSWORD_TEST_LOCKOUT_MS    (PARAMS_DEFAULT_LOCKOUT_TIME * 1000UL)
+#define PASSWORD_TEST_MARGIN_MS     500
+
+typedef struct
+{
+	SIM_NodeType *hmi;
+	SIM_NodeType *control;
+	KEYS_Type keys;
+	uint8 *password;
+	uint8 *passmatch;
+}PASSWORD_TestType;
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
+
+static void Password_type(PASSWORD_TestType *test, const char *keys)
+{
+	uint8_t values[32];
+	uint8_t count;
+
+	/* Digits as their value, the other keys as their code */
+	for(count = 0 ; keys[count] != '\0' ; count++)
+	{
+		values[count] = (keys[count] >= '0' && keys[count] <= '9') ? (uint8_t)(keys[count] - '0') :
+				(keys[count] == 'C') ? PASSWORD_TEST_CLEAR_KEY : (uint8_t)keys[count];
+	}
+	KEYS_type(&test->keys, values, count);
+}
+
+static int Password_is(const uint8 *password, const uint8_t *expected)
+{
+	return memcmp(password, expected, PASSWORD_SIZE) == 0;
+}
+
+int main(void)
+{
+	static PASSWORD_TestType test;
+	static const uint8_t first[PASSWORD_SIZE] = {1, 2, 4, 5, PASSWORD_NO_DIGIT};
+	static const uint8_t longer[PASSWORD_SIZE] = {9, 9, 9, 9, 9};
+	uint32_t received;
+	volatile boolean *busy;
+
+	srand(PASSWORD_TEST_SEED);
+	SIM_init();
+	test.control = LINK_HOST_addControl("build/control.so");
+	test.hmi = SIM_addNode("HMI", "build/hmi.so", "hmi_main");
+	SIM_connect(test.hmi, test.control);
+	KEYS_init(&test.keys, test.hmi);
+	test.password = SIM_symbol(test.hmi, "g_password");
+	test.passmatch = SIM_symbol(test.hmi, "g_passmatch");
+	busy = SIM_symbol(test.hmi, "g_busy");
+	SIM_run(PASSWORD_TEST_BOOT_NS);
+
+	/* Short '=' ignored, '*' erases the 3, then a 4 digit entry */
+	Password_type(&test, "12=3*45=");
+	SIM_CHECK(Password_is(test.password, first), "entry 12=3*45=: 1 2 4 5 and one padding place, got %u %u %u %u %u",
+			test.password[0], test.password[1], test.password[2], test.password[3], test.password[4]);
+
+	/* A 6th digit is dropped, the confirmation does not match and is not sent */
+	received = test.control->rxBytes;
+	Password_type(&test, "999999=");
+	SIM_run(PASSWORD_TEST_REPLY_NS);
+	SIM_CHECK(Password_is(test.passmatch, longer), "confirmation 999999=: the 6th digit is dropped");
+	SIM_CHECK(test.control->rxBytes == received, "confirmation not matched: no byte sent to the CONTROL_ECU");
+	SIM_run(PASSWORD_TEST_MESSAGE_NS);
+
+	/* ON/C clears the entry, then the same password twice is sent and saved */
+	Password_type(&test, "77C1245=");
+	SIM_CHECK(Password_is(test.password, first), "entry 77C1245=: the 7 7 are cleared");
+	Password_type(&test, "1245=");
+	SIM_run(PASSWORD_TEST_REPLY_NS);
+	SIM_CHECK(test.control->rxBytes != received, "confirmation matched: sent to the CONTROL_ECU");
+	SIM_CHECK(Password_is(&test.control->eeprom[LINK_HOST_PASSWORD_ADDRESS], first),
+			"the CONTROL_ECU saved 1 2 4 5 and one padding place");
+
+	/* Three wrong passwords to open the door */
+	Password_type(&test, "+");
+	Password_type(&test, "9999=");
+	SIM_run(PASSWORD_TEST_REPLY_NS);
+	Password_type(&test, "9999=");
+	SIM_run(PASSWORD_TEST_REPLY_NS);
+	Password_type(&test, "9999=");
+	SIM_run(PASSWORD_TEST_REPLY_NS);
+	SIM_CHECK(*busy, "third wrong password: locked out");
+	SIM_run(SIM_MS(PASSWORD_TEST_LOCKOUT_MS - PASSWORD_TEST_REPLY_NS / 1000000 - PASSWORD_TEST_MARGIN_MS));
+	SIM_CHECK(*busy, "still locked out %u ms before the end of the %lu ms lockout", PASSWORD_TEST_MARGIN_MS,
+			PASSWORD_TEST_LOCKOUT_MS);
+	SIM_run(SIM_MS(2 * PASSWORD_TEST_MARGIN_MS));
+	SIM_CHECK(!*busy, "lockout over %u ms after its end", PASSWORD_TEST_MARGIN_MS);
+	return SIM_exitCode();
+}
@@ -0,0 +1,254 @@
+/******************************************************************************
+ *
+ * File Name: test_profile.c
+ *
+ * Description: Host test of the DC motor speed profiles. The duty cycle, the
+ * OC0 output and the H-bridge inputs are read in the middle of each profile step
+ * and compared with the trapezoid of the profile:
+ * 1. A full door profile and a short one without cruise.
+ * 2. A profile without ramps.
+ * 3. A reversed profile started right after the last one: the motor brakes for the
+ *    dead time, then follows the duty of the current step. With every other scheduler
+ *    timer taken, the first profile step after the dead time ends it.
+ *
+ *******************************************************************************/
+
+#include "sim.h"
+#include "motor_app.h"
+#include "dc_motor.h"
+#include <stdio.h>
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+#define PROFILE_BOOT_NS             SIM_MS(10)
+#define PROFILE_COMMAND_NS          SIM_MS(10)
+/* Each step is read in its middle, the scheduler tick moves it by less than one tick */
+#define PROFILE_SAMPLE_NS           SIM_MS(DC_MOTOR_RAMP_STEP_MS / 2)
+
+/* H-bridge inputs on PB0 (in1) and PB1 (in2) */
+#define PROFILE_INPUTS_CW           0x02
+#define PROFILE_INPUTS_ACW          0x01
+#define PROFILE_INPUTS_BRAKE        0x03
+
+typedef struct
+{
+	SIM_NodeType *node;
+	volatile uint8 *command;
+	volatile uint8 *state;
+	volatile uint8 *speed;
+	DcMotor_ProfileType *profile;
+	volatile uint16 *doneCount;
+}PROFILE_TestType;
+
+/* Output of the motor at one time */
+typedef struct
+{
+	uint8_t inputs;
+	uint8_t compare;
+	uint8_t connected;
+}PROFILE_OutputType;
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
+
+static int Profile_idle(void *context)
+{
+	return *((PROFILE_TestType *)context)->command == MOTOR_APP_IDLE;
+}
+
+static void Profile_command(PROFILE_TestType *test, uint8_t command)
+{
+	*test->command = command;
+	SIM_runUntil(Profile_idle, test, PROFILE_COMMAND_NS);
+}
+
+static void Profile_start(PROFILE_TestType *test)
+{
+	SIM_init();
+	test->node = SIM_addNode("control", "build/motor_app.so", "motor_main");
+	test->command = SIM_symbol(test->node, "g_command");
+	test->state = SIM_symbol(test->node, "g_state");
+	test->speed = SIM_symbol(test->node, "g_speed");
+	test->profile = SIM_symbol(test->node, "g_profile");
+	test->doneCount = SIM_symbol(test->node, "g_doneCount");
+	SIM_run(PROFILE_BOOT_NS);
+}
+
+/* Start a profile, return the time of the start */
+static uint64_t Profile_run(PROFILE_TestType *test, DcMotor_State state, const DcMotor_ProfileType *profile)
+{
+	*test->state = state;
+	*test->profile = *profile;
+	Profile_command(test, MOTOR_APP_PROFILE);
+	return SIM_now();
+}
+
+static void Profile_read(const PROFILE_TestType *test, PROFILE_OutputType *output)
+{
+	output->inputs = test->node->reg8[STUB_PORTB] & 0x03;
+	output->compare = test->node->reg8[STUB_OCR0];
+	output->connected = (test->node->reg8[STUB_TCCR0] & (1<<COM01)) != 0;
+}
+
+/* Trapezoid of the profile, worked out here and not taken from DcMotor_profileSpeed */
+static uint8_t Profile_expectedSpeed(const DcMotor_ProfileType *profile, uint32_t time_ms)
+{
+	uint32_t decel_start = (uint32_t)profile->accel_time_ms + profile->cruise_time_ms;
+	uint32_t end = decel_start + profile->decel_time_ms;
+
+	if(time_ms < profile->accel_time_ms)
+	{
+		return (uint8_t)(profile->cruise_speed * time_ms / profile->accel_time_ms);
+	}
+	if(time_ms < decel_start)
+	{
+		return profile->cruise_speed;
+	}
+	if(time_ms < end)
+	{
+		return (uint8_t)(profile->cruise_speed * (end - time_ms) / profile->decel_time_ms);
+	}
+	return 0;
+}
+
+/* OCR0 written by PWM_Timer0_setDuty for a duty */
+static uint8_t Profile_compare(uint8_t duty)
+{
+	return (uint8_t)(((uint16_t)duty * 653) >> 8);
+}
+
+/*
+ * Description :
+ * Read each step of a running profile from the first one after first_ms and compare it
+ * with the trapezoid: duty and OC0 of the driven direction, or the brake before first_ms.
+ * Check the end of the profile: motor braked and one done call back.
+ */
+static void Profile_checkSteps(PROFILE_TestType *test, const char *name, uint64_t start, DcMotor_State state,
+		const DcMotor_ProfileType *profile, uint32_t first_ms)
+{
+	uint32_t end = (uint32_t)profile->accel_time_ms + profile->cruise_time_ms + profile->decel_time_ms;
+	uint8_t inputs = (state == DC_MOTOR_CW) ? PROFILE_INPUTS_CW : PROFILE_INPUTS_ACW;
+	uint16_t done = *test->doneCount;
+	PROFILE_OutputType output;
+	uint32_t steps = 0;
+	uint32_t wrong = 0;
+	uint32_t first_wrong = 0;
+	uint32_t braked = 0;
+	uint8_t largest = 0;
+	uint8_t last = 0;
+	uint8_t expected;
+	uint8_t ramp_step;
+	uint32_t time_ms;
+
+	for(time_ms = 0 ; time_ms < end ; time_ms += DC_MOTOR_RAMP_STEP_MS)
+	{
+		SIM_run(start + SIM_MS(time_ms) + PROFILE_SAMPLE_NS - SIM_now());
+		Profile_read(test, &output);
+		if(time_ms < first_ms)
+		{
+			braked += (output.inputs == PROFILE_INPUTS_BRAKE) && (output.compare == 0xFF) && output.connected;
+			continue;
+		}
+		expected = Profile_expectedSpeed(profile, time_ms);
+		if((output.inputs != inputs) || (output.compare != Profile_compare(expected)) ||
+				(output.connected != (expected != 0)))
+		{
+			first_wrong = (wrong == 0) ? time_ms : first_wrong;
+			wrong++;
+		}
+		if((steps != 0) && (expected > last) && ((uint8_t)(expected - last) > largest))
+		{
+			largest = (uint8_t)(expected - last);
+		}
+		if((steps != 0) && (last > expected) && ((uint8_t)(last - expected) > largest))
+		{
+			largest = (uint8_t)(last - expected);
+		}
+		last = expected;
+		steps++;
+	}
+
+	SIM_CHECK(wrong == 0, "%s: %lu steps follow the trapezoid (%lu wrong, first at %lu ms)", name,
+			(unsigned long)steps, (unsigned long)wrong, (unsigned long)first_wrong);
+	if(first_ms != 0)
+	{
+		SIM_CHECK(braked == first_ms / DC_MOTOR_RAMP_STEP_MS, "%s: braked for the %u ms dead time first (%lu steps)",
+				name, DC_MOTOR_DEAD_TIME_MS, (unsigned long)braked);
+	}
+	if((profile->accel_time_ms != 0) && (profile->decel_time_ms != 0))
+	{
+		ramp_step = (uint8_t)((profile->cruise_speed * DC_MOTOR_RAMP_STEP_MS + profile->accel_time_ms - 1) /
+				profile->accel_time_ms);
+		if(((profile->cruise_speed * DC_MOTOR_RAMP_STEP_MS + profile->decel_time_ms - 1) / profile->decel_time_ms) > ramp_step)
+		{
+			ramp_step = (uint8_t)((profile->cruise_speed * DC_MOTOR_RAMP_STEP_MS + profile->decel_time_ms - 1) /
+					profile->decel_time_ms);
+		}
+		SIM_CHECK(largest <= ramp_step, "%s: largest duty step %u%%, the ramps allow %u%%", name, largest, ramp_step);
+	}
+
+	SIM_run(start + SIM_MS(end) + PROFILE_SAMPLE_NS - SIM_now());
+	Profile_read(test, &output);
+	SIM_CHECK((output.inputs == PROFILE_INPUTS_BRAKE) && (output.compare == 0xFF) && output.connected,
+			"%s: braked at the end (inputs %u, OCR0 %u)", name, output.inputs, output.compare);
+	SIM_CHECK(*test->doneCount == done + 1, "%s: one done call back", name);
+}
+
+static void Test_profiles(void)
+{
+	static const DcMotor_ProfileType door = {100, 1000, 13000, 1000};
+	static const DcMotor_ProfileType shortMove = {60, 300, 0, 250};
+	static const DcMotor_ProfileType noRamps = {50, 0, 100, 0};
+	PROFILE_TestType test;
+	uint64_t start;
+
+	Profile_start(&test);
+	start = Profile_run(&test, DC_MOTOR_CW, &door);
+	Profile_checkSteps(&test, "door profile {100%, 1000/13000/1000 ms}", start, DC_MOTOR_CW, &door, 0);
+
+	Profile_start(&test);
+	start = Profile_run(&test, DC_MOTOR_ACW, &shortMove);
+	Profile_checkSteps(&test, "short profile {60%, 300/0/250 ms}", start, DC_MOTOR_ACW, &shortMove, 0);
+
+	Profile_start(&test);
+	start = Profile_run(&test, DC_MOTOR_CW, &noRamps);
+	Profile_checkSteps(&test, "profile without ramps {50%, 0/100/0 ms}", start, DC_MOTOR_CW, &noRamps, 0);
+}
+
+static void Test_reversal(void)
+{
+	static const DcMotor_ProfileType first = {100, 100, 0, 100};
+	static const DcMotor_ProfileType second = {60, 300, 0, 250};
+	PROFILE_TestType test;
+	uint64_t start;
+
+	Profile_start(&test);
+	start = Profile_run(&test, DC_MOTOR_CW, &first);
+	SIM_run(start + SIM_MS(150) - SIM_now());
+
+	/* Still turning CW, the new profile waits for the dead time */
+	start = Profile_run(&test, DC_MOTOR_ACW, &second);
+	Profile_checkSteps(&test, "reversed profile {60%, 300/0/250 ms}", start, DC_MOTOR_ACW, &second,
+			DC_MOTOR_DEAD_TIME_MS);
+
+	/* The steps get the timer of the last profile back, none is left for the dead time */
+	Profile_start(&test);
+	start = Profile_run(&test, DC_MOTOR_CW, &first);
+	Profile_command(&test, MOTOR_APP_FILL_TIMERS);
+	SIM_CHECK(*(volatile uint8_t *)SIM_symbol(test.node, "g_filledTimers") != 0, "no free timer: %u timers taken",
+			*(volatile uint8_t *)SIM_symbol(test.node, "g_filledTimers"));
+	SIM_run(start + SIM_MS(150) - SIM_now());
+	start = Profile_run(&test, DC_MOTOR_ACW, &second);
+	/* The brake starts after the tick of the step timer, the step after the dead time ends it */
+	Profile_checkSteps(&test, "reversed profile without a free timer", start, DC_MOTOR_ACW, &second,
+			DC_MOTOR_DEAD_TIME_MS + DC_MOTOR_RAMP_STEP_MS);
+}
+
+int main(void)
+{
+	Test_profiles();
+	Test_reversal();
+	return SIM_exitCode();
+}
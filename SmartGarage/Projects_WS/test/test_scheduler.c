@@ -0,0 +1,328 @@
+/******************************************************************************
+ *
+ * File Name: test_scheduler.c
+ *
+ * Description: Host test of the system tick and the timer wheel of the scheduler,
+ * run in the scheduler application of sched_app.c:
+ * 1. The tick ISR time read with SCHEDULER_getIsrTime stays short while every timer
+ *    runs: the call backs are called by the dispatcher, not by the ISR. One tick with
+ *    the interrupts off in the main loop shows in the measured time as its latency.
+ * 2. One-shot timers shorter and longer than a wheel turn are called once, on their tick.
+ * 3. Periodic timers are called on every period from their start, without drift.
+ * 4. With every timer taken the start fails, a one-shot timer is free again once it
+ *    is called, and a stopped timer is not called any more.
+ * 5. A main loop held longer than some periods: the late calls are made at once, the
+ *    next ones are back on their period.
+ * 6. SCHEDULER_elapsedMs and SCHEDULER_isTimeout with a start taken before the time wraps.
+ *
+ *******************************************************************************/
+
+#include "sim.h"
+#include "sched_app.h"
+#include "scheduler.h"
+#include <stdio.h>
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+#define SCHED_TEST_BOOT_NS          SIM_MS(10)
+#define SCHED_TEST_COMMAND_NS       SIM_MS(10)
+#define SCHED_TEST_RUN_MS           1000
+/* Tick ISR from the compare match to its end: latency, entry and the time count */
+#define SCHED_TEST_ISR_BUDGET_US    40
+#define SCHED_TEST_ISR_BUDGET       (SCHED_TEST_ISR_BUDGET_US / SCHEDULER_COUNT_TIME_US)
+/* A timer counts from the last tick handled by the dispatcher, at most one tick before its start */
+#define SCHED_TEST_LATE_MS          SCHEDULER_TICK_MS
+#define SCHED_TEST_PERIODIC_RUN_MS  2000
+#define SCHED_TEST_LONG_MS          1000
+#define SCHED_TEST_LATE_PERIOD_MS   10
+#define SCHED_TEST_BUSY_MS          35
+#define SCHED_TEST_WRAP_MS          50
+#define SCHED_TEST_TIMEOUT_MS       100
+
+typedef struct
+{
+	SIM_NodeType *node;
+	volatile uint8 *command;
+	volatile uint16 *time;
+	volatile uint8 *mode;
+	volatile uint8 *tag;
+	volatile uint8 *id;
+	volatile uint32 *now;
+	volatile uint32 *start;
+	volatile uint32 *timeout;
+	volatile uint32 *elapsed;
+	volatile uint8 *isTimeout;
+	SCHEDULER_IsrTimeType *isrTime;
+	SCHED_APP_CallType *log;
+	volatile uint16 *logCount;
+}SCHED_TestType;
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
+
+static int Sched_idle(void *context)
+{
+	return *((SCHED_TestType *)context)->command == SCHED_APP_IDLE;
+}
+
+static void Sched_command(SCHED_TestType *test, uint8_t command)
+{
+	*test->command = command;
+	SIM_runUntil(Sched_idle, test, SCHED_TEST_COMMAND_NS);
+}
+
+static void Sched_start(SCHED_TestType *test)
+{
+	SIM_init();
+	test->node = SIM_addNode("control", "build/sched_app.so", "sched_main");
+	test->command = SIM_symbol(test->node, "g_command");
+	test->time = SIM_symbol(test->node, "g_time");
+	test->mode = SIM_symbol(test->node, "g_mode");
+	test->tag = SIM_symbol(test->node, "g_tag");
+	test->id = SIM_symbol(test->node, "g_id");
+	test->now = SIM_symbol(test->node, "g_now");
+	test->start = SIM_symbol(test->node, "g_start");
+	test->timeout = SIM_symbol(test->node, "g_timeout");
+	test->elapsed = SIM_symbol(test->node, "g_elapsed");
+	test->isTimeout = SIM_symbol(test->node, "g_isTimeout");
+	test->isrTime = SIM_symbol(test->node, "g_isrTime");
+	test->log = SIM_symbol(test->node, "g_log");
+	test->logCount = SIM_symbol(test->node, "g_logCount");
+	SIM_run(SCHED_TEST_BOOT_NS);
+}
+
+/* Start a timer with the call back of a tag, return its id */
+static uint8_t Sched_startTimer(SCHED_TestType *test, uint16_t time_ms, SCHEDULER_TimerMode mode, uint8_t tag)
+{
+	*test->time = time_ms;
+	*test->mode = mode;
+	*test->tag = tag;
+	Sched_command(test, SCHED_APP_START);
+	return *test->id;
+}
+
+static void Sched_stopTimer(SCHED_TestType *test, uint8_t id)
+{
+	*test->id = id;
+	Sched_command(test, SCHED_APP_STOP);
+}
+
+/* Times of the call backs of a tag in the log, return their number */
+static uint16_t Sched_calls(const SCHED_TestType *test, uint8_t tag, uint32_t *millis, uint16_t size)
+{
+	uint16_t count = 0;
+	uint16_t i;
+
+	for(i = 0 ; i < *test->logCount ; i++)
+	{
+		if(test->log[i].tag != tag)
+		{
+			continue;
+		}
+		if(count < size)
+		{
+			millis[count] = test->log[i].millis;
+		}
+		count++;
+	}
+	return count;
+}
+
+static void Test_isrTime(void)
+{
+	SCHED_TestType test;
+	uint8_t i;
+
+	Sched_start(&test);
+	for(i = 0 ; i < SCHEDULER_MAX_TIMERS ; i++)
+	{
+		Sched_startTimer(&test, (uint16_t)(i + 1), SCHEDULER_PERIODIC, i);
+	}
+	SIM_run(SIM_MS(SCHED_TEST_RUN_MS));
+	Sched_command(&test, SCHED_APP_ISR_TIME);
+	SIM_CHECK(*test.logCount > SCHED_TEST_RUN_MS * 2, "every timer: %u call backs in %u ms", *test.logCount,
+			SCHED_TEST_RUN_MS);
+	SIM_CHECK((test.isrTime->last <= test.isrTime->max) && (test.isrTime->max <= SCHED_TEST_ISR_BUDGET),
+			"tick ISR: last %u counts, longest %u counts of %u us (budget %u counts)", test.isrTime->last,
+			test.isrTime->max, SCHEDULER_COUNT_TIME_US, SCHED_TEST_ISR_BUDGET);
+
+	/* The compare match in the masked tick is served at the end of it */
+	Sched_command(&test, SCHED_APP_MASK);
+	SIM_run(SIM_MS(SCHEDULER_TICK_MS));
+	Sched_command(&test, SCHED_APP_ISR_TIME);
+	SIM_CHECK((test.isrTime->max > SCHED_TEST_ISR_BUDGET) &&
+			(test.isrTime->max <= (SCHED_APP_MASK_US + SCHED_TEST_ISR_BUDGET_US) / SCHEDULER_COUNT_TIME_US),
+			"tick ISR after %u us with the interrupts off: longest %u counts of %u us", SCHED_APP_MASK_US,
+			test.isrTime->max, SCHEDULER_COUNT_TIME_US);
+}
+
+static void Test_oneShot(void)
+{
+	static const uint16_t times[] = {1, 5, SCHEDULER_WHEEL_SIZE - 1, SCHEDULER_WHEEL_SIZE, SCHEDULER_WHEEL_SIZE + 1,
+			3 * SCHEDULER_WHEEL_SIZE + 7, SCHED_TEST_LONG_MS};
+	const uint8_t count = sizeof(times) / sizeof(times[0]);
+	SCHED_TestType test;
+	uint32_t start[sizeof(times) / sizeof(times[0])];
+	uint32_t millis;
+	uint32_t late;
+	uint8_t i;
+
+	Sched_start(&test);
+	for(i = 0 ; i < count ; i++)
+	{
+		Sched_startTimer(&test, times[i], SCHEDULER_ONE_SHOT, i);
+		start[i] = *test.now;
+	}
+	SIM_run(SIM_MS(SCHED_TEST_LONG_MS + 100));
+	for(i = 0 ; i < count ; i++)
+	{
+		millis = 0;
+		late = 0;
+		if(Sched_calls(&test, i, &millis, 1) == 1)
+		{
+			late = millis - start[i] - times[i];
+		}
+		SIM_CHECK((millis != 0) && (late <= SCHED_TEST_LATE_MS), "one-shot %u ms: called once, %u ms after its time",
+				times[i], late);
+	}
+}
+
+static void Test_periodic(void)
+{
+	static const uint16_t periods[] = {1, 7, SCHEDULER_WHEEL_SIZE, 2 * SCHEDULER_WHEEL_SIZE + 5, 250};
+	const uint8_t count = sizeof(periods) / sizeof(periods[0]);
+	static uint32_t millis[SCHED_TEST_PERIODIC_RUN_MS + 1];
+	SCHED_TestType test;
+	uint32_t start[sizeof(periods) / sizeof(periods[0])];
+	uint16_t calls;
+	uint16_t drift;
+	uint16_t n;
+	uint8_t i;
+
+	Sched_start(&test);
+	for(i = 0 ; i < count ; i++)
+	{
+		Sched_startTimer(&test, periods[i], SCHEDULER_PERIODIC, i);
+		start[i] = *test.now;
+	}
+	SIM_run(SIM_MS(SCHED_TEST_PERIODIC_RUN_MS));
+	for(i = 0 ; i < count ; i++)
+	{
+		/* The run starts a little after the timers, the first and the last calls may be in it or not */
+		calls = Sched_calls(&test, i, millis, SCHED_TEST_PERIODIC_RUN_MS + 1);
+		drift = 0;
+		for(n = 1 ; (n < calls) && (n <= SCHED_TEST_PERIODIC_RUN_MS) ; n++)
+		{
+			drift += (millis[n] - millis[0] != (uint32_t)n * periods[i]);
+		}
+		SIM_CHECK((calls + 1 >= SCHED_TEST_PERIODIC_RUN_MS / periods[i]) &&
+				(calls <= SCHED_TEST_PERIODIC_RUN_MS / periods[i] + 1) &&
+				(millis[0] - start[i] - periods[i] <= SCHED_TEST_LATE_MS) && (drift == 0),
+				"periodic %u ms: %u calls in %u ms, %u off their period", periods[i], calls, SCHED_TEST_PERIODIC_RUN_MS,
+				drift);
+	}
+}
+
+static void Test_freeAndStop(void)
+{
+	SCHED_TestType test;
+	uint8_t ids[SCHEDULER_MAX_TIMERS];
+	uint8_t taken = 1;
+	uint8_t i;
+
+	Sched_start(&test);
+	ids[0] = Sched_startTimer(&test, 10, SCHEDULER_ONE_SHOT, 0);
+	for(i = 1 ; i < SCHEDULER_MAX_TIMERS ; i++)
+	{
+		ids[i] = Sched_startTimer(&test, SCHED_TEST_LONG_MS, SCHEDULER_ONE_SHOT, i);
+		taken += (ids[i] != SCHEDULER_NO_TIMER) && (ids[i] != ids[i - 1]);
+	}
+	SIM_CHECK((taken == SCHEDULER_MAX_TIMERS) &&
+			(Sched_startTimer(&test, SCHED_TEST_LONG_MS, SCHEDULER_ONE_SHOT, 0) == SCHEDULER_NO_TIMER),
+			"%u timers: %u different ids, the next start fails", SCHEDULER_MAX_TIMERS, taken);
+
+	SIM_run(SIM_MS(20));
+	SIM_CHECK(Sched_startTimer(&test, 10, SCHEDULER_PERIODIC, 0) == ids[0], "one-shot called: its id is free again");
+
+	/* Stop the new periodic timer after two calls and a long one-shot before its call */
+	SIM_run(SIM_MS(25));
+	Sched_stopTimer(&test, ids[0]);
+	Sched_stopTimer(&test, ids[1]);
+	SIM_run(SIM_MS(SCHED_TEST_LONG_MS));
+	SIM_CHECK((Sched_calls(&test, 0, NULL, 0) == 3) && (Sched_calls(&test, 1, NULL, 0) == 0) &&
+			(Sched_calls(&test, 2, NULL, 0) == 1), "stopped timers: not called any more, the others are");
+}
+
+static void Test_lateDispatch(void)
+{
+	static uint32_t millis[SCHED_APP_LOG_SIZE];
+	SCHED_TestType test;
+	uint16_t calls;
+	uint16_t late = 0;
+	uint16_t drift = 0;
+	uint32_t burst = 0;
+	uint16_t n;
+
+	Sched_start(&test);
+	Sched_startTimer(&test, SCHED_TEST_LATE_PERIOD_MS, SCHEDULER_PERIODIC, 0);
+	SIM_run(SIM_MS(4 * SCHED_TEST_LATE_PERIOD_MS + SCHED_TEST_LATE_PERIOD_MS / 2));
+	*test.time = SCHED_TEST_BUSY_MS;
+	Sched_command(&test, SCHED_APP_BUSY);
+	SIM_run(SIM_MS(10 * SCHED_TEST_LATE_PERIOD_MS));
+
+	/* The calls off their period are the late ones, all made at the end of the busy time */
+	calls = Sched_calls(&test, 0, millis, SCHED_APP_LOG_SIZE);
+	for(n = 1 ; n < calls ; n++)
+	{
+		if(millis[n] - millis[0] == (uint32_t)n * SCHED_TEST_LATE_PERIOD_MS)
+		{
+			continue;
+		}
+		late++;
+		if(burst == 0)
+		{
+			burst = millis[n];
+		}
+		drift += (millis[n] != burst);
+	}
+	/* The call due as the busy time ends may be on time or in the late ones */
+	SIM_CHECK((late >= SCHED_TEST_BUSY_MS / SCHED_TEST_LATE_PERIOD_MS) &&
+			(late <= SCHED_TEST_BUSY_MS / SCHED_TEST_LATE_PERIOD_MS + 1) && (drift == 0) &&
+			(millis[calls - 1] - millis[0] == (uint32_t)(calls - 1) * SCHED_TEST_LATE_PERIOD_MS),
+			"main loop held %u ms: %u late calls made at once, the next ones on their period", SCHED_TEST_BUSY_MS, late);
+}
+
+static void Test_wrap(void)
+{
+	SCHED_TestType test;
+	uint32 now;
+
+	/* The start wraps in the uint32 of the ECU code, wider than 32 bits on the host */
+	Sched_start(&test);
+	*test.start = (uint32)0 - SCHED_TEST_WRAP_MS;
+	*test.timeout = 0;
+	Sched_command(&test, SCHED_APP_ELAPSED);
+	now = *test.now;
+	SIM_CHECK(*test.elapsed - now - SCHED_TEST_WRAP_MS <= SCHEDULER_TICK_MS,
+			"start %u ms before the wrap: %lu ms elapsed at %lu ms", SCHED_TEST_WRAP_MS, *test.elapsed, now);
+
+	*test.timeout = now + SCHED_TEST_WRAP_MS + SCHED_TEST_TIMEOUT_MS;
+	Sched_command(&test, SCHED_APP_ELAPSED);
+	SIM_CHECK(*test.isTimeout == FALSE, "start before the wrap: no timeout before its time");
+	SIM_run(SIM_MS(SCHED_TEST_TIMEOUT_MS + SCHEDULER_TICK_MS));
+	Sched_command(&test, SCHED_APP_ELAPSED);
+	SIM_CHECK(*test.isTimeout == TRUE, "start before the wrap: timeout after %lu ms", *test.elapsed);
+}
+
+int main(void)
+{
+	Test_isrTime();
+	Test_oneShot();
+	Test_periodic();
+	Test_freeAndStop();
+	Test_lateDispatch();
+	Test_wrap();
+	return SIM_exitCode();
+}
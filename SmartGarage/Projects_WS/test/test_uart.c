@@ -0,0 +1,152 @@
+/******************************************************************************
+ *
+ * File Name: test_uart.c
+ *
+ * Description: Host test of the interrupt driven UART driver. A peer sends a
+ * burst that fills the RX ring buffer while the main loop is busy elsewhere,
+ * at each rate of the UBRR table. With the old busy-wait driver only the two
+ * bytes of the hardware FIFO survive such a burst, the rest are overruns.
+ *
+ *******************************************************************************/
+
+#include "sim.h"
+#include "uart.h"
+#include <stdio.h>
+
+/*******************************************************************************
+ *                                Definitions                                  *
+ *******************************************************************************/
+#define BURST_SIZE          (UART_RX_BUFFER_SIZE - 1)
+#define BUSY_MARGIN_MS      20
+
+static const uint32_t g_rates[UART_BAUD_COUNT] = {9600, 19200, 38400, 76800, 250000};
+
+/*******************************************************************************
+ *                      Functions Definitions                                  *
+ *******************************************************************************/
+
+static void Test_burst(uint8_t rate)
+{
+	SIM_NodeType *node;
+	SIM_PeerType *peer;
+	UART_StatsType stats;
+	void (*getStats)(UART_StatsType *stats);
+	volatile uint8 *received;
+	volatile uint16 *receivedCount;
+	uint8_t burst[BURST_SIZE];
+	uint32_t burst_ms = (uint32_t)((uint64_t)BURST_SIZE * 10 * 1000 / g_rates[rate]) + 1;
+	uint16_t in_order = 0;
+	uint16_t echoed = 0;
+	uint16_t i;
+
+	SIM_init();
+	node = SIM_addNode("uart", "build/uart.so", "uart_main");
+	peer = SIM_addPeer(node, SIM_BIT_NS(g_rates[rate]));
+	*(volatile uint8 *)SIM_symbol(node, "g_baudRate") = rate;
+	/* The main loop is away for longer than the whole burst */
+	*(volatile uint16 *)SIM_symbol(node, "g_busyMs") = (uint16)(burst_ms + BUSY_MARGIN_MS);
+	received = SIM_symbol(node, "g_received");
+	receivedCount = SIM_symbol(node, "g_receivedCount");
+	getStats = (void (*)(UART_StatsType *))SIM_symbol(node, "UART_getStats");
+
+	/* Let UART_init run, then send the burst right after the main loop went busy */
+	SIM_run(SIM_MS(1));
+	for(i = 0 ; i < BURST_SIZE ; i++)
+	{
+		burst[i] = (uint8_t)(i * 7 + 1);
+	}
+	SIM_peerSend(peer, burst, BURST_SIZE);
+	SIM_run(SIM_MS(2 * (burst_ms + BUSY_MARGIN_MS)) + SIM_MS(2 * burst_ms));
+
+	(*getStats)(&stats);
+	for(i = 0 ; (i < *receivedCount) && (i < BURST_SIZE) ; i++)
+	{
+		in_order += (received[i] == burst[i]);
+	}
+	for(i = 0 ; (i < peer->logCount) && (i < BURST_SIZE) ; i++)
+	{
+		echoed += (peer->log[i] == burst[i]) && !peer->logError[i];
+	}
+
+	SIM_CHECK(stats.overrun_errors == 0, "%6lu baud: no DOR while busy %u ms (got %u)",
+			(unsigned long)g_rates[rate], (unsigned)(burst_ms + BUSY_MARGIN_MS), stats.overrun_errors);
+	SIM_CHECK(stats.rx_overflows == 0, "%6lu baud: no RX ring buffer overflow (got %u)",
+			(unsigned long)g_rates[rate], stats.rx_overflows);
+	SIM_CHECK(stats.framing_errors == 0, "%6lu baud: no framing error (got %u)",
+			(unsigned long)g_rates[rate], stats.framing_errors);
+	SIM_CHECK((*receivedCount == BURST_SIZE) && (in_order == BURST_SIZE),
+			"%6lu baud: %u of %u bytes read in order", (unsigned long)g_rates[rate], in_order, BURST_SIZE);
+	SIM_CHECK((peer->logCount == BURST_SIZE) && (echoed == BURST_SIZE),
+			"%6lu baud: %u of %u bytes echoed back in order", (unsigned long)g_rates[rate], echoed, BURST_SIZE);
+	SIM_CHECK(node->isrCount[SIM_USART_RXC] == BURST_SIZE, "%6lu baud: one RXC interrupt per byte (%u)",
+			(unsigned long)g_rates[rate], (unsigned)node->isrCount[SIM_USART_RXC]);
+}
+
+/*
+ * Description :
+ * One byte more than the ring buffer holds: the extra byte is counted in rx_overflows
+ * and not as a hardware overrun, so the counter tells the two cases apart.
+ */
+static void Test_overflow(void)
+{
+	SIM_NodeType *node;
+	SIM_PeerType *peer;
+	UART_StatsType stats;
+	void (*getStats)(UART_StatsType *stats);
+	uint8_t burst[BURST_SIZE + 1] = {0};
+
+	SIM_init();
+	node = SIM_addNode("uart", "build/uart.so", "uart_main");
+	peer = SIM_addPeer(node, SIM_BIT_NS(250000));
+	*(volatile uint8 *)SIM_symbol(node, "g_baudRate") = UART_BAUD_250000;
+	*(volatile uint16 *)SIM_symbol(node, "g_busyMs") = 50;
+	getStats = (void (*)(UART_StatsType *))SIM_symbol(node, "UART_getStats");
+
+	SIM_run(SIM_MS(1));
+	SIM_peerSend(peer, burst, sizeof(burst));
+	SIM_run(SIM_MS(120));
+
+	(*getStats)(&stats);
+	SIM_CHECK((stats.rx_overflows == 1) && (stats.overrun_errors == 0),
+			"one byte over the ring buffer: rx_overflows %u, overrun_errors %u",
+			stats.rx_overflows, stats.overrun_errors);
+}
+
+/*
+ * Description :
+ * Same burst with the I-bit clear: the simulator must see the bytes the hardware
+ * FIFO cannot hold, or the checks above would prove nothing.
+ */
+static void Test_withoutInterrupts(void)
+{
+	SIM_NodeType *node;
+	SIM_PeerType *peer;
+	uint8_t burst[BURST_SIZE] = {0};
+
+	SIM_init();
+	node = SIM_addNode("uart", "build/uart.so", "uart_main");
+	peer = SIM_addPeer(node, SIM_BIT_NS(9600));
+	*(volatile uint8 *)SIM_symbol(node, "g_interrupts") = 0;
+	*(volatile uint16 *)SIM_symbol(node, "g_busyMs") = 100;
+
+	SIM_run(SIM_MS(1));
+	SIM_peerSend(peer, burst, sizeof(burst));
+	SIM_run(SIM_MS(100));
+
+	SIM_CHECK(node->rxOverrun == BURST_SIZE - SIM_RX_FIFO_SIZE,
+			"polling while busy: %u of %u bytes lost in the hardware FIFO",
+			(unsigned)node->rxOverrun, BURST_SIZE);
+}
+
+int main(void)
+{
+	uint8_t rate;
+
+	for(rate = 0 ; rate < UART_BAUD_COUNT ; rate++)
+	{
+		Test_burst(rate);
+	}
+	Test_overflow();
+	Test_withoutInterrupts();
+	return SIM_exitCode();
+}
@@ -0,0 +1,60 @@
+/******************************************************************************
+ *
+ * File Name: uart_app.c
+ *
+ * Description: ECU application of the UART test. The main loop stays busy for
+ * g_busyMs between two reads of the RX ring buffer, then echoes what it read.
+ *
+ *******************************************************************************/
+
+#include "uart.h"
+#include <avr/io.h>
+#include <util/delay.h>
+
+/*******************************************************************************
+ *                             Global Variables                                *
+ *******************************************************************************/
+/* Set by the test before the first quantum */
+volatile uint8 g_baudRate = UART_BAUD_9600;
+volatile uint16 g_busyMs = 0;
+/* Zero leaves the I-bit clear, like the old driver polling RXC while busy elsewhere */
+volatile uint8 g_interrupts = 1;
+
+/* Bytes read by the main loop, in order */
+volatile uint8 g_received[1024];
+volatile uint16 g_receivedCount = 0;
+
+int uart_main(void)
+{
+	UART_ConfigType config = {EIGHT, DISABLED, ONE, UART_BAUD_9600};
+	uint8 data[UART_RX_BUFFER_SIZE];
+	uint8 count;
+	uint8 i;
+
+	config.baud_rate = g_baudRate;
+	UART_init(&config);
+	if(g_interrupts)
+	{
+		SREG |= (1<<7);
+	}
+
+	while(1)
+	{
+		/* Busy elsewhere, the RX interrupt keeps the bytes in the ring buffer */
+		_delay_ms(g_busyMs);
+
+		count = UART_read(data, sizeof(data));
+		for(i = 0 ; i < count ; i++)
+		{
+			if(g_receivedCount < sizeof(g_received))
+			{
+				g_received[g_receivedCount++] = data[i];
+			}
+		}
+		/* The TX ring buffer is smaller than the RX one, queue the echo as it drains */
+		for(i = 0 ; i < count ; )
+		{
+			i += UART_write(&data[i], count - i);
+		}
+	}
+}